@@ -0,0 +1,368 @@
+#ifndef LIBS_HEADER_ANIMATION_H
+#define LIBS_HEADER_ANIMATION_H
+
+#include "camera.h"
+#include "constants.h"
+#include "frame.h"
+#include "image_output.h"
+#include "primitive.h"
+#include "scene.h"
+#include "vec3.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace LNF
+{
+    /* Keyframed value (linear interpolation between keys; first/last key is held outside of the key range) */
+    template <typename value_type>
+    class Track
+    {
+     public:
+        struct Key {
+            float           m_fTime;
+            value_type      m_value;
+        };
+
+     public:
+        /* add key at time _fTime (seconds); keys may be added in any order */
+        Track &addKey(float _fTime, const value_type &_value) {
+            auto it = std::upper_bound(m_keys.begin(), m_keys.end(), _fTime, [](float _fT, const Key &_key) {
+                return _fT < _key.m_fTime;
+            });
+
+            m_keys.insert(it, Key{_fTime, _value});
+            return *this;
+        }
+
+        bool empty() const {
+            return m_keys.empty();
+        }
+
+        const std::vector<Key> &keys() const {
+            return m_keys;
+        }
+
+        /* returns the value at time _fTime (track may not be empty) */
+        value_type value(float _fTime) const {
+            auto it = std::upper_bound(m_keys.begin(), m_keys.end(), _fTime, [](float _fT, const Key &_key) {
+                return _fT < _key.m_fTime;
+            });
+
+            if (it == m_keys.begin()) {
+                return m_keys.front().m_value;
+            }
+            else if (it == m_keys.end()) {
+                return m_keys.back().m_value;
+            }
+
+            const auto &a = *(it - 1);
+            const auto &b = *it;
+            float f = (_fTime - a.m_fTime) / (b.m_fTime - a.m_fTime);
+            return a.m_value + (b.m_value - a.m_value) * f;
+        }
+
+        /* returns the value at time _fTime or _default if the track is empty */
+        value_type value(float _fTime, const value_type &_default) const {
+            return m_keys.empty() ? _default : value(_fTime);
+        }
+
+     private:
+        std::vector<Key>        m_keys;
+    };
+
+
+    /* Keyframed camera (values are fixed where tracks have no keys) */
+    class CameraPath
+    {
+     public:
+        CameraPath(const Vec &_origin, const Vec &_up, const Vec &_lookat, float _fFov, float _fAperture, float _fFocusDist)
+            :m_originDefault(_origin),
+             m_up(_up),
+             m_lookatDefault(_lookat),
+             m_fFovDefault(_fFov),
+             m_fApertureDefault(_fAperture),
+             m_fFocusDistDefault(_fFocusDist)
+        {}
+
+        Track<Vec> &origin() {return m_origin;}
+        Track<Vec> &lookat() {return m_lookat;}
+        Track<float> &fov() {return m_fov;}
+        Track<float> &aperture() {return m_aperture;}
+        Track<float> &focusDistance() {return m_focusDist;}
+
+        /* returns camera at time _fTime (seconds) */
+        std::unique_ptr<Camera> camera(float _fTime) const {
+            return std::make_unique<SimpleCamera>(m_origin.value(_fTime, m_originDefault),
+                                                  m_up,
+                                                  m_lookat.value(_fTime, m_lookatDefault),
+                                                  m_fov.value(_fTime, m_fFovDefault),
+                                                  m_aperture.value(_fTime, m_fApertureDefault),
+                                                  m_focusDist.value(_fTime, m_fFocusDistDefault));
+        }
+
+     private:
+        Vec             m_originDefault;
+        Vec             m_up;
+        Vec             m_lookatDefault;
+        float           m_fFovDefault;
+        float           m_fApertureDefault;
+        float           m_fFocusDistDefault;
+        Track<Vec>      m_origin;
+        Track<Vec>      m_lookat;
+        Track<float>    m_fov;
+        Track<float>    m_aperture;
+        Track<float>    m_focusDist;
+    };
+
+
+    /* Camera circling around _lookat (around up axis) once in _fPeriodS seconds, starting at _origin */
+    inline CameraPath turntablePath(const Vec &_origin, const Vec &_up, const Vec &_lookat, float _fFov, float _fAperture, float _fFocusDist, float _fPeriodS, int _iKeys = 64) {
+        CameraPath path(_origin, _up, _lookat, _fFov, _fAperture, _fFocusDist);
+        const Vec up = _up.normalized();
+        const Vec offset = _origin - _lookat;
+        const Vec height = up * (offset * up);
+        const Vec radial = offset - height;
+        const Vec side = crossProduct(up, radial);
+
+        for (int i = 0; i <= _iKeys; i++) {
+            float fAngle = 2 * LNF::pi * i / _iKeys;
+            path.origin().addKey(_fPeriodS * i / _iKeys, _lookat + height + radial * cos(fAngle) + side * sin(fAngle));
+        }
+
+        return path;
+    }
+
+
+    /* Keyframed instance position and orientation (euler angles: alpha/Z, beta/Y, gamma/X) */
+    class InstancePath
+    {
+     public:
+        InstancePath(PrimitiveInstance *_pInstance)
+            :m_pInstance(_pInstance)
+        {}
+
+        Track<Vec> &position() {return m_position;}
+        Track<Vec> &rotation() {return m_rotation;}
+
+        /* moves/rotates instance (not safe while frames are rendering) */
+        void apply(float _fTime) const {
+            if (m_rotation.empty() == false) {
+                auto angles = m_rotation.value(_fTime);
+                m_pInstance->rotateEulerZYX(angles.x(), angles.y(), angles.z());
+            }
+
+            if (m_position.empty() == false) {
+                m_pInstance->move(m_position.value(_fTime));
+            }
+        }
+
+     private:
+        PrimitiveInstance       *m_pInstance;
+        Track<Vec>              m_position;
+        Track<Vec>              m_rotation;
+    };
+
+
+    /* Camera and instance tracks for a range of frames */
+    class Animation
+    {
+     public:
+        Animation(const CameraPath &_camera, int _iFrameCount, float _fFramesPerSecond = 30.0f)
+            :m_camera(_camera),
+             m_iFrameCount(_iFrameCount),
+             m_fFramesPerSecond(_fFramesPerSecond)
+        {}
+
+        CameraPath &camera() {return m_camera;}
+
+        InstancePath &addInstancePath(PrimitiveInstance *_pInstance) {
+            m_instances.emplace_back(_pInstance);
+            return m_instances.back();
+        }
+
+        int frameCount() const {
+            return m_iFrameCount;
+        }
+
+        /* returns time (seconds) of frame */
+        float frameTime(int _iFrame) const {
+            return _iFrame / m_fFramesPerSecond;
+        }
+
+        /* returns true if the scene changes between frames (frames can then not be rendered concurrently) */
+        bool movesInstances() const {
+            return m_instances.empty() == false;
+        }
+
+        /* returns camera for frame */
+        std::unique_ptr<Camera> camera(int _iFrame) const {
+            return m_camera.camera(frameTime(_iFrame));
+        }
+
+        /* moves instances to frame and updates the scene (not safe while frames are rendering) */
+        void applyInstances(int _iFrame, Scene *_pScene) const {
+            if (m_instances.empty() == false) {
+                for (const auto &path : m_instances) {
+                    path.apply(frameTime(_iFrame));
+                }
+
+                _pScene->update();
+            }
+        }
+
+     private:
+        CameraPath                  m_camera;
+        std::vector<InstancePath>   m_instances;
+        int                         m_iFrameCount;
+        float                       m_fFramesPerSecond;
+    };
+
+
+    /* returns true if _strPattern is a valid frame path pattern (exactly one %d/%i/%u conversion with optional flags and width; %% is allowed) */
+    inline bool isFramePathPattern(const std::string &_strPattern) {
+        int iConversions = 0;
+        for (size_t i = 0; i < _strPattern.size(); i++) {
+            if (_strPattern[i] != '%') {
+                continue;
+            }
+            
+            if ( (++i < _strPattern.size()) && (_strPattern[i] == '%') ) {
+                continue;
+            }
+            
+            while ( (i < _strPattern.size()) && (strchr("-+ #0", _strPattern[i]) != nullptr) ) i++;
+            while ( (i < _strPattern.size()) && (isdigit((unsigned char)_strPattern[i]) != 0) ) i++;
+            if ( (i >= _strPattern.size()) || (strchr("diu", _strPattern[i]) == nullptr) ) {
+                return false;
+            }
+            
+            iConversions++;
+        }
+        
+        return iConversions == 1;
+    }
+
+
+    /* returns output path for frame (printf style pattern with one integer, e.g. "frame_%04d.jpeg"; see isFramePathPattern()) */
+    inline std::string framePath(const std::string &_strPattern, int _iFrame) {
+        assert(isFramePathPattern(_strPattern) == true);
+        char szPath[1024];
+        snprintf(szPath, sizeof(szPath), _strPattern.c_str(), _iFrame);
+        return szPath;
+    }
+
+
+    /*
+     Renders a range of animation frames to a numbered image sequence.
+     Two frames are used in turn: the next frame is started before waiting for the previous
+     one, so its jobs fill the workers while the previous frame's last tiles finish. Both frames render on the
+     worker threads of the first frame (one set of threads and per thread arenas for the sequence).
+     Images are written by the output stage, as rows complete (JPEG, PNG or EXR, from the pattern extension).
+     If the animation moves instances, the scene can only be changed once no frame is rendering, so just the
+     image writing is overlapped.
+     */
+    class AnimationRenderer
+    {
+     public:
+        /*
+         Creates a frame for the given camera on the given workers (frames are restarted with new cameras for later frames).
+         Workers are nullptr for the first frame (the frame creates them); the second frame gets the first frame's workers.
+         */
+        using frame_factory_type = std::function<std::unique_ptr<Frame>(const Camera *, const std::shared_ptr<PixelWorkerPool> &)>;
+
+        // called after a frame was written (frame index, frame, output path)
+        using frame_callback_type = std::function<void(int, Frame &, const std::string &)>;
+
+     public:
+        AnimationRenderer(const Animation *_pAnimation, Scene *_pScene, const frame_factory_type &_frameFactory)
+            :m_pAnimation(_pAnimation),
+             m_pScene(_pScene),
+             m_frameFactory(_frameFactory)
+        {}
+
+        /* renders frames [_iFirst, _iLast] and writes them as images; returns 0 on success (1 if the path pattern is not valid) */
+        int render(int _iFirst, int _iLast, const std::string &_strPathPattern, int _iQuality, const frame_callback_type &_callback = nullptr) {
+            if (isFramePathPattern(_strPathPattern) == false) {
+                return 1;
+            }
+            
+            int iPrevious = -1;
+            int iResult = 0;
+
+            for (int i = _iFirst; i <= _iLast; i++) {
+                const int iSlot = i % 2;
+                if (m_pAnimation->movesInstances() == true) {
+                    if (iPrevious >= 0) {
+                        m_frames[iPrevious % 2]->waitFinished();
+                    }
+
+                    m_pAnimation->applyInstances(i, m_pScene);
+                }
+
+                // start frame (the frame in this slot was finished and written two frames ago)
+                auto pCamera = m_pAnimation->camera(i);
+                if (m_frames[iSlot] == nullptr) {
+                    const auto &pOther = m_frames[1 - iSlot];
+                    m_frames[iSlot] = m_frameFactory(pCamera.get(), pOther != nullptr ? pOther->workers() : nullptr);
+                }
+                else {
+                    m_frames[iSlot]->restart(pCamera.get());
+                }
+
+                m_cameras[iSlot] = std::move(pCamera);
+                m_outputs[iSlot] = m_output.write(m_frames[iSlot].get(), framePath(_strPathPattern, i), _iQuality);
+
+                if (iPrevious >= 0) {
+                    iResult |= finishFrame(iPrevious, _strPathPattern, _callback);
+                }
+
+                iPrevious = i;
+            }
+
+            if (iPrevious >= 0) {
+                iResult |= finishFrame(iPrevious, _strPathPattern, _callback);
+            }
+
+            return iResult;
+        }
+
+     private:
+        // waits for frame and its output (while the next frame is rendering)
+        int finishFrame(int _iFrame, const std::string &_strPathPattern, const frame_callback_type &_callback) {
+            auto &frame = *m_frames[_iFrame % 2];
+            frame.waitFinished();
+
+            auto strPath = framePath(_strPathPattern, _iFrame);
+            int iResult = m_outputs[_iFrame % 2].get();
+
+            if (_callback != nullptr) {
+                _callback(_iFrame, frame, strPath);
+            }
+
+            return iResult;
+        }
+
+     private:
+        const Animation             *m_pAnimation;
+        Scene                       *m_pScene;
+        frame_factory_type          m_frameFactory;
+        std::unique_ptr<Frame>      m_frames[2];
+        std::unique_ptr<Camera>     m_cameras[2];
+        ImageOutput                 m_output;           // destroyed (finished) before the frames
+        std::shared_future<int>     m_outputs[2];
+    };
+
+
+};  // namespace LNF
+
+
+#endif  // #ifndef LIBS_HEADER_ANIMATION_H
@@ -0,0 +1,183 @@
+#ifndef LIBS_HEADER_ARENA_H
+#define LIBS_HEADER_ARENA_H
+
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+namespace LNF
+{
+    /* Arena memory usage */
+    struct ArenaStats
+    {
+        void print(const char *_pszName) const {
+            printf("%s arena: used=%.2fMB, reserved=%.2fMB, blocks=%d, allocations=%d, objects=%d\n",
+                   _pszName, m_uUsedBytes / (1024.0 * 1024.0), m_uReservedBytes / (1024.0 * 1024.0),
+                   (int)m_uBlockCount, (int)m_uAllocationCount, (int)m_uObjectCount);
+        }
+
+        size_t      m_uUsedBytes = 0;           // allocated bytes (including alignment padding)
+        size_t      m_uReservedBytes = 0;       // block memory
+        size_t      m_uBlockCount = 0;
+        size_t      m_uAllocationCount = 0;
+        size_t      m_uObjectCount = 0;         // objects with destructors (created or adopted)
+    };
+
+
+    /*
+     Monotonic (bump) allocator: memory is carved from large blocks and only released all at once (release() or destructor).
+     Objects created with create() or adopted with adopt() are destroyed in reverse order on release.
+     Can be used as a std::pmr memory resource (deallocate is a no-op).
+     Not thread safe.
+     */
+    class Arena  : public std::pmr::memory_resource
+    {
+     public:
+        static constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+     public:
+        explicit Arena(size_t _uBlockSize = DEFAULT_BLOCK_SIZE)
+            :m_uBlockSize(_uBlockSize),
+             m_pBlocks(nullptr),
+             m_pDestructors(nullptr),
+             m_pNext(nullptr),
+             m_pEnd(nullptr)
+        {}
+
+        Arena(const Arena &) = delete;
+        Arena &operator=(const Arena &) = delete;
+
+        virtual ~Arena() {
+            release();
+        }
+
+        /* construct object in arena (destroyed on release) */
+        template <typename object_type, class... T>
+        object_type *create(T &&... t) {
+            auto *pObject = new (allocate(sizeof(object_type), alignof(object_type))) object_type(std::forward<T>(t)...);
+            if constexpr (std::is_trivially_destructible<object_type>::value == false) {
+                addDestructor(pObject, [](void *_p) {static_cast<object_type*>(_p)->~object_type();});
+            }
+
+            return pObject;
+        }
+
+        /* take ownership of a heap allocated object (deleted on release) */
+        template <typename object_type>
+        object_type *adopt(std::unique_ptr<object_type> &&_pObject) {
+            auto *pObject = _pObject.release();
+            addDestructor(pObject, [](void *_p) {delete static_cast<object_type*>(_p);});
+            return pObject;
+        }
+
+        /* allocate uninitialised array (trivial types only; not destroyed) */
+        template <typename value_type>
+        value_type *allocateArray(size_t _uCount) {
+            static_assert(std::is_trivially_destructible<value_type>::value == true, "arena arrays are not destroyed");
+            return static_cast<value_type*>(allocate(sizeof(value_type) * std::max<size_t>(_uCount, 1), alignof(value_type)));
+        }
+
+        /* destroy all objects and free all blocks */
+        void release() {
+            for (auto *pEntry = m_pDestructors; pEntry != nullptr; pEntry = pEntry->m_pNext) {
+                pEntry->m_destroy(pEntry->m_pObject);
+            }
+
+            while (m_pBlocks != nullptr) {
+                auto *pBlock = m_pBlocks;
+                m_pBlocks = pBlock->m_pNext;
+                ::operator delete(pBlock);
+            }
+
+            m_pDestructors = nullptr;
+            m_pNext = nullptr;
+            m_pEnd = nullptr;
+            m_stats = ArenaStats();
+        }
+
+        const ArenaStats &stats() const {
+            return m_stats;
+        }
+
+     protected:
+        virtual void *do_allocate(size_t _uBytes, size_t _uAlignment) override {
+            auto *pAligned = alignUp(m_pNext, _uAlignment);
+            if ( (pAligned == nullptr) || (pAligned + _uBytes > m_pEnd) ) {
+                addBlock(_uBytes + _uAlignment);
+                pAligned = alignUp(m_pNext, _uAlignment);
+            }
+
+            m_stats.m_uUsedBytes += (pAligned + _uBytes) - m_pNext;
+            m_stats.m_uAllocationCount++;
+            m_pNext = pAligned + _uBytes;
+            return pAligned;
+        }
+
+        virtual void do_deallocate(void *, size_t, size_t) override {}
+
+        virtual bool do_is_equal(const std::pmr::memory_resource &_other) const noexcept override {
+            return this == &_other;
+        }
+
+     private:
+        struct Block {
+            Block       *m_pNext;
+        };
+
+        struct Destructor {
+            void        *m_pObject;
+            void        (*m_destroy)(void *);
+            Destructor  *m_pNext;
+        };
+
+        static char *alignUp(char *_p, size_t _uAlignment) {
+            if (_p == nullptr) {
+                return nullptr;
+            }
+
+            return reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(_p) + _uAlignment - 1) & ~(uintptr_t)(_uAlignment - 1));
+        }
+
+        // start a new block (large allocations get their own block)
+        void addBlock(size_t _uMinBytes) {
+            const size_t uHeader = alignof(std::max_align_t) * ((sizeof(Block) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t));
+            const size_t uSize = std::max(m_uBlockSize, _uMinBytes + uHeader);
+            auto *pBlock = static_cast<Block*>(::operator new(uSize));
+            pBlock->m_pNext = m_pBlocks;
+            m_pBlocks = pBlock;
+
+            m_pNext = reinterpret_cast<char*>(pBlock) + uHeader;
+            m_pEnd = reinterpret_cast<char*>(pBlock) + uSize;
+            m_stats.m_uReservedBytes += uSize;
+            m_stats.m_uBlockCount++;
+        }
+
+        // destructors are kept as a list in the arena itself (newest first)
+        void addDestructor(void *_pObject, void (*_destroy)(void *)) {
+            auto *pEntry = new (allocate(sizeof(Destructor), alignof(Destructor))) Destructor{_pObject, _destroy, m_pDestructors};
+            m_pDestructors = pEntry;
+            m_stats.m_uObjectCount++;
+        }
+
+     private:
+        size_t          m_uBlockSize;
+        Block           *m_pBlocks;
+        Destructor      *m_pDestructors;
+        char            *m_pNext;
+        char            *m_pEnd;
+        ArenaStats      m_stats;
+    };
+
+
+};  // namespace LNF
+
+
+#endif  // #ifndef LIBS_HEADER_ARENA_H
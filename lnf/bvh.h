@@ -2,20 +2,48 @@
 #ifndef LIBS_HEADER_BVH_H
 #define LIBS_HEADER_BVH_H
 
+#include "arena.h"
 #include "constants.h"
+#include "counters.h"
+#include "jobs.h"
+#include "mapped_file.h"
+#include "simd.h"
 #include "vec3.h"
 #include "ray.h"
 
 #include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <memory_resource>
+#include <thread>
 #include <vector>
 #include <unordered_set>
 
 
 namespace LNF
 {
+    /* BVH node width (binary or collapsed wide BVH for SIMD traversal) */
+    enum class BvhWidth
+    {
+        BINARY = 2,
+        WIDE4 = 4,
+        WIDE8 = 8
+    };
+
+
+    /* BVH build strategies */
+    enum class BvhBuildMethod
+    {
+        MIDPOINT,       // split bounds in half on the longest axis
+        SAH             // binned surface area heuristic (across all three axes)
+    };
+
+
     // calculates bouds of nodes
-    template <typename node_type>
-    Bounds findBounds(const std::vector<const node_type*> &_nodes) {
+    template <typename node_type, typename allocator_type>
+    Bounds findBounds(const std::vector<const node_type*, allocator_type> &_nodes) {
         Bounds bounds = _nodes[0]->bounds();
                 
         for (auto &pNode : _nodes) {
@@ -29,9 +57,9 @@ namespace LNF
 
 
     // split nodes into 'left' or 'right' groups (using left as default if a node intersects with both)
-    template <typename node_type>
-    void splitNodes(std::vector<const node_type*> &_nodesLeft, std::vector<const node_type*> &_nodesRight,
-                    const std::vector<const node_type*> &_nodes,
+    template <typename node_type, typename allocator_type>
+    void splitNodes(std::vector<const node_type*, allocator_type> &_nodesLeft, std::vector<const node_type*, allocator_type> &_nodesRight,
+                    const std::vector<const node_type*, allocator_type> &_nodes,
                     const Bounds &_boundsLeft, const Bounds &_boundsRight)
     {
         for (auto &pNode : _nodes) {
@@ -49,11 +77,17 @@ namespace LNF
 
     /*
      Bounding volume hyrarchy nodes.
+     Build trees are allocated from an arena (nodes and primitive lists) and released all at once after flattening.
      */
     template <typename primitive_type>
     struct BvhNode
     {
-        BvhNode() noexcept
+        using primitive_list_type = std::pmr::vector<const primitive_type*>;
+        
+        explicit BvhNode(Arena &_arena) noexcept
+            :m_left(nullptr),
+             m_right(nullptr),
+             m_primitives(&_arena)
         {}
         
         bool intersect(const Ray &_ray) const {
@@ -65,9 +99,9 @@ namespace LNF
         }
         
         Bounds                              m_bounds;
-        std::unique_ptr<BvhNode>            m_left;
-        std::unique_ptr<BvhNode>            m_right;
-        std::vector<const primitive_type*>  m_primitives;       // primitives (leaf nodes)
+        BvhNode                             *m_left;
+        BvhNode                             *m_right;
+        primitive_list_type                 m_primitives;       // primitives (leaf nodes)
     };
 
 
@@ -75,23 +109,24 @@ namespace LNF
      Build BVH tree recursively
      */
     template <size_t BVH_MIN_NODE_SIZE, typename primitive_type>
-    std::unique_ptr<BvhNode<primitive_type>> buildBvhNode(const std::vector<const primitive_type*> &_primitives,
-                                                          const Bounds &_splitBounds,
-                                                          int _iDepth)
+    BvhNode<primitive_type> *buildBvhNode(Arena &_arena,
+                                          const typename BvhNode<primitive_type>::primitive_list_type &_primitives,
+                                          const Bounds &_splitBounds,
+                                          int _iDepth)
     {
         // create node
-        auto node = std::make_unique<BvhNode<primitive_type>>();
+        auto node = _arena.create<BvhNode<primitive_type>>(_arena);
 
         // split in left and right
         auto boxes = splitBox(_splitBounds);
-        std::vector<const primitive_type*> left;
-        std::vector<const primitive_type*> right;
+        typename BvhNode<primitive_type>::primitive_list_type left(&_arena);
+        typename BvhNode<primitive_type>::primitive_list_type right(&_arena);
         splitNodes(left, right, _primitives, boxes.first, boxes.second);
         std::vector<Bounds> boundsList;
         
         // left node: go down the tree
         if ( (left.size() > BVH_MIN_NODE_SIZE) && (_iDepth > 0) ) {
-            node->m_left = buildBvhNode<BVH_MIN_NODE_SIZE>(left, boxes.first, _iDepth - 1);
+            node->m_left = buildBvhNode<BVH_MIN_NODE_SIZE, primitive_type>(_arena, left, boxes.first, _iDepth - 1);
             boundsList.emplace_back(node->m_left->m_bounds);
         }
         else if (left.size() > 0) {
@@ -101,7 +136,7 @@ namespace LNF
         
         // right node: go down the tree
         if ( (right.size() > BVH_MIN_NODE_SIZE) && (_iDepth > 0)  ) {
-            node->m_right = buildBvhNode<BVH_MIN_NODE_SIZE>(right, boxes.second, _iDepth - 1);
+            node->m_right = buildBvhNode<BVH_MIN_NODE_SIZE, primitive_type>(_arena, right, boxes.second, _iDepth - 1);
             boundsList.emplace_back(node->m_right->m_bounds);
         }
         else if (right.size() > 0) {
@@ -115,17 +150,1407 @@ namespace LNF
     }
 
 
+    /* SAH build constants (costs are relative to a single primitive intersection) */
+    const int       BVH_SAH_BINS            = 16;
+    const float     BVH_SAH_TRAVERSAL_COST  = 0.125f;
+    
+    /* Parallel build constants (smaller builds run on the calling thread) */
+    const size_t    BVH_PARALLEL_MIN_PRIMITIVES     = 1 << 16;      // min primitives for a parallel build
+    const size_t    BVH_PARALLEL_BIN_CHUNK          = 1 << 14;      // primitives per binning job
+    const size_t    BVH_PARALLEL_SUBTREE_MIN        = 1 << 12;      // smaller nodes are built as a whole by one job
+
+
+    /* SAH bins for all three axis (primitive bounds and count per bin) */
+    struct BvhSahBins
+    {
+        struct Bin {
+            Bounds      m_bounds;
+            size_t      m_uCount = 0;
+        };
+        
+        void merge(const BvhSahBins &_bins) {
+            for (int axis = 0; axis < 3; axis++) {
+                for (int b = 0; b < BVH_SAH_BINS; b++) {
+                    const auto &src = _bins.m_bins[axis][b];
+                    auto &dst = m_bins[axis][b];
+                    if (src.m_uCount > 0) {
+                        dst.m_bounds = dst.m_uCount > 0 ? combineBoxes(dst.m_bounds, src.m_bounds) : src.m_bounds;
+                        dst.m_uCount += src.m_uCount;
+                    }
+                }
+            }
+        }
+        
+        std::array<std::array<Bin, BVH_SAH_BINS>, 3>    m_bins;
+    };
+
+
+    // calculates node and centroid bounds for primitive range
+    template <typename primitive_type>
+    void sahBounds(const std::vector<const primitive_type*> &_primitives, size_t _first, size_t _last,
+                   Bounds &_bounds, Bounds &_centroidBounds)
+    {
+        _centroidBounds = Bounds(_primitives[_first]->bounds().center(), _primitives[_first]->bounds().center());
+        _bounds = _primitives[_first]->bounds();
+        for (size_t i = _first; i < _last; i++) {
+            const auto &pb = _primitives[i]->bounds();
+            const auto c = pb.center();
+            _bounds = combineBoxes(_bounds, pb);
+            _centroidBounds.m_min = perElementMin(_centroidBounds.m_min, c);
+            _centroidBounds.m_max = perElementMax(_centroidBounds.m_max, c);
+        }
+    }
+    
+    
+    // returns SAH bin for primitive bounds center
+    inline int sahBin(float _fCenter, float _fMin, float _fBinScale) {
+        return std::min((int)((_fCenter - _fMin) * _fBinScale), BVH_SAH_BINS - 1);
+    }
+
+
+    // bins primitive range on all axis (axis without centroid extent are skipped)
+    template <typename primitive_type>
+    void sahBinPrimitives(const std::vector<const primitive_type*> &_primitives, size_t _first, size_t _last,
+                          const Bounds &_centroidBounds, BvhSahBins &_bins)
+    {
+        const Vec centroidSize = _centroidBounds.size();
+        for (int axis = 0; axis < 3; axis++) {
+            const float fExtent = centroidSize.m_v[axis];
+            if (fExtent <= 0.0f) {
+                continue;
+            }
+            
+            auto &bins = _bins.m_bins[axis];
+            const float fBinScale = BVH_SAH_BINS / fExtent;
+            for (size_t i = _first; i < _last; i++) {
+                const auto &pb = _primitives[i]->bounds();
+                int b = sahBin(pb.center().m_v[axis], _centroidBounds.m_min.m_v[axis], fBinScale);
+                bins[b].m_bounds = bins[b].m_uCount > 0 ? combineBoxes(bins[b].m_bounds, pb) : pb;
+                bins[b].m_uCount++;
+            }
+        }
+    }
+
+
+    /*
+     Finds the best split plane across all axis.
+     Returns the split axis (-1 if a leaf is cheaper); primitives in bins below _iBestBin go left.
+     */
+    inline int sahBestSplit(const BvhSahBins &_bins, size_t _n, const Bounds &_bounds, const Bounds &_centroidBounds, int &_iBestBin) {
+        const Vec centroidSize = _centroidBounds.size();
+        const double fNodeArea = std::max(_bounds.area(), 1e-12);
+        double fBestCost = (double)_n;        // cost of leaf node
+        int iBestAxis = -1;
+        
+        for (int axis = 0; axis < 3; axis++) {
+            if (centroidSize.m_v[axis] <= 0.0f) {
+                continue;
+            }
+            
+            const auto &bins = _bins.m_bins[axis];
+            
+            // sweep from the right to find right-hand areas
+            std::array<double, BVH_SAH_BINS> rightArea;
+            std::array<size_t, BVH_SAH_BINS> rightCount;
+            Bounds acc;
+            size_t count = 0;
+            for (int b = BVH_SAH_BINS - 1; b > 0; b--) {
+                if (bins[b].m_uCount > 0) {
+                    acc = count > 0 ? combineBoxes(acc, bins[b].m_bounds) : bins[b].m_bounds;
+                    count += bins[b].m_uCount;
+                }
+                
+                rightArea[b] = count > 0 ? acc.area() : 0.0;
+                rightCount[b] = count;
+            }
+            
+            // sweep from the left and evaluate split cost between bin b-1 and b
+            count = 0;
+            for (int b = 1; b < BVH_SAH_BINS; b++) {
+                if (bins[b-1].m_uCount > 0) {
+                    acc = count > 0 ? combineBoxes(acc, bins[b-1].m_bounds) : bins[b-1].m_bounds;
+                    count += bins[b-1].m_uCount;
+                }
+                
+                if ( (count == 0) || (rightCount[b] == 0) ) {
+                    continue;
+                }
+                
+                double fCost = BVH_SAH_TRAVERSAL_COST + (acc.area() * count + rightArea[b] * rightCount[b]) / fNodeArea;
+                if (fCost < fBestCost) {
+                    fBestCost = fCost;
+                    iBestAxis = axis;
+                    _iBestBin = b;
+                }
+            }
+        }
+        
+        return iBestAxis;
+    }
+
+
+    // partitions primitive range on split plane; returns first primitive of the right-hand side
+    template <typename primitive_type>
+    size_t sahPartition(std::vector<const primitive_type*> &_primitives, size_t _first, size_t _last,
+                        const Bounds &_centroidBounds, int _iAxis, int _iBin)
+    {
+        const float fBinScale = BVH_SAH_BINS / _centroidBounds.size().m_v[_iAxis];
+        const float fMin = _centroidBounds.m_min.m_v[_iAxis];
+        auto itMid = std::partition(_primitives.begin() + _first, _primitives.begin() + _last,
+                                    [&](const primitive_type *_pPrimitive) {
+                                        return sahBin(_pPrimitive->bounds().center().m_v[_iAxis], fMin, fBinScale) < _iBin;
+                                    });
+        
+        return (size_t)(itMid - _primitives.begin());
+    }
+
+
     /*
-     Build BVH tree root
+     Build BVH tree recursively using a binned surface area heuristic.
+     Primitives are binned on their bounds centers, so every primitive ends up in exactly one child.
+     The [_first, _last) range of _primitives is partitioned in place.
      */
     template <size_t BVH_MIN_NODE_SIZE, typename primitive_type>
-    std::unique_ptr<BvhNode<primitive_type>> buildBvhRoot(const std::vector<const primitive_type*> &_srcNodes,
-                                                          const size_t _bvhMaxDepth)
+    BvhNode<primitive_type> *buildBvhNodeSah(Arena &_arena,
+                                             std::vector<const primitive_type*> &_primitives,
+                                             size_t _first, size_t _last,
+                                             int _iDepth)
     {
-        Bounds bounds = findBounds(_srcNodes);
-        return buildBvhNode<BVH_MIN_NODE_SIZE>(_srcNodes, bounds, (int)_bvhMaxDepth);
+        auto node = _arena.create<BvhNode<primitive_type>>(_arena);
+        const size_t n = _last - _first;
+        
+        // find node and centroid bounds
+        Bounds centroidBounds;
+        sahBounds(_primitives, _first, _last, node->m_bounds, centroidBounds);
+        
+        // find best split plane across all axis
+        int iBestAxis = -1;
+        int iBestBin = 0;
+        if ( (n > BVH_MIN_NODE_SIZE) && (_iDepth > 0) ) {
+            BvhSahBins bins;
+            sahBinPrimitives(_primitives, _first, _last, centroidBounds, bins);
+            iBestAxis = sahBestSplit(bins, n, node->m_bounds, centroidBounds, iBestBin);
+        }
+        
+        // create leaf node
+        if (iBestAxis < 0) {
+            node->m_primitives.assign(_primitives.begin() + _first, _primitives.begin() + _last);
+            return node;
+        }
+        
+        // partition primitives and go down the tree
+        const size_t mid = sahPartition(_primitives, _first, _last, centroidBounds, iBestAxis, iBestBin);
+        node->m_left = buildBvhNodeSah<BVH_MIN_NODE_SIZE>(_arena, _primitives, _first, mid, _iDepth - 1);
+        node->m_right = buildBvhNodeSah<BVH_MIN_NODE_SIZE>(_arena, _primitives, mid, _last, _iDepth - 1);
+        
+        return node;
     }
 
+
+    /*
+     Parallel SAH build (same tree as buildBvhNodeSah).
+     The top levels are built on the calling thread with bounds and binning split into jobs. Once there are
+     enough nodes to keep all workers busy (or nodes get small), the remaining subtrees are built by one job each,
+     every job allocating from its own arena (owned by the build arena).
+     */
+    template <size_t BVH_MIN_NODE_SIZE, typename primitive_type>
+    class BvhParallelSahBuild
+    {
+     public:
+        using node_type = BvhNode<primitive_type>;
+        
+     public:
+        BvhParallelSahBuild(Arena &_arena, std::vector<const primitive_type*> &_primitives, WorkerPool &_pool)
+            :m_arena(_arena),
+             m_primitives(_primitives),
+             m_pool(_pool)
+        {}
+        
+        node_type *build(int _iDepth) {
+            node_type *pRoot = buildTop(0, m_primitives.size(), _iDepth, 1);
+            
+            // build subtrees (largest first)
+            std::sort(m_subtrees.begin(), m_subtrees.end(), [](const Subtree &_a, const Subtree &_b) {
+                return (_a.m_last - _a.m_first) > (_b.m_last - _b.m_first);
+            });
+            
+            TaskGroup tasks(m_pool.jobs());
+            for (const auto &subtree : m_subtrees) {
+                auto *pArena = m_arena.create<Arena>();
+                tasks.run([this, subtree, pArena]{
+                    *subtree.m_ppNode = buildBvhNodeSah<BVH_MIN_NODE_SIZE>(*pArena, m_primitives, subtree.m_first, subtree.m_last, subtree.m_iDepth);
+                });
+            }
+            
+            tasks.wait();
+            return pRoot;
+        }
+        
+     private:
+        struct Subtree {
+            node_type       **m_ppNode;
+            size_t          m_first;
+            size_t          m_last;
+            int             m_iDepth;
+        };
+        
+     private:
+        // top level node (_iNodes is the number of nodes on this level)
+        node_type *buildTop(size_t _first, size_t _last, int _iDepth, int _iNodes) {
+            auto node = m_arena.create<node_type>(m_arena);
+            const size_t n = _last - _first;
+            
+            // find node and centroid bounds
+            Bounds centroidBounds;
+            parallelBounds(_first, _last, node->m_bounds, centroidBounds);
+            
+            // find best split plane across all axis
+            int iBestAxis = -1;
+            int iBestBin = 0;
+            if ( (n > BVH_MIN_NODE_SIZE) && (_iDepth > 0) ) {
+                BvhSahBins bins;
+                parallelBins(_first, _last, centroidBounds, bins);
+                iBestAxis = sahBestSplit(bins, n, node->m_bounds, centroidBounds, iBestBin);
+            }
+            
+            // create leaf node
+            if (iBestAxis < 0) {
+                node->m_primitives.assign(m_primitives.begin() + _first, m_primitives.begin() + _last);
+                return node;
+            }
+            
+            // partition primitives and go down the tree (or leave subtrees to jobs)
+            const size_t mid = sahPartition(m_primitives, _first, _last, centroidBounds, iBestAxis, iBestBin);
+            const bool bTop = _iNodes < m_pool.size();        // fewer than two child nodes per worker
+            
+            if ( (bTop == true) && (mid - _first > BVH_PARALLEL_SUBTREE_MIN) ) {
+                node->m_left = buildTop(_first, mid, _iDepth - 1, _iNodes * 2);
+            }
+            else {
+                m_subtrees.push_back({&node->m_left, _first, mid, _iDepth - 1});
+            }
+            
+            if ( (bTop == true) && (_last - mid > BVH_PARALLEL_SUBTREE_MIN) ) {
+                node->m_right = buildTop(mid, _last, _iDepth - 1, _iNodes * 2);
+            }
+            else {
+                m_subtrees.push_back({&node->m_right, mid, _last, _iDepth - 1});
+            }
+            
+            return node;
+        }
+        
+        // node and centroid bounds over jobs
+        void parallelBounds(size_t _first, size_t _last, Bounds &_bounds, Bounds &_centroidBounds) {
+            const size_t uChunks = (_last - _first + BVH_PARALLEL_BIN_CHUNK - 1) / BVH_PARALLEL_BIN_CHUNK;
+            std::vector<std::pair<Bounds, Bounds>> chunks(uChunks);
+            
+            TaskGroup tasks(m_pool.jobs());
+            for (size_t i = 0; i < uChunks; i++) {
+                tasks.run([&, i]{
+                    size_t first = _first + i * BVH_PARALLEL_BIN_CHUNK;
+                    sahBounds(m_primitives, first, std::min(first + BVH_PARALLEL_BIN_CHUNK, _last), chunks[i].first, chunks[i].second);
+                });
+            }
+            
+            tasks.wait();
+            _bounds = chunks[0].first;
+            _centroidBounds = chunks[0].second;
+            for (const auto &chunk : chunks) {
+                _bounds = combineBoxes(_bounds, chunk.first);
+                _centroidBounds = combineBoxes(_centroidBounds, chunk.second);
+            }
+        }
+        
+        // binning over jobs
+        void parallelBins(size_t _first, size_t _last, const Bounds &_centroidBounds, BvhSahBins &_bins) {
+            const size_t uChunks = (_last - _first + BVH_PARALLEL_BIN_CHUNK - 1) / BVH_PARALLEL_BIN_CHUNK;
+            std::vector<BvhSahBins> chunks(uChunks);
+            
+            TaskGroup tasks(m_pool.jobs());
+            for (size_t i = 0; i < uChunks; i++) {
+                tasks.run([&, i]{
+                    size_t first = _first + i * BVH_PARALLEL_BIN_CHUNK;
+                    sahBinPrimitives(m_primitives, first, std::min(first + BVH_PARALLEL_BIN_CHUNK, _last), _centroidBounds, chunks[i]);
+                });
+            }
+            
+            tasks.wait();
+            for (const auto &chunk : chunks) {
+                _bins.merge(chunk);
+            }
+        }
+        
+     private:
+        Arena                                   &m_arena;
+        std::vector<const primitive_type*>      &m_primitives;
+        WorkerPool                              &m_pool;
+        std::vector<Subtree>                    m_subtrees;
+    };
+
+
+    /*
+     Build BVH tree root.
+     The tree lives in _arena (typically a build arena that is released once the tree was flattened).
+     Large SAH builds run in parallel on a temporary worker pool.
+     */
+    template <size_t BVH_MIN_NODE_SIZE, typename primitive_type>
+    BvhNode<primitive_type> *buildBvhRoot(Arena &_arena,
+                                          const std::vector<const primitive_type*> &_srcNodes,
+                                          const size_t _bvhMaxDepth,
+                                          BvhBuildMethod _method = BvhBuildMethod::MIDPOINT)
+    {
+        if (_srcNodes.empty() == true) {
+            return _arena.create<BvhNode<primitive_type>>(_arena);
+        }
+        
+        if (_method == BvhBuildMethod::SAH) {
+            auto nodes = _srcNodes;
+            if ( (nodes.size() >= BVH_PARALLEL_MIN_PRIMITIVES) && (std::thread::hardware_concurrency() > 1) ) {
+                WorkerPool pool;
+                return BvhParallelSahBuild<BVH_MIN_NODE_SIZE, primitive_type>(_arena, nodes, pool).build((int)_bvhMaxDepth);
+            }
+            
+            return buildBvhNodeSah<BVH_MIN_NODE_SIZE>(_arena, nodes, 0, nodes.size(), (int)_bvhMaxDepth);
+        }
+        
+        typename BvhNode<primitive_type>::primitive_list_type nodes(_srcNodes.begin(), _srcNodes.end(), &_arena);
+        Bounds bounds = findBounds(nodes);
+        return buildBvhNode<BVH_MIN_NODE_SIZE, primitive_type>(_arena, nodes, bounds, (int)_bvhMaxDepth);
+    }
+
+
+    /*
+     BVH tree quality stats.
+     SAH cost is relative to the root area (see BVH_SAH_TRAVERSAL_COST).
+     */
+    struct BvhStats
+    {
+        static constexpr size_t MAX_LEAF_SIZE = 32;     // leaf sizes above this are counted in the last histogram bucket
+        
+        BvhStats()
+            :m_fSahCost(0),
+             m_uNodeCount(0),
+             m_uLeafCount(0),
+             m_uPrimitiveCount(0),
+             m_uMaxDepth(0),
+             m_leafSizes(MAX_LEAF_SIZE + 1, 0)
+        {}
+        
+        void print(const char *_pszName) const {
+            printf("%s BVH: sah_cost=%.2f, nodes=%d, leaves=%d, primitives=%d, max_depth=%d\n",
+                   _pszName, m_fSahCost, (int)m_uNodeCount, (int)m_uLeafCount, (int)m_uPrimitiveCount, (int)m_uMaxDepth);
+            
+            printf("%s BVH leaf sizes:", _pszName);
+            for (size_t i = 0; i < m_leafSizes.size(); i++) {
+                if (m_leafSizes[i] > 0) {
+                    printf(" %d%s=%d", (int)i, (i == MAX_LEAF_SIZE) ? "+" : "", (int)m_leafSizes[i]);
+                }
+            }
+            
+            printf("\n");
+        }
+        
+        double                  m_fSahCost;
+        size_t                  m_uNodeCount;
+        size_t                  m_uLeafCount;           // nodes with primitives
+        size_t                  m_uPrimitiveCount;
+        size_t                  m_uMaxDepth;
+        std::vector<size_t>     m_leafSizes;            // histogram of primitives per leaf
+    };
+
+
+    // gather tree stats recursively
+    template <typename primitive_type>
+    void gatherBvhStats(BvhStats &_stats, const BvhNode<primitive_type> *_pNode, double _fRootArea, size_t _uDepth)
+    {
+        const double fAreaRatio = _pNode->m_bounds.area() / _fRootArea;
+        
+        _stats.m_uNodeCount++;
+        _stats.m_uMaxDepth = std::max(_stats.m_uMaxDepth, _uDepth);
+        
+        if ( (_pNode->m_left != nullptr) || (_pNode->m_right != nullptr) ) {
+            _stats.m_fSahCost += BVH_SAH_TRAVERSAL_COST * fAreaRatio;
+        }
+        
+        if (_pNode->empty() == false) {
+            const size_t n = _pNode->m_primitives.size();
+            _stats.m_fSahCost += n * fAreaRatio;
+            _stats.m_uLeafCount++;
+            _stats.m_uPrimitiveCount += n;
+            _stats.m_leafSizes[std::min(n, BvhStats::MAX_LEAF_SIZE)]++;
+        }
+        
+        if (_pNode->m_left != nullptr) {
+            gatherBvhStats(_stats, _pNode->m_left, _fRootArea, _uDepth + 1);
+        }
+        
+        if (_pNode->m_right != nullptr) {
+            gatherBvhStats(_stats, _pNode->m_right, _fRootArea, _uDepth + 1);
+        }
+    }
+
+
+    // calculate tree cost, depth and leaf size histogram
+    template <typename primitive_type>
+    BvhStats bvhStats(const BvhNode<primitive_type> *_pRoot)
+    {
+        BvhStats stats;
+        if (_pRoot != nullptr) {
+            gatherBvhStats(stats, _pRoot, std::max(_pRoot->m_bounds.area(), 1e-12), 0);
+        }
+        
+        return stats;
+    }
+
+
+
+    /*
+     Compact BVH node (32 bytes).
+     Inner nodes (m_uCount == 0): left child is stored directly after the node and m_uOffset is the index of the right child.
+     Leaf nodes (m_uCount > 0): m_uOffset and m_uCount refer to a contiguous range of primitives.
+     */
+    struct FlatBvhNode
+    {
+        bool leaf() const {
+            return m_uCount > 0;
+        }
+        
+        Bounds      m_bounds;
+        uint32_t    m_uOffset;
+        uint32_t    m_uCount;
+    };
+    
+    static_assert(sizeof(FlatBvhNode) == 32, "FlatBvhNode should be 32 bytes.");
+
+
+    /* returns ray entry distance for BVH box, or MAX_DIST on a miss or if box is further than _fMaxDist (near/far planes picked with the ray sign mask) */
+    inline float bvhEntryDistance(const Bounds &_box, const Ray &_ray, float _fMaxDist) {
+        float tmin, tmax;
+        aaboxSlabs(_box, _ray, tmin, tmax);
+        if ( (tmin <= tmax) && (tmax >= 0) && (tmin <= _fMaxDist) ) {
+            return tmin;
+        }
+        
+        return Ray::MAX_DIST;
+    }
+
+
+    /*
+     Wide BVH node with N child slots (child bounds stored in SoA form for SIMD slab tests).
+     Slot m_uCount == 0: m_uChild is the index of a wide inner node.
+     Slot m_uCount > 0: m_uChild and m_uCount refer to a contiguous range of primitives (leaf).
+     Only the first m_uSize slots are used.
+     */
+    template <int N>
+    struct alignas(32) WideBvhNode
+    {
+        float       m_minX[N];
+        float       m_minY[N];
+        float       m_minZ[N];
+        float       m_maxX[N];
+        float       m_maxY[N];
+        float       m_maxZ[N];
+        uint32_t    m_uChild[N];
+        uint32_t    m_uCount[N];
+        uint32_t    m_uSize;
+    };
+
+
+    /*
+     Wide BVH (BVH4/BVH8) collapsed from a flat binary BVH.
+     All children of a node are tested with one SIMD slab test. Leaf ranges are the same as for the binary BVH.
+     */
+    template <int N>
+    class WideBvh
+    {
+     public:
+        static const size_t STACK_SIZE = 512;         // traversal stack size
+        using simd_type = SimdFloat<N>;
+        
+     public:
+        WideBvh()
+            :m_uDepth(0)
+        {}
+        
+        /* collapse binary BVH (nodes as built by FlatBvh) */
+        void build(const DataArray<FlatBvhNode> &_nodes) {
+            m_nodes.clear();
+            m_uDepth = 0;
+            
+            if (_nodes.empty() == false) {
+                if (_nodes[0].leaf() == true) {
+                    // single leaf: wrap in root node
+                    auto &nodes = m_nodes.owned();
+                    nodes.emplace_back();
+                    initNode(nodes[0]);
+                    setSlot(nodes[0], 0, _nodes[0].m_bounds, _nodes[0].m_uOffset, _nodes[0].m_uCount);
+                    nodes[0].m_uSize = 1;
+                    m_uDepth = 1;
+                }
+                else {
+                    collapseNode(_nodes, 0, 1);
+                }
+            }
+            
+            assert(m_uDepth * (N - 1) + 1 < STACK_SIZE);
+        }
+        
+        bool empty() const {
+            return m_nodes.empty();
+        }
+        
+        const DataArray<WideBvhNode<N>> &nodes() const {
+            return m_nodes;
+        }
+        
+        size_t depth() const {
+            return m_uDepth;
+        }
+        
+        /*
+         Use nodes from external memory (e.g. a mapped cache file kept alive by _pOwner).
+         Returns false (and leaves the BVH unchanged) if the nodes are not a valid tree with leaf ranges below
+         _uPrimitiveCount, or if the tree is too deep for the traversal stack.
+         */
+        bool map(const WideBvhNode<N> *_pNodes, size_t _uCount, size_t _uDepth, size_t _uPrimitiveCount, const std::shared_ptr<const void> &_pOwner) {
+            if ( (_uDepth * (N - 1) + 1 >= STACK_SIZE) || (validNodes(_pNodes, _uCount, _uPrimitiveCount) == false) ) {
+                return false;
+            }
+            
+            m_nodes.map(_pNodes, _uCount, _pOwner);
+            m_uDepth = _uDepth;
+            return true;
+        }
+        
+        /* replace leaf ranges: _remapFunc(uint32_t &_uOffset, uint32_t &_uCount) */
+        template <typename remap_func>
+        void remapLeaves(remap_func &&_remapFunc) {
+            for (auto &node : m_nodes.owned()) {
+                for (uint32_t i = 0; i < node.m_uSize; i++) {
+                    if (node.m_uCount[i] > 0) {
+                        _remapFunc(node.m_uChild[i], node.m_uCount[i]);
+                    }
+                }
+            }
+        }
+        
+        /*
+         Refit slot bounds bottom-up (same topology): _leafBoundsFunc(uint32_t _uOffset, uint32_t _uCount) returns leaf bounds.
+         Inner nodes are stored after their parents, so nodes are refit in reverse order.
+         */
+        template <typename leaf_bounds_func>
+        void refit(leaf_bounds_func &&_leafBoundsFunc) {
+            auto &nodes = m_nodes.owned();
+            for (size_t i = nodes.size(); i-- > 0; ) {
+                auto &node = nodes[i];
+                for (uint32_t j = 0; j < node.m_uSize; j++) {
+                    Bounds bounds = node.m_uCount[j] > 0 ? _leafBoundsFunc(node.m_uChild[j], node.m_uCount[j]) : nodeBounds(nodes[node.m_uChild[j]]);
+                    setSlot(node, (int)j, bounds, node.m_uChild[j], node.m_uCount[j]);
+                }
+            }
+        }
+        
+        /*
+         Iterative ordered traversal (see FlatBvh::traverse()).
+         */
+        template <typename leaf_func>
+        void traverse(const Ray &_ray, float _fMaxDist, leaf_func &&_leafFunc) const {
+            traverseImpl<false>(_ray, _fMaxDist, [&](uint32_t _uOffset, uint32_t _uCount, float &_fDist) {
+                                    _leafFunc(_uOffset, _uCount, _fDist);
+                                    return false;
+                                });
+        }
+        
+        /*
+         Any-hit traversal (see FlatBvh::traverseAny()).
+         */
+        template <typename leaf_func>
+        bool traverseAny(const Ray &_ray, float _fMaxDist, leaf_func &&_leafFunc) const {
+            return traverseImpl<true>(_ray, _fMaxDist, [&](uint32_t _uOffset, uint32_t _uCount, float &_fDist) {
+                                          return _leafFunc(_uOffset, _uCount, _fDist);
+                                      });
+        }
+        
+     private:
+        // stack based traversal; stops (and returns true) if _leafFunc returns true; children are only sorted for closest hit
+        template <bool ANY_HIT, typename leaf_func>
+        bool traverseImpl(const Ray &_ray, float _fMaxDist, leaf_func &&_leafFunc) const {
+            if (m_nodes.empty() == true) {
+                return false;
+            }
+            
+            struct StackEntry {
+                uint32_t    m_uIndex;
+                uint32_t    m_uCount;       // > 0 for leaves
+                float       m_fEntry;
+            };
+            
+            const simd_type ox(_ray.m_origin.x()), oy(_ray.m_origin.y()), oz(_ray.m_origin.z());
+            const simd_type ix(_ray.m_invDirection.x()), iy(_ray.m_invDirection.y()), iz(_ray.m_invDirection.z());
+            const simd_type zero(0.0f);
+            const WideBvhNode<N> *pNodes = m_nodes.data();
+            
+            // near/far slab planes per axis (picked once per ray from the direction signs)
+            using slab_type = float (WideBvhNode<N>::*)[N];
+            const slab_type nearX = _ray.negative(0) ? &WideBvhNode<N>::m_maxX : &WideBvhNode<N>::m_minX;
+            const slab_type farX = _ray.negative(0) ? &WideBvhNode<N>::m_minX : &WideBvhNode<N>::m_maxX;
+            const slab_type nearY = _ray.negative(1) ? &WideBvhNode<N>::m_maxY : &WideBvhNode<N>::m_minY;
+            const slab_type farY = _ray.negative(1) ? &WideBvhNode<N>::m_minY : &WideBvhNode<N>::m_maxY;
+            const slab_type nearZ = _ray.negative(2) ? &WideBvhNode<N>::m_maxZ : &WideBvhNode<N>::m_minZ;
+            const slab_type farZ = _ray.negative(2) ? &WideBvhNode<N>::m_minZ : &WideBvhNode<N>::m_maxZ;
+            
+            std::array<StackEntry, STACK_SIZE> stack;
+            size_t uStackSize = 0;
+            stack[uStackSize++] = {0, 0, 0.0f};
+            ScopedCount nodes(Counter::BVH_NODES);
+            
+            alignas(32) float entries[N];
+            
+            while (uStackSize > 0) {
+                const auto entry = stack[--uStackSize];
+                if (entry.m_fEntry > _fMaxDist) {
+                    continue;       // already have a closer hit
+                }
+                
+                if (entry.m_uCount > 0) {
+                    if (_leafFunc(entry.m_uIndex, entry.m_uCount, _fMaxDist) == true) {
+                        return true;
+                    }
+                    
+                    continue;
+                }
+                
+                // slab test on all children
+                const auto &node = pNodes[entry.m_uIndex];
+                nodes.add();
+                const simd_type txn = (simd_type::load(node.*nearX) - ox) * ix;
+                const simd_type txf = (simd_type::load(node.*farX) - ox) * ix;
+                const simd_type tyn = (simd_type::load(node.*nearY) - oy) * iy;
+                const simd_type tyf = (simd_type::load(node.*farY) - oy) * iy;
+                const simd_type tzn = (simd_type::load(node.*nearZ) - oz) * iz;
+                const simd_type tzf = (simd_type::load(node.*farZ) - oz) * iz;
+                
+                const simd_type tmin = simdMax(simdMax(txn, tyn), tzn);
+                const simd_type tmax = simdMin(simdMin(txf, tyf), tzf);
+                const simd_type mask = (tmin <= tmax) & (tmax >= zero) & (tmin <= simd_type(_fMaxDist));
+                
+                int bits = simdMoveMask(mask) & ((1 << node.m_uSize) - 1);
+                if (bits == 0) {
+                    continue;
+                }
+                
+                tmin.store(entries);
+                
+                // push hit children, sorted so that the nearest child is on top of the stack
+                const size_t uFirst = uStackSize;
+                for (int i = 0; bits != 0; i++, bits >>= 1) {
+                    if ( (bits & 1) == 0 ) {
+                        continue;
+                    }
+                    
+                    StackEntry child = {node.m_uChild[i], node.m_uCount[i], entries[i]};
+                    size_t j = uStackSize++;
+                    if (ANY_HIT == false) {
+                        for (; (j > uFirst) && (stack[j - 1].m_fEntry < child.m_fEntry); j--) {
+                            stack[j] = stack[j - 1];
+                        }
+                    }
+                    
+                    stack[j] = child;
+                }
+            }
+            
+            return false;
+        }
+        
+        // mark all slots as unused
+        static void initNode(WideBvhNode<N> &_node) {
+            for (int i = 0; i < N; i++) {
+                setSlot(_node, i, Bounds(Vec(), Vec()), 0, 0);
+            }
+            
+            _node.m_uSize = 0;
+        }
+        
+        // bounds of all used slots
+        static Bounds nodeBounds(const WideBvhNode<N> &_node) {
+            Bounds bounds(Vec(_node.m_minX[0], _node.m_minY[0], _node.m_minZ[0]), Vec(_node.m_maxX[0], _node.m_maxY[0], _node.m_maxZ[0]));
+            for (uint32_t i = 1; i < _node.m_uSize; i++) {
+                bounds = combineBoxes(bounds, Bounds(Vec(_node.m_minX[i], _node.m_minY[i], _node.m_minZ[i]),
+                                                     Vec(_node.m_maxX[i], _node.m_maxY[i], _node.m_maxZ[i])));
+            }
+            
+            return bounds;
+        }
+        
+        static void setSlot(WideBvhNode<N> &_node, int _iSlot, const Bounds &_bounds, uint32_t _uChild, uint32_t _uCount) {
+            _node.m_minX[_iSlot] = _bounds.m_min.x();
+            _node.m_minY[_iSlot] = _bounds.m_min.y();
+            _node.m_minZ[_iSlot] = _bounds.m_min.z();
+            _node.m_maxX[_iSlot] = _bounds.m_max.x();
+            _node.m_maxY[_iSlot] = _bounds.m_max.y();
+            _node.m_maxZ[_iSlot] = _bounds.m_max.z();
+            _node.m_uChild[_iSlot] = _uChild;
+            _node.m_uCount[_iSlot] = _uCount;
+        }
+        
+        // checks external nodes (inner children are stored after their parent, as built) and the traversal stack depth
+        static bool validNodes(const WideBvhNode<N> *_pNodes, size_t _uCount, size_t _uPrimitiveCount) {
+            std::vector<size_t> depths(_uCount, 1);
+            for (size_t i = 0; i < _uCount; i++) {
+                const auto &node = _pNodes[i];
+                if ( (node.m_uSize == 0) || (node.m_uSize > (uint32_t)N) || (depths[i] * (N - 1) + 1 >= STACK_SIZE) ) {
+                    return false;
+                }
+                
+                for (uint32_t j = 0; j < node.m_uSize; j++) {
+                    if (node.m_uCount[j] > 0) {
+                        if ((uint64_t)node.m_uChild[j] + node.m_uCount[j] > _uPrimitiveCount) {
+                            return false;
+                        }
+                    }
+                    else if ( (node.m_uChild[j] <= i) || (node.m_uChild[j] >= _uCount) ) {
+                        return false;
+                    }
+                    else {
+                        depths[node.m_uChild[j]] = std::max(depths[node.m_uChild[j]], depths[i] + 1);
+                    }
+                }
+            }
+            
+            return true;
+        }
+        
+        // collapse binary inner node (opens the largest inner children until all N slots are used)
+        uint32_t collapseNode(const DataArray<FlatBvhNode> &_nodes, uint32_t _uNode, size_t _uDepth) {
+            m_uDepth = std::max(m_uDepth, _uDepth);
+            
+            std::vector<uint32_t> children = {_uNode + 1, _nodes[_uNode].m_uOffset};
+            while (children.size() < (size_t)N) {
+                int iLargest = -1;
+                double fLargestArea = -1;
+                for (size_t i = 0; i < children.size(); i++) {
+                    const auto &child = _nodes[children[i]];
+                    if ( (child.leaf() == false) && (child.m_bounds.area() > fLargestArea) ) {
+                        fLargestArea = child.m_bounds.area();
+                        iLargest = (int)i;
+                    }
+                }
+                
+                if (iLargest < 0) {
+                    break;      // only leaves left
+                }
+                
+                uint32_t uOpen = children[iLargest];
+                children[iLargest] = uOpen + 1;
+                children.push_back(_nodes[uOpen].m_uOffset);
+            }
+            
+            auto &nodes = m_nodes.owned();
+            auto index = (uint32_t)nodes.size();
+            nodes.emplace_back();
+            initNode(nodes[index]);
+            nodes[index].m_uSize = (uint32_t)children.size();
+            
+            for (size_t i = 0; i < children.size(); i++) {
+                const auto &child = _nodes[children[i]];
+                if (child.leaf() == true) {
+                    setSlot(nodes[index], (int)i, child.m_bounds, child.m_uOffset, child.m_uCount);
+                }
+                else {
+                    uint32_t uChild = collapseNode(_nodes, children[i], _uDepth + 1);
+                    setSlot(nodes[index], (int)i, child.m_bounds, uChild, 0);
+                }
+            }
+            
+            return index;
+        }
+        
+     private:
+        DataArray<WideBvhNode<N>>       m_nodes;
+        size_t                          m_uDepth;
+    };
+
+
+    /*
+     Wide BVH node with quantized child bounds (8 bits per plane, relative to the node bounds).
+     Child boxes are rounded outwards, so they always contain the full precision boxes.
+     Slots are used the same way as for WideBvhNode.
+     */
+    template <int N>
+    struct QuantizedWideBvhNode
+    {
+        float       m_origin[3];        // node bounds min
+        float       m_scale[3];         // size of one quantization step per axis
+        uint8_t     m_minX[N];
+        uint8_t     m_minY[N];
+        uint8_t     m_minZ[N];
+        uint8_t     m_maxX[N];
+        uint8_t     m_maxY[N];
+        uint8_t     m_maxZ[N];
+        uint32_t    m_uChild[N];
+        uint32_t    m_uCount[N];
+        uint32_t    m_uSize;
+    };
+
+
+    /*
+     Wide BVH with quantized child bounds (about half the node memory of WideBvh), converted from a WideBvh.
+     Child bounds are decoded per visited node, so traversal is a bit slower and visits a few more nodes.
+     Leaf ranges are the same as for the source BVH.
+     */
+    template <int N>
+    class QuantizedWideBvh
+    {
+     public:
+        static const size_t STACK_SIZE = WideBvh<N>::STACK_SIZE;
+        using simd_type = SimdFloat<N>;
+
+     public:
+        QuantizedWideBvh() = default;
+
+        /* quantize wide BVH (same topology and leaf ranges) */
+        void build(const WideBvh<N> &_bvh) {
+            const auto &srcNodes = _bvh.nodes();
+            m_nodes.clear();
+            m_nodes.reserve(srcNodes.size());
+
+            for (const auto &src : srcNodes) {
+                QuantizedWideBvhNode<N> node = {};
+                node.m_uSize = src.m_uSize;
+
+                const float *srcMin[3] = {src.m_minX, src.m_minY, src.m_minZ};
+                const float *srcMax[3] = {src.m_maxX, src.m_maxY, src.m_maxZ};
+                uint8_t *qMin[3] = {node.m_minX, node.m_minY, node.m_minZ};
+                uint8_t *qMax[3] = {node.m_maxX, node.m_maxY, node.m_maxZ};
+
+                for (int axis = 0; axis < 3; axis++) {
+                    float fMin = srcMin[axis][0], fMax = srcMax[axis][0];
+                    for (uint32_t i = 1; i < src.m_uSize; i++) {
+                        fMin = std::min(fMin, srcMin[axis][i]);
+                        fMax = std::max(fMax, srcMax[axis][i]);
+                    }
+
+                    // step size has to cover the node with 255 steps (grown until it does with float rounding)
+                    float fScale = (fMax - fMin) / 255.0f;
+                    while (fMin + 255.0f * fScale < fMax) {
+                        fScale = std::nextafter(fScale, std::numeric_limits<float>::max());
+                    }
+
+                    node.m_origin[axis] = fMin;
+                    node.m_scale[axis] = fScale;
+
+                    for (uint32_t i = 0; i < src.m_uSize; i++) {
+                        qMin[axis][i] = quantize(srcMin[axis][i], fMin, fScale, false);
+                        qMax[axis][i] = quantize(srcMax[axis][i], fMin, fScale, true);
+                    }
+                }
+
+                for (uint32_t i = 0; i < src.m_uSize; i++) {
+                    node.m_uChild[i] = src.m_uChild[i];
+                    node.m_uCount[i] = src.m_uCount[i];
+                }
+
+                m_nodes.push_back(node);
+            }
+
+            m_nodes.shrink_to_fit();
+        }
+
+        bool empty() const {
+            return m_nodes.empty();
+        }
+
+        const std::vector<QuantizedWideBvhNode<N>> &nodes() const {
+            return m_nodes;
+        }
+
+        /*
+         Iterative ordered traversal (see FlatBvh::traverse()).
+         */
+        template <typename leaf_func>
+        void traverse(const Ray &_ray, float _fMaxDist, leaf_func &&_leafFunc) const {
+            traverseImpl<false>(_ray, _fMaxDist, [&](uint32_t _uOffset, uint32_t _uCount, float &_fDist) {
+                                    _leafFunc(_uOffset, _uCount, _fDist);
+                                    return false;
+                                });
+        }
+
+        /*
+         Any-hit traversal (see FlatBvh::traverseAny()).
+         */
+        template <typename leaf_func>
+        bool traverseAny(const Ray &_ray, float _fMaxDist, leaf_func &&_leafFunc) const {
+            return traverseImpl<true>(_ray, _fMaxDist, [&](uint32_t _uOffset, uint32_t _uCount, float &_fDist) {
+                                          return _leafFunc(_uOffset, _uCount, _fDist);
+                                      });
+        }
+
+     private:
+        // quantize plane to the step at or below (min) or at or above (max) the value
+        static uint8_t quantize(float _fValue, float _fOrigin, float _fScale, bool _bRoundUp) {
+            if (_fScale <= 0.0f) {
+                return 0;
+            }
+
+            float fStep = (_fValue - _fOrigin) / _fScale;
+            int q = std::clamp(_bRoundUp ? (int)std::ceil(fStep) : (int)std::floor(fStep), 0, 255);
+
+            // fix float rounding (decoded plane has to be outside of the box)
+            while ( (_bRoundUp == false) && (q > 0) && (_fOrigin + q * _fScale > _fValue) ) q--;
+            while ( (_bRoundUp == true) && (q < 255) && (_fOrigin + q * _fScale < _fValue) ) q++;
+            return (uint8_t)q;
+        }
+
+        // stack based traversal (same as WideBvh::traverseImpl(), with child planes decoded per node)
+        template <bool ANY_HIT, typename leaf_func>
+        bool traverseImpl(const Ray &_ray, float _fMaxDist, leaf_func &&_leafFunc) const {
+            if (m_nodes.empty() == true) {
+                return false;
+            }
+
+            struct StackEntry {
+                uint32_t    m_uIndex;
+                uint32_t    m_uCount;       // > 0 for leaves
+                float       m_fEntry;
+            };
+
+            const simd_type zero(0.0f);
+            const QuantizedWideBvhNode<N> *pNodes = m_nodes.data();
+
+            // near/far slab planes per axis (picked once per ray from the direction signs)
+            using slab_type = uint8_t (QuantizedWideBvhNode<N>::*)[N];
+            const slab_type nearPlanes[3] = {_ray.negative(0) ? &QuantizedWideBvhNode<N>::m_maxX : &QuantizedWideBvhNode<N>::m_minX,
+                                             _ray.negative(1) ? &QuantizedWideBvhNode<N>::m_maxY : &QuantizedWideBvhNode<N>::m_minY,
+                                             _ray.negative(2) ? &QuantizedWideBvhNode<N>::m_maxZ : &QuantizedWideBvhNode<N>::m_minZ};
+            const slab_type farPlanes[3] = {_ray.negative(0) ? &QuantizedWideBvhNode<N>::m_minX : &QuantizedWideBvhNode<N>::m_maxX,
+                                            _ray.negative(1) ? &QuantizedWideBvhNode<N>::m_minY : &QuantizedWideBvhNode<N>::m_maxY,
+                                            _ray.negative(2) ? &QuantizedWideBvhNode<N>::m_minZ : &QuantizedWideBvhNode<N>::m_maxZ};
+
+            std::array<StackEntry, STACK_SIZE> stack;
+            size_t uStackSize = 0;
+            stack[uStackSize++] = {0, 0, 0.0f};
+            ScopedCount nodes(Counter::BVH_NODES);
+
+            alignas(32) float entries[N];
+            alignas(32) float planes[2][N];
+
+            while (uStackSize > 0) {
+                const auto entry = stack[--uStackSize];
+                if (entry.m_fEntry > _fMaxDist) {
+                    continue;       // already have a closer hit
+                }
+
+                if (entry.m_uCount > 0) {
+                    if (_leafFunc(entry.m_uIndex, entry.m_uCount, _fMaxDist) == true) {
+                        return true;
+                    }
+
+                    continue;
+                }
+
+                // slab test on all children (ray distance to plane q: q * scale / dir + (origin - o) / dir)
+                const auto &node = pNodes[entry.m_uIndex];
+                nodes.add();
+                simd_type tmin(0.0f), tmax(_fMaxDist);
+                for (int axis = 0; axis < 3; axis++) {
+                    const float fStep = node.m_scale[axis] > 0.0f ? node.m_scale[axis] * _ray.m_invDirection.m_v[axis] : 0.0f;
+                    const float fBase = (node.m_origin[axis] - _ray.m_origin.m_v[axis]) * _ray.m_invDirection.m_v[axis];
+                    for (int i = 0; i < N; i++) {
+                        planes[0][i] = (node.*nearPlanes[axis])[i];
+                        planes[1][i] = (node.*farPlanes[axis])[i];
+                    }
+
+                    tmin = simdMax(tmin, simd_type::load(planes[0]) * simd_type(fStep) + simd_type(fBase));
+                    tmax = simdMin(tmax, simd_type::load(planes[1]) * simd_type(fStep) + simd_type(fBase));
+                }
+
+                int bits = simdMoveMask(tmin <= tmax) & ((1 << node.m_uSize) - 1);
+                if (bits == 0) {
+                    continue;
+                }
+
+                tmin.store(entries);
+
+                // push hit children, sorted so that the nearest child is on top of the stack
+                const size_t uFirst = uStackSize;
+                for (int i = 0; bits != 0; i++, bits >>= 1) {
+                    if ( (bits & 1) == 0 ) {
+                        continue;
+                    }
+
+                    StackEntry child = {node.m_uChild[i], node.m_uCount[i], entries[i]};
+                    size_t j = uStackSize++;
+                    if (ANY_HIT == false) {
+                        for (; (j > uFirst) && (stack[j - 1].m_fEntry < child.m_fEntry); j--) {
+                            stack[j] = stack[j - 1];
+                        }
+                    }
+
+                    stack[j] = child;
+                }
+            }
+
+            return false;
+        }
+
+     private:
+        std::vector<QuantizedWideBvhNode<N>>    m_nodes;
+    };
+
+
+    /*
+     Flattened BVH (cache-linear node array built from a BvhNode tree).
+     Primitives are reordered so that each leaf's primitives are stored next to each other.
+     */
+    template <typename primitive_type>
+    class FlatBvh
+    {
+     public:
+        static const size_t MAX_DEPTH = 128;          // traversal stack size
+        
+     public:
+        FlatBvh()
+            :m_uDepth(0)
+        {}
+        
+        /* flatten tree (tree can be discarded afterwards); optionally collapse into a wide BVH */
+        void build(const BvhNode<primitive_type> *_pRoot, BvhWidth _width = BvhWidth::BINARY) {
+            m_nodes.clear();
+            m_primitives.clear();
+            m_wide4 = WideBvh<4>();
+            m_wide8 = WideBvh<8>();
+            m_uDepth = 0;
+            
+            if ( (_pRoot != nullptr) &&
+                 ( (_pRoot->empty() == false) || (_pRoot->m_left != nullptr) || (_pRoot->m_right != nullptr) ) )
+            {
+                flattenNode(_pRoot, 1);
+            }
+            
+            assert(m_uDepth < MAX_DEPTH);
+            
+            if (_width == BvhWidth::WIDE4) {
+                m_wide4.build(m_nodes);
+            }
+            else if (_width == BvhWidth::WIDE8) {
+                m_wide8.build(m_nodes);
+            }
+        }
+        
+        bool empty() const {
+            return m_nodes.empty();
+        }
+        
+        BvhWidth width() const {
+            if (m_wide4.empty() == false) return BvhWidth::WIDE4;
+            else if (m_wide8.empty() == false) return BvhWidth::WIDE8;
+            else return BvhWidth::BINARY;
+        }
+        
+        const DataArray<FlatBvhNode> &nodes() const {
+            return m_nodes;
+        }
+        
+        size_t depth() const {
+            return m_uDepth;
+        }
+        
+        const WideBvh<4> &wide4() const {return m_wide4;}
+        const WideBvh<8> &wide8() const {return m_wide8;}
+        WideBvh<4> &wide4() {return m_wide4;}
+        WideBvh<8> &wide8() {return m_wide8;}
+        
+        /*
+         Use binary nodes from external memory (e.g. a mapped cache file kept alive by _pOwner).
+         Mapped BVHs have no primitive list (owners map their own primitive storage) and can not be refit.
+         Returns false (and leaves the BVH unchanged) if the nodes are not a valid tree with leaf ranges below
+         _uPrimitiveCount, or if the tree is too deep for the traversal stack.
+         */
+        bool map(const FlatBvhNode *_pNodes, size_t _uCount, size_t _uDepth, size_t _uPrimitiveCount, const std::shared_ptr<const void> &_pOwner) {
+            if ( (_uDepth >= MAX_DEPTH) || (validNodes(_pNodes, _uCount, _uPrimitiveCount) == false) ) {
+                return false;
+            }
+            
+            m_nodes.map(_pNodes, _uCount, _pOwner);
+            m_primitives.clear();
+            m_uDepth = _uDepth;
+            return true;
+        }
+        
+        /* reordered primitives (leaf ranges index into this list) */
+        const std::vector<const primitive_type*> &primitives() const {
+            return m_primitives;
+        }
+        
+        /* drop primitive list (for owners that reorder their own primitive storage to match) */
+        void releasePrimitives() {
+            m_primitives = std::vector<const primitive_type*>();
+        }
+        
+        /*
+         Replace leaf ranges (e.g. to index into a repacked primitive list).
+         _remapFunc(uint32_t &_uOffset, uint32_t &_uCount) is called once per leaf, in node order.
+         Leaf ranges are unique, so the wide BVH is remapped with the same results.
+         Has to be called before releasePrimitives().
+         */
+        template <typename remap_func>
+        void remapLeaves(remap_func &&_remapFunc) {
+            std::vector<std::pair<uint32_t, uint32_t>> ranges(m_primitives.size());
+            for (auto &node : m_nodes.owned()) {
+                if (node.leaf() == true) {
+                    auto &range = ranges[node.m_uOffset];
+                    _remapFunc(node.m_uOffset, node.m_uCount);
+                    range = {node.m_uOffset, node.m_uCount};
+                }
+            }
+            
+            auto wideRemap = [&ranges](uint32_t &_uOffset, uint32_t &_uCount) {
+                const auto &range = ranges[_uOffset];
+                _uOffset = range.first;
+                _uCount = range.second;
+            };
+            
+            m_wide4.remapLeaves(wideRemap);
+            m_wide8.remapLeaves(wideRemap);
+        }
+        
+        /*
+         Refit node bounds bottom-up after primitives moved (tree topology stays the same, so quality degrades with
+         large moves; see sahCost()). Children are stored after their parents, so nodes are refit in reverse order.
+         Has to be called before releasePrimitives() and not while the BVH is traversed.
+         */
+        void refit() {
+            auto leafBounds = [this](uint32_t _uOffset, uint32_t _uCount) {
+                Bounds bounds = m_primitives[_uOffset]->bounds();
+                for (uint32_t i = _uOffset + 1; i < _uOffset + _uCount; i++) {
+                    bounds = combineBoxes(bounds, m_primitives[i]->bounds());
+                }
+                
+                return bounds;
+            };
+            
+            auto &nodes = m_nodes.owned();
+            for (size_t i = nodes.size(); i-- > 0; ) {
+                auto &node = nodes[i];
+                if (node.leaf() == true) {
+                    node.m_bounds = leafBounds(node.m_uOffset, node.m_uCount);
+                }
+                else {
+                    node.m_bounds = combineBoxes(nodes[i + 1].m_bounds, nodes[node.m_uOffset].m_bounds);
+                }
+            }
+            
+            m_wide4.refit(leafBounds);
+            m_wide8.refit(leafBounds);
+        }
+        
+        /* SAH cost of the binary nodes (relative to root area, same cost model as BvhStats) */
+        double sahCost() const {
+            if (m_nodes.empty() == true) {
+                return 0.0;
+            }
+            
+            const double fRootArea = std::max(m_nodes[0].m_bounds.area(), 1e-12);
+            double fCost = 0.0;
+            for (const auto &node : m_nodes) {
+                const double fAreaRatio = node.m_bounds.area() / fRootArea;
+                fCost += node.leaf() ? node.m_uCount * fAreaRatio : BVH_SAH_TRAVERSAL_COST * fAreaRatio;
+            }
+            
+            return fCost;
+        }
+        
+        /*
+         Iterative ordered traversal (uses the wide BVH if one was built).
+         Visits the nearest child first and skips nodes with an entry distance beyond _fMaxDist.
+         _leafFunc(uint32_t _uOffset, uint32_t _uCount, float &_fMaxDist) is called for every leaf
+         that is reached and may shorten _fMaxDist (closest hit so far).
+         */
+        template <typename leaf_func>
+        void traverse(const Ray &_ray, float _fMaxDist, leaf_func &&_leafFunc) const {
+            if (m_wide4.empty() == false) {
+                return m_wide4.traverse(_ray, _fMaxDist, _leafFunc);
+            }
+            else if (m_wide8.empty() == false) {
+                return m_wide8.traverse(_ray, _fMaxDist, _leafFunc);
+            }
+            
+            traverseImpl<false>(_ray, _fMaxDist, [&](uint32_t _uOffset, uint32_t _uCount, float &_fDist) {
+                                    _leafFunc(_uOffset, _uCount, _fDist);
+                                    return false;
+                                });
+        }
+        
+        /*
+         Any-hit traversal (for occlusion queries; visiting order is not defined).
+         _leafFunc(uint32_t _uOffset, uint32_t _uCount, float _fMaxDist) returns true to stop traversal (hit found).
+         Returns true if traversal was stopped.
+         */
+        template <typename leaf_func>
+        bool traverseAny(const Ray &_ray, float _fMaxDist, leaf_func &&_leafFunc) const {
+            if (m_wide4.empty() == false) {
+                return m_wide4.traverseAny(_ray, _fMaxDist, _leafFunc);
+            }
+            else if (m_wide8.empty() == false) {
+                return m_wide8.traverseAny(_ray, _fMaxDist, _leafFunc);
+            }
+            
+            return traverseImpl<true>(_ray, _fMaxDist, [&](uint32_t _uOffset, uint32_t _uCount, float &_fDist) {
+                                          return _leafFunc(_uOffset, _uCount, _fDist);
+                                      });
+        }
+        
+     private:
+        // stack based traversal of binary nodes; stops (and returns true) if _leafFunc returns true
+        template <bool ANY_HIT, typename leaf_func>
+        bool traverseImpl(const Ray &_ray, float _fMaxDist, leaf_func &&_leafFunc) const {
+            if (m_nodes.empty() == true) {
+                return false;
+            }
+            
+            struct StackEntry {
+                uint32_t    m_uNode;
+                float       m_fEntry;
+            };
+            
+            const FlatBvhNode *pNodes = m_nodes.data();
+            
+            std::array<StackEntry, MAX_DEPTH> stack;
+            size_t uStackSize = 0;
+            
+            float fEntry = bvhEntryDistance(pNodes[0].m_bounds, _ray, _fMaxDist);
+            if (fEntry < Ray::MAX_DIST) {
+                stack[uStackSize++] = {0, fEntry};
+            }
+            ScopedCount nodes(Counter::BVH_NODES);
+            
+            while (uStackSize > 0) {
+                const auto entry = stack[--uStackSize];
+                if (entry.m_fEntry > _fMaxDist) {
+                    continue;       // already have a closer hit
+                }
+                
+                const auto &node = pNodes[entry.m_uNode];
+                if (node.leaf() == true) {
+                    if (_leafFunc(node.m_uOffset, node.m_uCount, _fMaxDist) == true) {
+                        return true;
+                    }
+                    
+                    continue;
+                }
+                
+                // check children and push far child first (nearest child is visited next)
+                nodes.add();
+                const uint32_t uLeft = entry.m_uNode + 1;
+                const uint32_t uRight = node.m_uOffset;
+                const float fLeft = bvhEntryDistance(pNodes[uLeft].m_bounds, _ray, _fMaxDist);
+                const float fRight = bvhEntryDistance(pNodes[uRight].m_bounds, _ray, _fMaxDist);
+                
+                if ( (ANY_HIT == true) || (fLeft <= fRight) ) {
+                    if (fRight < Ray::MAX_DIST) stack[uStackSize++] = {uRight, fRight};
+                    if (fLeft < Ray::MAX_DIST) stack[uStackSize++] = {uLeft, fLeft};
+                }
+                else {
+                    if (fLeft < Ray::MAX_DIST) stack[uStackSize++] = {uLeft, fLeft};
+                    stack[uStackSize++] = {uRight, fRight};
+                }
+            }
+            
+            return false;
+        }
+        
+        // checks external nodes (left child directly after its parent, right child after the left sub-tree) and the traversal stack depth
+        static bool validNodes(const FlatBvhNode *_pNodes, size_t _uCount, size_t _uPrimitiveCount) {
+            std::vector<size_t> depths(_uCount, 1);
+            for (size_t i = 0; i < _uCount; i++) {
+                const auto &node = _pNodes[i];
+                if (depths[i] >= MAX_DEPTH) {
+                    return false;
+                }
+                
+                if (node.leaf() == true) {
+                    if ((uint64_t)node.m_uOffset + node.m_uCount > _uPrimitiveCount) {
+                        return false;
+                    }
+                }
+                else if ( (node.m_uOffset <= i + 1) || (node.m_uOffset >= _uCount) ) {
+                    return false;
+                }
+                else {
+                    depths[i + 1] = std::max(depths[i + 1], depths[i] + 1);
+                    depths[node.m_uOffset] = std::max(depths[node.m_uOffset], depths[i] + 1);
+                }
+            }
+            
+            return true;
+        }
+        
+        // add leaf node (and its primitives)
+        uint32_t addLeaf(const Bounds &_bounds, const typename BvhNode<primitive_type>::primitive_list_type &_primitives, size_t _uDepth) {
+            m_uDepth = std::max(m_uDepth, _uDepth);
+            
+            auto index = (uint32_t)m_nodes.size();
+            m_nodes.owned().push_back({_bounds, (uint32_t)m_primitives.size(), (uint32_t)_primitives.size()});
+            m_primitives.insert(m_primitives.end(), _primitives.begin(), _primitives.end());
+            return index;
+        }
+        
+        // add inner node (left sub-tree is added first, directly after the node)
+        template <typename left_func, typename right_func>
+        uint32_t addInner(const Bounds &_bounds, left_func &&_left, right_func &&_right) {
+            auto index = (uint32_t)m_nodes.size();
+            m_nodes.owned().push_back({_bounds, 0, 0});
+            
+            _left();
+            m_nodes.owned()[index].m_uOffset = _right();
+            return index;
+        }
+        
+        // flatten tree recursively (nodes with primitives and children are split into a leaf and the sub-trees)
+        uint32_t flattenNode(const BvhNode<primitive_type> *_pNode, size_t _uDepth) {
+            const BvhNode<primitive_type> *pLeft = _pNode->m_left;
+            const BvhNode<primitive_type> *pRight = _pNode->m_right;
+            const BvhNode<primitive_type> *pChild = (pLeft != nullptr) ? pLeft : pRight;
+            
+            if (pChild == nullptr) {
+                return addLeaf(_pNode->m_bounds, _pNode->m_primitives, _uDepth);
+            }
+            
+            auto subTree = [=]() {
+                if ( (pLeft != nullptr) && (pRight != nullptr) ) {
+                    return addInner(combineBoxes(pLeft->m_bounds, pRight->m_bounds),
+                                    [=]{return flattenNode(pLeft, _uDepth + 2);},
+                                    [=]{return flattenNode(pRight, _uDepth + 2);});
+                }
+                
+                return flattenNode(pChild, _uDepth + 1);
+            };
+            
+            if (_pNode->empty() == true) {
+                if ( (pLeft != nullptr) && (pRight != nullptr) ) {
+                    return addInner(_pNode->m_bounds,
+                                    [=]{return flattenNode(pLeft, _uDepth + 1);},
+                                    [=]{return flattenNode(pRight, _uDepth + 1);});
+                }
+                
+                return flattenNode(pChild, _uDepth);
+            }
+            
+            return addInner(_pNode->m_bounds,
+                            [=]{return addLeaf(findBounds(_pNode->m_primitives), _pNode->m_primitives, _uDepth + 1);},
+                            subTree);
+        }
+        
+     private:
+        DataArray<FlatBvhNode>              m_nodes;
+        std::vector<const primitive_type*>  m_primitives;
+        WideBvh<4>                          m_wide4;
+        WideBvh<8>                          m_wide8;
+        size_t                              m_uDepth;
+    };
+
 };  // namespace LNF
 
 #endif  // #ifndef LIBS_HEADER_BVH_H
@@ -44,7 +44,14 @@ namespace LNF
              m_fAperture(_fAperture),
              m_fFocusDist(_fFocusDist)
         {}
-        
+
+        SimpleCamera(const Axis &_axis, float _fFov, float _fAperture, float _fFocusDist)
+            :m_axis(_axis),
+             m_fFov(_fFov),
+             m_fAperture(_fAperture),
+             m_fFocusDist(_fFocusDist)
+        {}
+
         // returns the camera position
         virtual Vec origin() const override {
             return m_axis.m_origin;
@@ -0,0 +1,398 @@
+#ifndef LIBS_HEADER_COMPACT_MESH_H
+#define LIBS_HEADER_COMPACT_MESH_H
+
+#include "bvh.h"
+#include "counters.h"
+#include "material.h"
+#include "mesh.h"
+#include "primitive.h"
+#include "vec3.h"
+#include "uv.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+
+namespace LNF
+{
+    /* Octahedral unit vector encoding (2 x 16 bit snorm; ~0.005 degree error) */
+    inline uint32_t octEncode(const Vec &_n) {
+        const float fL1 = fabs(_n.x()) + fabs(_n.y()) + fabs(_n.z());
+        if (fL1 <= 0.0f) {
+            return 0;       // decodes to +Z
+        }
+
+        float x = _n.x() / fL1;
+        float y = _n.y() / fL1;
+        if (_n.z() < 0.0f) {
+            // fold lower hemisphere over the diagonals
+            const float fX = (1.0f - fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            const float fY = (1.0f - fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            x = fX;
+            y = fY;
+        }
+
+        auto snorm = [](float _f) {
+            return (uint32_t)(uint16_t)(int16_t)std::lround(std::clamp(_f, -1.0f, 1.0f) * 32767.0f);
+        };
+
+        return snorm(x) | (snorm(y) << 16);
+    }
+
+
+    /* Octahedral unit vector decoding */
+    inline Vec octDecode(uint32_t _uOct) {
+        float x = (int16_t)(uint16_t)(_uOct & 0xffff) / 32767.0f;
+        float y = (int16_t)(uint16_t)(_uOct >> 16) / 32767.0f;
+        const float z = 1.0f - fabs(x) - fabs(y);
+        if (z < 0.0f) {
+            const float fX = (1.0f - fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            const float fY = (1.0f - fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            x = fX;
+            y = fY;
+        }
+
+        return Vec(x, y, z).normalized();
+    }
+
+
+    /* Float to half float (round to nearest even; overflows to infinity) */
+    inline uint16_t floatToHalf(float _f) {
+        uint32_t u = 0;
+        std::memcpy(&u, &_f, sizeof(u));
+
+        const uint32_t uSign = (u >> 16) & 0x8000;
+        const uint32_t uAbs = u & 0x7fffffff;
+        if (uAbs > 0x7f800000) {
+            return (uint16_t)(uSign | 0x7e00);         // NaN
+        }
+        else if (uAbs >= 0x477ff000) {
+            return (uint16_t)(uSign | 0x7c00);         // too large (or infinity)
+        }
+        else if (uAbs < 0x38800000) {
+            // denormal half (or zero): align mantissa for an exponent of -14
+            const int iShift = 113 - (int)(uAbs >> 23);
+            if (iShift > 11) {
+                return (uint16_t)uSign;
+            }
+
+            const uint32_t uMantissa = (uAbs & 0x7fffff) | 0x800000;
+            uint32_t uHalf = uMantissa >> (iShift + 13);
+            const uint32_t uRest = uMantissa & ((1u << (iShift + 13)) - 1);
+            const uint32_t uHalfway = 1u << (iShift + 12);
+            uHalf += (uRest > uHalfway) || ( (uRest == uHalfway) && ((uHalf & 1) != 0) ) ? 1 : 0;
+            return (uint16_t)(uSign | uHalf);
+        }
+
+        uint32_t uHalf = ((uAbs - 0x38000000) >> 13);
+        const uint32_t uRest = uAbs & 0x1fff;
+        uHalf += (uRest > 0x1000) || ( (uRest == 0x1000) && ((uHalf & 1) != 0) ) ? 1 : 0;     // may carry into the exponent
+        return (uint16_t)(uSign | uHalf);
+    }
+
+
+    /* Half float to float */
+    inline float halfToFloat(uint16_t _uHalf) {
+        const uint32_t uSign = (uint32_t)(_uHalf & 0x8000) << 16;
+        const uint32_t uExponent = (_uHalf >> 10) & 0x1f;
+        const uint32_t uMantissa = _uHalf & 0x3ff;
+
+        if (uExponent == 0) {
+            const float f = uMantissa * (1.0f / (1 << 24));
+            return uSign != 0 ? -f : f;
+        }
+
+        uint32_t u = uSign | (uMantissa << 13);
+        u |= uExponent == 31 ? 0x7f800000 : (uExponent + 112) << 23;
+
+        float f = 0;
+        std::memcpy(&f, &u, sizeof(f));
+        return f;
+    }
+
+
+    /*
+     Mesh with compact storage, converted from a built Mesh (or MeshFile) for very large meshes:
+     - vertex normals are octahedral encoded (4 bytes) and UVs are half floats (4 bytes); positions stay full floats
+     - triangles are 3 x 16 bit vertex indices relative to a base vertex of their BVH leaf (6 bytes; vertices are
+       reordered in leaf order and duplicated where a leaf would exceed the 16 bit range)
+     - no per-triangle normals, bounds or SIMD packets (packets are gathered per visited leaf)
+     - quantized wide BVH nodes
+     The source mesh can be released after conversion. Uses roughly a quarter of the memory of a Mesh, at the cost of
+     slower intersection tests.
+     */
+    class CompactMesh  : public Primitive
+    {
+     public:
+        struct Triangle {
+            uint16_t    m_v[3];             // vertex indices relative to leaf base vertex
+        };
+
+        // BVH leaf chunk (triangles run up to the next chunk's first triangle; the chunk list ends with a sentinel)
+        struct Leaf {
+            uint32_t    m_uFirstTriangle;
+            uint32_t    m_uBaseVertex;
+        };
+
+        static const int PACKET_WIDTH = Mesh::PACKET_WIDTH;
+        using packet_type = TrianglePacket<PACKET_WIDTH>;
+
+        static constexpr uint32_t   MAX_LEAF_TRIANGLES = 1024;          // larger source leaves are split into chunks
+
+     public:
+        /* convert built mesh (uses the mesh material if _pMaterial is nullptr) */
+        CompactMesh(const Mesh &_mesh, const Material *_pMaterial = nullptr)
+            :m_pMaterial(_pMaterial != nullptr ? _pMaterial : _mesh.material()),
+             m_bounds(_mesh.bounds())
+        {
+            build(_mesh);
+        }
+
+        /* Returns the material used for rendering, etc. */
+        const Material *material() const override {
+            return m_pMaterial;
+        }
+
+        /* Quick node hit check (populates at least node and time properties of intercept) */
+        virtual bool hit(Intersect &_hit) const override {
+            ScopedCount triangles(Counter::TRIANGLE_TESTS);
+            float fPositionOnRay = -1;
+            uint32_t uHitIndex = 0;
+            Uv hitUv;
+            bool bHit = false;
+
+            // leaf ranges index into leaf chunks
+            m_bvh.traverse(_hit.m_priRay, _hit.m_priRay.m_fMaxDist,
+                           [&](uint32_t _uOffset, uint32_t _uCount, float &_fMaxDist) {
+                               packet_type packet;
+                               for (uint32_t i = _uOffset; i < _uOffset + _uCount; i++) {
+                                   const uint32_t uEnd = m_leaves[i + 1].m_uFirstTriangle;
+                                   for (uint32_t t = m_leaves[i].m_uFirstTriangle; t < uEnd; t += PACKET_WIDTH) {
+                                       uint32_t uIndex = 0;
+                                       buildPacket(packet, m_leaves[i].m_uBaseVertex, t, std::min(uEnd - t, (uint32_t)PACKET_WIDTH));
+                                       triangles.add(PACKET_WIDTH);
+                                       if (trianglePacketIntersect(fPositionOnRay, hitUv, uIndex, _hit.m_priRay, _fMaxDist, packet) == true) {
+                                           _fMaxDist = fPositionOnRay;
+                                           uHitIndex = uIndex;
+                                           bHit = true;
+                                       }
+                                   }
+                               }
+                           });
+
+            if (bHit == true) {
+                _hit.m_fPositionOnRay = fPositionOnRay;
+                _hit.m_uTriangleIndex = uHitIndex;
+                _hit.m_uv = hitUv;
+                return true;
+            }
+
+            return false;
+        }
+
+        /* Occlusion check (stops at first triangle hit) */
+        virtual bool occluded(const Ray &_ray, float _fMaxDist) const override {
+            ScopedCount triangles(Counter::TRIANGLE_TESTS);
+            return m_bvh.traverseAny(_ray, _fMaxDist,
+                                     [&](uint32_t _uOffset, uint32_t _uCount, float _fDist) {
+                                         packet_type packet;
+                                         float fPositionOnRay = -1;
+                                         uint32_t uIndex = 0;
+                                         Uv uv;
+                                         for (uint32_t i = _uOffset; i < _uOffset + _uCount; i++) {
+                                             const uint32_t uEnd = m_leaves[i + 1].m_uFirstTriangle;
+                                             for (uint32_t t = m_leaves[i].m_uFirstTriangle; t < uEnd; t += PACKET_WIDTH) {
+                                                 buildPacket(packet, m_leaves[i].m_uBaseVertex, t, std::min(uEnd - t, (uint32_t)PACKET_WIDTH));
+                                                 triangles.add(PACKET_WIDTH);
+                                                 if (trianglePacketIntersect(fPositionOnRay, uv, uIndex, _ray, _fDist, packet) == true) {
+                                                     return true;
+                                                 }
+                                             }
+                                         }
+
+                                         return false;
+                                     });
+        }
+
+        /* Completes the node intersect properties. */
+        virtual Intersect &intersect(Intersect &_hit) const override {
+            // base vertex from the leaf chunk containing the triangle
+            auto itLeaf = std::upper_bound(m_leaves.begin(), m_leaves.end(), _hit.m_uTriangleIndex, [](uint32_t _uTriangle, const Leaf &_leaf) {
+                return _uTriangle < _leaf.m_uFirstTriangle;
+            }) - 1;
+
+            const auto &t = m_triangles[_hit.m_uTriangleIndex];
+            const uint32_t i0 = itLeaf->m_uBaseVertex + t.m_v[0];
+            const uint32_t i1 = itLeaf->m_uBaseVertex + t.m_v[1];
+            const uint32_t i2 = itLeaf->m_uBaseVertex + t.m_v[2];
+            const float fU = _hit.m_uv.u();
+            const float fV = _hit.m_uv.v();
+
+            _hit.m_position = _hit.m_priRay.position(_hit.m_fPositionOnRay);
+
+            // interpolate vertex normals (from hit barycentric uv); face normal if the mesh has none
+            if (m_normals.empty() == false) {
+                _hit.m_normal = fU * octDecode(m_normals[i1]) + fV * octDecode(m_normals[i2]) + (1 - fU - fV) * octDecode(m_normals[i0]);
+            }
+            else {
+                _hit.m_normal = crossProduct(m_positions[i1] - m_positions[i0], m_positions[i2] - m_positions[i0]).normalized();
+            }
+
+            _hit.m_bInside = (_hit.m_normal * _hit.m_priRay.m_direction) >= 0;
+
+            // calc texture coords (from hit barycentric uv)
+            if (m_uvs.empty() == false) {
+                _hit.m_uv = fU * decodeUv(m_uvs[i1]) + fV * decodeUv(m_uvs[i2]) + (1 - fU - fV) * decodeUv(m_uvs[i0]);
+            }
+            else {
+                _hit.m_uv = Uv();
+            }
+
+            return _hit;
+        }
+
+        /* returns bounds for shape */
+        virtual const Bounds &bounds() const override {
+            return m_bounds;
+        }
+
+        /* returns memory used by the mesh data and BVH nodes (bytes) */
+        size_t memoryUsage() const {
+            return m_positions.size() * sizeof(Vec) + m_normals.size() * sizeof(uint32_t) + m_uvs.size() * sizeof(uint32_t) +
+                   m_triangles.size() * sizeof(Triangle) + m_leaves.size() * sizeof(Leaf) +
+                   m_bvh.nodes().size() * sizeof(QuantizedWideBvhNode<4>);
+        }
+
+        size_t vertexCount() const {
+            return m_positions.size();
+        }
+
+        size_t triangleCount() const {
+            return m_triangles.size();
+        }
+
+     private:
+        static uint32_t encodeUv(const Uv &_uv) {
+            return (uint32_t)floatToHalf(_uv.u()) | ((uint32_t)floatToHalf(_uv.v()) << 16);
+        }
+
+        static Uv decodeUv(uint32_t _uUv) {
+            return Uv(halfToFloat((uint16_t)(_uUv & 0xffff)), halfToFloat((uint16_t)(_uUv >> 16)));
+        }
+
+        // pack _uCount triangles, starting at _uFirst, into a SIMD packet (unused lanes never intersect)
+        void buildPacket(packet_type &_packet, uint32_t _uBaseVertex, uint32_t _uFirst, uint32_t _uCount) const {
+            for (uint32_t i = 0; i < (uint32_t)PACKET_WIDTH; i++) {
+                Vec v0, e1, e2;
+                if (i < _uCount) {
+                    const auto &t = m_triangles[_uFirst + i];
+                    v0 = m_positions[_uBaseVertex + t.m_v[0]];
+                    e1 = m_positions[_uBaseVertex + t.m_v[1]] - v0;
+                    e2 = m_positions[_uBaseVertex + t.m_v[2]] - v0;
+                }
+
+                _packet.m_v0x[i] = v0.x(); _packet.m_v0y[i] = v0.y(); _packet.m_v0z[i] = v0.z();
+                _packet.m_e1x[i] = e1.x(); _packet.m_e1y[i] = e1.y(); _packet.m_e1z[i] = e1.z();
+                _packet.m_e2x[i] = e2.x(); _packet.m_e2y[i] = e2.y(); _packet.m_e2z[i] = e2.z();
+                _packet.m_uIndex[i] = _uFirst + std::min(i, _uCount - 1);
+            }
+        }
+
+        // convert mesh data (in leaf order) and quantize its BVH
+        void build(const Mesh &_mesh) {
+            const auto &srcVertices = _mesh.vertices();
+            const auto &srcTriangles = _mesh.triangles();
+            if (_mesh.bvh().empty() == true) {
+                m_leaves.push_back({0, 0});
+                return;
+            }
+
+            bool bUvs = false;
+            for (const auto &v : srcVertices) {
+                bUvs = bUvs || (v.m_uv.u() != 0.0f) || (v.m_uv.v() != 0.0f);
+            }
+
+            const bool bNormals = _mesh.useVertexNormals();
+            const uint32_t NO_VERTEX = 0xffffffff;
+            std::vector<uint32_t> remap(srcVertices.size(), NO_VERTEX);
+
+            // one chunk of source triangles: vertices far outside of the 16 bit window (from earlier leaves) are duplicated
+            auto addChunk = [&](uint32_t _uFirst, uint32_t _uCount) {
+                const uint32_t uNewMax = (uint32_t)m_positions.size() + 3 * _uCount - 1;        // all vertices new (worst case)
+                auto reusable = [&](uint32_t _uVertex) {
+                    return (remap[_uVertex] != NO_VERTEX) && (remap[_uVertex] + 0xffff >= uNewMax);
+                };
+
+                uint32_t uBase = (uint32_t)m_positions.size();
+                for (uint32_t i = _uFirst; i < _uFirst + _uCount; i++) {
+                    for (int k = 0; k < 3; k++) {
+                        if (reusable(srcTriangles[i].m_v[k]) == true) {
+                            uBase = std::min(uBase, remap[srcTriangles[i].m_v[k]]);
+                        }
+                    }
+                }
+
+                m_leaves.push_back({(uint32_t)m_triangles.size(), uBase});
+                for (uint32_t i = _uFirst; i < _uFirst + _uCount; i++) {
+                    Triangle triangle;
+                    for (int k = 0; k < 3; k++) {
+                        const uint32_t uVertex = srcTriangles[i].m_v[k];
+                        if (reusable(uVertex) == false) {
+                            const auto &v = srcVertices[uVertex];
+                            remap[uVertex] = (uint32_t)m_positions.size();
+                            m_positions.push_back(v.m_v);
+                            if (bNormals == true) m_normals.push_back(octEncode(v.m_normal));
+                            if (bUvs == true) m_uvs.push_back(encodeUv(v.m_uv));
+                        }
+
+                        triangle.m_v[k] = (uint16_t)(remap[uVertex] - uBase);
+                    }
+
+                    m_triangles.push_back(triangle);
+                }
+            };
+
+            // source leaf ranges refer to mesh packets (collapsed from the binary nodes, so any mesh BVH width works)
+            WideBvh<4> wide;
+            wide.build(_mesh.bvh().nodes());
+            wide.remapLeaves([&](uint32_t &_uOffset, uint32_t &_uCount) {
+                                 uint32_t uFirst = 0, uTriangles = 0;
+                                 _mesh.leafTriangles(_uOffset, _uCount, uFirst, uTriangles);
+
+                                 _uOffset = (uint32_t)m_leaves.size();
+                                 for (uint32_t i = 0; i < uTriangles; i += MAX_LEAF_TRIANGLES) {
+                                     addChunk(uFirst + i, std::min(uTriangles - i, MAX_LEAF_TRIANGLES));
+                                 }
+
+                                 _uCount = (uint32_t)m_leaves.size() - _uOffset;
+                             });
+
+            m_leaves.push_back({(uint32_t)m_triangles.size(), 0});      // sentinel
+            m_bvh.build(wide);
+
+            m_positions.shrink_to_fit();
+            m_normals.shrink_to_fit();
+            m_uvs.shrink_to_fit();
+            m_triangles.shrink_to_fit();
+            m_leaves.shrink_to_fit();
+        }
+
+     private:
+        const Material                  *m_pMaterial;
+        Bounds                          m_bounds;
+        std::vector<Vec>                m_positions;
+        std::vector<uint32_t>           m_normals;          // octahedral (empty: face normals)
+        std::vector<uint32_t>           m_uvs;              // 2 x half float (empty: no texture coordinates)
+        std::vector<Triangle>           m_triangles;        // in leaf order
+        std::vector<Leaf>               m_leaves;
+        QuantizedWideBvh<4>             m_bvh;
+    };
+
+
+};  // namespace LNF
+
+
+#endif  // #ifndef LIBS_HEADER_COMPACT_MESH_H
@@ -0,0 +1,198 @@
+#ifndef LIBS_HEADER_COUNTERS_H
+#define LIBS_HEADER_COUNTERS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+
+namespace LNF
+{
+    /* Hot path events counted per thread (see RenderCounters) */
+    enum class Counter
+    {
+        RAYS,               // traced path segments (camera and scattered rays)
+        SHADOW_RAYS,        // light sampling occlusion checks
+        BVH_NODES,          // BVH inner nodes tested (scene and mesh BVHs)
+        PRIMITIVE_TESTS,    // primitive instance hit checks in scene and group BVH leaves
+        TRIANGLE_TESTS,     // ray-triangle tests (packet lanes included)
+        MARCH_STEPS,        // ray marching steps (see check_marched_hit())
+        COUNT
+    };
+
+
+    inline const char *counterName(Counter _counter) {
+        static const char *names[] = {"rays", "shadow_rays", "bvh_nodes", "primitive_tests", "triangle_tests", "march_steps"};
+        return names[(int)_counter];
+    }
+
+
+    /*
+     Render counters: hot path events, scatter calls per material type and rays per trace depth.
+     Every thread counts into its own (cache line aligned) instance, see threadCounters(); pixel jobs merge the
+     thread counters into the frame stats when they finish, so counting needs no atomics or locks.
+     Material types are keyed by name (Material::name() returns string literals, names are compared on merge).
+     Counting compiles to nothing if LNF_NO_COUNTERS is defined.
+     */
+    struct alignas(64) RenderCounters
+    {
+        static constexpr int MAX_DEPTH      = 64;       // deeper rays are counted at MAX_DEPTH - 1
+        static constexpr int MAX_MATERIALS  = 32;       // further material types are counted as "other"
+
+        RenderCounters() {
+            clear();
+        }
+
+        void clear() {
+            memset(m_uCounts, 0, sizeof(m_uCounts));
+            memset(m_uDepthRays, 0, sizeof(m_uDepthRays));
+            memset(m_uScatters, 0, sizeof(m_uScatters));
+            m_iMaterials = 0;
+        }
+
+        void add(Counter _counter, uint64_t _uCount = 1) {
+            m_uCounts[(int)_counter] += _uCount;
+        }
+
+        uint64_t count(Counter _counter) const {
+            return m_uCounts[(int)_counter];
+        }
+
+        /* count ray at trace depth (1 for camera rays) */
+        void addRay(int _iDepth, uint64_t _uCount = 1) {
+            m_uCounts[(int)Counter::RAYS] += _uCount;
+            m_uDepthRays[_iDepth < MAX_DEPTH ? _iDepth : MAX_DEPTH - 1] += _uCount;
+        }
+
+        /* count scatter call for material type (_pszMaterial should be a string literal) */
+        void addScatter(const char *_pszMaterial, uint64_t _uCount = 1) {
+            m_uScatters[materialIndex(_pszMaterial)] += _uCount;
+        }
+
+        /* add counters from another thread */
+        void merge(const RenderCounters &_counters) {
+            for (int i = 0; i < (int)Counter::COUNT; i++) {
+                m_uCounts[i] += _counters.m_uCounts[i];
+            }
+
+            for (int i = 0; i < MAX_DEPTH; i++) {
+                m_uDepthRays[i] += _counters.m_uDepthRays[i];
+            }
+
+            for (int i = 0; i < _counters.m_iMaterials; i++) {
+                m_uScatters[materialIndex(_counters.m_pszMaterials[i])] += _counters.m_uScatters[i];
+            }
+
+            m_uScatters[MAX_MATERIALS] += _counters.m_uScatters[MAX_MATERIALS];
+        }
+
+        void print(const char *_pszName) const {
+            printf("%s counters:", _pszName);
+            for (int i = 0; i < (int)Counter::COUNT; i++) {
+                printf(" %s=%llu", counterName((Counter)i), (unsigned long long)m_uCounts[i]);
+            }
+
+            printf("\n%s scatter calls:", _pszName);
+            for (int i = 0; i <= m_iMaterials; i++) {
+                if (m_uScatters[i] > 0) {
+                    printf(" %s=%llu", i < m_iMaterials ? m_pszMaterials[i] : "other", (unsigned long long)m_uScatters[i]);
+                }
+            }
+
+            printf("\n%s rays per depth:", _pszName);
+            for (int i = 1; i < MAX_DEPTH; i++) {
+                if (m_uDepthRays[i] > 0) {
+                    printf(" %d=%llu", i, (unsigned long long)m_uDepthRays[i]);
+                }
+            }
+
+            printf("\n");
+        }
+
+        uint64_t        m_uCounts[(int)Counter::COUNT];
+        uint64_t        m_uDepthRays[MAX_DEPTH];
+        uint64_t        m_uScatters[MAX_MATERIALS + 1];     // last slot counts "other"
+        const char      *m_pszMaterials[MAX_MATERIALS];
+        int             m_iMaterials;
+
+     private:
+        // slot for material name (literal pointers match first; names are compared before adding a new slot)
+        int materialIndex(const char *_pszMaterial) {
+            for (int i = 0; i < m_iMaterials; i++) {
+                if (m_pszMaterials[i] == _pszMaterial) {
+                    return i;
+                }
+            }
+
+            for (int i = 0; i < m_iMaterials; i++) {
+                if (strcmp(m_pszMaterials[i], _pszMaterial) == 0) {
+                    return i;
+                }
+            }
+
+            if (m_iMaterials < MAX_MATERIALS) {
+                m_pszMaterials[m_iMaterials] = _pszMaterial;
+                return m_iMaterials++;
+            }
+
+            return MAX_MATERIALS;
+        }
+    };
+
+
+    /* counters of the calling thread */
+    inline RenderCounters &threadCounters() {
+        thread_local static RenderCounters tlCounters;
+        return tlCounters;
+    }
+
+
+    /* count hot path event on the calling thread */
+    inline void countEvent(Counter _counter, uint64_t _uCount = 1) {
+#if !defined(LNF_NO_COUNTERS)
+        threadCounters().add(_counter, _uCount);
+#endif
+    }
+
+
+    /* count ray at trace depth on the calling thread */
+    inline void countRay(int _iDepth, uint64_t _uCount = 1) {
+#if !defined(LNF_NO_COUNTERS)
+        threadCounters().addRay(_iDepth, _uCount);
+#endif
+    }
+
+
+    /* count scatter call for material type on the calling thread */
+    inline void countScatter(const char *_pszMaterial) {
+#if !defined(LNF_NO_COUNTERS)
+        threadCounters().addScatter(_pszMaterial);
+#endif
+    }
+
+
+    /* Counts in a local variable (inner loops) and adds the total to the thread counters once, on scope exit */
+    class ScopedCount
+    {
+     public:
+        explicit ScopedCount(Counter _counter)
+            :m_counter(_counter),
+             m_uCount(0)
+        {}
+
+        ~ScopedCount() {
+            countEvent(m_counter, m_uCount);
+        }
+
+        void add(uint64_t _uCount = 1) {
+            m_uCount += _uCount;
+        }
+
+     private:
+        Counter     m_counter;
+        uint64_t    m_uCount;
+    };
+
+};  // namespace LNF
+
+#endif  // #ifndef LIBS_HEADER_COUNTERS_H
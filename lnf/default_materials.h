@@ -8,6 +8,10 @@
 #include "intersect.h"
 #include "mandlebrot.h"
 #include "ray.h"
+#include "texture.h"
+
+#include <cmath>
+#include <memory>
 
 
 namespace LNF
@@ -20,12 +24,21 @@ namespace LNF
             :m_color(_color)
         {}
         
-        /* Returns the scattered ray at the intersection point. */
+        /* Returns the material type name (counters). */
+        virtual const char *name() const override {return "diffuse";}
+        
+        /* Returns the scattered ray at the intersection point (cosine weighted). */
         virtual ScatteredRay scatter(const Intersect &_hit) const override {
-            auto scatteredDirection = (_hit.m_normal + randomUnitSphere()).normalized();
+            auto scatteredDirection = (_hit.m_normal + randomUnitSphereSurface()).normalized();
             return ScatteredRay(Ray(_hit.m_position, scatteredDirection), color(_hit), Color());
         }
         
+        /* Returns true if the material is a lambertian diffuser. */
+        virtual bool isLambertian() const override {return true;}
+        
+        /* Returns the diffuse reflectance at the intersection point. */
+        virtual Color albedo(const Intersect &_hit) const override {return color(_hit);}
+        
      protected:
         /* Returns the diffuse color at the given surface position */
         virtual Color color(const Intersect &_hit) const {return m_color;}
@@ -46,6 +59,9 @@ namespace LNF
              m_iBlockSize(_iBlockSize)
         {}
         
+        /* Returns the material type name (counters). */
+        virtual const char *name() const override {return "diffuse_checkered";}
+        
         /* Returns the diffuse color at the given surface position */
         virtual Color color(const Intersect &_hit) const override {
             float c = (float)(((int)(_hit.m_uv.u() * m_iBlockSize) + (int)(_hit.m_uv.v() * m_iBlockSize)) % 2);
@@ -63,20 +79,78 @@ namespace LNF
     class DiffuseMandlebrot : public Diffuse
     {
      public:
-        DiffuseMandlebrot()
+        /* _iBakeSize > 0 bakes the fractal into a (_iBakeSize x _iBakeSize) mip-mapped texture, instead of iterating per hit */
+        DiffuseMandlebrot(int _iBakeSize = 0)
             :Diffuse(Color()),
              m_mandlebrot(1, 1),
              m_baseColor(0.4f, 0.2f, 0.1f)
+        {
+            if (_iBakeSize > 0) {
+                m_pTexture = std::make_unique<Texture>(_iBakeSize, _iBakeSize,
+                                                       [this](const Uv &_uv) {
+                                                           float fIntensity = intensity(_uv.u(), _uv.v());
+                                                           return Color(fIntensity, fIntensity, fIntensity);
+                                                       },
+                                                       m_mandlebrot.max_iterations() * 0.1f + 0.1f);
+            }
+        }
+        
+        /* Returns the material type name (counters). */
+        virtual const char *name() const override {return "diffuse_mandlebrot";}
+        
+        /* Returns the diffuse color at the given surface position */
+        virtual Color color(const Intersect &_hit) const override {
+            if (m_pTexture != nullptr) {
+                return m_baseColor * m_pTexture->sample(_hit.m_uv).red();
+            }
+            
+            return m_baseColor * intensity(_hit.m_uv.u(), _hit.m_uv.v());
+        }
+        
+     private:
+        float intensity(float _fU, float _fV) const {
+            return m_mandlebrot.value(_fU, _fV) * 0.1f + 0.1f;
+        }
+        
+     private:
+        MandleBrot                  m_mandlebrot;
+        Color                       m_baseColor;
+        std::unique_ptr<Texture>    m_pTexture;
+    };
+
+
+    // diffuse material with a texture image
+    class DiffuseTexture : public Diffuse
+    {
+     public:
+        /*
+         _fLodDistance is the view distance at which the first smaller mip level is used (mip level = log2(distance / _fLodDistance));
+         0 always samples the full size level.
+         */
+        DiffuseTexture(const Texture *_pTexture, float _fLodDistance = 0.0f, const Color &_tint = Color(1, 1, 1))
+            :Diffuse(Color()),
+             m_pTexture(_pTexture),
+             m_fLodDistance(_fLodDistance),
+             m_tint(_tint)
         {}
         
+        /* Returns the material type name (counters). */
+        virtual const char *name() const override {return "diffuse_texture";}
+        
         /* Returns the diffuse color at the given surface position */
         virtual Color color(const Intersect &_hit) const override {
-            return m_baseColor * (m_mandlebrot.value(_hit.m_uv.u(), _hit.m_uv.v()) * 0.1f + 0.1f);
+            float fLod = 0.0f;
+            if ( (m_fLodDistance > 0.0f) && (_hit.m_fViewPositionOnRay > m_fLodDistance) ) {
+                fLod = std::log2(_hit.m_fViewPositionOnRay / m_fLodDistance);
+            }
+            
+            return m_pTexture->sample(_hit.m_uv, fLod) * m_tint;
         }
         
      private:
-        MandleBrot      m_mandlebrot;
-        Color           m_baseColor;
+        const Texture       *m_pTexture;
+        float               m_fLodDistance;
+        Color               m_tint;
     };
 
 
@@ -88,10 +162,21 @@ namespace LNF
             :m_color(_color)
        {}
        
+       /* Returns the material type name (counters). */
+       virtual const char *name() const override {return "light";}
+       
        /* Returns the scattered ray at the intersection point. */
        virtual ScatteredRay scatter(const Intersect &_hit) const override {
+            return ScatteredRay(_hit.m_priRay, Color(), emitted(_hit));
+       }
+       
+       /* Returns true if the material emits light. */
+       virtual bool isEmissive() const override {return true;}
+       
+       /* Returns the light emitted at the intersection point. */
+       virtual Color emitted(const Intersect &_hit) const override {
             float fIntensity = fabs(_hit.m_normal * _hit.m_priRay.m_direction);
-            return ScatteredRay(_hit.m_priRay, Color(), m_color * fIntensity);
+            return m_color * fIntensity;
        }
        
      private:
@@ -108,6 +193,9 @@ namespace LNF
              m_fScatter(_fScatter)
         {}
         
+        /* Returns the material type name (counters). */
+        virtual const char *name() const override {return "metal";}
+        
         /* Returns the scattered ray at the intersection point. */
         virtual ScatteredRay scatter(const Intersect &_hit) const override {
             auto normal = (_hit.m_normal + randomUnitSphere() * m_fScatter).normalized();
@@ -132,6 +220,9 @@ namespace LNF
              m_fIndexOfRefraction(_fIndexOfRefraction)
         {}
         
+        /* Returns the material type name (counters). */
+        virtual const char *name() const override {return "glass";}
+        
         /* Returns the scattered ray at the intersection point. */
         virtual ScatteredRay scatter(const Intersect &_hit) const override {
             return ScatteredRay(Ray(_hit.m_position,
@@ -154,6 +245,9 @@ namespace LNF
             :m_bInside(_bInside)
         {}
         
+        /* Returns the material type name (counters). */
+        virtual const char *name() const override {return "surface_normal";}
+        
         /* Returns the scattered ray at the intersection point. */
         virtual ScatteredRay scatter(const Intersect &_hit) const override {
             if (_hit.m_bInside == m_bInside) {
@@ -181,6 +275,9 @@ namespace LNF
         TriangleRGB()
         {}
         
+        /* Returns the material type name (counters). */
+        virtual const char *name() const override {return "triangle_rgb";}
+        
         /* Returns the scattered ray at the intersection point. */
         virtual ScatteredRay scatter(const Intersect &_hit) const override {
             auto scatteredDirection = (_hit.m_normal + randomUnitSphere()).normalized();
@@ -0,0 +1,706 @@
+#ifndef LIBS_HEADER_DISTRIBUTED_H
+#define LIBS_HEADER_DISTRIBUTED_H
+
+#include "camera.h"
+#include "frame.h"
+#include "image_file.h"
+#include "jobs.h"
+#include "loaders.h"
+#include "outputimage.h"
+#include "sampler.h"
+#include "socket.h"
+#include "viewport.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace LNF
+{
+    /*
+     Render node protocol (see socket.h for message framing):
+     coordinator -> node: SETUP, then TILE (tile index) any number of times and DONE at the end of the frame.
+     node -> coordinator: READY (worker count) after setup, then RESULT (tile accumulation pixels) for every tile.
+     */
+    enum class RenderMessage : uint32_t
+    {
+        SETUP = 1,
+        READY,
+        TILE,
+        RESULT,
+        DONE
+    };
+
+
+    /* Frame settings sent to render nodes (fixed layout) */
+    struct RenderSetup
+    {
+        static constexpr uint32_t VERSION = 1;
+
+        uint32_t    m_uVersion = VERSION;
+        int32_t     m_iScene = 0;                   // example scene index (see createSceneLoader())
+        int32_t     m_iWidth = 0;
+        int32_t     m_iHeight = 0;
+        int32_t     m_iSamplesPerPixel = 0;
+        int32_t     m_iMaxTraceDepth = 0;
+        int32_t     m_iTileSize = 0;
+        int32_t     m_iTileOrder = 0;
+        int32_t     m_iTracerType = 0;
+        int32_t     m_iSamplerType = 0;
+        uint32_t    m_uRandSeed = 0;                // sampler seed (same on all nodes)
+        uint32_t    m_uNodeSeed = 0;                // worker random generator seed (unique per node)
+        float       m_camera[16] = {};              // axis x, y, z, origin, scale, fov, aperture, focus distance
+
+        void setCamera(const Camera &_camera) {
+            const Axis &axis = _camera.axis();
+            const Vec *vecs[] = {&axis.m_x, &axis.m_y, &axis.m_z, &axis.m_origin};
+            for (int i = 0; i < 4; i++) {
+                m_camera[3 * i + 0] = vecs[i]->x();
+                m_camera[3 * i + 1] = vecs[i]->y();
+                m_camera[3 * i + 2] = vecs[i]->z();
+            }
+
+            m_camera[12] = axis.m_fScale;
+            m_camera[13] = _camera.fov();
+            m_camera[14] = _camera.aperture();
+            m_camera[15] = _camera.focusDistance();
+        }
+
+        std::unique_ptr<Camera> camera() const {
+            auto vec = [this](int _i) {return Vec(m_camera[3 * _i], m_camera[3 * _i + 1], m_camera[3 * _i + 2]);};
+            return std::make_unique<SimpleCamera>(Axis(vec(0), vec(1), vec(2), vec(3), m_camera[12]),
+                                                  m_camera[13], m_camera[14], m_camera[15]);
+        }
+    };
+
+
+    /* Tile result header (followed by RenderPixel values, tile rows top to bottom) */
+    struct RenderTileHeader
+    {
+        int32_t     m_iTile;
+        uint32_t    m_uReserved;
+        uint64_t    m_uRayCount;
+    };
+
+
+    /* Accumulation buffer pixel as sent by render nodes */
+    struct RenderPixel
+    {
+        float       m_fSum[3];
+        float       m_fLuminanceSq;
+        uint32_t    m_uSamples;
+    };
+
+
+    /*
+     Render node: accepts coordinator connections (one at a time), loads the requested example scene (kept for the
+     next frame if the scene does not change) and renders the tiles it is sent on its own workers.
+     Tiles are rendered with the sampler seed of the frame, so a tile renders the same image samples on any node.
+     */
+    class RenderServer
+    {
+     public:
+        using loader_func = std::function<std::unique_ptr<Loader>(int)>;
+
+     public:
+        explicit RenderServer(int _iNumWorkers, const loader_func &_loaderFunc = createSceneLoader)
+            :m_iNumWorkers(std::max(_iNumWorkers, 1)),
+             m_loaderFunc(_loaderFunc),
+             m_iScene(-1)
+        {}
+
+        /* serves coordinators until listening fails (returns -1) */
+        int serve(uint16_t _uPort) {
+            TcpSocket listener;
+            if (listener.listen(_uPort) != 0) {
+                return -1;
+            }
+
+            while (true) {
+                auto socket = listener.accept();
+                if (socket.valid() == false) {
+                    fprintf(stderr, "ERROR: accept failed\n");
+                    return -1;
+                }
+
+                auto tpStart = std::chrono::steady_clock::now();
+                int iTiles = 0;
+                int iResult = render(socket, iTiles);
+                auto fTimeS = std::chrono::duration<float>(std::chrono::steady_clock::now() - tpStart).count();
+                printf("frame %s %.2fs, tiles=%d\n", iResult == 0 ? "done" : "failed", fTimeS, iTiles);
+                fflush(stdout);
+            }
+        }
+
+        /* renders the tiles of one frame for a connected coordinator; returns 0 if the frame was finished */
+        int render(TcpSocket &_socket, int &_iTiles) {
+            _iTiles = 0;
+
+            uint32_t uType = 0;
+            std::vector<unsigned char> message;
+            RenderSetup setup;
+            if ( (receiveMessage(_socket, uType, message) != 0) ||
+                 (uType != (uint32_t)RenderMessage::SETUP) ||
+                 (message.size() != sizeof(setup)) )
+            {
+                fprintf(stderr, "ERROR: bad render setup\n");
+                return -1;
+            }
+
+            std::memcpy(&setup, message.data(), sizeof(setup));
+            if ( (setup.m_uVersion != RenderSetup::VERSION) ||
+                 (setup.m_iWidth <= 0) || (setup.m_iHeight <= 0) ||
+                 ((int64_t)setup.m_iWidth * setup.m_iHeight > MAX_PIXELS) ||
+                 (setup.m_iSamplesPerPixel <= 0) || (setup.m_iMaxTraceDepth <= 0) || (setup.m_iTileSize < 0) ||
+                 (setup.m_iSamplerType < (int)SamplerType::RANDOM) || (setup.m_iSamplerType > (int)SamplerType::SOBOL) ||
+                 (setup.m_iTileOrder < (int)TileOrder::SHUFFLED) || (setup.m_iTileOrder > (int)TileOrder::SPIRAL) ||
+                 (setup.m_iTracerType < (int)TracerType::DEPTH_FIRST) || (setup.m_iTracerType > (int)TracerType::WAVEFRONT) )
+            {
+                fprintf(stderr, "ERROR: unsupported render setup\n");
+                return -1;
+            }
+
+            if (loadScene(setup.m_iScene) != 0) {
+                return -1;
+            }
+
+            Viewport viewport(setup.m_iWidth, setup.m_iHeight);
+            auto pCamera = setup.camera();
+            auto pSampler = createSampler((SamplerType)setup.m_iSamplerType, setup.m_uRandSeed);
+            OutputImageBuffer image(setup.m_iWidth, setup.m_iHeight);
+            AccumulationBuffer accumulation(setup.m_iWidth, setup.m_iHeight);
+            FrameStats stats;
+            std::atomic<bool> bCancelled(false);
+            TileListener listener;
+
+            const auto regions = Frame::imageRegions(setup.m_iWidth, setup.m_iHeight, setup.m_iTileSize, (TileOrder)setup.m_iTileOrder);
+            std::vector<std::unique_ptr<PixelJob>> jobs;
+            jobs.reserve(regions.size());
+            for (size_t i = 0; i < regions.size(); i++) {
+                const auto &rect = regions[i];
+                jobs.push_back(std::make_unique<PixelJob>(&image, rect.m_iX, rect.m_iY, rect.m_iWidth, rect.m_iHeight,
+                                                          &viewport,
+                                                          pCamera.get(),
+                                                          m_pScene.get(),
+                                                          &stats,
+                                                          setup.m_iSamplesPerPixel,
+                                                          setup.m_iMaxTraceDepth,
+                                                          0.0f,
+                                                          &accumulation,
+                                                          &listener,
+                                                          (int)i,
+                                                          setup.m_iSamplesPerPixel,
+                                                          (TracerType)setup.m_iTracerType,
+                                                          pSampler.get(),
+                                                          &bCancelled));
+            }
+
+            JobQueue jobQueue;
+            std::vector<std::unique_ptr<Worker>> workers;
+            for (int i = 0; i < m_iNumWorkers; i++) {
+                workers.push_back(std::make_unique<PixelWorker>(&jobQueue, 1, setup.m_uNodeSeed));
+            }
+
+            // receive tile requests on their own thread
+            bool bFinished = false;
+            std::thread receiver([&]() {
+                uint32_t uType = 0;
+                std::vector<unsigned char> message;
+                while (receiveMessage(_socket, uType, message) == 0) {
+                    int32_t iTile = -1;
+                    if ( (uType == (uint32_t)RenderMessage::TILE) && (message.size() == sizeof(iTile)) ) {
+                        std::memcpy(&iTile, message.data(), sizeof(iTile));
+                        if ( (iTile >= 0) && ((size_t)iTile < jobs.size()) ) {
+                            jobQueue.push(std::vector<Job*>{jobs[iTile].get()});
+                            continue;
+                        }
+                    }
+
+                    bFinished = uType == (uint32_t)RenderMessage::DONE;
+                    break;
+                }
+
+                listener.stop();
+            });
+
+            // send results as tiles finish
+            int iResult = 0;
+            const int32_t iWorkers = m_iNumWorkers;
+            if (sendMessage(_socket, (uint32_t)RenderMessage::READY, &iWorkers, sizeof(iWorkers)) != 0) {
+                iResult = -1;
+            }
+
+            std::vector<unsigned char> result;
+            uint64_t uRayCount = 0;
+            int iTile = -1;
+            while ( (iResult == 0) && (listener.next(iTile) == true) ) {
+                const uint64_t uRays = stats.rayCount();
+                const auto &rect = regions[iTile];
+                RenderTileHeader header = {iTile, 0, uRays - uRayCount};
+                uRayCount = uRays;
+
+                result.resize(sizeof(header) + sizeof(RenderPixel) * rect.m_iWidth * rect.m_iHeight);
+                std::memcpy(result.data(), &header, sizeof(header));
+
+                auto pPixel = result.data() + sizeof(header);
+                for (int j = rect.m_iY; j < rect.m_iY + rect.m_iHeight; j++) {
+                    for (int i = rect.m_iX; i < rect.m_iX + rect.m_iWidth; i++, pPixel += sizeof(RenderPixel)) {
+                        const auto &pixel = accumulation.pixel(i, j);
+                        RenderPixel value = {{pixel.m_sum.red(), pixel.m_sum.green(), pixel.m_sum.blue()},
+                                             pixel.m_fLuminanceSq,
+                                             pixel.m_uSamples};
+                        std::memcpy(pPixel, &value, sizeof(value));
+                    }
+                }
+
+                if (sendMessage(_socket, (uint32_t)RenderMessage::RESULT, result.data(), result.size()) != 0) {
+                    iResult = -1;
+                }
+
+                _iTiles++;
+            }
+
+            // stop receiving and rendering (workers are stopped before the jobs and buffers go away)
+            _socket.shutdown();
+            receiver.join();
+            bCancelled = true;
+            for (const auto &pWorker : workers) {
+                pWorker->stop();
+            }
+
+            workers.clear();
+            return (iResult == 0) && (bFinished == true) ? 0 : -1;
+        }
+
+     private:
+        static constexpr int64_t MAX_PIXELS = (int64_t)1 << 28;
+
+        // collects finished tiles (called from worker threads)
+        class TileListener  : public PixelJobListener
+        {
+         public:
+            virtual void onJobFinished(int _iJobIndex, const PixelJobResult &) override {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_tiles.push_back(_iJobIndex);
+                }
+
+                m_cv.notify_all();
+            }
+
+            /* waits for the next finished tile; returns false once stopped */
+            bool next(int &_iTile) {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [this]{return (m_tiles.empty() == false) || (m_bStopped == true);});
+                if (m_bStopped == true) {
+                    return false;
+                }
+
+                _iTile = m_tiles.front();
+                m_tiles.pop_front();
+                return true;
+            }
+
+            void stop() {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_bStopped = true;
+                }
+
+                m_cv.notify_all();
+            }
+
+         private:
+            std::mutex                  m_mutex;
+            std::condition_variable     m_cv;
+            std::deque<int>             m_tiles;
+            bool                        m_bStopped = false;
+        };
+
+     private:
+        int loadScene(int _iScene) {
+            if ( (m_pScene != nullptr) && (m_iScene == _iScene) ) {
+                return 0;
+            }
+
+            m_pScene.reset();
+            m_iScene = -1;
+
+            auto pLoader = m_loaderFunc(_iScene);
+            if (pLoader == nullptr) {
+                fprintf(stderr, "ERROR: unknown scene %d\n", _iScene);
+                return -1;
+            }
+
+            m_pScene = pLoader->loadScene();
+            m_iScene = _iScene;
+            return 0;
+        }
+
+     private:
+        int                         m_iNumWorkers;
+        loader_func                 m_loaderFunc;
+        int                         m_iScene;
+        std::unique_ptr<Scene>      m_pScene;
+    };
+
+
+    /*
+     Coordinator for a frame rendered on render nodes ('host:port', see RenderServer).
+     All nodes load the same example scene and camera. Tiles (the same tiling as Frame) are handed out to nodes as
+     they finish (up to two per node worker in flight, to hide network latency) and the returned accumulation pixels
+     are merged into the frame's accumulation buffer. The tiles of a node that fails go back to the other nodes;
+     the frame fails (incompleteTiles() > 0) only if all nodes fail.
+     */
+    class DistributedFrame
+    {
+     public:
+        DistributedFrame(const std::vector<std::string> &_nodes,
+                         int _iScene,
+                         const Viewport *_pViewport,
+                         const Camera *_pCamera,
+                         int _iMaxSamplesPerPixel,
+                         int _iMaxTraceDepth,
+                         uint32_t _uRandSeed,
+                         int _iTileSize = 32,
+                         TileOrder _tileOrder = TileOrder::SPIRAL,
+                         TracerType _tracerType = TracerType::DEPTH_FIRST,
+                         SamplerType _samplerType = SamplerType::SOBOL)
+            :m_nodes(_nodes),
+             m_image(_pViewport->width(), _pViewport->height()),
+             m_accumulation(_pViewport->width(), _pViewport->height()),
+             m_regions(Frame::imageRegions(_pViewport->width(), _pViewport->height(), _iTileSize, _tileOrder)),
+             m_tpStart(std::chrono::steady_clock::now()),
+             m_uRayCount(0),
+             m_bCancelled(false),
+             m_iTilesDone(0),
+             m_iNodesLeft((int)_nodes.size()),
+             m_iFailedNodes(0),
+             m_bDone(_nodes.empty() == true),
+             m_fTimeTotalS(0)
+        {
+            m_setup.m_iScene = _iScene;
+            m_setup.m_iWidth = _pViewport->width();
+            m_setup.m_iHeight = _pViewport->height();
+            m_setup.m_iSamplesPerPixel = _iMaxSamplesPerPixel;
+            m_setup.m_iMaxTraceDepth = _iMaxTraceDepth;
+            m_setup.m_iTileSize = _iTileSize;
+            m_setup.m_iTileOrder = (int32_t)_tileOrder;
+            m_setup.m_iTracerType = (int32_t)_tracerType;
+            m_setup.m_iSamplerType = (int32_t)_samplerType;
+            m_setup.m_uRandSeed = _uRandSeed;
+            m_setup.setCamera(*_pCamera);
+
+            for (size_t i = 0; i < m_regions.size(); i++) {
+                m_pending.push_back((int)i);
+            }
+
+            for (size_t i = 0; i < m_nodes.size(); i++) {
+                m_threads.emplace_back(&DistributedFrame::runNode, this, i);
+            }
+        }
+
+        /* cancels the frame in flight and waits for connections to close */
+        ~DistributedFrame() {
+            cancel();
+            for (auto &thread : m_threads) {
+                thread.join();
+            }
+        }
+
+        void cancel() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_bCancelled = true;
+            for (auto pSocket : m_sockets) {
+                pSocket->shutdown();
+            }
+
+            m_cv.notify_all();
+        }
+
+        /* blocks until all tiles are done (or all nodes failed) */
+        void waitFinished() {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this]{return m_bDone;});
+        }
+
+        bool isFinished() const {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_bDone;
+        }
+
+        float progress() const {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_regions.empty() ? 1.0f : (float)m_iTilesDone / m_regions.size();
+        }
+
+        float timeTotal() const {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_bDone ? m_fTimeTotalS : elapsed();
+        }
+
+        float raysPerSecond() const {
+            float fTimeS = timeTotal();
+            return fTimeS > 0 ? m_uRayCount / fTimeS : 0.0f;
+        }
+
+        /* returns the number of nodes that could not be reached or dropped out */
+        int failedNodes() const {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_iFailedNodes;
+        }
+
+        /* returns the number of tiles that were not rendered (all nodes failed) */
+        int incompleteTiles() const {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return (int)m_regions.size() - m_iTilesDone;
+        }
+
+        const OutputImageBuffer &image() const {
+            return m_image;
+        }
+
+        const AccumulationBuffer &accumulation() const {
+            return m_accumulation;
+        }
+
+        /* writes finished frame to file (JPEG, PNG or HDR EXR by extension); returns 0 on success */
+        int writeImageFile(const std::string &_strPath, int _iQuality) const {
+            auto pWriter = createImageFileWriter(_strPath, _iQuality);
+            if (pWriter->open(_strPath.c_str(), m_image.width(), m_image.height()) != 0) {
+                return -1;
+            }
+
+            std::vector<float> row((size_t)m_image.width() * 3);
+            for (int j = 0; j < m_image.height(); j++) {
+                int iResult = 0;
+                if (pWriter->hdr() == true) {
+                    for (int i = 0; i < m_image.width(); i++) {
+                        auto color = m_accumulation.pixel(i, j).mean();
+                        row[3 * i + 0] = color.red();
+                        row[3 * i + 1] = color.green();
+                        row[3 * i + 2] = color.blue();
+                    }
+
+                    iResult = pWriter->writeRow(row.data());
+                }
+                else {
+                    iResult = pWriter->writeRow(m_image.row(j));
+                }
+
+                if (iResult != 0) {
+                    return -1;
+                }
+            }
+
+            return pWriter->finish();
+        }
+
+     private:
+        float elapsed() const {
+            return std::chrono::duration<float>(std::chrono::steady_clock::now() - m_tpStart).count();
+        }
+
+        // connection to one node (own thread): keeps tiles in flight and merges results
+        void runNode(size_t _uNode) {
+            TcpSocket socket;
+            std::deque<int> inFlight;
+            int iResult = renderNode(_uNode, socket, inFlight);
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_sockets.erase(std::remove(m_sockets.begin(), m_sockets.end(), &socket), m_sockets.end());
+
+            if (iResult != 0) {
+                if (m_bCancelled == false) {
+                    fprintf(stderr, "ERROR: render node %s failed, %d tiles reassigned\n", m_nodes[_uNode].c_str(), (int)inFlight.size());
+                }
+
+                m_pending.insert(m_pending.begin(), inFlight.begin(), inFlight.end());
+                m_iFailedNodes++;
+            }
+
+            if ( (--m_iNodesLeft == 0) && (m_bDone == false) ) {
+                finish();
+            }
+
+            m_cv.notify_all();
+        }
+
+        int renderNode(size_t _uNode, TcpSocket &_socket, std::deque<int> &_inFlight) {
+            const auto &strNode = m_nodes[_uNode];
+            auto uColon = strNode.rfind(':');
+            if (uColon == std::string::npos) {
+                fprintf(stderr, "ERROR: bad render node '%s' (host:port)\n", strNode.c_str());
+                return -1;
+            }
+
+            if (_socket.connect(strNode.substr(0, uColon), (uint16_t)atoi(strNode.c_str() + uColon + 1)) != 0) {
+                return -1;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_bCancelled == true) {
+                    return -1;
+                }
+
+                m_sockets.push_back(&_socket);
+            }
+
+            RenderSetup setup = m_setup;
+            setup.m_uNodeSeed = m_setup.m_uRandSeed + (uint32_t)(_uNode + 1) * 0x9e3779b9u;
+
+            uint32_t uType = 0;
+            int32_t iWorkers = 0;
+            std::vector<unsigned char> message;
+            if ( (sendMessage(_socket, (uint32_t)RenderMessage::SETUP, &setup, sizeof(setup)) != 0) ||
+                 (receiveMessage(_socket, uType, message) != 0) ||
+                 (uType != (uint32_t)RenderMessage::READY) ||
+                 (message.size() != sizeof(iWorkers)) )
+            {
+                return -1;
+            }
+
+            std::memcpy(&iWorkers, message.data(), sizeof(iWorkers));
+            const size_t uMaxInFlight = (size_t)std::max(iWorkers, 1) * 2;
+
+            while (true) {
+                // queue more tiles, or wait for tiles of failed nodes while nothing is in flight
+                std::vector<int32_t> tiles;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    if (_inFlight.empty() == true) {
+                        m_cv.wait(lock, [this]{return (m_pending.empty() == false) || (m_bDone == true) || (m_bCancelled == true);});
+                    }
+
+                    if (m_bCancelled == true) {
+                        return -1;
+                    }
+
+                    if ( (m_bDone == true) && (_inFlight.empty() == true) ) {
+                        break;
+                    }
+
+                    while ( (_inFlight.size() < uMaxInFlight) && (m_pending.empty() == false) ) {
+                        tiles.push_back(m_pending.front());
+                        _inFlight.push_back(m_pending.front());
+                        m_pending.pop_front();
+                    }
+                }
+
+                for (auto iTile : tiles) {
+                    if (sendMessage(_socket, (uint32_t)RenderMessage::TILE, &iTile, sizeof(iTile)) != 0) {
+                        return -1;
+                    }
+                }
+
+                // merge next result
+                if ( (receiveMessage(_socket, uType, message) != 0) ||
+                     (uType != (uint32_t)RenderMessage::RESULT) ||
+                     (mergeTile(message, _inFlight) != 0) )
+                {
+                    return -1;
+                }
+            }
+
+            return sendMessage(_socket, (uint32_t)RenderMessage::DONE, nullptr, 0);
+        }
+
+        // copies tile accumulation pixels into the frame (tiles are only ever in flight on one node)
+        int mergeTile(const std::vector<unsigned char> &_message, std::deque<int> &_inFlight) {
+            RenderTileHeader header;
+            if (_message.size() < sizeof(header)) {
+                return -1;
+            }
+
+            std::memcpy(&header, _message.data(), sizeof(header));
+            auto it = std::find(_inFlight.begin(), _inFlight.end(), header.m_iTile);
+            if (it == _inFlight.end()) {
+                return -1;
+            }
+
+            const auto &rect = m_regions[header.m_iTile];
+            if (_message.size() != sizeof(header) + sizeof(RenderPixel) * rect.m_iWidth * rect.m_iHeight) {
+                return -1;
+            }
+
+            auto pPixel = _message.data() + sizeof(header);
+            for (int j = rect.m_iY; j < rect.m_iY + rect.m_iHeight; j++) {
+                unsigned char *pOutput = m_image.row(j) + 3 * rect.m_iX;
+                for (int i = rect.m_iX; i < rect.m_iX + rect.m_iWidth; i++, pPixel += sizeof(RenderPixel)) {
+                    RenderPixel value;
+                    std::memcpy(&value, pPixel, sizeof(value));
+
+                    auto &pixel = m_accumulation.pixel(i, j);
+                    pixel.m_sum = Color(value.m_fSum[0], value.m_fSum[1], value.m_fSum[2]);
+                    pixel.m_fLuminanceSq = value.m_fLuminanceSq;
+                    pixel.m_uSamples = value.m_uSamples;
+
+                    auto color = pixel.mean();
+                    color.clamp();
+
+                    *(pOutput++) = (int)(255 * color.red() + 0.5);
+                    *(pOutput++) = (int)(255 * color.green() + 0.5);
+                    *(pOutput++) = (int)(255 * color.blue() + 0.5);
+                }
+            }
+
+            _inFlight.erase(it);
+            m_uRayCount += header.m_uRayCount;
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (++m_iTilesDone == (int)m_regions.size()) {
+                finish();
+                m_cv.notify_all();
+            }
+
+            return 0;
+        }
+
+        // called with lock held
+        void finish() {
+            m_fTimeTotalS = elapsed();
+            m_bDone = true;
+        }
+
+     private:
+        std::vector<std::string>        m_nodes;
+        RenderSetup                     m_setup;
+        OutputImageBuffer               m_image;
+        AccumulationBuffer              m_accumulation;
+        std::vector<ImageRect>          m_regions;
+        std::chrono::steady_clock::time_point   m_tpStart;
+        std::atomic<uint64_t>           m_uRayCount;
+
+        mutable std::mutex              m_mutex;
+        std::condition_variable         m_cv;
+        std::deque<int>                 m_pending;          // tiles waiting for a node
+        std::vector<TcpSocket*>         m_sockets;          // open node connections (shut down on cancel)
+        bool                            m_bCancelled;
+        int                             m_iTilesDone;
+        int                             m_iNodesLeft;
+        int                             m_iFailedNodes;
+        bool                            m_bDone;
+        float                           m_fTimeTotalS;
+
+        std::vector<std::thread>        m_threads;
+    };
+
+
+};  // namespace LNF
+
+
+#endif  // #ifndef LIBS_HEADER_DISTRIBUTED_H
@@ -0,0 +1,251 @@
+#ifndef LIBS_HEADER_FIXED_POINT_H
+#define LIBS_HEADER_FIXED_POINT_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+
+namespace LNF
+{
+    /*
+     Signed fixed point number with (LIMBS - 1) * 32 fraction bits and a 32 bit integer part (two's complement,
+     least significant limb first). Integer arithmetic only, so results do not depend on floating point flags
+     (e.g. -ffast-math). Multiplication truncates the extra fraction bits.
+     */
+    template <int LIMBS>
+    class FixedPoint
+    {
+     public:
+        static_assert(LIMBS >= 2, "FixedPoint needs at least one fraction limb");
+
+        static constexpr int FRACTION_BITS = (LIMBS - 1) * 32;
+
+     public:
+        FixedPoint() noexcept
+            :m_limbs{}
+        {}
+
+        /* exact for |_f| < 2^31 (fraction bits beyond the precision are truncated) */
+        explicit FixedPoint(double _f) noexcept
+            :m_limbs{}
+        {
+            double f = fabs(_f);
+            double fInt = floor(f);
+            m_limbs[LIMBS - 1] = (uint32_t)fInt;
+            f -= fInt;
+
+            for (int i = LIMBS - 2; (i >= 0) && (f > 0); i--) {
+                f *= 4294967296.0;
+                fInt = floor(f);
+                m_limbs[i] = (uint32_t)fInt;
+                f -= fInt;
+            }
+
+            if (_f < 0) {
+                negate();
+            }
+        }
+
+        /* conversion between precisions (extra fraction bits are truncated) */
+        template <int OTHER_LIMBS>
+        explicit FixedPoint(const FixedPoint<OTHER_LIMBS> &_other) noexcept
+            :m_limbs{}
+        {
+            for (int i = 0; i < LIMBS; i++) {
+                const int j = i + OTHER_LIMBS - LIMBS;
+                if (j >= 0) {
+                    m_limbs[i] = _other.limb(j);
+                }
+            }
+        }
+
+        /*
+         Parses a decimal number ('-1.25', '0.74364388703715870475219150611477e-1'); returns false if the text is not a
+         number or is out of range.
+         */
+        static bool parse(const char *_pszText, FixedPoint &_value) {
+            const char *p = _pszText;
+            const bool bNegative = *p == '-';
+            if ( (*p == '-') || (*p == '+') ) {
+                p++;
+            }
+
+            // integer digits
+            const char *pDigits = p;
+            int64_t iInt = 0;
+            while ( (*p >= '0') && (*p <= '9') ) {
+                iInt = iInt * 10 + (*p++ - '0');
+                if (iInt > 0x7fffffff) {
+                    return false;
+                }
+            }
+
+            // fraction digits (added from the last digit: x = (x + d) / 10)
+            const char *pFraction = nullptr;
+            const char *pFractionEnd = nullptr;
+            if (*p == '.') {
+                pFraction = ++p;
+                while ( (*p >= '0') && (*p <= '9') ) {
+                    p++;
+                }
+
+                pFractionEnd = p;
+            }
+
+            if ( (p == pDigits) || (p == pFraction) ) {
+                return false;
+            }
+
+            int iExponent = 0;
+            if ( (*p == 'e') || (*p == 'E') ) {
+                char *pEnd = nullptr;
+                iExponent = (int)strtol(p + 1, &pEnd, 10);
+                if (pEnd == p + 1) {
+                    return false;
+                }
+
+                p = pEnd;
+            }
+
+            if (*p != 0) {
+                return false;
+            }
+
+            FixedPoint value;
+            if (pFraction != nullptr) {
+                for (const char *q = pFractionEnd; q > pFraction; q--) {
+                    value.m_limbs[LIMBS - 1] += (uint32_t)(q[-1] - '0');
+                    value.divide(10);
+                }
+            }
+
+            value.m_limbs[LIMBS - 1] += (uint32_t)iInt;
+
+            for (int i = 0; i < iExponent; i++) {
+                if (value.m_limbs[LIMBS - 1] >= 0x7fffffff / 10) {
+                    return false;
+                }
+
+                value = value * FixedPoint(10.0);
+            }
+
+            for (int i = 0; i > iExponent; i--) {
+                value.divide(10);
+            }
+
+            if (bNegative == true) {
+                value.negate();
+            }
+
+            _value = value;
+            return true;
+        }
+
+        double toDouble() const {
+            FixedPoint magnitude = *this;
+            if (negative() == true) {
+                magnitude.negate();
+            }
+
+            double f = 0;
+            for (int i = 0; i < LIMBS; i++) {
+                f += ldexp((double)magnitude.m_limbs[i], 32 * i - FRACTION_BITS);
+            }
+
+            return negative() == true ? -f : f;
+        }
+
+        bool negative() const {
+            return (m_limbs[LIMBS - 1] & 0x80000000) != 0;
+        }
+
+        uint32_t limb(int _i) const {
+            return m_limbs[_i];
+        }
+
+        void negate() {
+            uint64_t uCarry = 1;
+            for (int i = 0; i < LIMBS; i++) {
+                uCarry += (uint32_t)~m_limbs[i];
+                m_limbs[i] = (uint32_t)uCarry;
+                uCarry >>= 32;
+            }
+        }
+
+        friend FixedPoint operator+(const FixedPoint &_a, const FixedPoint &_b) {
+            FixedPoint ret;
+            uint64_t uCarry = 0;
+            for (int i = 0; i < LIMBS; i++) {
+                uCarry += (uint64_t)_a.m_limbs[i] + _b.m_limbs[i];
+                ret.m_limbs[i] = (uint32_t)uCarry;
+                uCarry >>= 32;
+            }
+
+            return ret;
+        }
+
+        friend FixedPoint operator-(const FixedPoint &_a, const FixedPoint &_b) {
+            FixedPoint b = _b;
+            b.negate();
+            return _a + b;
+        }
+
+        friend FixedPoint operator*(const FixedPoint &_a, const FixedPoint &_b) {
+            // multiply magnitudes and keep the limbs of the integer part and the top fraction bits
+            FixedPoint a = _a, b = _b;
+            const bool bNegative = a.negative() != b.negative();
+            if (a.negative() == true) a.negate();
+            if (b.negative() == true) b.negate();
+
+            uint32_t product[2 * LIMBS] = {};
+            for (int i = 0; i < LIMBS; i++) {
+                uint64_t uCarry = 0;
+                for (int j = 0; j < LIMBS; j++) {
+                    uCarry += (uint64_t)a.m_limbs[i] * b.m_limbs[j] + product[i + j];
+                    product[i + j] = (uint32_t)uCarry;
+                    uCarry >>= 32;
+                }
+
+                product[i + LIMBS] = (uint32_t)uCarry;
+            }
+
+            FixedPoint ret;
+            std::memcpy(ret.m_limbs, product + LIMBS - 1, sizeof(ret.m_limbs));
+            if (bNegative == true) {
+                ret.negate();
+            }
+
+            return ret;
+        }
+
+     private:
+        // divides magnitude by a small integer (truncates)
+        void divide(uint32_t _uDivisor) {
+            const bool bNegative = negative();
+            if (bNegative == true) {
+                negate();
+            }
+
+            uint64_t uRemainder = 0;
+            for (int i = LIMBS - 1; i >= 0; i--) {
+                const uint64_t u = (uRemainder << 32) | m_limbs[i];
+                m_limbs[i] = (uint32_t)(u / _uDivisor);
+                uRemainder = u % _uDivisor;
+            }
+
+            if (bNegative == true) {
+                negate();
+            }
+        }
+
+     private:
+        uint32_t        m_limbs[LIMBS];
+    };
+
+
+};  // namespace LNF
+
+
+#endif  // #ifndef LIBS_HEADER_FIXED_POINT_H
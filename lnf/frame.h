@@ -4,27 +4,54 @@
 
 
 
+#include "arena.h"
 #include "constants.h"
+#include "counters.h"
 #include "jobs.h"
+#include "image_file.h"
 #include "jpeg.h"
+#include "json.h"
 #include "outputimage.h"
 #include "viewport.h"
 #include "scene.h"
 #include "camera.h"
 #include "trace.h"
+#include "wavefront.h"
 #include "ray.h"
 #include "random.h"
+#include "sampler.h"
 
 #include <algorithm>
 #include <chrono>
 #include <random>
 #include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 
 
 namespace LNF
 {
-    /* Gather and calculate frame stats */
+    /* Pixel job timing (one per job run; times are seconds since the frame started) */
+    struct TileEvent
+    {
+        int         m_iRegion;          // job/region index
+        int         m_iSamples;         // samples per pixel of the run
+        uint32_t    m_uThread;          // worker thread (hashed thread id)
+        double      m_fStartS;
+        double      m_fDurationS;
+        uint64_t    m_uRays;
+    };
+    
+    
+    /*
+     Gather and calculate frame stats.
+     Render counters and tile events are added by pixel jobs as they finish.
+     */
     class FrameStats
     {
      private:
@@ -34,7 +61,9 @@ namespace LNF
         FrameStats()
             :m_uActiveJobs(0),
              m_uJobCount(0),
+             m_uPixelCount(0),
              m_uRayCount(0),
+             m_uPixelsDone(0),
              m_fFrameProgress(0),
              m_fTimeSpentS(0),
              m_fTimeToFinishS(0),
@@ -45,10 +74,34 @@ namespace LNF
             m_tpStart = m_clock.now();
         }
         
+        /* clear counters and restart timer (new frame) */
+        void reset() {
+            m_uActiveJobs = 0;
+            m_uJobCount = 0;
+            m_uPixelCount = 0;
+            m_uRayCount = 0;
+            m_uPixelsDone = 0;
+            m_fFrameProgress = 0;
+            m_fTimeSpentS = 0;
+            m_fTimeToFinishS = 0;
+            m_fRaysPerSecond = 0;
+            m_bFinished = false;
+            m_bUpdates = false;
+            m_tpStart = m_clock.now();
+            
+            std::lock_guard<std::mutex> lock(m_eventMutex);
+            m_counters.clear();
+            m_tileEvents.clear();
+        }
+        
         void setJobCount(size_t _uJobCount) {
             m_uJobCount = _uJobCount;
         }
         
+        void setPixelCount(size_t _uPixelCount) {
+            m_uPixelCount = _uPixelCount;
+        }
+        
         void setActiveJobs(size_t _uActiveJobs) {
             if (m_uActiveJobs != _uActiveJobs) {
                 m_uActiveJobs = _uActiveJobs;
@@ -62,6 +115,41 @@ namespace LNF
                 m_bUpdates = true;
             }
         }
+        
+        void updatePixelCount(uint64_t _uPixelCountDelta) {
+            if (_uPixelCountDelta > 0) {
+                m_uPixelsDone += _uPixelCountDelta;
+                m_bUpdates = true;
+            }
+        }
+
+        /* add (and clear) counters of a worker thread */
+        void mergeCounters(RenderCounters &_counters) {
+            std::lock_guard<std::mutex> lock(m_eventMutex);
+            m_counters.merge(_counters);
+            _counters.clear();
+        }
+        
+        void addTileEvent(const TileEvent &_event) {
+            std::lock_guard<std::mutex> lock(m_eventMutex);
+            m_tileEvents.push_back(_event);
+        }
+        
+        /* returns counters merged so far (all of them once the frame is done) */
+        RenderCounters counters() {
+            std::lock_guard<std::mutex> lock(m_eventMutex);
+            return m_counters;
+        }
+        
+        std::vector<TileEvent> tileEvents() {
+            std::lock_guard<std::mutex> lock(m_eventMutex);
+            return m_tileEvents;
+        }
+        
+        /* returns seconds since frame start */
+        double elapsed() const {
+            return std::chrono::duration<double>(m_clock.now() - m_tpStart).count();
+        }
 
         // recalculate frame stats
         void update() {
@@ -70,8 +158,14 @@ namespace LNF
                 auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(m_clock.now() - m_tpStart).count();
                 m_fTimeSpentS = ns * 1e-9f;
 
-                // calc perf, progress and time to go
-                m_fFrameProgress = (float)(m_uJobCount - m_uActiveJobs) / m_uJobCount;
+                // calc perf, progress (pixels done, since jobs may differ in size) and time to go
+                if (m_uPixelCount > 0) {
+                    m_fFrameProgress = std::min((float)m_uPixelsDone / m_uPixelCount, 1.0f);
+                }
+                else {
+                    m_fFrameProgress = (float)(m_uJobCount - m_uActiveJobs) / m_uJobCount;
+                }
+                
                 m_bFinished = m_uActiveJobs == 0;
                 
                 if (m_fFrameProgress > 0.01) {
@@ -92,6 +186,14 @@ namespace LNF
             return m_uActiveJobs;
         }
         
+        uint64_t pixelsDone() const {
+            return m_uPixelsDone;
+        }
+        
+        uint64_t rayCount() const {
+            return m_uRayCount;
+        }
+        
         float progress() const {
             return m_fFrameProgress;
         }
@@ -120,7 +222,9 @@ namespace LNF
         
         size_t                                  m_uActiveJobs;
         size_t                                  m_uJobCount;
+        std::atomic<size_t>                     m_uPixelCount;
         std::atomic<uint64_t>                   m_uRayCount;
+        std::atomic<uint64_t>                   m_uPixelsDone;
 
         float                                   m_fFrameProgress;
         float                                   m_fTimeSpentS;
@@ -128,36 +232,115 @@ namespace LNF
         float                                   m_fRaysPerSecond;
         bool                                    m_bFinished;
         bool                                    m_bUpdates;
+        
+        std::mutex                              m_eventMutex;
+        RenderCounters                          m_counters;
+        std::vector<TileEvent>                  m_tileEvents;
+    };
+
+
+    /* Path tracer used by pixel jobs */
+    enum class TracerType
+    {
+        DEPTH_FIRST,    // one path at a time (RayTracer)
+        WAVEFRONT       // all paths of a job in a batch, bounce by bounce (WavefrontTracer)
+    };
+    
+    
+    /* Job ordering for tiles */
+    enum class TileOrder
+    {
+        SHUFFLED,
+        HILBERT,        // along Hilbert curve (coherent, tile neighbours rendered together)
+        SPIRAL          // spiral out from image center
     };
 
 
-    /* Raytracing job (line of pixels on output image) */
+    /* Progressive pixel job results */
+    struct PixelJobResult
+    {
+        double      m_fErrorSum = 0;            // sum of pixel noise estimates (luminance std error)
+        double      m_fRelativeErrorSum = 0;    // sum of relative pixel noise estimates
+        uint64_t    m_uSamples = 0;             // number of samples added
+    };
+    
+    
+    /* Receives pixel job completion (used to chain progressive passes) */
+    class PixelJobListener
+    {
+     public:
+        virtual ~PixelJobListener() = default;
+        
+        /* called by every progressive job once done */
+        virtual void onJobFinished(int _iJobIndex, const PixelJobResult &_result) = 0;
+    };
+    
+    
+    /*
+     Raytracing job (line or tile of pixels on output image).
+     If an accumulation buffer is given, samples are added to the buffer and the running mean is written to the output image.
+     The wavefront tracer traces all camera rays of the job as one batch (color tollerance quick exits are not used).
+     Every sample is seeded from the sampler by (pixel, sample index), so images do not depend on the number of threads.
+     Jobs can be rerun (with a new camera or sample count) and stop after the current line once the cancel flag is set.
+     Every run is profiled: thread counters are merged into the frame stats with a tile event (run timing), and the
+     time spent per pixel is added to _pPixelCost (if given; wavefront batch time is spread evenly over the job pixels).
+     */
     class PixelJob  : public Job
     {
      public:
-        PixelJob(const OutputImageBuffer *_pImage, int _iLine,
+        PixelJob(const OutputImageBuffer *_pImage, int _iX, int _iY, int _iWidth, int _iHeight,
                  const Viewport *_pViewport,
                  const Camera *_pCamera,
                  const Scene *_pScene,
                  FrameStats *_pFrameStats,
                  int _iMaxSamplesPerPixel,
                  int _iMaxDepth,
-                 float _fColorTollerance)
+                 float _fColorTollerance,
+                 AccumulationBuffer *_pAccumulation = nullptr,
+                 PixelJobListener *_pListener = nullptr,
+                 int _iJobIndex = 0,
+                 int _iMaxPixelSamples = 0,
+                 TracerType _tracerType = TracerType::DEPTH_FIRST,
+                 const Sampler *_pSampler = nullptr,
+                 const std::atomic<bool> *_pCancelled = nullptr,
+                 float *_pPixelCost = nullptr)
             :m_pImage(_pImage),
              m_pViewport(_pViewport),
              m_pCamera(_pCamera),
              m_pScene(_pScene),
              m_pFrameStats(_pFrameStats),
-             m_iLine(_iLine),
+             m_iX(_iX),
+             m_iY(_iY),
+             m_iWidth(_iWidth),
+             m_iHeight(_iHeight),
              m_iMaxSamplesPerPixel(_iMaxSamplesPerPixel),
              m_iMaxDepth(_iMaxDepth),
-             m_fColorTollerance(_fColorTollerance)
+             m_fColorTollerance(_fColorTollerance),
+             m_pAccumulation(_pAccumulation),
+             m_pListener(_pListener),
+             m_iJobIndex(_iJobIndex),
+             m_iMaxPixelSamples(_iMaxPixelSamples),
+             m_tracerType(_tracerType),
+             m_pSampler(_pSampler),
+             m_pCancelled(_pCancelled),
+             m_pPixelCost(_pPixelCost)
         {}
         
+        void setCamera(const Camera *_pCamera) {
+            m_pCamera = _pCamera;
+        }
+        
+        void setSamplesPerPixel(int _iSamplesPerPixel) {
+            m_iMaxSamplesPerPixel = _iSamplesPerPixel;
+        }
+        
+        bool cancelled() const {
+            return (m_pCancelled != nullptr) && (*m_pCancelled == true);
+        }
+        
         void run()
         {
             RayTracer tracer(m_pScene, m_iMaxDepth);
-            unsigned char *pPixel = (unsigned char *)m_pImage->row(m_iLine);
             const int iViewWidth = m_pViewport->width();
             const int iViewHeight = m_pViewport->height();
             const int iMaxSamplesPerPixel = m_iMaxSamplesPerPixel;
@@ -167,52 +350,151 @@ namespace LNF
             const float fCameraAperature = m_pCamera->aperture();
             const float fCameraFocusDistance = m_pCamera->focusDistance();
             const float fSubPixelScale = 0.5f / iViewWidth;
-            const float y = (1 - 2 * m_iLine / (float)iViewHeight) * fFovScale;
-            const float fColorTollerance = m_fColorTollerance;
+            const bool bWavefront = m_tracerType == TracerType::WAVEFRONT;
+            const float fColorTollerance = bWavefront ? 0.0f : m_fColorTollerance;
             const Axis &axisCameraView = m_pCamera->axis();
+            static const RandomSampler defaultSampler(0);
+            const Sampler &sampler = m_pSampler != nullptr ? *m_pSampler : defaultSampler;
+            PixelJobResult result;
+            
+            // profiling (counters of this thread only count this job)
+            using clock_type = std::chrono::steady_clock;
+            const double fStartS = m_pFrameStats->elapsed();
+            float fPixelCostNs = 0.0f;
+            threadCounters().clear();
+            
+            // create camera ray through pixel (starts a new pixel sample)
+            auto cameraRay = [&](float x, float y, uint32_t _uPixel, uint32_t _uSample) {
+                sampler.startSample(_uPixel, _uSample);
+                auto subPixel = sampler.get2D(_uPixel, _uSample, 0);
+                auto lens = sampler.get2D(_uPixel, _uSample, 1);
+                
+                // set ray depth of field and focus aliasing
+                auto rayOrigin = mapUnitDisc(lens.u(), lens.v()) * fCameraAperature * 0.5;
+                auto rayFocus = (Vec(subPixel.u() * 2 - 1, subPixel.v() * 2 - 1, 0) * fSubPixelScale + Vec(-x, y, 1)).normalized() * fCameraFocusDistance;
+                
+                // transform from camera to world
+                rayOrigin = axisCameraView.transformFrom(rayOrigin);
+                rayFocus = axisCameraView.transformFrom(rayFocus);
+                
+                // create ray
+                return Ray(rayOrigin, (rayFocus - rayOrigin).normalized());
+            };
+            
+            // samples to add for pixel (progressive: up to max samples per pixel)
+            auto pixelSamples = [&](int i, int j) {
+                int iSamples = iMaxSamplesPerPixel;
+                if ( (m_pAccumulation != nullptr) && (m_iMaxPixelSamples > 0) ) {
+                    iSamples = std::min(iSamples, m_iMaxPixelSamples - (int)m_pAccumulation->pixel(i, j).m_uSamples);
+                }
+                
+                return std::max(iSamples, 0);
+            };
+            
+            // index of first sample to add for pixel
+            auto firstSample = [&](int i, int j) {
+                return m_pAccumulation != nullptr ? m_pAccumulation->pixel(i, j).m_uSamples : 0;
+            };
+            
+            // wavefront: trace all camera rays up front (samples are then consumed in the same order)
+            WavefrontTracer wavefront(m_pScene, m_iMaxDepth);
+            std::vector<Color> wavefrontColors;
+            size_t uNextColor = 0;
+            
+            if ( (bWavefront == true) && (cancelled() == false) ) {
+                std::vector<Ray> rays;
+                std::vector<default_rand_type> randoms;
+                for (auto j = m_iY; j < m_iY + m_iHeight; j++) {
+                    const float y = (1 - 2 * j / (float)iViewHeight) * fFovScale;
+                    for (auto i = m_iX; i < m_iX + m_iWidth; i++) {
+                        const float x = (2 * i / (float)iViewWidth - 1) * fViewAspect * fFovScale;
+                        const uint32_t uPixel = (uint32_t)(j * iViewWidth + i);
+                        const uint32_t uFirst = (uint32_t)firstSample(i, j);
+                        for (int k = 0, n = pixelSamples(i, j); k < n; k++) {
+                            rays.push_back(cameraRay(x, y, uPixel, uFirst + k));
+                            randoms.push_back(generator());
+                        }
+                    }
+                }
+                
+                auto tpTrace = clock_type::now();
+                wavefront.trace(rays, wavefrontColors, &randoms);
+                fPixelCostNs = std::chrono::duration<float, std::nano>(clock_type::now() - tpTrace).count() / ((float)m_iWidth * m_iHeight);
+            }
+            
+            // trace a single sample through pixel
+            auto traceSample = [&](float x, float y, uint32_t _uPixel, uint32_t _uSample) {
+                return bWavefront ? wavefrontColors[uNextColor++] : tracer.trace(cameraRay(x, y, _uPixel, _uSample));
+            };
 
-            for (auto i = 0; i < iViewWidth; i++)
+            int iLines = 0;
+            for (auto j = m_iY; (j < m_iY + m_iHeight) && (cancelled() == false); j++, iLines++)
             {
-                const float x = (2 * i / (float)iViewWidth - 1) * fViewAspect * fFovScale;
+                unsigned char *pPixel = (unsigned char *)m_pImage->row(j) + 3 * m_iX;
+                const float y = (1 - 2 * j / (float)iViewHeight) * fFovScale;
                 
-                auto stats = ColorStat();
-                for (int k = 0; k < iMaxSamplesPerPixel; k++)
+                for (auto i = m_iX; i < m_iX + m_iWidth; i++)
                 {
-                    // set ray depth of field and focus aliasing
-                    auto rayOrigin = randomUnitDisc() * fCameraAperature * 0.5;
-                    auto rayFocus = (randomUnitSquare() * fSubPixelScale + Vec(-x, y, 1)).normalized() * fCameraFocusDistance;
-                    
-                    // transform from camera to world
-                    rayOrigin = axisCameraView.transformFrom(rayOrigin);
-                    rayFocus = axisCameraView.transformFrom(rayFocus);
-                    
-                    // create ray
-                    auto ray = Ray(rayOrigin, (rayFocus - rayOrigin).normalized());
+                    const float x = (2 * i / (float)iViewWidth - 1) * fViewAspect * fFovScale;
+                    const uint32_t uPixel = (uint32_t)(j * iViewWidth + i);
+                    const auto tpPixel = clock_type::now();
+                    Color color;
                     
-                    // trace ray
-                    auto color = tracer.trace(ray);
-                    stats.push(color);
+                    if (m_pAccumulation != nullptr) {
+                        // progressive: add samples to accumulation buffer
+                        int iSamples = pixelSamples(i, j);
+                        auto &pixel = m_pAccumulation->pixel(i, j);
+                        for (int k = 0; k < iSamples; k++) {
+                            pixel.push(traceSample(x, y, uPixel, (uint32_t)pixel.m_uSamples));
+                        }
+                        
+                        color = pixel.mean();
+                        result.m_fErrorSum += pixel.error();
+                        result.m_fRelativeErrorSum += pixel.relativeError();
+                        result.m_uSamples += iSamples;
+                    }
+                    else {
+                        auto stats = ColorStat();
+                        for (int k = 0; k < iMaxSamplesPerPixel; k++)
+                        {
+                            stats.push(traceSample(x, y, uPixel, (uint32_t)k));
+                            
+                            // check color stats for a quick exit
+                            if ( (fColorTollerance > 0.0f) &&
+                                 (k >= 4 * tracer.traceDepthMax() + 8) &&
+                                 (stats.standardDeviation() < fColorTollerance) )
+                            {
+                                break;
+                            }
+                        }
+                        
+                        color = stats.mean();
+                    }
+                                    
+                    // write averaged color to output image
+                    color.clamp();
+
+                    *(pPixel++) = (int)(255 * color.red() + 0.5);
+                    *(pPixel++) = (int)(255 * color.green() + 0.5);
+                    *(pPixel++) = (int)(255 * color.blue() + 0.5);
                     
-                    // check color stats for a quick exit
-                    if ( (fColorTollerance > 0.0f) &&
-                         (k >= 4 * tracer.traceDepthMax() + 8) &&
-                         (stats.standardDeviation() < fColorTollerance) )
-                    {
-                        break;
+                    if (m_pPixelCost != nullptr) {
+                        m_pPixelCost[uPixel] += fPixelCostNs + std::chrono::duration<float, std::nano>(clock_type::now() - tpPixel).count();
                     }
                 }
-                                
-                // write averaged color to output image
-                auto color = stats.mean();
-                color.clamp();
-
-                *(pPixel++) = (int)(255 * color.red() + 0.5);
-                *(pPixel++) = (int)(255 * color.green() + 0.5);
-                *(pPixel++) = (int)(255 * color.blue() + 0.5);
             }
 
             // update frame stats
-            m_pFrameStats->updateRayCount(tracer.rayCount());
+            const uint64_t uRays = tracer.rayCount() + wavefront.rayCount();
+            m_pFrameStats->updateRayCount(uRays);
+            m_pFrameStats->updatePixelCount((uint64_t)m_iWidth * iLines);
+            m_pFrameStats->mergeCounters(threadCounters());
+            m_pFrameStats->addTileEvent({m_iJobIndex, iMaxSamplesPerPixel, (uint32_t)std::hash<std::thread::id>()(std::this_thread::get_id()),
+                                         fStartS, m_pFrameStats->elapsed() - fStartS, uRays});
+            
+            if (m_pListener != nullptr) {
+                m_pListener->onJobFinished(m_iJobIndex, result);
+            }
         }
 
      private:
@@ -221,10 +503,21 @@ namespace LNF
         const Camera                   *m_pCamera;
         const Scene                    *m_pScene;
         FrameStats                     *m_pFrameStats;
-        int                            m_iLine;
+        int                            m_iX;
+        int                            m_iY;
+        int                            m_iWidth;
+        int                            m_iHeight;
         int                            m_iMaxSamplesPerPixel;
         int                            m_iMaxDepth;
         float                          m_fColorTollerance;
+        AccumulationBuffer             *m_pAccumulation;
+        PixelJobListener               *m_pListener;
+        int                            m_iJobIndex;
+        int                            m_iMaxPixelSamples;
+        TracerType                     m_tracerType;
+        const Sampler                  *m_pSampler;
+        const std::atomic<bool>        *m_pCancelled;
+        float                          *m_pPixelCost;
     };
 
 
@@ -245,16 +538,99 @@ namespace LNF
      private:
         uint32_t    m_uRandomSeed;
     };
+    
+    
+    /*
+     Pixel worker threads and their job queue.
+     Every frame creates its own pool unless it is given one to share: frames rendering at the same time (e.g.
+     consecutive animation frames) then share the threads, so the next frame's jobs fill workers that go idle while
+     the previous frame's last tiles finish, instead of competing with it on a second set of threads.
+     */
+    class PixelWorkerPool
+    {
+     public:
+        PixelWorkerPool(int _iNumWorkers, int _iJobChunkSize, uint32_t _uRandSeed) {
+            for (int i = 0; i < _iNumWorkers; i++) {
+                m_workers.push_back(std::make_unique<PixelWorker>(&m_jobs, _iJobChunkSize, _uRandSeed));
+            }
+        }
+        
+        ~PixelWorkerPool() {
+            for (const auto &pWorker : m_workers) {
+                pWorker->stop();
+            }
+            
+            m_workers.clear();
+        }
+        
+        PixelWorkerPool(const PixelWorkerPool &) = delete;
+        PixelWorkerPool &operator=(const PixelWorkerPool &) = delete;
+        
+        JobQueue *jobs() {
+            return &m_jobs;
+        }
+        
+        int size() const {
+            return (int)m_workers.size();
+        }
+        
+     private:
+        JobQueue                                m_jobs;
+        std::vector<std::unique_ptr<Worker>>    m_workers;
+    };
 
     
+    /* Progressive rendering settings (disabled if samples per pass is 0) */
+    struct ProgressiveSettings
+    {
+        int         m_iSamplesPerPass = 0;      // samples per pixel added by every pass
+        float       m_fTimeBudgetS = 0;         // no new passes are started after this time (0 for no budget)
+        float       m_fNoiseTarget = 0;         // stop once mean pixel noise (luminance std error) is below target (0 for no target)
+        float       m_fAdaptiveThreshold = 0;   // mean relative pixel error at which tiles are converged (0 to sample uniformly)
+    };
+    
+    
     /*
      Container for output image and job system for a single frame
      
+     Jobs are full scanlines (shuffled) if tile size is 0, otherwise square tiles in the given order.
+     In progressive mode the whole image is rendered in passes (accumulated in a float buffer) until the
+     max samples per pixel, time budget or noise target is reached. The last job of a pass queues the next pass.
+     Adaptive sampling (progressive mode only) drops converged tiles from later passes, renders the tiles with the
+     highest relative error first and gives them up to ADAPTIVE_MAX_SCALE times more samples.
+     
+     A frame can be restarted (e.g. new camera for the next animation frame, same scene and viewport) without
+     re-creating the worker threads or the job descriptors (one per line/tile). Restarting or destroying a frame
+     cancels the jobs in flight (running jobs stop after their current line). Frames can share their worker threads
+     (see PixelWorkerPool and workers()); a frame on shared workers waits for its cancelled jobs when destroyed.
+     
+     Completed rows are tracked (leading rows with all pixels done, see readyRows()/waitRows()), so image files can
+     be written while the frame renders (see ImageOutput). Progressive frames complete all rows at the end.
+     Finished regions are also tracked for previews: updateDisplay() copies only the regions that changed since the
+     last update into a display buffer, without reading pixels that are still being written.
+     
+     Render counters (see RenderCounters), per job timing (Chrome trace, see writeTrace()) and the time spent per pixel
+     (see writeCostHeatmap()) are gathered for every frame.
      */
-    class Frame
+    class Frame     : public PixelJobListener
     {
      protected:
-        const static int    JOB_CHUNK_SIZE      = 4;      // number of jobs grabbed by worker
+        static constexpr int JOB_CHUNK_SIZE      = 4;      // number of jobs grabbed by worker
+        static constexpr int ADAPTIVE_MIN_PASSES = 2;      // passes before tiles are prioritised or dropped
+        static constexpr int ADAPTIVE_MAX_SCALE  = 4;      // max samples per pass scale for a high error tile
+        
+        // line or tile of output image
+        struct Region {
+            int         m_iX;
+            int         m_iY;
+            int         m_iWidth;
+            int         m_iHeight;
+            double      m_fErrorSum;
+            float       m_fRelativeError;
+            bool        m_bActive;
+            bool        m_bQueued;          // job queued or running (pixels are being written)
+            bool        m_bDirty;           // finished since last display update
+        };
 
      public:
         Frame(const Viewport *_pViewport,
@@ -264,41 +640,119 @@ namespace LNF
               int _iMaxSamplesPerPixel,
               int _iMaxTraceDepth,
               float _fColorTollerance,
-              uint32_t _uRandSeed)
+              uint32_t _uRandSeed,
+              int _iTileSize = 0,
+              TileOrder _tileOrder = TileOrder::SHUFFLED,
+              const ProgressiveSettings &_progressive = ProgressiveSettings(),
+              TracerType _tracerType = TracerType::DEPTH_FIRST,
+              SamplerType _samplerType = SamplerType::SOBOL,
+              const std::shared_ptr<PixelWorkerPool> &_pWorkers = nullptr)
             :m_pViewport(_pViewport),
              m_pCamera(_pCamera),
              m_pScene(_pScene),
              m_uJobCount(0),
+             m_uCompletedJobs(0),
              m_image(_pViewport->width(), _pViewport->height()),
              m_iMaxSamplesPerPixel(_iMaxSamplesPerPixel),
              m_iNumWorkers(_iNumWorkers),
              m_iMaxTraceDepth(_iMaxTraceDepth),
              m_fColorTollerance(_fColorTollerance),
-             m_uRandomSeed(_uRandSeed)
+             m_uRandomSeed(_uRandSeed),
+             m_iTileSize(_iTileSize),
+             m_tileOrder(_tileOrder),
+             m_progressive(_progressive),
+             m_tracerType(_tracerType),
+             m_pSampler(createSampler(_samplerType, _uRandSeed)),
+             m_iPass(0),
+             m_iPassCount(1),
+             m_uPassJobsLeft(0),
+             m_fNoise(1.0f),
+             m_bCancelled(false),
+             m_bDone(false),
+             m_iReadyRows(0),
+             m_pixelCost((size_t)_pViewport->width() * _pViewport->height(), 0.0f)
         {
-            generator().seed(m_uRandomSeed);
-
+            if (m_progressive.m_iSamplesPerPass > 0) {
+                m_pAccumulation = std::make_unique<AccumulationBuffer>(m_image.width(), m_image.height());
+                m_iPassCount = std::max((m_iMaxSamplesPerPixel + m_progressive.m_iSamplesPerPass - 1) / m_progressive.m_iSamplesPerPass, 1);
+            }
+            
+            createRegions();
             createJobs();
-            createWorkers();
+            m_pWorkers = _pWorkers != nullptr ? _pWorkers : std::make_shared<PixelWorkerPool>(m_iNumWorkers, (int)JOB_CHUNK_SIZE, m_uRandomSeed);
+            startFrame();
         }
         
         virtual ~Frame() {
-            // stop all workers and then wait for them to finish
-            for (const auto &pWorker : m_workers) {
-                pWorker->stop();
+            // cancel jobs in flight; shared workers keep running, so wait for them to return this frame's jobs
+            // (own workers are stopped and joined with the pool)
+            cancel();
+            if (m_pWorkers.use_count() > 1) {
+                waitFinished();
             }
             
-            m_workers.clear();
+            m_pWorkers.reset();
         }
         
-        void updateFrameProgress() {
-            // calc active jobs
-            auto completedJobs = 0;
-            for (const auto &pWorker : m_workers) {
-                completedJobs += pWorker->completedJobs();
+        /* returns the worker pool (pass to frames that should render on the same threads) */
+        const std::shared_ptr<PixelWorkerPool> &workers() const {
+            return m_pWorkers;
+        }
+        
+        /*
+         Cancels the frame in flight and starts a new one (same scene, viewport and settings) on the same workers.
+         The camera is kept if _pCamera is nullptr (it has to stay alive until the frame is done or restarted).
+         */
+        void restart(const Camera *_pCamera = nullptr) {
+            cancel();
+            waitFinished();
+            
+            if (_pCamera != nullptr) {
+                m_pCamera = _pCamera;
+                for (auto &pJob : m_jobs) {
+                    pJob->setCamera(_pCamera);
+                }
             }
             
-            int activeJobs = (int)m_uJobCount - completedJobs;
+            for (auto &region : m_regions) {
+                region.m_fErrorSum = 0.0;
+                region.m_fRelativeError = 1.0f;
+                region.m_bActive = true;
+            }
+            
+            if (m_pAccumulation != nullptr) {
+                m_pAccumulation->clear();
+            }
+            
+            std::fill(m_pixelCost.begin(), m_pixelCost.end(), 0.0f);
+            m_iPass = 0;
+            m_fNoise = 1.0f;
+            m_uJobCount = 0;
+            m_uCompletedJobs = 0;
+            m_frameStats.reset();
+            m_bCancelled = false;
+            startFrame();
+        }
+        
+        /*
+         Stops the frame in flight (running jobs finish their current line, queued jobs return without rendering).
+         Frames that are already done are not cancelled (their image is complete).
+         */
+        void cancel() {
+            std::lock_guard<std::mutex> lock(m_passMutex);
+            if (m_bDone == false) {
+                m_bCancelled = true;
+            }
+        }
+        
+        /* returns true if the frame was cancelled before it was done (isFinished() or waitFinished() tell when cancelled jobs are done) */
+        bool cancelled() const {
+            return m_bCancelled;
+        }
+        
+        void updateFrameProgress() {
+            // calc active jobs
+            int activeJobs = (int)m_uJobCount - (int)m_uCompletedJobs;
             if (activeJobs < 0) {
                 activeJobs = 0;
             }
@@ -332,54 +786,532 @@ namespace LNF
             return m_frameStats.isFinished();
         }
         
+        /* blocks until all jobs are done (instead of polling updateFrameProgress() and isFinished()) */
+        void waitFinished() {
+            {
+                std::unique_lock<std::mutex> lock(m_passMutex);
+                m_finishedCv.wait(lock, [this]{return m_bDone;});
+            }
+            
+            m_frameStats.setActiveJobs(0);
+            m_frameStats.update();
+        }
+        
+        /*
+         Copies regions finished since the last update into _display (same size as image()) and returns their rects.
+         Regions that are rendering again are left for a later update, so _display never sees pixels being written.
+         */
+        std::vector<ImageRect> updateDisplay(OutputImageBuffer &_display) {
+            std::vector<ImageRect> rects;
+            std::lock_guard<std::mutex> lock(m_passMutex);
+            size_t uDirty = 0;
+            for (auto i : m_dirtyRegions) {
+                auto &region = m_regions[i];
+                if (region.m_bQueued == true) {
+                    m_dirtyRegions[uDirty++] = i;
+                    continue;
+                }
+                
+                ImageRect rect = {region.m_iX, region.m_iY, region.m_iWidth, region.m_iHeight};
+                _display.copy(m_image, rect);
+                region.m_bDirty = false;
+                rects.push_back(rect);
+            }
+            
+            m_dirtyRegions.resize(uDirty);
+            return rects;
+        }
+        
+        /*
+         Splits an image into lines (tile size 0) or tiles in the given order; job/region i of a frame renders rect i
+         (also used to hand out the same tiles to render nodes).
+         */
+        static std::vector<ImageRect> imageRegions(int _iWidth, int _iHeight, int _iTileSize, TileOrder _order) {
+            std::vector<ImageRect> rects;
+            if (_iTileSize > 0) {
+                for (const auto &tile : tileOrder(_iWidth, _iHeight, _iTileSize, _order)) {
+                    int x = tile.first * _iTileSize;
+                    int y = tile.second * _iTileSize;
+                    rects.push_back({x, y, std::min(_iTileSize, _iWidth - x), std::min(_iTileSize, _iHeight - y)});
+                }
+            }
+            else {
+                for (int j = 0; j < _iHeight; j++) {
+                    rects.push_back({0, j, _iWidth, 1});
+                }
+            }
+            
+            return rects;
+        }
+        
+        /* returns the number of leading image rows that are done (all rows once the frame is done or cancelled) */
+        int readyRows() {
+            std::lock_guard<std::mutex> lock(m_passMutex);
+            return m_bDone ? m_image.height() : m_iReadyRows;
+        }
+        
+        /* blocks until at least _iRows leading rows are done (or the frame is done); returns the number of ready rows */
+        int waitRows(int _iRows) {
+            std::unique_lock<std::mutex> lock(m_passMutex);
+            m_finishedCv.wait(lock, [this, _iRows]{return (m_bDone == true) || (m_iReadyRows >= _iRows);});
+            return m_bDone ? m_image.height() : m_iReadyRows;
+        }
+        
+        /*
+         Writes rows [_iFirst, _iLast) to an image file writer (rows have to be ready; returns 0 on success).
+         HDR writers get the unclamped accumulated colors in progressive mode (the 8 bit image otherwise).
+         */
+        int writeRows(ImageFileWriter &_writer, int _iFirst, int _iLast) {
+            const bool bFloat = (_writer.hdr() == true) && (m_pAccumulation != nullptr);
+            std::vector<float> row(bFloat ? (size_t)m_image.width() * 3 : 0);
+            
+            for (int j = _iFirst; j < _iLast; j++) {
+                int iResult = 0;
+                if (bFloat == true) {
+                    for (int i = 0; i < m_image.width(); i++) {
+                        const Color color = m_pAccumulation->pixel(i, j).mean();
+                        row[i * 3] = color.red();
+                        row[i * 3 + 1] = color.green();
+                        row[i * 3 + 2] = color.blue();
+                    }
+                    
+                    iResult = _writer.writeRow(row.data());
+                }
+                else {
+                    iResult = _writer.writeRow(m_image.row(j));
+                }
+                
+                if (iResult != 0) {
+                    return iResult;
+                }
+            }
+            
+            return 0;
+        }
+        
+        /* write current image to file (JPEG, PNG or EXR, from the path extension); returns 0 on success */
+        int writeImageFile(const std::string &_strPath, int _iQuality)
+        {
+            auto pWriter = createImageFileWriter(_strPath, _iQuality);
+            if ( (pWriter->open(_strPath.c_str(), m_image.width(), m_image.height()) != 0) ||
+                 (writeRows(*pWriter, 0, m_image.height()) != 0) )
+            {
+                return -1;
+            }
+            
+            return pWriter->finish();
+        }
+        
+        /* returns the number of completed progressive passes */
+        int passes() const {
+            return m_iPass;
+        }
+        
+        /* returns mean pixel noise estimate after last progressive pass */
+        float noise() const {
+            return m_fNoise;
+        }
+        
         // write current image to file
         int writeJpegFile(const std::string &_strPath, int _iQuality)
         {
             return LNF::writeJpegFile(_strPath.c_str(), m_image.width(), m_image.height(), m_image.data(), _iQuality);
         }
         
+        // write per pixel sample counts (progressive mode) as heatmap, blue (few) to red (max samples)
+        int writeSampleHeatmap(const std::string &_strPath, int _iQuality)
+        {
+            if (m_pAccumulation == nullptr) {
+                return -1;
+            }
+            
+            return writeHeatmap(_strPath, _iQuality, [this](int i, int j) {
+                return (float)m_pAccumulation->pixel(i, j).m_uSamples / std::max(m_iMaxSamplesPerPixel, 1);
+            });
+        }
+        
+        /*
+         Write render time per pixel as heatmap, blue (cheap) to red (expensive), for finding the pixels that eat the
+         render budget. Times are scaled to the 99th percentile, so a few very slow pixels don't hide the rest.
+         */
+        int writeCostHeatmap(const std::string &_strPath, int _iQuality)
+        {
+            std::vector<float> sorted(m_pixelCost);
+            auto itPercentile = sorted.begin() + (sorted.size() * 99) / 100;
+            std::nth_element(sorted.begin(), itPercentile, sorted.end());
+            const float fScale = (itPercentile != sorted.end()) && (*itPercentile > 0.0f) ? 1.0f / *itPercentile : 0.0f;
+            
+            return writeHeatmap(_strPath, _iQuality, [this, fScale](int i, int j) {
+                return m_pixelCost[(size_t)j * m_image.width() + i] * fScale;
+            });
+        }
+        
+        /* returns render time per pixel (ns, summed over all passes) */
+        const std::vector<float> &pixelCost() const {
+            return m_pixelCost;
+        }
+        
+        /* returns render counters merged from all jobs that finished so far */
+        RenderCounters counters() {
+            return m_frameStats.counters();
+        }
+        
+        /* returns timing of all jobs that finished so far */
+        std::vector<TileEvent> tileEvents() {
+            return m_frameStats.tileEvents();
+        }
+        
+        /*
+         Write job timing as a Chrome trace (JSON trace event format; open in chrome://tracing or ui.perfetto.dev).
+         One complete event per job run, on one track per worker thread. Returns 0 on success.
+         */
+        int writeTrace(const std::string &_strPath)
+        {
+            auto events = JsonValue::array();
+            std::vector<uint32_t> threads;
+            for (const auto &event : tileEvents()) {
+                auto itThread = std::find(threads.begin(), threads.end(), event.m_uThread);
+                const int iTrack = (int)(itThread - threads.begin()) + 1;
+                if (itThread == threads.end()) {
+                    threads.push_back(event.m_uThread);
+                    
+                    auto &meta = events.push(JsonValue::object());
+                    meta.set("name", "thread_name");
+                    meta.set("ph", "M");
+                    meta.set("pid", 1);
+                    meta.set("tid", iTrack);
+                    meta.set("args", JsonValue::object()).set("name", "worker " + std::to_string(iTrack));
+                }
+                
+                const auto &region = m_regions[event.m_iRegion];
+                auto &trace = events.push(JsonValue::object());
+                trace.set("name", "tile " + std::to_string(event.m_iRegion));
+                trace.set("cat", "render");
+                trace.set("ph", "X");
+                trace.set("pid", 1);
+                trace.set("tid", iTrack);
+                trace.set("ts", event.m_fStartS * 1e6);
+                trace.set("dur", event.m_fDurationS * 1e6);
+                
+                auto &args = trace.set("args", JsonValue::object());
+                args.set("x", region.m_iX);
+                args.set("y", region.m_iY);
+                args.set("width", region.m_iWidth);
+                args.set("height", region.m_iHeight);
+                args.set("spp", event.m_iSamples);
+                args.set("rays", (double)event.m_uRays);
+            }
+            
+            auto trace = JsonValue::object();
+            trace.set("traceEvents", std::move(events));
+            trace.set("displayTimeUnit", "ms");
+            
+            FILE *pFile = fopen(_strPath.c_str(), "w");
+            if (pFile == nullptr) {
+                fprintf(stderr, "ERROR: can't open %s\n", _strPath.c_str());
+                return -1;
+            }
+            
+            const std::string strTrace = trace.dump();
+            const bool bOk = fwrite(strTrace.data(), 1, strTrace.size(), pFile) == strTrace.size();
+            return (fclose(pFile) == 0) && (bOk == true) ? 0 : -1;
+        }
+        
         OutputImageBuffer &image() {
             return m_image;
         }
         
      private:
-        // split output image into pixel jobs
-        void createJobs() {
-            // create jobs
-            std::vector<std::unique_ptr<Job>> jobs;
-            for (int j = 0; j < m_image.height(); j++) {
-                jobs.push_back(std::make_unique<PixelJob>(&m_image, j,
-                                                           m_pViewport,
-                                                           m_pCamera,
-                                                           m_pScene,
-                                                           &m_frameStats,
-                                                           m_iMaxSamplesPerPixel,
-                                                           m_iMaxTraceDepth,
-                                                           m_fColorTollerance));
-                m_uJobCount++;
+        // write heatmap image (JPEG, PNG or EXR); _valueFunc(i, j) returns pixel values in [0, 1], blue (0) to red (1)
+        template <typename value_func>
+        int writeHeatmap(const std::string &_strPath, int _iQuality, const value_func &_valueFunc)
+        {
+            OutputImageBuffer heatmap(m_image.width(), m_image.height());
+            for (int j = 0; j < heatmap.height(); j++) {
+                unsigned char *pPixel = heatmap.row(j);
+                for (int i = 0; i < heatmap.width(); i++) {
+                    float f = std::min(std::max(_valueFunc(i, j), 0.0f), 1.0f);
+                    *(pPixel++) = (int)(255 * f + 0.5f);
+                    *(pPixel++) = (int)(255 * (1 - fabs(2 * f - 1)) + 0.5f);
+                    *(pPixel++) = (int)(255 * (1 - f) + 0.5f);
+                }
+            }
+            
+            auto pWriter = createImageFileWriter(_strPath, _iQuality);
+            if (pWriter->open(_strPath.c_str(), heatmap.width(), heatmap.height()) != 0) {
+                return -1;
+            }
+            
+            for (int j = 0; j < heatmap.height(); j++) {
+                if (pWriter->writeRow(heatmap.row(j)) != 0) {
+                    return -1;
+                }
+            }
+            
+            return pWriter->finish();
+        }
+        
+        // queue first pass
+        void startFrame() {
+            generator().seed(m_uRandomSeed);
+            m_tpStart = std::chrono::steady_clock::now();
+            m_frameStats.setPixelCount((size_t)m_image.width() * m_image.height() * m_iPassCount);
+            
+            std::lock_guard<std::mutex> lock(m_passMutex);
+            m_rowPixels.assign(m_image.height(), 0);
+            m_iReadyRows = 0;
+            m_bDone = false;
+            queueJobs();
+            m_bDone = m_uPassJobsLeft == 0;
+        }
+        
+        // split output image into lines or tiles
+        void createRegions() {
+            for (const auto &rect : imageRegions(m_image.width(), m_image.height(), m_iTileSize, m_tileOrder)) {
+                m_regions.push_back({rect.m_iX, rect.m_iY, rect.m_iWidth, rect.m_iHeight, 0.0, 1.0f, true, false, false});
+            }
+        }
+        
+        // queue pixel jobs for (active) regions
+        void queueJobs() {
+            std::vector<size_t> order;
+            double fRelativeErrorSum = 0;
+            for (size_t i = 0; i < m_regions.size(); i++) {
+                if (m_regions[i].m_bActive == true) {
+                    order.push_back(i);
+                    fRelativeErrorSum += m_regions[i].m_fRelativeError;
+                }
             }
             
+            const bool bPrioritise = (m_pAccumulation != nullptr) &&
+                                     (m_progressive.m_fAdaptiveThreshold > 0.0f) &&
+                                     (m_iPass >= ADAPTIVE_MIN_PASSES);
+            const float fMeanRelativeError = order.empty() ? 0.0f : (float)(fRelativeErrorSum / order.size());
+            
+            if (bPrioritise == true) {
+                // highest error first
+                std::stable_sort(order.begin(), order.end(), [this](size_t _a, size_t _b) {
+                    return m_regions[_a].m_fRelativeError > m_regions[_b].m_fRelativeError;
+                });
+            }
+            else if ( (m_iTileSize <= 0) || (m_tileOrder == TileOrder::SHUFFLED) ) {
+                // shuffle lines/tiles a little
+                std::shuffle(order.begin(), order.end(), generator());
+            }
+            
+            std::vector<Job*> jobs;
+            for (auto i : order) {
+                int iSamples = m_pAccumulation != nullptr ? m_progressive.m_iSamplesPerPass : m_iMaxSamplesPerPixel;
+                if ( (bPrioritise == true) && (fMeanRelativeError > 0.0f) ) {
+                    float fScale = m_regions[i].m_fRelativeError / fMeanRelativeError;
+                    iSamples *= std::max(std::min((int)(fScale + 0.5f), ADAPTIVE_MAX_SCALE), 1);
+                }
+                
+                m_jobs[i]->setSamplesPerPixel(iSamples);
+                m_regions[i].m_bQueued = true;
+                jobs.push_back(m_jobs[i]);
+            }
+            
+            m_uPassJobsLeft = jobs.size();
+            m_uJobCount += jobs.size();
             m_frameStats.setJobCount(m_uJobCount);
             
-            // shuffle jobs a little
-            m_jobQueue.push_shuffle(jobs, generator());
+            m_pWorkers->jobs()->push(jobs);
+        }
+        
+        // progressive pass bookkeeping and frame completion (called from worker threads)
+        virtual void onJobFinished(int _iJobIndex, const PixelJobResult &_result) override {
+            std::lock_guard<std::mutex> lock(m_passMutex);
+            m_uCompletedJobs++;
+            markDirty(_iJobIndex);
+            
+            if (m_pAccumulation == nullptr) {
+                updateReadyRows(m_regions[_iJobIndex]);
+            }
+            
+            if ( (m_pAccumulation == nullptr) || (m_bCancelled == true) ) {
+                if (--m_uPassJobsLeft == 0) {
+                    m_bDone = true;
+                    m_finishedCv.notify_all();
+                }
+                
+                return;
+            }
+            
+            auto &region = m_regions[_iJobIndex];
+            region.m_fErrorSum = _result.m_fErrorSum;
+            region.m_fRelativeError = (float)(_result.m_fRelativeErrorSum / ((double)region.m_iWidth * region.m_iHeight));
+            
+            if (m_progressive.m_fAdaptiveThreshold > 0.0f) {
+                // drop converged regions
+                region.m_bActive = (_result.m_uSamples > 0) &&
+                                   ( (m_iPass + 1 < ADAPTIVE_MIN_PASSES) ||
+                                     (region.m_fRelativeError >= m_progressive.m_fAdaptiveThreshold) );
+            }
+            
+            if (--m_uPassJobsLeft > 0) {
+                return;
+            }
+            
+            // pass done
+            size_t uPixels = (size_t)m_image.width() * m_image.height();
+            double fErrorSum = 0;
+            bool bActive = false;
+            for (const auto &r : m_regions) {
+                fErrorSum += r.m_fErrorSum;
+                bActive |= r.m_bActive;
+            }
+            
+            m_fNoise = (float)(fErrorSum / uPixels);
+            m_iPass++;
+            
+            auto fTimeS = std::chrono::duration<float>(std::chrono::steady_clock::now() - m_tpStart).count();
+            bool bDone = (m_iPass >= m_iPassCount) ||
+                         (bActive == false) ||
+                         ( (m_progressive.m_fTimeBudgetS > 0) && (fTimeS >= m_progressive.m_fTimeBudgetS) ) ||
+                         ( (m_progressive.m_fNoiseTarget > 0) && (m_fNoise <= m_progressive.m_fNoiseTarget) );
+            
+            if (bDone == false) {
+                queueJobs();
+            }
+            else {
+                m_frameStats.setPixelCount(m_frameStats.pixelsDone());     // finished early (or skipped converged tiles)
+                m_bDone = true;
+                m_finishedCv.notify_all();
+            }
         }
         
-        // create worker threads
-        void createWorkers() {
-            std::vector<std::unique_ptr<Worker>> workers;
-            for (int i = 0; i < m_iNumWorkers; i++) {
-                m_workers.push_back(std::make_unique<PixelWorker>(&m_jobQueue, (int)JOB_CHUNK_SIZE, m_uRandomSeed));
+        // region pixels are final until the region is queued again
+        void markDirty(int _iJobIndex) {
+            auto &region = m_regions[_iJobIndex];
+            region.m_bQueued = false;
+            if (region.m_bDirty == false) {
+                region.m_bDirty = true;
+                m_dirtyRegions.push_back(_iJobIndex);
             }
         }
         
+        // count finished region pixels per row and advance ready rows (rows are final in single pass mode)
+        void updateReadyRows(const Region &_region) {
+            for (int j = _region.m_iY; j < _region.m_iY + _region.m_iHeight; j++) {
+                m_rowPixels[j] += _region.m_iWidth;
+            }
+            
+            const int iReadyRows = m_iReadyRows;
+            while ( (m_iReadyRows < m_image.height()) && (m_rowPixels[m_iReadyRows] >= m_image.width()) ) {
+                m_iReadyRows++;
+            }
+            
+            if (m_iReadyRows > iReadyRows) {
+                m_finishedCv.notify_all();
+            }
+        }
+        
+        // create one (reusable) pixel job per region in the frame arena; samples per pixel are set when queued
+        void createJobs() {
+            const bool bProgressive = m_pAccumulation != nullptr;
+            m_jobs.reserve(m_regions.size());
+            for (size_t i = 0; i < m_regions.size(); i++) {
+                const auto &region = m_regions[i];
+                m_jobs.push_back(m_jobArena.create<PixelJob>(&m_image, region.m_iX, region.m_iY, region.m_iWidth, region.m_iHeight,
+                                                             m_pViewport,
+                                                             m_pCamera,
+                                                             m_pScene,
+                                                             &m_frameStats,
+                                                             m_iMaxSamplesPerPixel,
+                                                             m_iMaxTraceDepth,
+                                                             bProgressive ? 0.0f : m_fColorTollerance,
+                                                             m_pAccumulation.get(),
+                                                             this,
+                                                             (int)i,
+                                                             bProgressive ? m_iMaxSamplesPerPixel : 0,
+                                                             m_tracerType,
+                                                             m_pSampler.get(),
+                                                             &m_bCancelled,
+                                                             m_pixelCost.data()));
+            }
+        }
+        
+        // returns tile coordinates (in tiles) in render order
+        static std::vector<std::pair<int, int>> tileOrder(int _iWidth, int _iHeight, int _iTileSize, TileOrder _order) {
+            const int iTilesX = (_iWidth + _iTileSize - 1) / _iTileSize;
+            const int iTilesY = (_iHeight + _iTileSize - 1) / _iTileSize;
+            std::vector<std::pair<int, int>> tiles;
+            tiles.reserve((size_t)iTilesX * iTilesY);
+            
+            if (_order == TileOrder::HILBERT) {
+                // walk Hilbert curve covering all tiles and skip the ones outside of image
+                int n = 1;
+                while ( (n < iTilesX) || (n < iTilesY) ) {
+                    n *= 2;
+                }
+                
+                for (int d = 0; d < n * n; d++) {
+                    auto tile = hilbertPosition(n, d);
+                    if ( (tile.first < iTilesX) && (tile.second < iTilesY) ) {
+                        tiles.push_back(tile);
+                    }
+                }
+            }
+            else {
+                for (int j = 0; j < iTilesY; j++) {
+                    for (int i = 0; i < iTilesX; i++) {
+                        tiles.emplace_back(i, j);
+                    }
+                }
+                
+                if (_order == TileOrder::SPIRAL) {
+                    // sort by ring around center, then by angle
+                    const float cx = (iTilesX - 1) * 0.5f;
+                    const float cy = (iTilesY - 1) * 0.5f;
+                    auto ring = [=](const std::pair<int, int> &_tile) {
+                        return std::max(fabs(_tile.first - cx), fabs(_tile.second - cy));
+                    };
+                    
+                    auto angle = [=](const std::pair<int, int> &_tile) {
+                        return atan2(_tile.second - cy, _tile.first - cx);
+                    };
+                    
+                    std::sort(tiles.begin(), tiles.end(), [&](const auto &_a, const auto &_b) {
+                        float ra = ring(_a), rb = ring(_b);
+                        return (ra < rb) || ((ra == rb) && (angle(_a) < angle(_b)));
+                    });
+                }
+            }
+            
+            return tiles;
+        }
+        
+        // returns (x, y) at distance _iD along Hilbert curve covering a _iN x _iN grid (_iN a power of 2)
+        static std::pair<int, int> hilbertPosition(int _iN, int _iD) {
+            int x = 0, y = 0;
+            for (int s = 1; s < _iN; s *= 2) {
+                int rx = 1 & (_iD / 2);
+                int ry = 1 & (_iD ^ rx);
+                if (ry == 0) {
+                    if (rx == 1) {
+                        x = s - 1 - x;
+                        y = s - 1 - y;
+                    }
+                    
+                    std::swap(x, y);
+                }
+                
+                x += s * rx;
+                y += s * ry;
+                _iD /= 4;
+            }
+            
+            return {x, y};
+        }
+        
      private:
         const Viewport                          *m_pViewport;
         const Camera                            *m_pCamera;
         const Scene                             *m_pScene;
-        size_t                                  m_uJobCount;
-        JobQueue                                m_jobQueue;
-        std::vector<std::unique_ptr<Worker>>    m_workers;
+        std::atomic<size_t>                     m_uJobCount;
+        std::atomic<size_t>                     m_uCompletedJobs;
+        std::shared_ptr<PixelWorkerPool>        m_pWorkers;
         OutputImageBuffer                       m_image;
         FrameStats                              m_frameStats;
         int                                     m_iMaxSamplesPerPixel;
@@ -387,6 +1319,28 @@ namespace LNF
         int                                     m_iMaxTraceDepth;
         float                                   m_fColorTollerance;
         uint32_t                                m_uRandomSeed;
+        int                                     m_iTileSize;
+        TileOrder                               m_tileOrder;
+        ProgressiveSettings                     m_progressive;
+        TracerType                              m_tracerType;
+        std::unique_ptr<Sampler>                m_pSampler;
+        std::unique_ptr<AccumulationBuffer>     m_pAccumulation;
+        std::chrono::steady_clock::time_point   m_tpStart;
+        std::mutex                              m_passMutex;
+        std::atomic<int>                        m_iPass;
+        int                                     m_iPassCount;
+        size_t                                  m_uPassJobsLeft;
+        std::vector<Region>                     m_regions;
+        Arena                                   m_jobArena;
+        std::vector<PixelJob*>                  m_jobs;             // owned by the job arena
+        std::atomic<float>                      m_fNoise;
+        std::atomic<bool>                       m_bCancelled;
+        std::condition_variable                 m_finishedCv;       // frame done and ready rows
+        bool                                    m_bDone;
+        std::vector<int>                        m_rowPixels;        // finished pixels per row
+        int                                     m_iReadyRows;
+        std::vector<int>                        m_dirtyRegions;     // regions finished since last display update
+        std::vector<float>                      m_pixelCost;        // render time per pixel (ns, all passes)
     };
     
     
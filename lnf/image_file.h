@@ -0,0 +1,481 @@
+#ifndef LIBS_HEADER_IMAGE_FILE_H
+#define LIBS_HEADER_IMAGE_FILE_H
+
+#include "jpeg.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace LNF
+{
+    /* Output image file formats */
+    enum class ImageFormat
+    {
+        JPEG,
+        PNG,        // lossless, 8 bit RGB
+        EXR         // HDR, 32 bit float RGB
+    };
+
+
+    /* Returns image format from file extension ('.png', '.exr'; everything else is JPEG) */
+    inline ImageFormat imageFormat(const std::string &_strPath) {
+        auto extension = [&](const char *_pszExtension) {
+            const size_t n = strlen(_pszExtension);
+            if (_strPath.size() < n) {
+                return false;
+            }
+
+            for (size_t i = 0; i < n; i++) {
+                if (tolower(_strPath[_strPath.size() - n + i]) != _pszExtension[i]) {
+                    return false;
+                }
+            }
+
+            return true;
+        };
+
+        if (extension(".png") == true) {
+            return ImageFormat::PNG;
+        }
+        else if (extension(".exr") == true) {
+            return ImageFormat::EXR;
+        }
+
+        return ImageFormat::JPEG;
+    }
+
+
+    /*
+     Streaming image file writer base: rows are written top to bottom, as 8 bit RGB or as float RGB (hdr() writers).
+     The other row type is converted. All functions return 0 on success.
+     */
+    class ImageFileWriter
+    {
+     public:
+        virtual ~ImageFileWriter() = default;
+
+        virtual int open(const char *_pszFilename, int _iWidth, int _iHeight) = 0;
+
+        /* true if the writer keeps float rows (writeRow(const float*) is lossless) */
+        virtual bool hdr() const {return false;}
+
+        /* writes next row (raw RGB (8:8:8)) */
+        virtual int writeRow(const unsigned char *_pRow) = 0;
+
+        /* writes next row (RGB floats) */
+        virtual int writeRow(const float *_pRow) {
+            m_row8.resize((size_t)m_iWidth * 3);
+            for (size_t i = 0; i < m_row8.size(); i++) {
+                m_row8[i] = (unsigned char)(255 * std::clamp(_pRow[i], 0.0f, 1.0f) + 0.5f);
+            }
+
+            return writeRow(m_row8.data());
+        }
+
+        /* finishes and closes file (all rows have to be written) */
+        virtual int finish() = 0;
+
+     protected:
+        int                             m_iWidth = 0;
+        int                             m_iHeight = 0;
+        std::vector<unsigned char>      m_row8;
+    };
+
+
+    /* JPEG writer (libjpeg) */
+    class JpegFileWriter    : public ImageFileWriter
+    {
+     public:
+        explicit JpegFileWriter(int _iQuality)
+            :m_iQuality(_iQuality)
+        {}
+
+        virtual int open(const char *_pszFilename, int _iWidth, int _iHeight) override {
+            m_iWidth = _iWidth;
+            m_iHeight = _iHeight;
+            return m_writer.open(_pszFilename, _iWidth, _iHeight, m_iQuality);
+        }
+
+        using ImageFileWriter::writeRow;
+        virtual int writeRow(const unsigned char *_pRow) override {
+            return m_writer.writeRow(_pRow);
+        }
+
+        virtual int finish() override {
+            return m_writer.finish();
+        }
+
+     private:
+        JpegWriter      m_writer;
+        int             m_iQuality;
+    };
+
+
+    /*
+     PNG writer (8 bit RGB, no filtering).
+     The zlib stream uses uncompressed (stored) deflate blocks, so no compression library is needed (files are
+     about the size of the raw image). Rows are flushed as IDAT chunks of up to CHUNK_SIZE bytes.
+     */
+    class PngFileWriter     : public ImageFileWriter
+    {
+     public:
+        static constexpr size_t CHUNK_SIZE = 65535;      // max stored deflate block
+
+     public:
+        ~PngFileWriter() {
+            if (m_pFile != nullptr) {
+                fclose(m_pFile);
+            }
+        }
+
+        virtual int open(const char *_pszFilename, int _iWidth, int _iHeight) override {
+            if ((m_pFile = fopen(_pszFilename, "wb")) == NULL) {
+                fprintf(stderr, "ERROR: can't open %s\n", _pszFilename);
+                return -1;
+            }
+
+            m_iWidth = _iWidth;
+            m_iHeight = _iHeight;
+            m_uAdler = 1;
+
+            static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+            fwrite(signature, 1, sizeof(signature), m_pFile);
+
+            unsigned char header[13] = {};
+            putBigEndian(header, (uint32_t)_iWidth);
+            putBigEndian(header + 4, (uint32_t)_iHeight);
+            header[8] = 8;      // bit depth
+            header[9] = 2;      // RGB
+            writeChunk("IHDR", header, sizeof(header));
+
+            // zlib header (deflate, 32K window, no dictionary)
+            m_data = {0x78, 0x01};
+            return checkError();
+        }
+
+        using ImageFileWriter::writeRow;
+        virtual int writeRow(const unsigned char *_pRow) override {
+            if (m_pFile == nullptr) {
+                return -1;
+            }
+
+            // row filter type 0 (none) + row data
+            const unsigned char filter = 0;
+            addData(&filter, 1);
+            addData(_pRow, (size_t)m_iWidth * 3);
+            return checkError();
+        }
+
+        virtual int finish() override {
+            if (m_pFile == nullptr) {
+                return -1;
+            }
+
+            flushBlock(true);
+
+            unsigned char adler[4];
+            putBigEndian(adler, m_uAdler);
+            m_data.insert(m_data.end(), adler, adler + 4);
+            writeChunk("IDAT", m_data.data(), m_data.size());
+            writeChunk("IEND", nullptr, 0);
+
+            bool bOk = ferror(m_pFile) == 0;
+            bOk = (fclose(m_pFile) == 0) && bOk;
+            m_pFile = nullptr;
+            if (bOk == false) {
+                fprintf(stderr, "ERROR: can't write PNG file\n");
+                return -1;
+            }
+
+            return 0;
+        }
+
+     private:
+        static void putBigEndian(unsigned char *_pData, uint32_t _u) {
+            _pData[0] = (unsigned char)(_u >> 24);
+            _pData[1] = (unsigned char)(_u >> 16);
+            _pData[2] = (unsigned char)(_u >> 8);
+            _pData[3] = (unsigned char)_u;
+        }
+
+        static uint32_t crc32(uint32_t _uCrc, const unsigned char *_pData, size_t _uSize) {
+            static const auto table = []() {
+                std::vector<uint32_t> t(256);
+                for (uint32_t n = 0; n < 256; n++) {
+                    uint32_t c = n;
+                    for (int k = 0; k < 8; k++) {
+                        c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                    }
+
+                    t[n] = c;
+                }
+
+                return t;
+            }();
+
+            for (size_t i = 0; i < _uSize; i++) {
+                _uCrc = table[(_uCrc ^ _pData[i]) & 0xff] ^ (_uCrc >> 8);
+            }
+
+            return _uCrc;
+        }
+
+        void writeChunk(const char *_pszType, const unsigned char *_pData, size_t _uSize) {
+            unsigned char length[4];
+            putBigEndian(length, (uint32_t)_uSize);
+            fwrite(length, 1, 4, m_pFile);
+            fwrite(_pszType, 1, 4, m_pFile);
+            if (_uSize > 0) {
+                fwrite(_pData, 1, _uSize, m_pFile);
+            }
+
+            uint32_t uCrc = crc32(0xffffffffu, (const unsigned char*)_pszType, 4);
+            uCrc = crc32(uCrc, _pData, _uSize) ^ 0xffffffffu;
+
+            unsigned char crc[4];
+            putBigEndian(crc, uCrc);
+            fwrite(crc, 1, 4, m_pFile);
+        }
+
+        // adds image data to current stored block (full blocks are written out)
+        void addData(const unsigned char *_pData, size_t _uSize) {
+            // adler32 of uncompressed data
+            uint32_t a = m_uAdler & 0xffff, b = m_uAdler >> 16;
+            for (size_t i = 0; i < _uSize; i++) {
+                a = (a + _pData[i]) % 65521;
+                b = (b + a) % 65521;
+            }
+
+            m_uAdler = (b << 16) | a;
+
+            while (_uSize > 0) {
+                const size_t n = std::min(_uSize, CHUNK_SIZE - m_block.size());
+                m_block.insert(m_block.end(), _pData, _pData + n);
+                _pData += n;
+                _uSize -= n;
+
+                if (m_block.size() == CHUNK_SIZE) {
+                    flushBlock(false);
+                    writeChunk("IDAT", m_data.data(), m_data.size());
+                    m_data.clear();
+                }
+            }
+        }
+
+        // appends stored deflate block (header + data) to the IDAT data
+        void flushBlock(bool _bFinal) {
+            const uint16_t uLength = (uint16_t)m_block.size();
+            const unsigned char header[5] = {(unsigned char)(_bFinal ? 1 : 0),
+                                             (unsigned char)uLength, (unsigned char)(uLength >> 8),
+                                             (unsigned char)~uLength, (unsigned char)(~uLength >> 8)};
+            m_data.insert(m_data.end(), header, header + 5);
+            m_data.insert(m_data.end(), m_block.begin(), m_block.end());
+            m_block.clear();
+        }
+
+        int checkError() {
+            if (ferror(m_pFile) != 0) {
+                fclose(m_pFile);
+                m_pFile = nullptr;
+                fprintf(stderr, "ERROR: can't write PNG file\n");
+                return -1;
+            }
+
+            return 0;
+        }
+
+     private:
+        FILE                        *m_pFile = nullptr;
+        uint32_t                    m_uAdler = 1;
+        std::vector<unsigned char>  m_block;        // current stored block data
+        std::vector<unsigned char>  m_data;         // zlib stream bytes for next IDAT chunk
+    };
+
+
+    /*
+     OpenEXR writer (scanline file, uncompressed, 32 bit float R, G, B channels).
+     Line offsets are known up front (fixed line size), so lines are written as they arrive.
+     */
+    class ExrFileWriter     : public ImageFileWriter
+    {
+     public:
+        ~ExrFileWriter() {
+            if (m_pFile != nullptr) {
+                fclose(m_pFile);
+            }
+        }
+
+        virtual int open(const char *_pszFilename, int _iWidth, int _iHeight) override {
+            if ((m_pFile = fopen(_pszFilename, "wb")) == NULL) {
+                fprintf(stderr, "ERROR: can't open %s\n", _pszFilename);
+                return -1;
+            }
+
+            m_iWidth = _iWidth;
+            m_iHeight = _iHeight;
+            m_iNextRow = 0;
+
+            std::vector<unsigned char> header;
+            putInt(header, 20000630);       // magic
+            putInt(header, 2);              // version 2, scanline file
+
+            // channels (alphabetical order): name, FLOAT, linear, reserved, x/y sampling
+            std::vector<unsigned char> channels;
+            for (const char *pszChannel : {"B", "G", "R"}) {
+                putString(channels, pszChannel);
+                putInt(channels, 2);
+                putInt(channels, 0);
+                putInt(channels, 1);
+                putInt(channels, 1);
+            }
+
+            channels.push_back(0);
+            putAttribute(header, "channels", "chlist", channels);
+            putAttribute(header, "compression", "compression", {0});
+
+            std::vector<unsigned char> window;
+            putInt(window, 0);
+            putInt(window, 0);
+            putInt(window, _iWidth - 1);
+            putInt(window, _iHeight - 1);
+            putAttribute(header, "dataWindow", "box2i", window);
+            putAttribute(header, "displayWindow", "box2i", window);
+            putAttribute(header, "lineOrder", "lineOrder", {0});
+
+            std::vector<unsigned char> value;
+            putFloat(value, 1.0f);
+            putAttribute(header, "pixelAspectRatio", "float", value);
+            putAttribute(header, "screenWindowWidth", "float", value);
+
+            value.clear();
+            putFloat(value, 0.0f);
+            putFloat(value, 0.0f);
+            putAttribute(header, "screenWindowCenter", "v2f", value);
+            header.push_back(0);
+
+            // line offset table
+            const uint64_t uLineSize = 8 + (uint64_t)_iWidth * 3 * 4;
+            const uint64_t uFirstLine = header.size() + (uint64_t)_iHeight * 8;
+            for (int y = 0; y < _iHeight; y++) {
+                const uint64_t uOffset = uFirstLine + y * uLineSize;
+                putInt(header, (uint32_t)uOffset);
+                putInt(header, (uint32_t)(uOffset >> 32));
+            }
+
+            fwrite(header.data(), 1, header.size(), m_pFile);
+            return checkError();
+        }
+
+        virtual bool hdr() const override {return true;}
+
+        virtual int writeRow(const unsigned char *_pRow) override {
+            m_rowFloat.resize((size_t)m_iWidth * 3);
+            for (size_t i = 0; i < m_rowFloat.size(); i++) {
+                m_rowFloat[i] = _pRow[i] / 255.0f;
+            }
+
+            return writeRow(m_rowFloat.data());
+        }
+
+        virtual int writeRow(const float *_pRow) override {
+            if (m_pFile == nullptr) {
+                return -1;
+            }
+
+            // y, data size, then all B, G and R values of the line
+            std::vector<unsigned char> &line = m_line;
+            line.clear();
+            putInt(line, (uint32_t)m_iNextRow++);
+            putInt(line, (uint32_t)(m_iWidth * 3 * 4));
+            for (int c = 2; c >= 0; c--) {
+                for (int x = 0; x < m_iWidth; x++) {
+                    putFloat(line, _pRow[x * 3 + c]);
+                }
+            }
+
+            fwrite(line.data(), 1, line.size(), m_pFile);
+            return checkError();
+        }
+
+        virtual int finish() override {
+            if (m_pFile == nullptr) {
+                return -1;
+            }
+
+            bool bOk = ferror(m_pFile) == 0;
+            bOk = (fclose(m_pFile) == 0) && bOk;
+            m_pFile = nullptr;
+            if (bOk == false) {
+                fprintf(stderr, "ERROR: can't write EXR file\n");
+                return -1;
+            }
+
+            return 0;
+        }
+
+     private:
+        static void putInt(std::vector<unsigned char> &_data, uint32_t _u) {
+            for (int i = 0; i < 4; i++) {
+                _data.push_back((unsigned char)(_u >> (8 * i)));
+            }
+        }
+
+        static void putFloat(std::vector<unsigned char> &_data, float _f) {
+            uint32_t u;
+            memcpy(&u, &_f, sizeof(u));
+            putInt(_data, u);
+        }
+
+        static void putString(std::vector<unsigned char> &_data, const char *_psz) {
+            _data.insert(_data.end(), _psz, _psz + strlen(_psz) + 1);
+        }
+
+        static void putAttribute(std::vector<unsigned char> &_data, const char *_pszName, const char *_pszType, const std::vector<unsigned char> &_value) {
+            putString(_data, _pszName);
+            putString(_data, _pszType);
+            putInt(_data, (uint32_t)_value.size());
+            _data.insert(_data.end(), _value.begin(), _value.end());
+        }
+
+        int checkError() {
+            if (ferror(m_pFile) != 0) {
+                fclose(m_pFile);
+                m_pFile = nullptr;
+                fprintf(stderr, "ERROR: can't write EXR file\n");
+                return -1;
+            }
+
+            return 0;
+        }
+
+     private:
+        FILE                        *m_pFile = nullptr;
+        int                         m_iNextRow = 0;
+        std::vector<float>          m_rowFloat;
+        std::vector<unsigned char>  m_line;
+    };
+
+
+    /* returns writer for the file format (from the path extension; _iQuality is used for JPEG) */
+    inline std::unique_ptr<ImageFileWriter> createImageFileWriter(const std::string &_strPath, int _iQuality) {
+        switch (imageFormat(_strPath)) {
+            case ImageFormat::PNG: return std::make_unique<PngFileWriter>();
+            case ImageFormat::EXR: return std::make_unique<ExrFileWriter>();
+            default: break;
+        }
+
+        return std::make_unique<JpegFileWriter>(_iQuality);
+    }
+
+
+};  // namespace LNF
+
+
+#endif  // #ifndef LIBS_HEADER_IMAGE_FILE_H
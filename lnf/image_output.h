@@ -0,0 +1,154 @@
+#ifndef LIBS_HEADER_IMAGE_OUTPUT_H
+#define LIBS_HEADER_IMAGE_OUTPUT_H
+
+#include "frame.h"
+#include "image_file.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+
+
+namespace LNF
+{
+    /*
+     Asynchronous output stage: writes frames to image files (JPEG, PNG or EXR) on its own thread.
+     Rows are encoded as the frame completes them, so encoding overlaps with rendering and only the last rows are
+     left once the frame is done. Outputs are written in the order they were queued.
+     */
+    class ImageOutput
+    {
+     public:
+        ImageOutput()
+            :m_iPending(0),
+             m_iErrors(0),
+             m_bRunning(true)
+        {
+            m_thread = std::thread(&ImageOutput::run, this);
+        }
+
+        /* finishes queued outputs */
+        ~ImageOutput() {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_bRunning = false;
+            }
+
+            m_queueCv.notify_all();
+            m_thread.join();
+        }
+
+        ImageOutput(const ImageOutput &) = delete;
+        ImageOutput &operator=(const ImageOutput &) = delete;
+
+        /*
+         Queues frame output (the frame may still be rendering); the future returns 0 if the file was written.
+         The frame has to stay alive and must not be restarted until the output is done. Cancelling the frame
+         discards the output (no file is left behind).
+         */
+        std::shared_future<int> write(Frame *_pFrame, const std::string &_strPath, int _iQuality) {
+            Output output = {_pFrame, _strPath, _iQuality, std::promise<int>()};
+            auto result = output.m_result.get_future().share();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_queue.push_back(std::move(output));
+                m_iPending++;
+            }
+
+            m_queueCv.notify_all();
+            return result;
+        }
+
+        /* blocks until all queued outputs are written; returns the number of failed outputs since the last wait() */
+        int wait() {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_doneCv.wait(lock, [this]{return m_iPending == 0;});
+
+            int iErrors = m_iErrors;
+            m_iErrors = 0;
+            return iErrors;
+        }
+
+     private:
+        struct Output {
+            Frame               *m_pFrame;
+            std::string         m_strPath;
+            int                 m_iQuality;
+            std::promise<int>   m_result;
+        };
+
+     private:
+        // output thread
+        void run() {
+            while (true) {
+                Output output;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_queueCv.wait(lock, [this]{return (m_queue.empty() == false) || (m_bRunning == false);});
+                    if (m_queue.empty() == true) {
+                        break;
+                    }
+
+                    output = std::move(m_queue.front());
+                    m_queue.pop_front();
+                }
+
+                int iResult = writeFrame(*output.m_pFrame, output.m_strPath, output.m_iQuality);
+                output.m_result.set_value(iResult);
+
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_iErrors += iResult != 0 ? 1 : 0;
+                    m_iPending--;
+                }
+
+                m_doneCv.notify_all();
+            }
+        }
+
+        // streams frame rows to file as they become ready (cancelled frames are discarded)
+        static int writeFrame(Frame &_frame, const std::string &_strPath, int _iQuality) {
+            const int iHeight = _frame.image().height();
+            auto pWriter = createImageFileWriter(_strPath, _iQuality);
+            if (pWriter->open(_strPath.c_str(), _frame.image().width(), iHeight) != 0) {
+                return -1;
+            }
+
+            for (int iRow = 0; iRow < iHeight; ) {
+                int iReady = _frame.waitRows(iRow + 1);
+                if (_frame.cancelled() == true) {
+                    pWriter.reset();
+                    std::remove(_strPath.c_str());
+                    return -1;
+                }
+
+                if (_frame.writeRows(*pWriter, iRow, iReady) != 0) {
+                    return -1;
+                }
+
+                iRow = iReady;
+            }
+
+            return pWriter->finish();
+        }
+
+     private:
+        std::thread                 m_thread;
+        std::mutex                  m_mutex;
+        std::condition_variable     m_queueCv;
+        std::condition_variable     m_doneCv;
+        std::deque<Output>          m_queue;
+        int                         m_iPending;
+        int                         m_iErrors;
+        bool                        m_bRunning;
+    };
+
+
+};  // namespace LNF
+
+
+#endif  // #ifndef LIBS_HEADER_IMAGE_OUTPUT_H
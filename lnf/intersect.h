@@ -22,7 +22,9 @@ namespace LNF
     {
         Intersect() noexcept
             :m_pPrimitive(nullptr),
+             m_pGroupInstance(nullptr),
              m_fPositionOnRay(-1),
+             m_fViewPositionOnRay(-1),
              m_uTriangleIndex(0),
              m_uTraceDepth(0),
              m_uMarchDepth(0),
@@ -33,7 +35,9 @@ namespace LNF
         Intersect(const Ray &_viewRay) noexcept
             :m_viewRay(_viewRay),
              m_pPrimitive(nullptr),
+             m_pGroupInstance(nullptr),
              m_fPositionOnRay(-1),
+             m_fViewPositionOnRay(-1),
              m_uTriangleIndex(0),
              m_uTraceDepth(0),
              m_uMarchDepth(0),
@@ -56,9 +60,11 @@ namespace LNF
         Ray                     m_viewRay;              // view ray
         Ray                     m_priRay;               // ray transformed for intersection with specific primitive
         const PrimitiveInstance *m_pPrimitive;          // primitive we intersected with
+        const PrimitiveInstance *m_pGroupInstance;      // prototype instance hit inside an instanced group (set by PrimitiveGroup)
         
         // key fields that should be populated on primitive hit
-        float                   m_fPositionOnRay;       // t0
+        float                   m_fPositionOnRay;       // t0 (on primitive ray)
+        float                   m_fViewPositionOnRay;   // t0 (on view ray; set by primitive instance)
 
         // fields required to complete intercept/hit
         Vec                     m_position;             // hit position on surface of shape
@@ -72,6 +78,57 @@ namespace LNF
     };
 
 
+    /*
+     Candidate hits without a full Intersect copy per tested primitive.
+     Candidates are tested on a scratch intersect; an accepted candidate swaps roles with the best hit,
+     so the caller's intersect is only written once (if the best hit ended up in the scratch copy).
+     */
+    class HitCandidates
+    {
+     public:
+        HitCandidates(Intersect &_hit)
+            :m_hit(_hit),
+             m_scratch(_hit),
+             m_pBest(&_hit),
+             m_pNext(&m_scratch)
+        {}
+
+        /*
+         Returns scratch intersect for next candidate (view ray limited to closest hit so far).
+         Hit state a primitive may leave unset is cleared, so nothing leaks from a rejected candidate.
+         */
+        Intersect &next(float _fMaxDist) {
+            m_pNext->m_viewRay.m_fMaxDist = _fMaxDist;
+            m_pNext->m_pGroupInstance = nullptr;
+            m_pNext->m_fPositionOnRay = -1;
+            m_pNext->m_uTriangleIndex = 0;
+            m_pNext->m_bInside = false;
+            return *m_pNext;
+        }
+
+        /* last candidate becomes the best hit */
+        void accept() {
+            std::swap(m_pBest, m_pNext);
+            m_pBest->m_viewRay.m_fMaxDist = m_pBest->m_fViewPositionOnRay;
+        }
+
+        /* copies best hit to caller's intersect (if required); returns true on a hit */
+        bool finish() {
+            if (m_pBest != &m_hit) {
+                m_hit = *m_pBest;
+            }
+
+            return m_hit;
+        }
+
+     private:
+        Intersect       &m_hit;
+        Intersect       m_scratch;
+        Intersect       *m_pBest;
+        Intersect       *m_pNext;
+    };
+
+
 };  // namespace LNF
 
 
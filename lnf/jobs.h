@@ -2,12 +2,15 @@
 #define LIBS_HEADER_JOBS_H
 
 #include "constants.h"
-#include "queue.h"
 
+#include <algorithm>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <thread>
-#include <queue>
 #include <vector>
 
 
@@ -25,8 +28,245 @@ namespace LNF
     };
 
 
-    /* collection of jobs for workers */
-    using JobQueue = Queue<std::unique_ptr<Job>>;
+    /*
+        Work-stealing job queue.
+        New jobs go to a shared inbox. Every worker has its own deque that it fills from the inbox in chunks
+        and works through from the back. Idle workers steal half of another worker's deque (from the front)
+        and park on a condition variable when no jobs are left at all.
+     */
+    class JobQueue
+    {
+     public:
+        static constexpr int MAX_WORKER_SLOTS   = 256;      // workers beyond this share deques
+        
+        // deletes owned jobs only (borrowed jobs are reused by their owner)
+        struct JobDeleter {
+            void operator()(Job *_pJob) const {
+                if (m_bOwned == true) {
+                    delete _pJob;
+                }
+            }
+            
+            bool    m_bOwned = true;
+        };
+        
+        using JobPtr = std::unique_ptr<Job, JobDeleter>;
+        
+     public:
+        JobQueue()
+            :m_slots(MAX_WORKER_SLOTS),
+             m_iWorkerCount(0),
+             m_iPending(0)
+        {}
+        
+        /* returns true if no jobs are waiting (jobs may still be running) */
+        bool empty() const {
+            return m_iPending == 0;
+        }
+        
+        /* returns the number of jobs waiting to be run */
+        size_t size() const {
+            return (size_t)std::max(m_iPending.load(), 0);
+        }
+        
+        void push(std::unique_ptr<Job> &&_pJob) {
+            {
+                std::lock_guard<std::mutex> lock(m_inboxMutex);
+                m_inbox.push_back(JobPtr(_pJob.release(), JobDeleter{true}));
+                m_iPending++;
+            }
+            
+            wakeAll();
+        }
+        
+        void push(std::vector<std::unique_ptr<Job>> &_jobs) {
+            {
+                std::lock_guard<std::mutex> lock(m_inboxMutex);
+                for (auto &pJob : _jobs) {
+                    m_inbox.push_back(JobPtr(pJob.release(), JobDeleter{true}));
+                }
+                
+                m_iPending += (int)_jobs.size();
+            }
+            
+            _jobs.clear();
+            wakeAll();
+        }
+        
+        /* queue jobs owned by caller (jobs are not deleted and have to stay alive until they have run) */
+        void push(const std::vector<Job*> &_jobs) {
+            {
+                std::lock_guard<std::mutex> lock(m_inboxMutex);
+                for (auto pJob : _jobs) {
+                    m_inbox.push_back(JobPtr(pJob, JobDeleter{false}));
+                }
+                
+                m_iPending += (int)_jobs.size();
+            }
+            
+            wakeAll();
+        }
+        
+        template <typename random_gen>
+        void push_shuffle(std::vector<std::unique_ptr<Job>> &_jobs, random_gen &_gen) {
+            std::shuffle(_jobs.begin(), _jobs.end(), _gen);
+            push(_jobs);
+        }
+        
+        /* register new worker; returns worker slot */
+        int addWorker() {
+            return m_iWorkerCount++ % MAX_WORKER_SLOTS;
+        }
+        
+        /*
+         Returns next job for worker (nullptr if no jobs could be found).
+         Order: own deque, shared inbox (grabs _iChunkSize jobs), steal from other workers.
+         */
+        JobPtr pop(int _iSlot, int _iChunkSize) {
+            auto &slot = m_slots[_iSlot];
+            JobPtr pJob = popBack(slot);
+            
+            if (pJob == nullptr) {
+                pJob = popInbox(slot, std::max(_iChunkSize, 1));
+            }
+            
+            if (pJob == nullptr) {
+                pJob = steal(_iSlot);
+            }
+            
+            if (pJob != nullptr) {
+                m_iPending--;
+            }
+            
+            return pJob;
+        }
+        
+        /* returns the number of jobs queued in worker deque */
+        int localJobs(int _iSlot) const {
+            return m_slots[_iSlot].m_iSize;
+        }
+        
+        /* park calling worker until jobs are available or worker is stopped */
+        void wait(const std::atomic<bool> &_bRunning) {
+            std::unique_lock<std::mutex> lock(m_parkMutex);
+            m_parkCv.wait(lock, [&]{return (m_iPending > 0) || (_bRunning == false);});
+        }
+        
+        /* wake all parked workers */
+        void wakeAll() {
+            {
+                std::lock_guard<std::mutex> lock(m_parkMutex);
+            }
+            
+            m_parkCv.notify_all();
+        }
+        
+     private:
+        struct WorkerSlot {
+            WorkerSlot()
+                :m_iSize(0)
+            {}
+            
+            std::deque<JobPtr>                  m_jobs;
+            std::atomic<int>                    m_iSize;
+            mutable std::mutex                  m_mutex;
+        };
+        
+     private:
+        // pop from own deque
+        static JobPtr popBack(WorkerSlot &_slot) {
+            if (_slot.m_iSize == 0) {
+                return nullptr;
+            }
+            
+            std::lock_guard<std::mutex> lock(_slot.m_mutex);
+            if (_slot.m_jobs.empty() == true) {
+                return nullptr;
+            }
+            
+            auto pJob = std::move(_slot.m_jobs.back());
+            _slot.m_jobs.pop_back();
+            _slot.m_iSize = (int)_slot.m_jobs.size();
+            return pJob;
+        }
+        
+        // grab a chunk of jobs from the inbox (first job is returned, the rest goes to own deque)
+        JobPtr popInbox(WorkerSlot &_slot, int _iChunkSize) {
+            std::vector<JobPtr> jobs;
+            {
+                std::lock_guard<std::mutex> lock(m_inboxMutex);
+                while ( (m_inbox.empty() == false) && ((int)jobs.size() < _iChunkSize) ) {
+                    jobs.push_back(std::move(m_inbox.front()));
+                    m_inbox.pop_front();
+                }
+            }
+            
+            if (jobs.empty() == true) {
+                return nullptr;
+            }
+            
+            auto pJob = std::move(jobs.front());
+            if (jobs.size() > 1) {
+                std::lock_guard<std::mutex> lock(_slot.m_mutex);
+                for (size_t i = jobs.size() - 1; i > 0; i--) {
+                    _slot.m_jobs.push_back(std::move(jobs[i]));
+                }
+                
+                _slot.m_iSize = (int)_slot.m_jobs.size();
+            }
+            
+            return pJob;
+        }
+        
+        // steal half of the jobs from the front of another worker's deque
+        JobPtr steal(int _iSlot) {
+            const int iSlots = std::min(m_iWorkerCount.load(), MAX_WORKER_SLOTS);
+            for (int i = 1; i < iSlots; i++) {
+                auto &victim = m_slots[(_iSlot + i) % iSlots];
+                if (victim.m_iSize == 0) {
+                    continue;
+                }
+                
+                std::vector<JobPtr> jobs;
+                {
+                    std::lock_guard<std::mutex> lock(victim.m_mutex);
+                    size_t uCount = (victim.m_jobs.size() + 1) / 2;
+                    for (size_t j = 0; j < uCount; j++) {
+                        jobs.push_back(std::move(victim.m_jobs.front()));
+                        victim.m_jobs.pop_front();
+                    }
+                    
+                    victim.m_iSize = (int)victim.m_jobs.size();
+                }
+                
+                if (jobs.empty() == false) {
+                    auto pJob = std::move(jobs.front());
+                    if (jobs.size() > 1) {
+                        auto &slot = m_slots[_iSlot];
+                        std::lock_guard<std::mutex> lock(slot.m_mutex);
+                        for (size_t j = jobs.size() - 1; j > 0; j--) {
+                            slot.m_jobs.push_back(std::move(jobs[j]));
+                        }
+                        
+                        slot.m_iSize = (int)slot.m_jobs.size();
+                    }
+                    
+                    return pJob;
+                }
+            }
+            
+            return nullptr;
+        }
+        
+     private:
+        std::vector<WorkerSlot>             m_slots;
+        std::deque<JobPtr>                  m_inbox;
+        std::mutex                          m_inboxMutex;
+        std::mutex                          m_parkMutex;
+        std::condition_variable             m_parkCv;
+        std::atomic<int>                    m_iWorkerCount;
+        std::atomic<int>                    m_iPending;
+    };
 
 
     /* Worker that can execute jobs */
@@ -36,6 +276,7 @@ namespace LNF
         Worker(JobQueue *_pJobs, int _iJobChunkSize)
             :m_pJobs(_pJobs),
              m_iJobChunkSize(_iJobChunkSize),
+             m_iSlot(_pJobs->addWorker()),
              m_iActiveJobs(0),
              m_iCompletedJobs(0),
              m_bRunning(true)
@@ -52,6 +293,7 @@ namespace LNF
         
         virtual void stop() {
             m_bRunning = false;
+            m_pJobs->wakeAll();
         }
         
         virtual bool running() const {
@@ -83,23 +325,17 @@ namespace LNF
             onStart();
 
             while (m_bRunning == true) {
-                // grab new jobs if local list is empty
-                if (m_localJobs.empty() == true) {
-                    m_localJobs = m_pJobs->pop(m_iJobChunkSize);
-                    m_iActiveJobs = (int)m_localJobs.size();
-                }
-
-                // work on first job in local list
-                if (m_localJobs.empty() == false) {
-                    auto pJobPtr = std::move(m_localJobs.back());
-                    m_localJobs.pop_back();
-                    m_iActiveJobs = (int)m_localJobs.size() + 1;
-
+                auto pJobPtr = m_pJobs->pop(m_iSlot, m_iJobChunkSize);
+                if (pJobPtr != nullptr) {
+                    m_iActiveJobs = m_pJobs->localJobs(m_iSlot) + 1;
+                    
                     pJobPtr->run();
                     m_iCompletedJobs++;
+                    m_iActiveJobs = m_pJobs->localJobs(m_iSlot);
                 }
                 else {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                    // park until new jobs arrive
+                    m_pJobs->wait(m_bRunning);
                 }
             }
             
@@ -110,13 +346,112 @@ namespace LNF
         std::thread                                 m_thread;
         JobQueue                                    *m_pJobs;
         int                                         m_iJobChunkSize;
-        std::vector<std::unique_ptr<Job>>           m_localJobs;
+        int                                         m_iSlot;
         std::atomic<int>                            m_iActiveJobs;
         std::atomic<int>                            m_iCompletedJobs;
         std::atomic<bool>                           m_bRunning;
     };
 
 
+
+    /* Job queue with its own set of workers (e.g. for parallel scene/BVH builds) */
+    class WorkerPool
+    {
+     public:
+        explicit WorkerPool(int _iNumWorkers = (int)std::max(std::thread::hardware_concurrency(), 1u)) {
+            for (int i = 0; i < _iNumWorkers; i++) {
+                m_workers.push_back(std::make_unique<Worker>(&m_jobs, 1));
+            }
+        }
+        
+        ~WorkerPool() {
+            for (const auto &pWorker : m_workers) {
+                pWorker->stop();
+            }
+            
+            m_workers.clear();
+        }
+        
+        JobQueue *jobs() {
+            return &m_jobs;
+        }
+        
+        int size() const {
+            return (int)m_workers.size();
+        }
+        
+     private:
+        JobQueue                                m_jobs;
+        std::vector<std::unique_ptr<Worker>>    m_workers;
+    };
+
+
+    /*
+     Fork/join helper: runs functions as jobs on a queue and waits for all of them to finish.
+     wait() has to be called from outside the queue's workers (it blocks instead of running jobs).
+     */
+    class TaskGroup
+    {
+     public:
+        explicit TaskGroup(JobQueue *_pJobs)
+            :m_pJobs(_pJobs),
+             m_iPending(0)
+        {}
+        
+        ~TaskGroup() {
+            wait();
+        }
+        
+        void run(std::function<void()> &&_task) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_iPending++;
+            }
+            
+            m_pJobs->push(std::make_unique<TaskJob>(this, std::move(_task)));
+        }
+        
+        /* blocks until all tasks have run */
+        void wait() {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_doneCv.wait(lock, [this]{return m_iPending == 0;});
+        }
+        
+     private:
+        class TaskJob   : public Job
+        {
+         public:
+            TaskJob(TaskGroup *_pGroup, std::function<void()> &&_task)
+                :m_pGroup(_pGroup),
+                 m_task(std::move(_task))
+            {}
+            
+            virtual void run() override {
+                m_task();
+                m_pGroup->onTaskFinished();
+            }
+            
+         private:
+            TaskGroup               *m_pGroup;
+            std::function<void()>   m_task;
+        };
+        
+     private:
+        void onTaskFinished() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_iPending == 0) {
+                m_doneCv.notify_all();
+            }
+        }
+        
+     private:
+        JobQueue                    *m_pJobs;
+        int                         m_iPending;
+        std::mutex                  m_mutex;
+        std::condition_variable     m_doneCv;
+    };
+
+
 };  // namespace LNF
 
 
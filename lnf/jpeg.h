@@ -3,56 +3,209 @@
 
 #include "constants.h"
 
+#include <setjmp.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <jpeglib.h>
+#include <vector>
 
 
 namespace LNF
 {
+    // libjpeg error manager that jumps back to the caller (setjmp) instead of exiting
+    struct JpegErrorManager {
+        struct jpeg_error_mgr   m_mgr;
+        jmp_buf                 m_jump;
+        
+        static void errorExit(j_common_ptr _pInfo) {
+            (*_pInfo->err->output_message)(_pInfo);
+            longjmp(reinterpret_cast<JpegErrorManager*>(_pInfo->err)->m_jump, 1);
+        }
+    };
+    
+    
+    /*
+     Streaming JPEG writer: rows are compressed as they are written (top to bottom).
+     All functions return 0 on success; after an error the file is closed and later calls fail.
+     */
+    class JpegWriter
+    {
+     public:
+        JpegWriter()
+            :m_cinfo{},
+             m_error{},
+             m_pFile(nullptr)
+        {}
+        
+        ~JpegWriter() {
+            close();
+        }
+        
+        JpegWriter(const JpegWriter &) = delete;
+        JpegWriter &operator=(const JpegWriter &) = delete;
+        
+        int open(const char *_pszFilename, int _iWidth, int _iHeight, int _iQuality) {
+            close();
+            if ((m_pFile = fopen(_pszFilename, "wb")) == NULL)
+            {
+                fprintf(stderr, "ERROR: can't open %s\n", _pszFilename);
+                return -1;
+            }
+            
+            m_cinfo.err = jpeg_std_error(&m_error.m_mgr);
+            m_error.m_mgr.error_exit = &JpegErrorManager::errorExit;
+            if (setjmp(m_error.m_jump) != 0) {
+                return fail();
+            }
+            
+            jpeg_create_compress(&m_cinfo);
+            jpeg_stdio_dest(&m_cinfo, m_pFile);
+            
+            m_cinfo.image_width  = _iWidth;         // Image width and height in pixels.
+            m_cinfo.image_height = _iHeight;
+            m_cinfo.input_components = 3;           // Number of color components per pixel.
+            m_cinfo.in_color_space = JCS_RGB;       // Colorspace of input image as RGB.
+            
+            jpeg_set_defaults(&m_cinfo);
+            jpeg_set_quality(&m_cinfo, _iQuality, TRUE);
+            jpeg_start_compress(&m_cinfo, TRUE);
+            return 0;
+        }
+        
+        /* writes next row (raw RGB (8:8:8)) */
+        int writeRow(const unsigned char *_pRow) {
+            if (m_pFile == nullptr) {
+                return -1;
+            }
+            
+            if (setjmp(m_error.m_jump) != 0) {
+                return fail();
+            }
+            
+            JSAMPROW row_pointer[1] = {(unsigned char*)_pRow};
+            jpeg_write_scanlines(&m_cinfo, row_pointer, 1);
+            return 0;
+        }
+        
+        /* finishes and closes file (all rows have to be written) */
+        int finish() {
+            if (m_pFile == nullptr) {
+                return -1;
+            }
+            
+            if (setjmp(m_error.m_jump) != 0) {
+                return fail();
+            }
+            
+            jpeg_finish_compress(&m_cinfo);
+            jpeg_destroy_compress(&m_cinfo);
+            
+            bool bOk = ferror(m_pFile) == 0;
+            bOk = (fclose(m_pFile) == 0) && bOk;
+            m_pFile = nullptr;
+            
+            if (bOk == false) {
+                fprintf(stderr, "ERROR: can't write JPEG file\n");
+                return -1;
+            }
+            
+            return 0;
+        }
+        
+     private:
+        int fail() {
+            close();
+            fprintf(stderr, "ERROR: can't write JPEG file\n");
+            return -1;
+        }
+        
+        void close() {
+            if (m_pFile != nullptr) {
+                jpeg_destroy_compress(&m_cinfo);
+                fclose(m_pFile);
+                m_pFile = nullptr;
+            }
+        }
+        
+     private:
+        struct jpeg_compress_struct     m_cinfo;
+        JpegErrorManager                m_error;
+        FILE                            *m_pFile;
+    };
+    
+    
     /*
-     Write out JPEG file to disk.
+     Write out JPEG file to disk (returns 0 on success).
      _pImageData: raw RGB (8:8:8) image data.
      */
-    int writeJpegFile(const char *_pszFilename, int _iWidth, int _iHeight, const unsigned char *_pImageData, int _iQuality)
+    inline int writeJpegFile(const char *_pszFilename, int _iWidth, int _iHeight, const unsigned char *_pImageData, int _iQuality)
     {
-        struct jpeg_compress_struct cinfo = {0};
-        struct jpeg_error_mgr jerr = {0};
+        JpegWriter writer;
+        if (writer.open(_pszFilename, _iWidth, _iHeight, _iQuality) != 0) {
+            return -1;
+        }
         
-        cinfo.err = jpeg_std_error(&jerr);
-        jpeg_create_compress(&cinfo);
-        FILE *outfile;
+        for (int y = 0; y < _iHeight; y++) {
+            if (writer.writeRow(_pImageData + (size_t)y * _iWidth * 3) != 0) {
+                return -1;
+            }
+        }
         
-        if ((outfile = fopen(_pszFilename, "wb")) == NULL)
+        return writer.finish();
+    }
+
+
+    /*
+     Read JPEG file from disk (returns 0 on success).
+     _imageData: raw RGB (8:8:8) image data (grayscale images are expanded to RGB).
+     */
+    inline int readJpegFile(const char *_pszFilename, int &_iWidth, int &_iHeight, std::vector<unsigned char> &_imageData)
+    {
+        struct jpeg_decompress_struct cinfo = {0};
+        JpegErrorManager jerr = {};
+        
+        FILE *infile;
+        if ((infile = fopen(_pszFilename, "rb")) == NULL)
         {
             fprintf(stderr, "ERROR: can't open %s\n", _pszFilename);
-            exit(1);
+            return -1;
+        }
+        
+        cinfo.err = jpeg_std_error(&jerr.m_mgr);
+        jerr.m_mgr.error_exit = &JpegErrorManager::errorExit;     // libjpeg errors jump back here instead of exiting
+        
+        if (setjmp(jerr.m_jump) != 0)
+        {
+            jpeg_destroy_decompress(&cinfo);
+            fclose(infile);
+            fprintf(stderr, "ERROR: can't read %s\n", _pszFilename);
+            return -1;
         }
         
-        jpeg_stdio_dest(&cinfo, outfile);
+        jpeg_create_decompress(&cinfo);
+        jpeg_stdio_src(&cinfo, infile);
+        jpeg_read_header(&cinfo, TRUE);
         
-        cinfo.image_width  = _iWidth;           // Image width and height in pixels.
-        cinfo.image_height = _iHeight;
-        cinfo.input_components = 3;         // Number of color components per pixel.
-        cinfo.in_color_space = JCS_RGB;     // Colorspace of input image as RGB.
+        cinfo.out_color_space = JCS_RGB;     // libjpeg converts grayscale and YCbCr
+        jpeg_start_decompress(&cinfo);
         
-        jpeg_set_defaults(&cinfo);
-        jpeg_set_quality(&cinfo, _iQuality, TRUE);
+        _iWidth = (int)cinfo.output_width;
+        _iHeight = (int)cinfo.output_height;
+        _imageData.resize((size_t)_iWidth * _iHeight * 3);
         
-        jpeg_start_compress(&cinfo, TRUE);
-        int row_stride = cinfo.image_width * 3;        // JSAMPLEs per row in image_buffer
+        int row_stride = _iWidth * 3;
         JSAMPROW row_pointer[1] = {0};
         
-        while (cinfo.next_scanline < cinfo.image_height)
+        while (cinfo.output_scanline < cinfo.output_height)
         {
-          row_pointer[0] = (unsigned char*)&_pImageData[cinfo.next_scanline * row_stride];
-          jpeg_write_scanlines(&cinfo, row_pointer, 1);
+            row_pointer[0] = &_imageData[(size_t)cinfo.output_scanline * row_stride];
+            jpeg_read_scanlines(&cinfo, row_pointer, 1);
         }
         
-        jpeg_finish_compress(&cinfo);
-        jpeg_destroy_compress(&cinfo);
-        fclose(outfile);
-
+        jpeg_finish_decompress(&cinfo);
+        jpeg_destroy_decompress(&cinfo);
+        fclose(infile);
+        
         return 0;
     }
 
@@ -0,0 +1,584 @@
+#ifndef LIBS_HEADER_JSON_H
+#define LIBS_HEADER_JSON_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace LNF
+{
+    /*
+     Small JSON document value (null, bool, number, string, array or object).
+     Object members keep their order; lookups of missing members/items return a null value, so nested reads like
+     value["camera"]["fov"].number(60) do not need checks.
+     */
+    class JsonValue
+    {
+     public:
+        enum class Type
+        {
+            NUL,
+            BOOL,
+            NUMBER,
+            STRING,
+            ARRAY,
+            OBJECT
+        };
+
+        using member_type = std::pair<std::string, JsonValue>;
+
+     public:
+        JsonValue()
+            :m_type(Type::NUL),
+             m_fNumber(0)
+        {}
+
+        JsonValue(bool _bValue)
+            :m_type(Type::BOOL),
+             m_fNumber(_bValue ? 1 : 0)
+        {}
+
+        JsonValue(double _fValue)
+            :m_type(Type::NUMBER),
+             m_fNumber(_fValue)
+        {}
+
+        JsonValue(int _iValue)
+            :m_type(Type::NUMBER),
+             m_fNumber(_iValue)
+        {}
+
+        JsonValue(const char *_pszValue)
+            :m_type(Type::STRING),
+             m_fNumber(0),
+             m_strValue(_pszValue)
+        {}
+
+        JsonValue(const std::string &_strValue)
+            :m_type(Type::STRING),
+             m_fNumber(0),
+             m_strValue(_strValue)
+        {}
+
+        static JsonValue array() {
+            JsonValue value;
+            value.m_type = Type::ARRAY;
+            return value;
+        }
+
+        static JsonValue object() {
+            JsonValue value;
+            value.m_type = Type::OBJECT;
+            return value;
+        }
+
+        Type type() const {return m_type;}
+        bool isNull() const {return m_type == Type::NUL;}
+        bool isBool() const {return m_type == Type::BOOL;}
+        bool isNumber() const {return m_type == Type::NUMBER;}
+        bool isString() const {return m_type == Type::STRING;}
+        bool isArray() const {return m_type == Type::ARRAY;}
+        bool isObject() const {return m_type == Type::OBJECT;}
+
+        bool boolean(bool _bDefault = false) const {
+            return m_type == Type::BOOL ? m_fNumber != 0 : _bDefault;
+        }
+
+        double number(double _fDefault = 0) const {
+            return m_type == Type::NUMBER ? m_fNumber : _fDefault;
+        }
+
+        const std::string &string() const {
+            return m_strValue;
+        }
+
+        std::string string(const std::string &_strDefault) const {
+            return m_type == Type::STRING ? m_strValue : _strDefault;
+        }
+
+        /* number of array items or object members */
+        size_t size() const {
+            return m_type == Type::ARRAY ? m_items.size() : (m_type == Type::OBJECT ? m_members.size() : 0);
+        }
+
+        const JsonValue &operator[](size_t _uIndex) const {
+            return (m_type == Type::ARRAY) && (_uIndex < m_items.size()) ? m_items[_uIndex] : null();
+        }
+
+        const JsonValue &operator[](const std::string &_strKey) const {
+            auto pValue = find(_strKey);
+            return pValue != nullptr ? *pValue : null();
+        }
+
+        bool has(const std::string &_strKey) const {
+            return find(_strKey) != nullptr;
+        }
+
+        const std::vector<JsonValue> &items() const {
+            return m_items;
+        }
+
+        const std::vector<member_type> &members() const {
+            return m_members;
+        }
+
+        /* appends array item (returns the item) */
+        JsonValue &push(JsonValue _value) {
+            m_items.push_back(std::move(_value));
+            return m_items.back();
+        }
+
+        /* adds or replaces object member (returns the member value) */
+        JsonValue &set(const std::string &_strKey, JsonValue _value) {
+            for (auto &member : m_members) {
+                if (member.first == _strKey) {
+                    member.second = std::move(_value);
+                    return member.second;
+                }
+            }
+
+            m_members.emplace_back(_strKey, std::move(_value));
+            return m_members.back().second;
+        }
+
+        /* returns JSON text (compact if _iIndent is 0) */
+        std::string dump(int _iIndent = 0) const {
+            std::string strText;
+            write(strText, _iIndent, 0);
+            return strText;
+        }
+
+        /* parses JSON text; returns false on syntax errors (_pstrError gets the message and line) */
+        static bool parse(const std::string &_strText, JsonValue &_value, std::string *_pstrError = nullptr) {
+            return parse(_strText.c_str(), _strText.size(), _value, _pstrError);
+        }
+
+        /* parses JSON text in place (e.g. a mapped file; no copy of the text is made) */
+        static bool parse(const char *_pText, size_t _uSize, JsonValue &_value, std::string *_pstrError = nullptr) {
+            Parser parser(_pText, _pText + _uSize);
+            JsonValue value;
+            if ( (parser.value(value, 0) == false) || (parser.end() == false) ) {
+                if (_pstrError != nullptr) {
+                    *_pstrError = parser.error();
+                }
+
+                return false;
+            }
+
+            _value = std::move(value);
+            return true;
+        }
+
+        /* reads and parses a JSON file; returns false on errors */
+        static bool parseFile(const std::string &_strPath, JsonValue &_value, std::string *_pstrError = nullptr) {
+            FILE *pFile = fopen(_strPath.c_str(), "rb");
+            if (pFile == nullptr) {
+                if (_pstrError != nullptr) {
+                    *_pstrError = "can't open " + _strPath;
+                }
+
+                return false;
+            }
+
+            std::string strText;
+            char buffer[4096];
+            size_t uRead = 0;
+            while ( (uRead = fread(buffer, 1, sizeof(buffer), pFile)) > 0 ) {
+                strText.append(buffer, uRead);
+            }
+
+            fclose(pFile);
+            return parse(strText, _value, _pstrError);
+        }
+
+     private:
+        static const JsonValue &null() {
+            static const JsonValue value;
+            return value;
+        }
+
+        const JsonValue *find(const std::string &_strKey) const {
+            for (const auto &member : m_members) {
+                if (member.first == _strKey) {
+                    return &member.second;
+                }
+            }
+
+            return nullptr;
+        }
+
+        static void writeString(std::string &_strText, const std::string &_strValue) {
+            _strText += '"';
+            for (unsigned char c : _strValue) {
+                switch (c) {
+                    case '"': _strText += "\\\""; break;
+                    case '\\': _strText += "\\\\"; break;
+                    case '\n': _strText += "\\n"; break;
+                    case '\r': _strText += "\\r"; break;
+                    case '\t': _strText += "\\t"; break;
+                    default:
+                        if (c < 0x20) {
+                            char szCode[8];
+                            snprintf(szCode, sizeof(szCode), "\\u%04x", c);
+                            _strText += szCode;
+                        }
+                        else {
+                            _strText += (char)c;
+                        }
+                }
+            }
+
+            _strText += '"';
+        }
+
+        void write(std::string &_strText, int _iIndent, int _iDepth) const {
+            auto newLine = [&](int _iLevel) {
+                if (_iIndent > 0) {
+                    _strText += '\n';
+                    _strText.append((size_t)(_iIndent * _iLevel), ' ');
+                }
+            };
+
+            switch (m_type) {
+                case Type::NUL: _strText += "null"; break;
+                case Type::BOOL: _strText += m_fNumber != 0 ? "true" : "false"; break;
+                case Type::NUMBER: {
+                    char szNumber[32];
+                    if (std::isfinite(m_fNumber) == false) {
+                        snprintf(szNumber, sizeof(szNumber), "null");
+                    }
+                    else if ( (m_fNumber == std::floor(m_fNumber)) && (std::fabs(m_fNumber) < 1e15) ) {
+                        snprintf(szNumber, sizeof(szNumber), "%.0f", m_fNumber);
+                    }
+                    else {
+                        snprintf(szNumber, sizeof(szNumber), "%.9g", m_fNumber);
+                    }
+
+                    _strText += szNumber;
+                    break;
+                }
+                case Type::STRING: writeString(_strText, m_strValue); break;
+                case Type::ARRAY:
+                    _strText += '[';
+                    for (size_t i = 0; i < m_items.size(); i++) {
+                        _strText += i > 0 ? "," : "";
+                        newLine(_iDepth + 1);
+                        m_items[i].write(_strText, _iIndent, _iDepth + 1);
+                    }
+
+                    if (m_items.empty() == false) {
+                        newLine(_iDepth);
+                    }
+
+                    _strText += ']';
+                    break;
+                case Type::OBJECT:
+                    _strText += '{';
+                    for (size_t i = 0; i < m_members.size(); i++) {
+                        _strText += i > 0 ? "," : "";
+                        newLine(_iDepth + 1);
+                        writeString(_strText, m_members[i].first);
+                        _strText += _iIndent > 0 ? ": " : ":";
+                        m_members[i].second.write(_strText, _iIndent, _iDepth + 1);
+                    }
+
+                    if (m_members.empty() == false) {
+                        newLine(_iDepth);
+                    }
+
+                    _strText += '}';
+                    break;
+            }
+        }
+
+     private:
+        // recursive descent parser
+        class Parser
+        {
+         public:
+            static constexpr int MAX_DEPTH = 256;
+
+         public:
+            Parser(const char *_pBegin, const char *_pEnd)
+                :m_pBegin(_pBegin),
+                 m_p(_pBegin),
+                 m_pEnd(_pEnd)
+            {}
+
+            bool value(JsonValue &_value, int _iDepth) {
+                skipSpace();
+                if (m_p >= m_pEnd) {
+                    return fail("unexpected end");
+                }
+
+                if (_iDepth > MAX_DEPTH) {
+                    return fail("too deeply nested");
+                }
+
+                switch (*m_p) {
+                    case '{': return object(_value, _iDepth);
+                    case '[': return array(_value, _iDepth);
+                    case '"': _value = JsonValue(); _value.m_type = Type::STRING; return string(_value.m_strValue);
+                    case 't': _value = JsonValue(true); return literal("true");
+                    case 'f': _value = JsonValue(false); return literal("false");
+                    case 'n': _value = JsonValue(); return literal("null");
+                    default: return number(_value);
+                }
+            }
+
+            /* true if only whitespace is left */
+            bool end() {
+                skipSpace();
+                return m_p >= m_pEnd ? true : fail("unexpected text after value");
+            }
+
+            std::string error() const {
+                int iLine = 1;
+                for (auto p = m_pBegin; p < m_pError; p++) {
+                    iLine += *p == '\n' ? 1 : 0;
+                }
+
+                return m_strError + " (line " + std::to_string(iLine) + ")";
+            }
+
+         private:
+            bool fail(const char *_pszError) {
+                if (m_strError.empty() == true) {
+                    m_strError = _pszError;
+                    m_pError = m_p;
+                }
+
+                return false;
+            }
+
+            void skipSpace() {
+                while ( (m_p < m_pEnd) && ( (*m_p == ' ') || (*m_p == '\t') || (*m_p == '\n') || (*m_p == '\r') ) ) {
+                    m_p++;
+                }
+            }
+
+            bool literal(const char *_pszLiteral) {
+                size_t uLength = strlen(_pszLiteral);
+                if ( ((size_t)(m_pEnd - m_p) < uLength) || (strncmp(m_p, _pszLiteral, uLength) != 0) ) {
+                    return fail("bad literal");
+                }
+
+                m_p += uLength;
+                return true;
+            }
+
+            bool number(JsonValue &_value) {
+                // strtod needs a terminated copy (the text is not necessarily terminated after the number)
+                const char *pStart = m_p;
+                while ( (m_p < m_pEnd) && (strchr("+-0123456789.eE", *m_p) != nullptr) ) {
+                    m_p++;
+                }
+
+                std::string strNumber(pStart, m_p);
+                char *pszEnd = nullptr;
+                double fValue = strtod(strNumber.c_str(), &pszEnd);
+                if ( (strNumber.empty() == true) || (*pszEnd != 0) ) {
+                    m_p = pStart;
+                    return fail("bad value");
+                }
+
+                _value = JsonValue(fValue);
+                return true;
+            }
+
+            static void appendUtf8(std::string &_str, uint32_t _uCode) {
+                if (_uCode < 0x80) {
+                    _str += (char)_uCode;
+                }
+                else if (_uCode < 0x800) {
+                    _str += (char)(0xc0 | (_uCode >> 6));
+                    _str += (char)(0x80 | (_uCode & 0x3f));
+                }
+                else if (_uCode < 0x10000) {
+                    _str += (char)(0xe0 | (_uCode >> 12));
+                    _str += (char)(0x80 | ((_uCode >> 6) & 0x3f));
+                    _str += (char)(0x80 | (_uCode & 0x3f));
+                }
+                else {
+                    _str += (char)(0xf0 | (_uCode >> 18));
+                    _str += (char)(0x80 | ((_uCode >> 12) & 0x3f));
+                    _str += (char)(0x80 | ((_uCode >> 6) & 0x3f));
+                    _str += (char)(0x80 | (_uCode & 0x3f));
+                }
+            }
+
+            bool hex4(uint32_t &_uCode) {
+                if (m_pEnd - m_p < 4) {
+                    return fail("bad escape");
+                }
+
+                _uCode = 0;
+                for (int i = 0; i < 4; i++, m_p++) {
+                    char c = *m_p;
+                    int iDigit = (c >= '0') && (c <= '9') ? c - '0' :
+                                 (c >= 'a') && (c <= 'f') ? c - 'a' + 10 :
+                                 (c >= 'A') && (c <= 'F') ? c - 'A' + 10 : -1;
+                    if (iDigit < 0) {
+                        return fail("bad escape");
+                    }
+
+                    _uCode = _uCode * 16 + (uint32_t)iDigit;
+                }
+
+                return true;
+            }
+
+            bool string(std::string &_str) {
+                m_p++;  // opening quote
+                _str.clear();
+                while (m_p < m_pEnd) {
+                    char c = *m_p++;
+                    if (c == '"') {
+                        return true;
+                    }
+                    else if (c != '\\') {
+                        _str += c;
+                        continue;
+                    }
+
+                    if (m_p >= m_pEnd) {
+                        break;
+                    }
+
+                    c = *m_p++;
+                    switch (c) {
+                        case '"': _str += '"'; break;
+                        case '\\': _str += '\\'; break;
+                        case '/': _str += '/'; break;
+                        case 'b': _str += '\b'; break;
+                        case 'f': _str += '\f'; break;
+                        case 'n': _str += '\n'; break;
+                        case 'r': _str += '\r'; break;
+                        case 't': _str += '\t'; break;
+                        case 'u': {
+                            uint32_t uCode = 0;
+                            if (hex4(uCode) == false) {
+                                return false;
+                            }
+
+                            // surrogate pair
+                            if ( (uCode >= 0xd800) && (uCode < 0xdc00) && (m_pEnd - m_p >= 6) && (m_p[0] == '\\') && (m_p[1] == 'u') ) {
+                                uint32_t uLow = 0;
+                                m_p += 2;
+                                if (hex4(uLow) == false) {
+                                    return false;
+                                }
+
+                                uCode = 0x10000 + ((uCode - 0xd800) << 10) + (uLow - 0xdc00);
+                            }
+
+                            appendUtf8(_str, uCode);
+                            break;
+                        }
+                        default: return fail("bad escape");
+                    }
+                }
+
+                return fail("unterminated string");
+            }
+
+            bool array(JsonValue &_value, int _iDepth) {
+                m_p++;
+                _value = JsonValue::array();
+                skipSpace();
+                if ( (m_p < m_pEnd) && (*m_p == ']') ) {
+                    m_p++;
+                    return true;
+                }
+
+                while (true) {
+                    if (value(_value.push(JsonValue()), _iDepth + 1) == false) {
+                        return false;
+                    }
+
+                    skipSpace();
+                    if ( (m_p < m_pEnd) && (*m_p == ',') ) {
+                        m_p++;
+                    }
+                    else if ( (m_p < m_pEnd) && (*m_p == ']') ) {
+                        m_p++;
+                        return true;
+                    }
+                    else {
+                        return fail("expected ',' or ']'");
+                    }
+                }
+            }
+
+            bool object(JsonValue &_value, int _iDepth) {
+                m_p++;
+                _value = JsonValue::object();
+                skipSpace();
+                if ( (m_p < m_pEnd) && (*m_p == '}') ) {
+                    m_p++;
+                    return true;
+                }
+
+                while (true) {
+                    std::string strKey;
+                    skipSpace();
+                    if ( (m_p >= m_pEnd) || (*m_p != '"') ) {
+                        return fail("expected member name");
+                    }
+
+                    if (string(strKey) == false) {
+                        return false;
+                    }
+
+                    skipSpace();
+                    if ( (m_p >= m_pEnd) || (*m_p != ':') ) {
+                        return fail("expected ':'");
+                    }
+
+                    m_p++;
+                    if (value(_value.set(strKey, JsonValue()), _iDepth + 1) == false) {
+                        return false;
+                    }
+
+                    skipSpace();
+                    if ( (m_p < m_pEnd) && (*m_p == ',') ) {
+                        m_p++;
+                    }
+                    else if ( (m_p < m_pEnd) && (*m_p == '}') ) {
+                        m_p++;
+                        return true;
+                    }
+                    else {
+                        return fail("expected ',' or '}'");
+                    }
+                }
+            }
+
+         private:
+            const char      *m_pBegin;
+            const char      *m_p;
+            const char      *m_pEnd;
+            const char      *m_pError = nullptr;
+            std::string     m_strError;
+        };
+
+     private:
+        Type                        m_type;
+        double                      m_fNumber;
+        std::string                 m_strValue;
+        std::vector<JsonValue>      m_items;
+        std::vector<member_type>    m_members;
+    };
+
+
+};  // namespace LNF
+
+
+#endif  // #ifndef LIBS_HEADER_JSON_H
@@ -0,0 +1,521 @@
+#ifndef LIBS_HEADER_LOADERS_H
+#define LIBS_HEADER_LOADERS_H
+
+#include "animation.h"
+#include "box.h"
+#include "camera.h"
+#include "compact_mesh.h"
+#include "constants.h"
+#include "default_materials.h"
+#include "marched_bubbles.h"
+#include "marched_mandle.h"
+#include "marched_materials.h"
+#include "marched_sphere.h"
+#include "mesh_file.h"
+#include "plane.h"
+#include "primitive_group.h"
+#include "random.h"
+#include "scene.h"
+#include "simple_scene.h"
+#include "smoke_box.h"
+#include "sphere.h"
+#include "texture.h"
+#include "vec3.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace LNF
+{
+    // Factory responsible for creating the correct scene and camera
+    class Loader
+    {
+     public:
+        virtual ~Loader() = default;
+        virtual std::unique_ptr<Scene> loadScene() const = 0;
+        virtual std::unique_ptr<Camera> loadCamera() const = 0;
+        
+        /* short scene name (e.g. for benchmark reports) */
+        virtual const char *name() const {
+            return "scene";
+        }
+        
+        /* animation (camera and instance tracks) for a scene created by loadScene() (nullptr if not animated) */
+        virtual std::unique_ptr<Animation> loadAnimation(Scene *_pScene) const {
+            return nullptr;
+        }
+    };
+
+
+    // scene -- mandlebulb
+    class LoaderScene0  : public Loader
+    {
+     public:
+        virtual const char *name() const override {
+            return "mandlebulb";
+        }
+
+        virtual std::unique_ptr<Scene> loadScene() const override {
+            auto pScene = std::make_unique<SimpleSceneBvh>();
+            auto pAO = createMaterial<FakeAmbientOcclusion>(pScene);
+            auto pGlow = createMaterial<Glow>(pScene);
+            auto pLightWhite = createMaterial<Light>(pScene, Color(30.0, 30.0, 30.0));
+
+            createPrimitiveInstance<Sphere>(pScene, axisTranslation(Vec(0, 200, 100)), 30, pLightWhite);
+            createPrimitiveInstance<MarchedMandle>(pScene, axisEulerZYX(0, 0, 0, Vec(0, 0, 0), 40.0), pGlow);
+
+            pScene->build();   // build BVH
+            return pScene;
+        }
+
+        virtual std::unique_ptr<Camera> loadCamera() const override {
+            return std::make_unique<SimpleCamera>(Vec(50, 0, 30), Vec(0, 1, 0), Vec(0, 0, 15), deg2rad(60), 5.0, 15);
+        }
+
+        // turntable
+        virtual std::unique_ptr<Animation> loadAnimation(Scene *_pScene) const override {
+            return std::make_unique<Animation>(turntablePath(Vec(50, 0, 30), Vec(0, 1, 0), Vec(0, 0, 15), deg2rad(60), 5.0, 15, 8.0f), 240);
+        }
+    };
+
+
+    // scene -- raymarching
+    class LoaderScene1  : public Loader
+    {
+     public:
+        virtual const char *name() const override {
+            return "raymarching";
+        }
+
+        virtual std::unique_ptr<Scene> loadScene() const override {
+            auto pScene = std::make_unique<SimpleSceneBvh>();
+            auto pDiffuseFloor = createMaterial<DiffuseCheckered>(pScene, Color(1.0, 1.0, 1.0), Color(1.0, 0.4, 0.2), 2);
+            //auto pDiffuseFog = createMaterial<Diffuse>(_pScene.get(), Color(0.9, 0.9, 0.9));
+            auto pGlass = createMaterial<Glass>(pScene, Color(0.95, 0.95, 0.95), 0.01, 1.8);
+            auto pMirror = createMaterial<Metal>(pScene, Color(0.95, 0.95, 0.95), 0.02);
+            auto pAO = createMaterial<FakeAmbientOcclusion>(pScene);
+            auto pMetalIt = createMaterial<MetalIterations>(pScene);
+            auto pGlow = createMaterial<Glow>(pScene);
+            auto pLightWhite = createMaterial<Light>(pScene, Color(30.0, 30.0, 30.0));
+
+            createPrimitiveInstance<Disc>(pScene, axisIdentity(), 500, pDiffuseFloor);
+            createPrimitiveInstance<Rectangle>(pScene, axisTranslation(Vec(0, 1, 0)), 200, 200, pMirror);
+            //createPrimitiveInstance<SmokeBox>(_pScene.get(), axisIdentity(), 400, pDiffuseFog, 400);
+            createPrimitiveInstance<Sphere>(pScene, axisTranslation(Vec(0, 200, 100)), 30, pLightWhite);
+            auto marchGlass = MarchSettings{1000, 1e-5f, 1e-4f, 1.5f, 0.8f};       // relaxed marching (glass is not coloured by step count)
+
+            createPrimitiveInstance<MarchedMandle>(pScene, axisEulerZYX(0, 1, 0, Vec(-50, 45, 50), 40.0), pGlow);
+            createPrimitiveInstance<MarchedSphere>(pScene, axisEulerZYX(0, 1, 0, Vec(50, 45, 50), 40.0), 2.0f, pGlass, 0.04f, marchGlass);
+            createPrimitiveInstance<MarchedBubbles>(pScene, axisEulerZYX(0, 1, 0, Vec(0, 45, -50), 40.0), 2.0f, pGlass, marchGlass);
+
+            pScene->build();   // build BVH
+            return pScene;
+        }
+
+        virtual std::unique_ptr<Camera> loadCamera() const override {
+            return std::make_unique<SimpleCamera>(Vec(0, 50, 220), Vec(0, 1, 0), Vec(0, 5, 0), deg2rad(60), 2.0, 200);
+        }
+
+        // turntable with bouncing glass sphere and spinning bubbles (instances in the order created by loadScene())
+        virtual std::unique_ptr<Animation> loadAnimation(Scene *_pScene) const override {
+            auto pScene = static_cast<SimpleScene*>(_pScene);
+            auto pAnimation = std::make_unique<Animation>(turntablePath(Vec(0, 50, 220), Vec(0, 1, 0), Vec(0, 5, 0), deg2rad(60), 2.0, 200, 8.0f), 240);
+
+            auto &sphere = pAnimation->addInstancePath(pScene->instance(4));
+            for (int i = 0; i <= 8; i++) {
+                sphere.position().addKey(i * 1.0f, Vec(50, (i % 2) == 0 ? 45 : 90, 50));
+            }
+
+            auto &bubbles = pAnimation->addInstancePath(pScene->instance(5));
+            bubbles.rotation().addKey(0.0f, Vec(0, 1, 0)).addKey(8.0f, Vec(0, 1 + 2 * LNF::pi, 0));
+            return pAnimation;
+        }
+    };
+
+
+    // scene -- many spheres
+    class LoaderScene2  : public Loader
+    {
+     public:
+        virtual const char *name() const override {
+            return "spheres";
+        }
+
+        virtual std::unique_ptr<Scene> loadScene() const override {
+            auto pScene = std::make_unique<SimpleSceneBvh>();
+            auto pDiffuseRed = createMaterial<Diffuse>(pScene, Color(0.9f, 0.1f, 0.1f));
+            auto pDiffuseGreen = createMaterial<Diffuse>(pScene, Color(0.1f, 0.9f, 0.1f));
+            auto pDiffuseBlue = createMaterial<Diffuse>(pScene, Color(0.1f, 0.1f, 0.9f));
+
+            //auto pMesh1 = createPrimitive<SphereMesh>(pScene, 16, 16, 4, pDiffuseRed);
+            //auto pMesh2 = createPrimitive<SphereMesh>(pScene, 16, 16, 4, pDiffuseGreen);
+            //auto pMesh3 = createPrimitive<SphereMesh>(pScene, 16, 16, 4, pDiffuseBlue);
+            //auto shapes = std::vector{pMesh1, pMesh2, pMesh3};
+
+            auto pSphere1 = createPrimitive<Sphere>(pScene, 4, pDiffuseRed);
+            auto pSphere2 = createPrimitive<Sphere>(pScene, 4, pDiffuseGreen);
+            auto pSphere3 = createPrimitive<Sphere>(pScene, 4, pDiffuseBlue);
+            auto shapes = std::vector{pSphere1, pSphere2, pSphere3};
+
+            auto pLightWhite = createMaterial<Light>(pScene, Color(10.0f, 10.0f, 10.0f));
+            createPrimitiveInstance<Sphere>(pScene, axisTranslation(Vec(0, 200, 100)), 30, pLightWhite);
+
+            int n = 200;
+            for (int i = 0; i < n; i++) {
+
+                float x = 100 * sin((float)i / n * LNF::pi * 2);
+                float y = 20 * (cos((float)i / n * LNF::pi * 16) + 1);
+                float z = 100 * cos((float)i / n * LNF::pi * 2);
+
+                createPrimitiveInstance(pScene, axisEulerZYX(0, 0, 0, Vec(x, y, z)), shapes[i % shapes.size()]);
+            }
+
+            pScene->build();   // build BVH
+            return pScene;
+        }
+
+        virtual std::unique_ptr<Camera> loadCamera() const override {
+            return std::make_unique<SimpleCamera>(Vec(0, 50, 220), Vec(0, 1, 0), Vec(0, 5, 0), deg2rad(60), 2.0, 150);
+        }
+
+        // turntable
+        virtual std::unique_ptr<Animation> loadAnimation(Scene *_pScene) const override {
+            return std::make_unique<Animation>(turntablePath(Vec(0, 50, 220), Vec(0, 1, 0), Vec(0, 5, 0), deg2rad(60), 2.0, 150, 8.0f), 240);
+        }
+    };
+
+
+    // scene -- many spheres (stacked in a cube)
+    class LoaderScene3  : public Loader
+    {
+     public:
+        virtual const char *name() const override {
+            return "sphere_stack";
+        }
+
+        virtual std::unique_ptr<Scene> loadScene() const override {
+            auto pScene = std::make_unique<SimpleSceneBvh>();
+            auto pDiffuseFloor = createMaterial<DiffuseCheckered>(pScene, Color(0.1, 1.0, 0.1), Color(0.1, 0.1, 1.0), 2);
+            auto pGlass = createMaterial<Glass>(pScene, Color(0.99, 0.99, 0.99), 0.01, 1.8);
+            auto pLight = createMaterial<Light>(pScene, Color(10.0f, 10.0f, 10.0f));
+
+            auto pSphere = createPrimitive<Sphere>(pScene, 10, pGlass);
+
+            createPrimitiveInstance<Sphere>(pScene, axisTranslation(Vec(0, 500, 0)), 100, pLight);
+            createPrimitiveInstance<Disc>(pScene, axisTranslation(Vec(0, -100, 0)), 500, pDiffuseFloor);
+
+            for (int x = -2; x <= 2; x++) {
+                for (int y = -2; y <= 2; y++) {
+                    for (int z = -2; z <= 2; z++) {
+                        createPrimitiveInstance(pScene, axisTranslation(Vec(x * 20, y * 20, z * 20)), pSphere);
+                    }
+                }
+            }
+
+            pScene->build();   // build BVH
+            return pScene;
+        }
+
+        virtual std::unique_ptr<Camera> loadCamera() const override {
+            return std::make_unique<SimpleCamera>(Vec(100, 80, 100), Vec(0, 1, 0), Vec(0, 5, 0), deg2rad(60), 5.0, 100);
+        }
+
+        // turntable
+        virtual std::unique_ptr<Animation> loadAnimation(Scene *_pScene) const override {
+            return std::make_unique<Animation>(turntablePath(Vec(100, 80, 100), Vec(0, 1, 0), Vec(0, 5, 0), deg2rad(60), 5.0, 100, 8.0f), 240);
+        }
+    };
+
+
+    // scene -- triangle meshes (three finely tessellated sphere meshes instanced on a floor)
+    class LoaderScene4  : public Loader
+    {
+     public:
+        virtual const char *name() const override {
+            return "meshes";
+        }
+
+        virtual std::unique_ptr<Scene> loadScene() const override {
+            auto pScene = std::make_unique<SimpleSceneBvh>();
+            auto pDiffuseFloor = createMaterial<DiffuseCheckered>(pScene, Color(0.9, 0.9, 0.9), Color(0.2, 0.2, 0.2), 2);
+            auto pDiffuse = createMaterial<Diffuse>(pScene, Color(0.8f, 0.3f, 0.2f));
+            auto pMetal = createMaterial<Metal>(pScene, Color(0.8f, 0.8f, 0.9f), 0.05f);
+            auto pGlass = createMaterial<Glass>(pScene, Color(0.95, 0.95, 0.95), 0.01, 1.8);
+            auto pLight = createMaterial<Light>(pScene, Color(10.0f, 10.0f, 10.0f));
+
+            createPrimitiveInstance<Sphere>(pScene, axisTranslation(Vec(0, 300, 100)), 60, pLight);
+            createPrimitiveInstance<Disc>(pScene, axisTranslation(Vec(0, 0, 0)), 500, pDiffuseFloor);
+
+            // ~130k triangles per mesh
+            auto pMesh1 = createPrimitive<SphereMesh>(pScene, 512, 128, 8, pDiffuse);
+            auto pMesh2 = createPrimitive<SphereMesh>(pScene, 512, 128, 8, pMetal);
+            auto pMesh3 = createPrimitive<SphereMesh>(pScene, 512, 128, 8, pGlass);
+            auto shapes = std::vector<const Primitive*>{pMesh1, pMesh2, pMesh3};
+
+            for (int x = -2; x <= 2; x++) {
+                for (int z = -2; z <= 2; z++) {
+                    createPrimitiveInstance(pScene, axisTranslation(Vec(x * 20, 8, z * 20)), shapes[(x + z + 4) % shapes.size()]);
+                }
+            }
+
+            pScene->build();   // build BVH
+            return pScene;
+        }
+
+        virtual std::unique_ptr<Camera> loadCamera() const override {
+            return std::make_unique<SimpleCamera>(Vec(0, 60, 120), Vec(0, 1, 0), Vec(0, 5, 0), deg2rad(60), 0.0, 120);
+        }
+    };
+
+
+    // scene -- smoke (volume scattering around a few spheres)
+    class LoaderScene5  : public Loader
+    {
+     public:
+        virtual const char *name() const override {
+            return "smoke";
+        }
+
+        virtual std::unique_ptr<Scene> loadScene() const override {
+            auto pScene = std::make_unique<SimpleSceneBvh>();
+            auto pDiffuseFloor = createMaterial<DiffuseCheckered>(pScene, Color(1.0, 1.0, 1.0), Color(1.0, 0.4, 0.2), 2);
+            auto pDiffuseFog = createMaterial<Diffuse>(pScene, Color(0.9, 0.9, 0.9));
+            auto pGlass = createMaterial<Glass>(pScene, Color(0.95, 0.95, 0.95), 0.01, 1.8);
+            auto pMirror = createMaterial<Metal>(pScene, Color(0.95, 0.95, 0.95), 0.02);
+            auto pLightWhite = createMaterial<Light>(pScene, Color(30.0, 30.0, 30.0));
+
+            createPrimitiveInstance<Disc>(pScene, axisIdentity(), 500, pDiffuseFloor);
+            createPrimitiveInstance<SmokeBox>(pScene, axisTranslation(Vec(0, 75, 0)), 150, pDiffuseFog, 600);
+            createPrimitiveInstance<Sphere>(pScene, axisTranslation(Vec(0, 200, 100)), 30, pLightWhite);
+            createPrimitiveInstance<Sphere>(pScene, axisTranslation(Vec(-40, 30, 0)), 30, pGlass);
+            createPrimitiveInstance<Sphere>(pScene, axisTranslation(Vec(40, 30, 0)), 30, pMirror);
+
+            pScene->build();   // build BVH
+            return pScene;
+        }
+
+        virtual std::unique_ptr<Camera> loadCamera() const override {
+            return std::make_unique<SimpleCamera>(Vec(0, 50, 220), Vec(0, 1, 0), Vec(0, 25, 0), deg2rad(60), 0.0, 220);
+        }
+    };
+
+
+    // scene -- large instance count (100k spheres on a grid)
+    class LoaderScene6  : public Loader
+    {
+     public:
+        virtual const char *name() const override {
+            return "instances";
+        }
+
+        virtual std::unique_ptr<Scene> loadScene() const override {
+            auto pScene = std::make_unique<SimpleSceneBvh>();
+            auto pDiffuseFloor = createMaterial<DiffuseCheckered>(pScene, Color(0.9, 0.9, 0.9), Color(0.2, 0.2, 0.2), 2);
+            auto pDiffuseRed = createMaterial<Diffuse>(pScene, Color(0.9f, 0.1f, 0.1f));
+            auto pDiffuseGreen = createMaterial<Diffuse>(pScene, Color(0.1f, 0.9f, 0.1f));
+            auto pMetal = createMaterial<Metal>(pScene, Color(0.8f, 0.8f, 0.9f), 0.05f);
+            auto pLight = createMaterial<Light>(pScene, Color(10.0f, 10.0f, 10.0f));
+
+            createPrimitiveInstance<Sphere>(pScene, axisTranslation(Vec(0, 500, 0)), 100, pLight);
+            createPrimitiveInstance<Disc>(pScene, axisTranslation(Vec(0, -1, 0)), 1000, pDiffuseFloor);
+
+            auto pSphere1 = createPrimitive<Sphere>(pScene, 0.8f, pDiffuseRed);
+            auto pSphere2 = createPrimitive<Sphere>(pScene, 0.8f, pDiffuseGreen);
+            auto pSphere3 = createPrimitive<Sphere>(pScene, 0.8f, pMetal);
+            auto shapes = std::vector<const Primitive*>{pSphere1, pSphere2, pSphere3};
+
+            for (int x = -50; x < 50; x++) {
+                for (int y = 0; y < 10; y++) {
+                    for (int z = -50; z < 50; z++) {
+                        createPrimitiveInstance(pScene, axisTranslation(Vec(x * 2.0f, y * 2.0f, z * 2.0f)), shapes[(x + y + z + 150) % shapes.size()]);
+                    }
+                }
+            }
+
+            pScene->build();   // build BVH
+            return pScene;
+        }
+
+        virtual std::unique_ptr<Camera> loadCamera() const override {
+            return std::make_unique<SimpleCamera>(Vec(120, 80, 120), Vec(0, 1, 0), Vec(0, 0, 0), deg2rad(60), 0.0, 160);
+        }
+    };
+
+
+    // scene -- forest (two tree prototypes, each a primitive group, instanced 40k times)
+    class LoaderScene7  : public Loader
+    {
+     public:
+        virtual const char *name() const override {
+            return "forest";
+        }
+
+        virtual std::unique_ptr<Scene> loadScene() const override {
+            auto pScene = std::make_unique<SimpleSceneBvh>();
+            auto pDiffuseFloor = createMaterial<Diffuse>(pScene, Color(0.4f, 0.35f, 0.2f));
+            auto pBark = createMaterial<Diffuse>(pScene, Color(0.3f, 0.2f, 0.1f));
+            auto pLeavesDark = createMaterial<Diffuse>(pScene, Color(0.1f, 0.4f, 0.1f));
+            auto pLeavesLight = createMaterial<Diffuse>(pScene, Color(0.3f, 0.6f, 0.1f));
+            auto pLight = createMaterial<Light>(pScene, Color(10.0f, 10.0f, 10.0f));
+
+            createPrimitiveInstance<Sphere>(pScene, axisTranslation(Vec(0, 500, 0)), 100, pLight);
+            createPrimitiveInstance<Disc>(pScene, axisIdentity(), 1000, pDiffuseFloor);
+
+            // tree prototypes (sharing one trunk primitive)
+            auto pTrunk = createPrimitive<Box>(pScene, Vec(0.6f, 4.0f, 0.6f), pBark);
+
+            auto pPine = createPrimitiveGroup(pScene);
+            createGroupInstance(pScene, pPine, axisTranslation(Vec(0, 2, 0)), pTrunk);
+            createGroupInstance<Sphere>(pScene, pPine, axisTranslation(Vec(0, 4.5f, 0)), 2.0f, pLeavesDark);
+            createGroupInstance<Sphere>(pScene, pPine, axisTranslation(Vec(0, 6.5f, 0)), 1.5f, pLeavesDark);
+            createGroupInstance<Sphere>(pScene, pPine, axisTranslation(Vec(0, 8.0f, 0)), 1.0f, pLeavesDark);
+            pPine->build();
+
+            auto pBroadleaf = createPrimitiveGroup(pScene);
+            createGroupInstance(pScene, pBroadleaf, axisTranslation(Vec(0, 2, 0)), pTrunk);
+            createGroupInstance<Sphere>(pScene, pBroadleaf, axisTranslation(Vec(0, 5.5f, 0)), 2.0f, pLeavesLight);
+            createGroupInstance<Sphere>(pScene, pBroadleaf, axisTranslation(Vec(1.5f, 4.5f, 0)), 1.5f, pLeavesLight);
+            createGroupInstance<Sphere>(pScene, pBroadleaf, axisTranslation(Vec(-1.5f, 4.5f, 0)), 1.5f, pLeavesLight);
+            createGroupInstance<Sphere>(pScene, pBroadleaf, axisTranslation(Vec(0, 4.5f, 1.5f)), 1.5f, pLeavesLight);
+            createGroupInstance<Sphere>(pScene, pBroadleaf, axisTranslation(Vec(0, 4.5f, -1.5f)), 1.5f, pLeavesLight);
+            pBroadleaf->build();
+
+            auto prototypes = std::vector<const Primitive*>{pPine, pBroadleaf};
+
+            // jittered grid (hashed, so every load and render node places the same trees)
+            for (int x = -100; x < 100; x++) {
+                for (int z = -100; z < 100; z++) {
+                    const uint32_t uHash = hash32(hashCombine(hash32((uint32_t)x), (uint32_t)z));
+                    const float fJitterX = ((uHash & 0xff) / 255.0f - 0.5f) * 3.0f;
+                    const float fJitterZ = (((uHash >> 8) & 0xff) / 255.0f - 0.5f) * 3.0f;
+                    const float fAngle = ((uHash >> 16) & 0xff) / 255.0f * 2 * pi;
+                    const float fScale = 0.7f + ((uHash >> 24) & 0xff) / 255.0f * 0.6f;
+                    createPrimitiveInstance(pScene,
+                                            axisEulerZYX(0, fAngle, 0, Vec(x * 5.0f + fJitterX, 0, z * 5.0f + fJitterZ), fScale),
+                                            prototypes[uHash % prototypes.size()]);
+                }
+            }
+
+            pScene->build();   // build BVH
+            return pScene;
+        }
+
+        virtual std::unique_ptr<Camera> loadCamera() const override {
+            return std::make_unique<SimpleCamera>(Vec(60, 40, 60), Vec(0, 1, 0), Vec(0, 5, 0), deg2rad(60), 0.0, 80);
+        }
+    };
+
+
+    // scene -- triangle mesh file (OBJ/PLY) instanced a few times on a floor (optionally converted to compact storage and textured)
+    class LoaderMeshFile  : public Loader
+    {
+     public:
+        LoaderMeshFile(const std::string &_strPath, bool _bCompact = false, const std::string &_strTexturePath = "")
+            :m_strPath(_strPath),
+             m_strTexturePath(_strTexturePath),
+             m_bCompact(_bCompact)
+        {}
+
+        virtual const char *name() const override {
+            return "mesh_file";
+        }
+
+        virtual std::unique_ptr<Scene> loadScene() const override {
+            auto pScene = std::make_unique<SimpleSceneBvh>();
+            auto pDiffuseFloor = createMaterial<DiffuseCheckered>(pScene, Color(0.9, 0.9, 0.9), Color(0.2, 0.2, 0.2), 2);
+            auto pDiffuse = createMaterial<Diffuse>(pScene, Color(0.8f, 0.3f, 0.2f));
+            auto pMetal = createMaterial<Metal>(pScene, Color(0.8f, 0.8f, 0.9f), 0.05f);
+            if (m_strTexturePath.empty() == false) {
+                auto pTexture = createTexture(pScene, m_strTexturePath);
+                if (pTexture->valid() == true) {
+                    pDiffuse = createMaterial<DiffuseTexture>(pScene, pTexture, 100.0f);
+                }
+            }
+
+            auto pLight = createMaterial<Light>(pScene, Color(10.0f, 10.0f, 10.0f));
+
+            createPrimitiveInstance<Sphere>(pScene, axisTranslation(Vec(0, 300, 100)), 60, pLight);
+            createPrimitiveInstance<Disc>(pScene, axisTranslation(Vec(0, 0, 0)), 500, pDiffuseFloor);
+
+            // mesh is loaded (or mapped from its cache) once and shared by all instances
+            const Primitive *pMesh = nullptr;
+            const Primitive *pMeshMetal = nullptr;
+            if (m_bCompact == true) {
+                // full mesh is only kept for the conversion
+                auto pFile = std::make_unique<MeshFile>(m_strPath, pDiffuse);
+                if (pFile->loaded() == true) {
+                    auto pCompact = pScene->arena().template create<CompactMesh>(*pFile);
+                    auto pCompactMetal = pScene->arena().template create<CompactMesh>(*pFile, pMetal);
+                    pScene->addResource(pCompact);
+                    pScene->addResource(pCompactMetal);
+                    pMesh = pCompact;
+                    pMeshMetal = pCompactMetal;
+                }
+            }
+            else {
+                auto pFile = pScene->arena().template create<MeshFile>(m_strPath, pDiffuse);
+                auto pFileMetal = pScene->arena().template create<MeshFile>(m_strPath, pMetal);
+                pScene->addResource(pFile);
+                pScene->addResource(pFileMetal);
+                if (pFile->loaded() == true) {
+                    pMesh = pFile;
+                    pMeshMetal = pFileMetal;
+                }
+            }
+
+            if (pMesh != nullptr) {
+                // scale mesh to fit a 40 unit cube, standing on the floor
+                const Bounds &bounds = pMesh->bounds();
+                const Vec size = bounds.size();
+                const float fScale = 40.0f / std::max(std::max(size.x(), size.y()), std::max(size.z(), 1e-6f));
+                const Vec base = Vec(bounds.center().x(), bounds.m_min.y(), bounds.center().z()) * fScale;
+
+                for (int i = 0; i < 3; i++) {
+                    createPrimitiveInstance(pScene,
+                                            axisTranslation(Vec(-50 + 50 * i, 0, 0) - base, fScale),
+                                            i == 1 ? pMeshMetal : pMesh);
+                }
+            }
+
+            pScene->build();   // build BVH
+            return pScene;
+        }
+
+        virtual std::unique_ptr<Camera> loadCamera() const override {
+            return std::make_unique<SimpleCamera>(Vec(0, 60, 140), Vec(0, 1, 0), Vec(0, 15, 0), deg2rad(60), 0.0, 140);
+        }
+
+     private:
+        std::string     m_strPath;
+        std::string     m_strTexturePath;
+        bool            m_bCompact;
+    };
+
+
+    constexpr int EXAMPLE_SCENE_COUNT = 8;     // example scenes 0 to EXAMPLE_SCENE_COUNT - 1
+
+
+    /* returns loader for the given example scene (nullptr if unknown) */
+    inline std::unique_ptr<Loader> createSceneLoader(int _iScene) {
+        switch (_iScene) {
+            case 0: return std::make_unique<LoaderScene0>();
+            case 1: return std::make_unique<LoaderScene1>();
+            case 2: return std::make_unique<LoaderScene2>();
+            case 3: return std::make_unique<LoaderScene3>();
+            case 4: return std::make_unique<LoaderScene4>();
+            case 5: return std::make_unique<LoaderScene5>();
+            case 6: return std::make_unique<LoaderScene6>();
+            case 7: return std::make_unique<LoaderScene7>();
+        }
+        
+        return nullptr;
+    }
+
+
+};  // namespace LNF
+
+
+#endif  // #ifndef LIBS_HEADER_LOADERS_H
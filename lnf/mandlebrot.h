@@ -2,8 +2,14 @@
 #define LIBS_HEADER_MANDLEBROT_H
 
 #include "constants.h"
+#include "fixed_point.h"
+#include "jobs.h"
 #include "jpeg.h"
+#include "simd.h"
 
+#include <algorithm>
+#include <cmath>
+#include <string>
 #include <vector>
 
 
@@ -35,15 +41,171 @@ namespace LNF
         return 0;
     }
     
+    
+    /*
+     Returns mandlebrot escape iteration count (or 0) for 4 points at once (one point per lane, in _pResults).
+     Lanes are masked out as they escape and the loop exits once all lanes are done. Orbits that return to within
+     _fPeriodEpsilon of an earlier point (Brent's cycle check) are periodic, i.e. interior points, and stop early.
+     */
+    inline void mandlebrot4(Double4 _cx, Double4 _cy, unsigned int _uMaxIterations, double _fPeriodEpsilon, int *_pResults)
+    {
+        const Double4 four(4.0);
+        const Double4 periodEpsilon2(_fPeriodEpsilon * _fPeriodEpsilon);
+        Double4 zx(0.0), zy(0.0);
+        Double4 px(0.0), py(0.0);
+        int iActive = 0xf;
+        unsigned int uNextCheck = 1;
+        
+        std::fill(_pResults, _pResults + 4, 0);
+        
+        for (unsigned int i = 0; i < _uMaxIterations; i++)
+        {
+            auto zxx = zx * zx;
+            auto zyy = zy * zy;
+            
+            int iEscaped = simdMoveMask((zxx + zyy) >= four) & iActive;
+            if (iEscaped != 0) {
+                for (int l = 0; l < 4; l++) {
+                    if ((iEscaped >> l) & 1) _pResults[l] = (int)i;
+                }
+                
+                iActive &= ~iEscaped;
+            }
+            
+            if (i > 0) {
+                auto dx = zx - px;
+                auto dy = zy - py;
+                iActive &= ~simdMoveMask((dx * dx + dy * dy) < periodEpsilon2);
+            }
+            
+            if (iActive == 0) {
+                break;
+            }
+            
+            if (i == uNextCheck) {
+                px = zx;
+                py = zy;
+                uNextCheck *= 2;
+            }
+            
+            auto zxy = zx * zy;
+            zy = zxy + zxy + _cy;
+            zx = zxx - zyy + _cx;
+        }
+    }
+    
+    
+    /*
+     Perturbation version of mandlebrot4() for deep zooms: lanes are offsets (_dcx, _dcy) from a reference point with
+     orbit (_pRefX[n], _pRefY[n]), n = [0.._iRefLength), computed at high precision. Lanes iterate their (small) orbit
+     offsets in double precision: dz' = (2Z + dz)dz + dc. A lane is rebased onto the start of the reference orbit when
+     its orbit gets closer to 0 than its offset (or the reference orbit ends), which avoids glitches from a single
+     reference. Same results and period check as mandlebrot4().
+     */
+    inline void mandlebrotPerturbed4(Double4 _dcx, Double4 _dcy, const double *_pRefX, const double *_pRefY, int _iRefLength,
+                                     unsigned int _uMaxIterations, double _fPeriodEpsilon, int *_pResults)
+    {
+        const Double4 four(4.0);
+        const Double4 periodEpsilon2(_fPeriodEpsilon * _fPeriodEpsilon);
+        Double4 dzx(0.0), dzy(0.0);
+        Double4 px(0.0), py(0.0);
+        int iActive = 0xf;
+        unsigned int uNextCheck = 1;
+        int ref[4] = {0, 0, 0, 0};
+        alignas(32) double refx[4];
+        alignas(32) double refy[4];
+        
+        std::fill(_pResults, _pResults + 4, 0);
+        
+        for (unsigned int i = 0; i < _uMaxIterations; i++)
+        {
+            int iRebase = 0;
+            for (int l = 0; l < 4; l++) {
+                refx[l] = _pRefX[ref[l]];
+                refy[l] = _pRefY[ref[l]];
+                iRebase |= (ref[l] == _iRefLength - 1) << l;
+            }
+            
+            auto rx = Double4::load(refx);
+            auto ry = Double4::load(refy);
+            auto zx = rx + dzx;
+            auto zy = ry + dzy;
+            auto r2 = zx * zx + zy * zy;
+            
+            int iEscaped = simdMoveMask(r2 >= four) & iActive;
+            if (iEscaped != 0) {
+                for (int l = 0; l < 4; l++) {
+                    if ((iEscaped >> l) & 1) _pResults[l] = (int)i;
+                }
+                
+                iActive &= ~iEscaped;
+            }
+            
+            if (i > 0) {
+                auto dx = zx - px;
+                auto dy = zy - py;
+                iActive &= ~simdMoveMask((dx * dx + dy * dy) < periodEpsilon2);
+            }
+            
+            if (iActive == 0) {
+                break;
+            }
+            
+            if (i == uNextCheck) {
+                px = zx;
+                py = zy;
+                uNextCheck *= 2;
+            }
+            
+            // rebase: dz = z, Z = Z[0] = 0
+            iRebase |= simdMoveMask(r2 < (dzx * dzx + dzy * dzy));
+            if (iRebase != 0) {
+                alignas(32) double mask[4];
+                for (int l = 0; l < 4; l++) {
+                    const bool bRebase = (iRebase >> l) & 1;
+                    mask[l] = bRebase ? -1.0 : 0.0;
+                    ref[l] = bRebase ? 0 : ref[l];
+                }
+                
+                auto rebase = Double4::load(mask) < Double4(0.0);
+                dzx = simdSelect(rebase, dzx, zx);
+                dzy = simdSelect(rebase, dzy, zy);
+                rx = simdSelect(rebase, rx, Double4(0.0));
+                ry = simdSelect(rebase, ry, Double4(0.0));
+            }
+            
+            auto ax = rx + rx + dzx;
+            auto ay = ry + ry + dzy;
+            auto ndzx = ax * dzx - ay * dzy + _dcx;
+            dzy = ax * dzy + ay * dzx + _dcy;
+            dzx = ndzx;
+            
+            for (int l = 0; l < 4; l++) {
+                ref[l]++;
+            }
+        }
+    }
+    
+    
     /*
         Mandlebrot fractal rendering.
         Use `setView(...) to set position and zoom level.
         Use `render(...)` and `writeToJpeg(...)` to render fractal and write to disk.
         For manually rendering fractal using normalised coordinates (x, y = [0..1, 0..1]),
         create object with `width,height = 1, 1` and then use `value(...)` to find iteration count.
+        
+        Rendering iterates 4 pixels at a time (SIMD lanes) and can be split into tiles that run on a worker pool.
+        Deep zooms (pixels smaller than DEEP_ZOOM_SCALE) use perturbation: one reference orbit, at the view center,
+        is computed with fixed point numbers and pixels iterate their offsets from it in double precision. Use the
+        decimal string version of `setView(...)` for centers that need more precision than a double.
      */
     class MandleBrot
     {
+     public:
+        static constexpr double DEEP_ZOOM_SCALE         = 1e-8;         // pixel size below which perturbation is used (direct double iteration loses accuracy)
+        static constexpr double PERIOD_EPSILON_SCALE    = 1e-3;         // period check distance (relative to pixel size)
+        static constexpr int    CENTER_LIMBS            = 16;           // fixed point view center (480 fraction bits)
+        
      public:
         /* _iWidth and _iHeight is size of output image. See `renderToJpeg`. */
         MandleBrot(int _iWidth, int _iHeight)
@@ -65,21 +227,29 @@ namespace LNF
         int bytesPerPixel() const {return 3;}
         int max_iterations() const {return m_iMaxIterations;}
         const unsigned char *image() const {return m_image.data();}
+        
+        /* true if the view is rendered with perturbation */
+        bool deep() const {return m_fScale < DEEP_ZOOM_SCALE;}
 
         /* Set position and zoom level, using Mandlebrot values. */
         void setView(double _fCx, double _fCy, double _fZoom, int _iMaxIterations)
         {
-            m_fZoom = _fZoom;
-            if (m_iWidth < m_iHeight) {
-                m_fScale = 1.0 / m_iWidth / m_fZoom;
-            }
-            else {
-                m_fScale = 1.0 / m_iHeight / m_fZoom;
+            setView(FixedPoint<CENTER_LIMBS>(_fCx), FixedPoint<CENTER_LIMBS>(_fCy), _fZoom, _iMaxIterations);
+        }
+        
+        /* Set position (decimal strings, e.g. "-0.743643887037158704752191506114774") and zoom level; returns false for invalid positions. */
+        bool setView(const std::string &_strCx, const std::string &_strCy, double _fZoom, int _iMaxIterations)
+        {
+            FixedPoint<CENTER_LIMBS> cx, cy;
+            if ( (FixedPoint<CENTER_LIMBS>::parse(_strCx.c_str(), cx) == false) ||
+                 (FixedPoint<CENTER_LIMBS>::parse(_strCy.c_str(), cy) == false) )
+            {
+                fprintf(stderr, "ERROR: invalid mandlebrot position '%s, %s'\n", _strCx.c_str(), _strCy.c_str());
+                return false;
             }
             
-            m_fPosX = _fCx - m_fScale*m_iWidth*0.5;
-            m_fPosY = _fCy - m_fScale*m_iHeight*0.5;
-            m_iMaxIterations = _iMaxIterations;
+            setView(cx, cy, _fZoom, _iMaxIterations);
+            return true;
         }
         
         /* Returns mandlebrot escape iteration count or 0 if it reached max iterations.
@@ -88,6 +258,14 @@ namespace LNF
          */
         int value(double _fPixelX, double _fPixelY) const
         {
+            if (deep() == true) {
+                int results[4];
+                mandlebrotPerturbed4(Double4((_fPixelX - m_iWidth * 0.5) * m_fScale), Double4((_fPixelY - m_iHeight * 0.5) * m_fScale),
+                                     m_refX.data(), m_refY.data(), (int)m_refX.size(),
+                                     m_iMaxIterations, m_fScale * PERIOD_EPSILON_SCALE, results);
+                return results[0];
+            }
+            
             return mandlebrot(_fPixelX * m_fScale + m_fPosX,
                               _fPixelY * m_fScale + m_fPosY,
                               m_iMaxIterations);
@@ -96,21 +274,24 @@ namespace LNF
         /* Render fractal to internal buffer. */
         void render()
         {
-            int ipx = 0;
-            unsigned char *pImage = m_image.data();
+            renderTile(0, 0, m_iWidth, m_iHeight);
+        }
+        
+        /* Render fractal to internal buffer, with tiles (_iTileSize x _iTileSize pixels) running on the worker pool. */
+        void render(WorkerPool &_pool, int _iTileSize = 64)
+        {
+            const int iTileSize = std::max(_iTileSize, 4);
+            TaskGroup group(_pool.jobs());
             
-            for (int y = 0; y < m_iHeight; y++)
-            {
-                for (int x = 0; x < m_iWidth; x++)
-                {
-                    int color = value((int)x, (int)y);
-                    
-                    // TODO: use proper palette (also scale according to zoom value)
-                    pImage[ipx++] = color << 4;
-                    pImage[ipx++] = color << 5;
-                    pImage[ipx++] = color << 6;
+            for (int y = 0; y < m_iHeight; y += iTileSize) {
+                for (int x = 0; x < m_iWidth; x += iTileSize) {
+                    group.run([this, x, y, iTileSize]() {
+                        renderTile(x, y, std::min(x + iTileSize, m_iWidth), std::min(y + iTileSize, m_iHeight));
+                    });
                 }
             }
+            
+            group.wait();
         }
         
         /* Write last render to disk */
@@ -119,6 +300,102 @@ namespace LNF
             writeJpegFile(_pszFilename, m_iWidth, m_iHeight, m_image.data(), 100);
         }
          
+     private:
+        void setView(const FixedPoint<CENTER_LIMBS> &_cx, const FixedPoint<CENTER_LIMBS> &_cy, double _fZoom, int _iMaxIterations)
+        {
+            m_fZoom = _fZoom;
+            if (m_iWidth < m_iHeight) {
+                m_fScale = 1.0 / m_iWidth / m_fZoom;
+            }
+            else {
+                m_fScale = 1.0 / m_iHeight / m_fZoom;
+            }
+            
+            m_centerX = _cx;
+            m_centerY = _cy;
+            m_fPosX = _cx.toDouble() - m_fScale*m_iWidth*0.5;
+            m_fPosY = _cy.toDouble() - m_fScale*m_iHeight*0.5;
+            m_iMaxIterations = _iMaxIterations;
+            
+            m_refX.clear();
+            m_refY.clear();
+            if (deep() == true) {
+                // fixed point precision: pixel size plus 64 bits
+                if (-log2(m_fScale) + 64 <= FixedPoint<8>::FRACTION_BITS) {
+                    referenceOrbit<8>();
+                }
+                else {
+                    referenceOrbit<CENTER_LIMBS>();
+                }
+            }
+        }
+        
+        // reference orbit at view center (until it escapes or reaches max iterations)
+        template <int LIMBS>
+        void referenceOrbit()
+        {
+            using fixed_type = FixedPoint<LIMBS>;
+            const fixed_type cx(m_centerX), cy(m_centerY);
+            fixed_type zx, zy;
+            
+            m_refX.push_back(0.0);
+            m_refY.push_back(0.0);
+            
+            for (int i = 0; i < m_iMaxIterations; i++) {
+                fixed_type zxx = zx * zx;
+                fixed_type zyy = zy * zy;
+                fixed_type zxy = zx * zy;
+                zy = zxy + zxy + cy;
+                zx = zxx - zyy + cx;
+                
+                const double fZx = zx.toDouble();
+                const double fZy = zy.toDouble();
+                m_refX.push_back(fZx);
+                m_refY.push_back(fZy);
+                
+                if (fZx * fZx + fZy * fZy >= 4) {
+                    break;
+                }
+            }
+        }
+        
+        // renders pixels [_iX0, _iX1) x [_iY0, _iY1), 4 pixels at a time
+        void renderTile(int _iX0, int _iY0, int _iX1, int _iY1)
+        {
+            const bool bDeep = deep();
+            const double fPeriodEpsilon = m_fScale * PERIOD_EPSILON_SCALE;
+            alignas(32) double cx[4];
+            int results[4];
+            
+            for (int y = _iY0; y < _iY1; y++)
+            {
+                unsigned char *pImage = m_image.data() + ((size_t)y * m_iWidth + _iX0) * 3;
+                
+                for (int x = _iX0; x < _iX1; x += 4)
+                {
+                    if (bDeep == true) {
+                        for (int l = 0; l < 4; l++) cx[l] = (x + l - m_iWidth * 0.5) * m_fScale;
+                        mandlebrotPerturbed4(Double4::load(cx), Double4((y - m_iHeight * 0.5) * m_fScale),
+                                             m_refX.data(), m_refY.data(), (int)m_refX.size(),
+                                             m_iMaxIterations, fPeriodEpsilon, results);
+                    }
+                    else {
+                        for (int l = 0; l < 4; l++) cx[l] = (x + l) * m_fScale + m_fPosX;
+                        mandlebrot4(Double4::load(cx), Double4(y * m_fScale + m_fPosY), m_iMaxIterations, fPeriodEpsilon, results);
+                    }
+                    
+                    for (int l = 0; (l < 4) && (x + l < _iX1); l++) {
+                        int color = results[l];
+                        
+                        // TODO: use proper palette (also scale according to zoom value)
+                        *pImage++ = color << 4;
+                        *pImage++ = color << 5;
+                        *pImage++ = color << 6;
+                    }
+                }
+            }
+        }
+        
      private:
         int                         m_iWidth;
         int                         m_iHeight;
@@ -128,6 +405,10 @@ namespace LNF
         double                      m_fPosY;
         double                      m_fZoom;
         double                      m_fScale;
+        FixedPoint<CENTER_LIMBS>    m_centerX;
+        FixedPoint<CENTER_LIMBS>    m_centerY;
+        std::vector<double>         m_refX;             // reference orbit (deep zooms)
+        std::vector<double>         m_refY;
     };
 
 
@@ -0,0 +1,239 @@
+#ifndef LIBS_HEADER_MAPPED_FILE_H
+#define LIBS_HEADER_MAPPED_FILE_H
+
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace LNF
+{
+    /*
+     Read-only memory mapped file.
+     Files are mapped once per path and shared (the mapping is released when the last user lets go).
+     On Windows the file is read into memory instead.
+     */
+    class MappedFile
+    {
+     public:
+        ~MappedFile() {
+#if !defined(_WIN32)
+            if (m_pData != nullptr) {
+                munmap(const_cast<uint8_t*>(m_pData), m_uSize);
+            }
+#endif
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        /* returns shared mapping of file (nullptr if the file could not be opened) */
+        static std::shared_ptr<const MappedFile> open(const std::string &_strPath) {
+            static std::mutex mutex;
+            static std::map<std::string, std::weak_ptr<const MappedFile>> files;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            auto pFile = files[_strPath].lock();
+            if (pFile == nullptr) {
+                pFile = std::shared_ptr<const MappedFile>(new MappedFile(_strPath));
+                if (pFile->data() == nullptr) {
+                    files.erase(_strPath);
+                    return nullptr;
+                }
+
+                files[_strPath] = pFile;
+            }
+
+            return pFile;
+        }
+
+        const uint8_t *data() const {
+            return m_pData;
+        }
+
+        size_t size() const {
+            return m_uSize;
+        }
+
+        const std::string &path() const {
+            return m_strPath;
+        }
+
+     private:
+        explicit MappedFile(const std::string &_strPath)
+            :m_strPath(_strPath),
+             m_pData(nullptr),
+             m_uSize(0)
+        {
+#if defined(_WIN32)
+            std::ifstream file(_strPath, std::ios::binary | std::ios::ate);
+            if (file.good() == true) {
+                m_buffer.resize((size_t)file.tellg());
+                file.seekg(0);
+                if ( (m_buffer.empty() == false) && (file.read((char*)m_buffer.data(), m_buffer.size()).good() == true) ) {
+                    m_pData = m_buffer.data();
+                    m_uSize = m_buffer.size();
+                }
+            }
+#else
+            int fd = ::open(_strPath.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return;
+            }
+
+            struct stat st;
+            if ( (fstat(fd, &st) == 0) && (st.st_size > 0) ) {
+                void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    m_pData = static_cast<const uint8_t*>(p);
+                    m_uSize = (size_t)st.st_size;
+                }
+            }
+
+            ::close(fd);
+#endif
+        }
+
+     private:
+        std::string             m_strPath;
+        const uint8_t           *m_pData;
+        size_t                  m_uSize;
+#if defined(_WIN32)
+        std::vector<uint8_t>    m_buffer;
+#endif
+    };
+
+
+    /* returns file size and modification time (for cache invalidation); false if the file does not exist */
+    inline bool fileStamp(const std::string &_strPath, uint64_t &_uSize, int64_t &_iTime) {
+#if defined(_WIN32)
+        std::ifstream file(_strPath, std::ios::binary | std::ios::ate);
+        if (file.good() == false) {
+            return false;
+        }
+
+        _uSize = (uint64_t)file.tellg();
+        _iTime = 0;
+#else
+        struct stat st;
+        if (stat(_strPath.c_str(), &st) != 0) {
+            return false;
+        }
+
+        _uSize = (uint64_t)st.st_size;
+        _iTime = (int64_t)st.st_mtime;
+#endif
+        return true;
+    }
+
+
+    /*
+     Array that either owns its elements or refers to external (e.g. memory mapped) data.
+     Read access is the same for both; owned() gives mutable access (mapped data is copied first).
+     */
+    template <typename value_type>
+    class DataArray
+    {
+     public:
+        DataArray()
+            :m_pMapped(nullptr),
+             m_uMappedSize(0)
+        {}
+
+        DataArray &operator=(std::vector<value_type> &&_values) {
+            unmap();
+            m_owned = std::move(_values);
+            return *this;
+        }
+
+        DataArray &operator=(const std::vector<value_type> &_values) {
+            unmap();
+            m_owned = _values;
+            return *this;
+        }
+
+        /* refer to external data (kept alive by _pOwner) */
+        void map(const value_type *_pData, size_t _uSize, const std::shared_ptr<const void> &_pOwner) {
+            m_owned = std::vector<value_type>();
+            m_pMapped = _pData;
+            m_uMappedSize = _uSize;
+            m_pOwner = _pOwner;
+        }
+
+        bool mapped() const {
+            return m_pMapped != nullptr;
+        }
+
+        /* returns owned elements (mapped data is copied on first use) */
+        std::vector<value_type> &owned() {
+            if (m_pMapped != nullptr) {
+                std::vector<value_type> values(m_pMapped, m_pMapped + m_uMappedSize);
+                unmap();
+                m_owned = std::move(values);
+            }
+
+            return m_owned;
+        }
+
+        void clear() {
+            unmap();
+            m_owned.clear();
+        }
+
+        const value_type *data() const {
+            return m_pMapped != nullptr ? m_pMapped : m_owned.data();
+        }
+
+        size_t size() const {
+            return m_pMapped != nullptr ? m_uMappedSize : m_owned.size();
+        }
+
+        bool empty() const {
+            return size() == 0;
+        }
+
+        const value_type &operator[](size_t _uIndex) const {
+            return data()[_uIndex];
+        }
+
+        const value_type *begin() const {
+            return data();
+        }
+
+        const value_type *end() const {
+            return data() + size();
+        }
+
+     private:
+        void unmap() {
+            m_pMapped = nullptr;
+            m_uMappedSize = 0;
+            m_pOwner = nullptr;
+        }
+
+     private:
+        std::vector<value_type>         m_owned;
+        const value_type                *m_pMapped;
+        size_t                          m_uMappedSize;
+        std::shared_ptr<const void>     m_pOwner;
+    };
+
+
+};  // namespace LNF
+
+
+#endif  // #ifndef LIBS_HEADER_MAPPED_FILE_H
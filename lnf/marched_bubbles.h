@@ -15,16 +15,20 @@ namespace LNF
     class MarchedBubbles        : public Primitive
     {
      public:
-        MarchedBubbles(const Vec &_size, const Material *_pMaterial)
+        MarchedBubbles(const Vec &_size, const Material *_pMaterial, const MarchSettings &_marchSettings = MarchSettings())
             :m_bounds(-_size * 0.5f, _size * 0.5f),
              m_pMaterial(_pMaterial),
-             m_fSize(_size.size() * 0.5f)
+             m_fSize(_size.size() * 0.5f),
+             m_sdf(0, m_fSize * 2.0f),
+             m_marchSettings(_marchSettings)
         {}
 
-        MarchedBubbles(float _fSize, const Material *_pMaterial)
+        MarchedBubbles(float _fSize, const Material *_pMaterial, const MarchSettings &_marchSettings = MarchSettings())
             :m_bounds(boxVec(-_fSize*0.5f), boxVec(_fSize*0.5f)),
              m_pMaterial(_pMaterial),
-             m_fSize(_fSize * 0.5f)
+             m_fSize(_fSize * 0.5f),
+             m_sdf(0, m_fSize * 2.0f),
+             m_marchSettings(_marchSettings)
         {}
         
         /* Returns the material used for rendering, etc. */
@@ -39,9 +43,9 @@ namespace LNF
                 // try to hit surface inside (using raymarching)
                 bool is_hit = check_marched_hit(_hit,
                                                 bi.m_tmax,
-                                                [this](const Vec &_p){
-                                                    return sdfBubbles(_p, 0, m_fSize*2.0f);
-                                                });
+                                                m_sdf,
+                                                m_marchSettings,
+                                                &m_marchStats);
 
                 if ( (is_hit == true) &&
                      (_hit.m_priRay.inside(_hit.m_fPositionOnRay) == true) )
@@ -64,13 +68,16 @@ namespace LNF
         virtual const Bounds &bounds() const override {
             return  m_bounds;
         }
+        
+        /* returns march steps per hit stats */
+        const MarchStats &marchStats() const {
+            return m_marchStats;
+        }
 
      protected:
         // get normal from surface function
         Vec surfaceNormal(const Vec &_p) const {
-            return LNF::surfaceNormal(_p, [this](const Vec &_x){
-                return sdfBubbles(_x, 0, m_fSize * 2.0f);
-            });
+            return LNF::surfaceNormal(_p, m_sdf);
         }
 
         // calc surface UV
@@ -83,6 +90,9 @@ namespace LNF
         Bounds                 m_bounds;
         const Material         *m_pMaterial;
         float                  m_fSize;
+        SdfBubbles             m_sdf;
+        MarchSettings          m_marchSettings;
+        mutable MarchStats     m_marchStats;
     };
 
 };  // namespace LNF
@@ -18,15 +18,24 @@ namespace LNF
         FakeAmbientOcclusion()
         {}
         
-        /* Returns the scattered ray at the intersection point. */
+        /* Returns the material type name (counters). */
+        virtual const char *name() const override {return "fake_ambient_occlusion";}
+        
+        /* Returns the scattered ray at the intersection point (cosine weighted). */
         virtual ScatteredRay scatter(const Intersect &_hit) const override {
-            auto color = Color(_hit.m_uMarchDepth*0.005f,
-                               _hit.m_uMarchDepth*0.005f,
-                               _hit.m_uMarchDepth*0.005f,
-                               Color::OPERATION::CLAMP);
-            
-            auto scatteredDirection = (_hit.m_normal + randomUnitSphere()).normalized();
-            return ScatteredRay(Ray(_hit.m_position, scatteredDirection), color, Color());
+            auto scatteredDirection = (_hit.m_normal + randomUnitSphereSurface()).normalized();
+            return ScatteredRay(Ray(_hit.m_position, scatteredDirection), albedo(_hit), Color());
+        }
+        
+        /* Returns true if the material is a lambertian diffuser. */
+        virtual bool isLambertian() const override {return true;}
+        
+        /* Returns the diffuse reflectance at the intersection point. */
+        virtual Color albedo(const Intersect &_hit) const override {
+            return Color(_hit.m_uMarchDepth*0.005f,
+                         _hit.m_uMarchDepth*0.005f,
+                         _hit.m_uMarchDepth*0.005f,
+                         Color::OPERATION::CLAMP);
         }
 
      private:
@@ -40,6 +49,9 @@ namespace LNF
         MetalIterations()
         {}
         
+        /* Returns the material type name (counters). */
+        virtual const char *name() const override {return "metal_iterations";}
+        
         /* Returns the scattered ray at the intersection point. */
         virtual ScatteredRay scatter(const Intersect &_hit) const override {
             float scale = 3.0f;
@@ -65,6 +77,9 @@ namespace LNF
         Glow()
         {}
         
+        /* Returns the material type name (counters). */
+        virtual const char *name() const override {return "glow";}
+        
         /* Returns the scattered ray at the intersection point. */
         virtual ScatteredRay scatter(const Intersect &_hit) const override {
             auto color = (Color(0.0f, 0.21f, 0.11f) * _hit.m_uIterations).wrap();
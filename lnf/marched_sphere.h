@@ -15,18 +15,20 @@ namespace LNF
     class MarchedSphere        : public Primitive
     {
      public:
-        MarchedSphere(const Vec &_size, const Material *_pMaterial, float _fWaveRatio)
+        MarchedSphere(const Vec &_size, const Material *_pMaterial, float _fWaveRatio, const MarchSettings &_marchSettings = MarchSettings())
             :m_bounds(-_size * 0.5f, _size * 0.5f),
              m_pMaterial(_pMaterial),
              m_fSize(_size.size() * 0.5f),
-             m_fWaveRatio(_fWaveRatio)
+             m_fWaveRatio(_fWaveRatio),
+             m_marchSettings(_marchSettings)
         {}
 
-        MarchedSphere(float _fSize, const Material *_pMaterial, float _fWaveRatio)
+        MarchedSphere(float _fSize, const Material *_pMaterial, float _fWaveRatio, const MarchSettings &_marchSettings = MarchSettings())
             :m_bounds(boxVec(-_fSize*0.5f), boxVec(_fSize*0.5f)),
              m_pMaterial(_pMaterial),
              m_fSize(_fSize * 0.5f),
-             m_fWaveRatio(_fWaveRatio)
+             m_fWaveRatio(_fWaveRatio),
+             m_marchSettings(_marchSettings)
         {}
         
         /* Returns the material used for rendering, etc. */
@@ -45,7 +47,9 @@ namespace LNF
                                                     return sdfSphereDeformed(_p,
                                                                              m_fSize * (1 - m_fWaveRatio),
                                                                              m_fSize * m_fWaveRatio);
-                                                });
+                                                },
+                                                m_marchSettings,
+                                                &m_marchStats);
 
                 if ( (is_hit == true) &&
                      (_hit.m_priRay.inside(_hit.m_fPositionOnRay) == true) )
@@ -68,6 +72,11 @@ namespace LNF
         virtual const Bounds &bounds() const override {
             return  m_bounds;
         }
+        
+        /* returns march steps per hit stats */
+        const MarchStats &marchStats() const {
+            return m_marchStats;
+        }
 
      protected:
         // get normal from surface function
@@ -90,6 +99,8 @@ namespace LNF
         const Material         *m_pMaterial;
         float                  m_fSize;
         float                  m_fWaveRatio;
+        MarchSettings          m_marchSettings;
+        mutable MarchStats     m_marchStats;
     };
 
 };  // namespace LNF
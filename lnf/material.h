@@ -17,6 +17,24 @@ namespace LNF
         
         /* Returns the scattered ray at the intersection point. */
         virtual ScatteredRay scatter(const Intersect &_hit) const = 0;
+        
+        /* Returns true if the material emits light (scene keeps a light list of emissive instances). */
+        virtual bool isEmissive() const {return false;}
+        
+        /* Returns the light emitted at the intersection point (only m_priRay, m_position and m_normal are required). */
+        virtual Color emitted(const Intersect &_hit) const {return Color();}
+        
+        /*
+         Returns true if the material is a lambertian diffuser (scatter() is cosine weighted and the scattered
+         color is the albedo). Tracers sample lights directly on these surfaces.
+         */
+        virtual bool isLambertian() const {return false;}
+        
+        /* Returns the diffuse reflectance at the intersection point (lambertian materials only). */
+        virtual Color albedo(const Intersect &_hit) const {return Color();}
+        
+        /* Returns the material type name (a string literal; scatter calls are counted per type). */
+        virtual const char *name() const {return "material";}
     };
 
 };  // namespace LNF
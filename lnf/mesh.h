@@ -3,11 +3,29 @@
 
 #include "bvh.h"
 #include "constants.h"
+#include "counters.h"
+#include "mapped_file.h"
 #include "primitive.h"
 #include "material.h"
+#include "simd.h"
 #include "vec3.h"
 #include "uv.h"
 
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
 
 namespace LNF
 {
@@ -49,6 +67,93 @@ namespace LNF
     }
 
 
+    /*
+     Packet of N triangles (v0, edge1, edge2 in SoA form) for SIMD intersect checks.
+     Unused lanes have zero edges and never intersect.
+     */
+    template <int N>
+    struct alignas(32) TrianglePacket
+    {
+        float       m_v0x[N];
+        float       m_v0y[N];
+        float       m_v0z[N];
+        float       m_e1x[N];
+        float       m_e1y[N];
+        float       m_e1z[N];
+        float       m_e2x[N];
+        float       m_e2y[N];
+        float       m_e2z[N];
+        uint32_t    m_uIndex[N];      // triangle index in mesh
+    };
+
+
+    /*
+     Triangle packet intersect check (Moller-Trumbore on all lanes).
+     Updates position on ray (t), UV (barycentric) and triangle index if a lane is closer than _fMaxDist.
+     Returns true on intersect.
+     */
+    template <int N>
+    bool trianglePacketIntersect(float &_fPositionOnRay, Uv &_uv, uint32_t &_uIndex,
+                                 const Ray &_ray, float _fMaxDist, const TrianglePacket<N> &_packet) {
+        using simd_type = SimdFloat<N>;
+        const float EPSILON = 0.000001f;
+        
+        const simd_type dx(_ray.m_direction.x()), dy(_ray.m_direction.y()), dz(_ray.m_direction.z());
+        const simd_type e1x = simd_type::load(_packet.m_e1x), e1y = simd_type::load(_packet.m_e1y), e1z = simd_type::load(_packet.m_e1z);
+        const simd_type e2x = simd_type::load(_packet.m_e2x), e2y = simd_type::load(_packet.m_e2y), e2z = simd_type::load(_packet.m_e2z);
+        
+        // h = dir x e2, a = e1 . h
+        const simd_type hx = dy * e2z - dz * e2y;
+        const simd_type hy = dz * e2x - dx * e2z;
+        const simd_type hz = dx * e2y - dy * e2x;
+        const simd_type a = e1x * hx + e1y * hy + e1z * hz;
+        auto mask = simdAbs(a) >= simd_type(EPSILON);
+        if (simdMoveMask(mask) == 0) {
+            return false;   // rays parallel to planes
+        }
+        
+        const simd_type f = simd_type(1.0f) / a;
+        const simd_type sx = simd_type(_ray.m_origin.x()) - simd_type::load(_packet.m_v0x);
+        const simd_type sy = simd_type(_ray.m_origin.y()) - simd_type::load(_packet.m_v0y);
+        const simd_type sz = simd_type(_ray.m_origin.z()) - simd_type::load(_packet.m_v0z);
+        const simd_type u = f * (sx * hx + sy * hy + sz * hz);
+        
+        // q = s x e1
+        const simd_type qx = sy * e1z - sz * e1y;
+        const simd_type qy = sz * e1x - sx * e1z;
+        const simd_type qz = sx * e1y - sy * e1x;
+        const simd_type v = f * (dx * qx + dy * qy + dz * qz);
+        const simd_type t = f * (e2x * qx + e2y * qy + e2z * qz);
+        
+        const simd_type zero(0.0f), one(1.0f);
+        mask = mask & (u >= zero) & (u <= one) & (v >= zero) & (u + v <= one) &
+               (t >= simd_type(_ray.m_fMinDist)) & (t <= simd_type(_fMaxDist));
+        
+        int bits = simdMoveMask(mask);
+        if (bits == 0) {
+            return false;
+        }
+        
+        // closest lane
+        alignas(32) float ts[N], us[N], vs[N];
+        t.store(ts);
+        u.store(us);
+        v.store(vs);
+        
+        int iClosest = -1;
+        for (int i = 0; bits != 0; i++, bits >>= 1) {
+            if ( ((bits & 1) != 0) && ((iClosest < 0) || (ts[i] < ts[iClosest])) ) {
+                iClosest = i;
+            }
+        }
+        
+        _fPositionOnRay = ts[iClosest];
+        _uv = Uv(us[iClosest], vs[iClosest]);   // NOTE: Barycentric UV (u + v + w = 1)
+        _uIndex = _packet.m_uIndex[iClosest];
+        return true;
+    }
+
+
     /* Mesh defined by vertices, triangle indices and a material */
     class Mesh        : public Primitive
     {
@@ -67,6 +172,9 @@ namespace LNF
             Vec         m_normal;
         };
         
+        static const int PACKET_WIDTH = 4;
+        using packet_type = TrianglePacket<PACKET_WIDTH>;
+        
      public:
         Mesh(const Material *_pMaterial)
             :m_pMaterial(_pMaterial),
@@ -81,11 +189,26 @@ namespace LNF
         
         /* Quick node hit check (populates at least node and time properties of intercept) */
         virtual bool hit(Intersect &_hit) const override {
+            ScopedCount triangles(Counter::TRIANGLE_TESTS);
             float fPositionOnRay = -1;
             int hitIndex = 0;
             Uv hitUv;
+            bool bHit = false;
 
-            bool bHit = checkBvhHit(fPositionOnRay, hitIndex, hitUv, m_bvhRoot, _hit.m_priRay);
+            // leaf ranges index into triangle packets
+            m_bvh.traverse(_hit.m_priRay, _hit.m_priRay.m_fMaxDist,
+                           [&](uint32_t _uOffset, uint32_t _uCount, float &_fMaxDist) {
+                               for (uint32_t i = _uOffset; i < _uOffset + _uCount; i++) {
+                                   uint32_t uIndex = 0;
+                                   triangles.add(PACKET_WIDTH);
+                                   if (trianglePacketIntersect(fPositionOnRay, hitUv, uIndex, _hit.m_priRay, _fMaxDist, m_packets[i]) == true) {
+                                       _fMaxDist = fPositionOnRay;
+                                       hitIndex = (int)uIndex;
+                                       bHit = true;
+                                   }
+                               }
+                           });
+            
             if (bHit == true) {
                 _hit.m_fPositionOnRay = fPositionOnRay;
                 _hit.m_uTriangleIndex = hitIndex;
@@ -96,6 +219,25 @@ namespace LNF
             return false;
         }
 
+        /* Occlusion check (stops at first triangle hit) */
+        virtual bool occluded(const Ray &_ray, float _fMaxDist) const override {
+            ScopedCount triangles(Counter::TRIANGLE_TESTS);
+            return m_bvh.traverseAny(_ray, _fMaxDist,
+                                     [&](uint32_t _uOffset, uint32_t _uCount, float _fDist) {
+                                         float fPositionOnRay = -1;
+                                         uint32_t uIndex = 0;
+                                         Uv uv;
+                                         for (uint32_t i = _uOffset; i < _uOffset + _uCount; i++) {
+                                             triangles.add(PACKET_WIDTH);
+                                             if (trianglePacketIntersect(fPositionOnRay, uv, uIndex, _ray, _fDist, m_packets[i]) == true) {
+                                                 return true;
+                                             }
+                                         }
+                                         
+                                         return false;
+                                     });
+        }
+        
         /* Triangle intersect check */
         bool checkTriangleHit(float &_fPositionOnRay, int &_hitIndex, Uv &_hitUv, const Triangle *_pTriangle, const Ray &_ray) const {
             const auto &v0 = m_vertices[_pTriangle->m_v[0]];
@@ -119,31 +261,6 @@ namespace LNF
             return false;
         }
         
-        /* Search for best hit through BVH */
-        bool checkBvhHit(float &_fPositionOnRay, int &_hitIndex, Uv &_hitUv,
-                         const std::unique_ptr<BvhNode<Triangle>> &_pNode,
-                         const Ray &_ray) const {
-            bool bHit = false;
-            
-            if (_pNode->empty() == false) {
-                for (const auto &pTriangle : _pNode->m_primitives) {
-                    bHit |= checkTriangleHit(_fPositionOnRay, _hitIndex, _hitUv, pTriangle, _ray);
-                }
-            }
-
-            if ( (_pNode->m_left != nullptr) &&
-                 (_pNode->m_left->intersect(_ray) == true) ) {
-                bHit |= checkBvhHit(_fPositionOnRay, _hitIndex, _hitUv, _pNode->m_left, _ray);
-            }
-            
-            if ( (_pNode->m_right != nullptr) &&
-                 (_pNode->m_right->intersect(_ray) == true) ) {
-                bHit |= checkBvhHit(_fPositionOnRay, _hitIndex, _hitUv, _pNode->m_right, _ray);
-            }
-            
-            return bHit;
-        }
-
         /* Completes the node intersect properties. */
         virtual Intersect &intersect(Intersect &_hit) const override {
             const auto &t = m_triangles[_hit.m_uTriangleIndex];
@@ -152,7 +269,6 @@ namespace LNF
             const auto &v2 = m_vertices[t.m_v[2]];
             
             _hit.m_position = _hit.m_priRay.position(_hit.m_fPositionOnRay);
-            _hit.m_bInside = (_hit.m_normal * _hit.m_priRay.m_direction) >= 0;
             
             // interpolate vertex normals (from hit barycentric uv)
             if (m_bUseVertexNormals == true) {
@@ -164,6 +280,8 @@ namespace LNF
                 _hit.m_normal = t.m_normal;
             }
 
+            _hit.m_bInside = (_hit.m_normal * _hit.m_priRay.m_direction) >= 0;
+
             // calc texture coords (from hit barycentric uv)
             _hit.m_uv = _hit.m_uv.u() * v1.m_uv +
                         _hit.m_uv.v() * v2.m_uv +
@@ -189,10 +307,16 @@ namespace LNF
             m_triangles = std::forward<triangles_type>(_triangles);
         }
 
+        /* use vertex normals (with interpolation), e.g. if normals were loaded with the vertices */
+        void setUseVertexNormals(bool _bUseVertexNormals) {
+            m_bUseVertexNormals = _bUseVertexNormals;
+        }
+
         /* calc triangle normals */
         void buildTriangleNormals() {
-            for (size_t i = 0; i < m_triangles.size(); i++) {
-                auto &t = m_triangles[i];
+            auto &triangles = m_triangles.owned();
+            for (size_t i = 0; i < triangles.size(); i++) {
+                auto &t = triangles[i];
                 const auto &v0 = m_vertices[t.m_v[0]].m_v;
                 const auto &v1 = m_vertices[t.m_v[1]].m_v;
                 const auto &v2 = m_vertices[t.m_v[2]].m_v;
@@ -210,24 +334,23 @@ namespace LNF
         void buildVertexNormals() {
             m_bUseVertexNormals = true;
             
-            for (size_t i = 0; i < m_vertices.size(); i++) {
-                auto &v = m_vertices[i];
+            // accumulate triangle normals on their vertices (single pass over triangles)
+            auto &vertices = m_vertices.owned();
+            std::vector<int> counts(vertices.size(), 0);
+            for (auto &v : vertices) {
                 v.m_normal = Vec();
-                int count = 0;
-                
-                for (size_t j = 0; j < m_triangles.size(); j++) {
-                    auto &t = m_triangles[j];
-                    
-                    for (size_t k = 0; k < 3; k++) {
-                        if (i == t.m_v[k]) {
-                            v.m_normal += t.m_normal;
-                            count++;
-                        }
-                    }
+            }
+            
+            for (const auto &t : m_triangles) {
+                for (size_t k = 0; k < 3; k++) {
+                    vertices[t.m_v[k]].m_normal += t.m_normal;
+                    counts[t.m_v[k]]++;
                 }
-                
-                if (count > 0) {
-                    v.m_normal /= (float)count;
+            }
+            
+            for (size_t i = 0; i < vertices.size(); i++) {
+                if (counts[i] > 0) {
+                    vertices[i].m_normal /= (float)counts[i];
                 }
             }
         }
@@ -242,8 +365,9 @@ namespace LNF
                 }
 
                 // calc triangle bounds
-                for (size_t i = 0; i < m_triangles.size(); i++) {
-                    auto &t = m_triangles[i];
+                auto &triangles = m_triangles.owned();
+                for (size_t i = 0; i < triangles.size(); i++) {
+                    auto &t = triangles[i];
                     const auto &v0 = m_vertices[t.m_v[0]].m_v;
                     const auto &v1 = m_vertices[t.m_v[1]].m_v;
                     const auto &v2 = m_vertices[t.m_v[2]].m_v;
@@ -257,17 +381,287 @@ namespace LNF
         }
 
         /* build acceleration structures etc. */
-        void buildBvh() {
+        void buildBvh(BvhBuildMethod _method = BvhBuildMethod::SAH, BvhWidth _width = BvhWidth::WIDE4) {
             std::vector<const Triangle*> trianglePtrs = getTrianglePtrs();
-            m_bvhRoot = buildBvhRoot<4>(trianglePtrs, 16);
+            Arena buildArena;
+            auto pRoot = buildBvhRoot<4>(buildArena, trianglePtrs, 16, _method);
+            m_bvhStats = LNF::bvhStats(pRoot);
+            m_bvh.build(pRoot, _width);
+            
+            // reorder triangles to match BVH leaves (leaf ranges then index directly into triangle list)
+            std::vector<Triangle> triangles;
+            triangles.reserve(m_triangles.size());
+            for (const auto &pTriangle : m_bvh.primitives()) {
+                triangles.push_back(*pTriangle);
+            }
+            
+            m_triangles = std::move(triangles);
+            
+            // pack leaf triangles (leaf ranges are remapped to packet ranges)
+            auto &packets = m_packets.owned();
+            packets.clear();
+            m_bvh.remapLeaves([this, &packets](uint32_t &_uOffset, uint32_t &_uCount) {
+                                  uint32_t uFirstPacket = (uint32_t)packets.size();
+                                  for (uint32_t i = 0; i < _uCount; i += PACKET_WIDTH) {
+                                      packets.push_back(buildPacket(_uOffset + i, std::min(_uCount - i, (uint32_t)PACKET_WIDTH)));
+                                  }
+                                  
+                                  _uCount = (uint32_t)packets.size() - uFirstPacket;
+                                  _uOffset = uFirstPacket;
+                              });
+            
+            m_bvh.releasePrimitives();
+        }
+        
+        /* returns BVH tree cost, depth and leaf size stats (from last build) */
+        const BvhStats &bvhStats() const {
+            return m_bvhStats;
+        }
+
+        /* mesh data (triangles are in BVH leaf order once the BVH is built) */
+        const DataArray<Vertex> &vertices() const {return m_vertices;}
+        const DataArray<Triangle> &triangles() const {return m_triangles;}
+        const FlatBvh<Triangle> &bvh() const {return m_bvh;}
+        bool useVertexNormals() const {return m_bUseVertexNormals;}
+
+        /* returns the triangle range of a built BVH leaf (leaf ranges refer to packets; unused packet lanes repeat their first triangle) */
+        void leafTriangles(uint32_t _uOffset, uint32_t _uCount, uint32_t &_uFirst, uint32_t &_uTriangleCount) const {
+            const auto &last = m_packets[_uOffset + _uCount - 1];
+            uint32_t uLastCount = 1;
+            while ( (uLastCount < (uint32_t)PACKET_WIDTH) && (last.m_uIndex[uLastCount] == last.m_uIndex[0] + uLastCount) ) {
+                uLastCount++;
+            }
+
+            _uFirst = m_packets[_uOffset].m_uIndex[0];
+            _uTriangleCount = (_uCount - 1) * PACKET_WIDTH + uLastCount;
         }
 
+        /* returns memory used by the mesh data and BVH nodes (bytes) */
+        size_t memoryUsage() const {
+            return m_vertices.size() * sizeof(Vertex) + m_triangles.size() * sizeof(Triangle) + m_packets.size() * sizeof(packet_type) +
+                   m_bvh.nodes().size() * sizeof(FlatBvhNode) + m_bvh.wide4().nodes().size() * sizeof(WideBvhNode<4>) +
+                   m_bvh.wide8().nodes().size() * sizeof(WideBvhNode<8>);
+        }
+
+        /*
+         Writes the built mesh (vertices, triangles, packets and BVH nodes) to a binary cache file that can be used in place with mapCache().
+         _uSourceSize and _iSourceTime identify the source file (cache is invalid once the source changes).
+         The file is written to a temporary path first (unique per process and call) and then renamed, so readers never see partial files.
+         */
+        bool writeCache(const std::string &_strPath, uint64_t _uSourceSize, int64_t _iSourceTime) const {
+            CacheHeader header = cacheHeader(_uSourceSize, _iSourceTime);
+            header.m_bounds = m_bounds;
+            header.m_uUseVertexNormals = m_bUseVertexNormals ? 1 : 0;
+            header.m_uBvhDepth[0] = (uint32_t)m_bvh.depth();
+            header.m_uBvhDepth[1] = (uint32_t)m_bvh.wide4().depth();
+            header.m_uBvhDepth[2] = (uint32_t)m_bvh.wide8().depth();
+            
+            const void *sections[CACHE_SECTIONS] = {m_vertices.data(), m_triangles.data(), m_packets.data(),
+                                                    m_bvh.nodes().data(), m_bvh.wide4().nodes().data(), m_bvh.wide8().nodes().data()};
+            const size_t counts[CACHE_SECTIONS] = {m_vertices.size(), m_triangles.size(), m_packets.size(),
+                                                   m_bvh.nodes().size(), m_bvh.wide4().nodes().size(), m_bvh.wide8().nodes().size()};
+            
+            uint64_t uOffset = cacheAlign(sizeof(CacheHeader));
+            for (int i = 0; i < CACHE_SECTIONS; i++) {
+                header.m_sections[i] = {uOffset, counts[i]};
+                uOffset = cacheAlign(uOffset + counts[i] * header.m_uSizes[i + 1]);
+            }
+            
+            const std::string strTempPath = cacheTempPath(_strPath);
+            FILE *pFile = fopen(strTempPath.c_str(), "wb");
+            if (pFile == nullptr) {
+                return false;
+            }
+            
+            bool bOk = fwrite(&header, sizeof(header), 1, pFile) == 1;
+            uint64_t uPosition = sizeof(header);
+            for (int i = 0; (i < CACHE_SECTIONS) && (bOk == true); i++) {
+                static const char padding[CACHE_ALIGNMENT] = {};
+                bOk = fwrite(padding, 1, header.m_sections[i].m_uOffset - uPosition, pFile) == header.m_sections[i].m_uOffset - uPosition;
+                
+                const size_t uBytes = counts[i] * header.m_uSizes[i + 1];
+                bOk = bOk && ( (uBytes == 0) || (fwrite(sections[i], 1, uBytes, pFile) == uBytes) );
+                uPosition = header.m_sections[i].m_uOffset + uBytes;
+            }
+            
+            bOk = (fclose(pFile) == 0) && bOk;
+            if ( (bOk == false) || (std::rename(strTempPath.c_str(), _strPath.c_str()) != 0) ) {
+                std::remove(strTempPath.c_str());
+                return false;
+            }
+            
+            return true;
+        }
+        
+        /*
+         Uses mesh data in place from a mapped cache file (no parsing or BVH build; the mapping is shared by all users).
+         Returns false (and leaves the mesh unchanged) if the file is not a valid cache for this build and source file.
+         Section sizes, vertex/triangle indices and BVH nodes are checked, so corrupt files are rejected as well.
+         */
+        bool mapCache(const std::shared_ptr<const MappedFile> &_pFile, uint64_t _uSourceSize, int64_t _iSourceTime) {
+            if ( (_pFile == nullptr) || (_pFile->size() < sizeof(CacheHeader)) ) {
+                return false;
+            }
+            
+            CacheHeader header;
+            std::memcpy(&header, _pFile->data(), sizeof(header));
+            
+            const CacheHeader expected = cacheHeader(_uSourceSize, _iSourceTime);
+            if (std::memcmp(&header, &expected, offsetof(CacheHeader, m_bounds)) != 0) {
+                return false;       // different format, build or source file
+            }
+            
+            for (int i = 0; i < CACHE_SECTIONS; i++) {
+                const auto &section = header.m_sections[i];
+                if ( (section.m_uOffset % CACHE_ALIGNMENT != 0) ||
+                     (section.m_uOffset > _pFile->size()) ||
+                     (section.m_uCount > (_pFile->size() - section.m_uOffset) / header.m_uSizes[i + 1]) )
+                {
+                    return false;
+                }
+            }
+            
+            auto section = [&](int _iSection) {
+                return _pFile->data() + header.m_sections[_iSection].m_uOffset;
+            };
+            
+            // triangles have to refer to cached vertices, packets to cached triangles and BVH leaves to packets
+            const auto *pVertices = reinterpret_cast<const Vertex*>(section(0));
+            const auto *pTriangles = reinterpret_cast<const Triangle*>(section(1));
+            const auto *pPackets = reinterpret_cast<const packet_type*>(section(2));
+            const size_t uVertexCount = header.m_sections[0].m_uCount;
+            const size_t uTriangleCount = header.m_sections[1].m_uCount;
+            const size_t uPacketCount = header.m_sections[2].m_uCount;
+            
+            for (size_t i = 0; i < uTriangleCount; i++) {
+                for (auto v : pTriangles[i].m_v) {
+                    if (v >= uVertexCount) {
+                        return false;
+                    }
+                }
+            }
+            
+            for (size_t i = 0; i < uPacketCount; i++) {
+                for (auto uIndex : pPackets[i].m_uIndex) {
+                    if (uIndex >= uTriangleCount) {
+                        return false;
+                    }
+                }
+            }
+            
+            FlatBvh<Triangle> bvh;
+            if ( (bvh.map(reinterpret_cast<const FlatBvhNode*>(section(3)), header.m_sections[3].m_uCount, header.m_uBvhDepth[0], uPacketCount, _pFile) == false) ||
+                 (bvh.wide4().map(reinterpret_cast<const WideBvhNode<4>*>(section(4)), header.m_sections[4].m_uCount, header.m_uBvhDepth[1], uPacketCount, _pFile) == false) ||
+                 (bvh.wide8().map(reinterpret_cast<const WideBvhNode<8>*>(section(5)), header.m_sections[5].m_uCount, header.m_uBvhDepth[2], uPacketCount, _pFile) == false) )
+            {
+                return false;
+            }
+            
+            m_vertices.map(pVertices, uVertexCount, _pFile);
+            m_triangles.map(pTriangles, uTriangleCount, _pFile);
+            m_packets.map(pPackets, uPacketCount, _pFile);
+            m_bvh = std::move(bvh);
+            
+            m_bounds = header.m_bounds;
+            m_bBoundsInit = true;
+            m_bUseVertexNormals = header.m_uUseVertexNormals != 0;
+            m_bvhStats = BvhStats();
+            return true;
+        }
+
+     private:
+        static constexpr uint32_t   CACHE_VERSION = 1;
+        static constexpr int        CACHE_SECTIONS = 6;         // vertices, triangles, packets, binary/wide4/wide8 BVH nodes
+        static constexpr size_t     CACHE_ALIGNMENT = 64;
+        
+        struct CacheSection {
+            uint64_t    m_uOffset;
+            uint64_t    m_uCount;
+        };
+        
+        // cache file header (everything before m_bounds has to match the expected header)
+        struct CacheHeader {
+            char            m_szMagic[8];
+            uint32_t        m_uVersion;
+            uint32_t        m_uByteOrder;
+            uint32_t        m_uSizes[CACHE_SECTIONS + 1];       // header and element sizes (layout check)
+            uint32_t        m_uReserved;
+            uint64_t        m_uSourceSize;
+            int64_t         m_iSourceTime;
+            Bounds          m_bounds;
+            uint32_t        m_uUseVertexNormals;
+            uint32_t        m_uBvhDepth[3];
+            CacheSection    m_sections[CACHE_SECTIONS];
+        };
+        
+        static_assert(std::is_trivially_copyable<Vertex>::value && std::is_trivially_copyable<Triangle>::value &&
+                      std::is_trivially_copyable<packet_type>::value && std::is_trivially_copyable<FlatBvhNode>::value &&
+                      std::is_trivially_copyable<WideBvhNode<4>>::value && std::is_trivially_copyable<WideBvhNode<8>>::value,
+                      "mesh cache data has to be trivially copyable");
+        
+        static uint64_t cacheAlign(uint64_t _uOffset) {
+            return (_uOffset + CACHE_ALIGNMENT - 1) / CACHE_ALIGNMENT * CACHE_ALIGNMENT;
+        }
+        
+        // temporary cache file path (process id and call count, so concurrent writers of the same cache never share a file)
+        static std::string cacheTempPath(const std::string &_strPath) {
+            static std::atomic<uint32_t> uCount(0);
+#if defined(_WIN32)
+            const long iProcess = (long)_getpid();
+#else
+            const long iProcess = (long)getpid();
+#endif
+            return _strPath + "." + std::to_string(iProcess) + "." + std::to_string(uCount++) + ".tmp";
+        }
+        
+        // expected header for this build and source file
+        static CacheHeader cacheHeader(uint64_t _uSourceSize, int64_t _iSourceTime) {
+            CacheHeader header = {};
+            std::memcpy(header.m_szMagic, "LNFMESH", 8);
+            header.m_uVersion = CACHE_VERSION;
+            header.m_uByteOrder = 0x01020304;
+            header.m_uSizes[0] = (uint32_t)sizeof(CacheHeader);
+            header.m_uSizes[1] = (uint32_t)sizeof(Vertex);
+            header.m_uSizes[2] = (uint32_t)sizeof(Triangle);
+            header.m_uSizes[3] = (uint32_t)sizeof(packet_type);
+            header.m_uSizes[4] = (uint32_t)sizeof(FlatBvhNode);
+            header.m_uSizes[5] = (uint32_t)sizeof(WideBvhNode<4>);
+            header.m_uSizes[6] = (uint32_t)sizeof(WideBvhNode<8>);
+            header.m_uSourceSize = _uSourceSize;
+            header.m_iSourceTime = _iSourceTime;
+            return header;
+        }
+        
      protected:
         // returns index of triangle in mesh
         uint32_t getIndex(const Triangle *_pTriangle) const {
             return (uint32_t)(_pTriangle - m_triangles.data());
         }
         
+        // pack _uCount triangles, starting at _uFirst, into a SIMD packet
+        packet_type buildPacket(uint32_t _uFirst, uint32_t _uCount) const {
+            packet_type packet;
+            for (uint32_t i = 0; i < (uint32_t)PACKET_WIDTH; i++) {
+                Vec v0, e1, e2;
+                uint32_t uIndex = _uFirst;
+                
+                if (i < _uCount) {
+                    uIndex = _uFirst + i;
+                    const auto &t = m_triangles[uIndex];
+                    v0 = m_vertices[t.m_v[0]].m_v;
+                    e1 = m_vertices[t.m_v[1]].m_v - v0;
+                    e2 = m_vertices[t.m_v[2]].m_v - v0;
+                }
+                
+                packet.m_v0x[i] = v0.x(); packet.m_v0y[i] = v0.y(); packet.m_v0z[i] = v0.z();
+                packet.m_e1x[i] = e1.x(); packet.m_e1y[i] = e1.y(); packet.m_e1z[i] = e1.z();
+                packet.m_e2x[i] = e2.x(); packet.m_e2y[i] = e2.y(); packet.m_e2z[i] = e2.z();
+                packet.m_uIndex[i] = uIndex;
+            }
+            
+            return packet;
+        }
+        
         // get list of triangles (raw pointers)
         std::vector<const Triangle*> getTrianglePtrs() const {
             std::vector<const Triangle*> trianglePtrs;
@@ -281,13 +675,15 @@ namespace LNF
         }
 
      private:
-        std::vector<Vertex>                 m_vertices;
-        std::vector<Triangle>               m_triangles;
+        DataArray<Vertex>                   m_vertices;
+        DataArray<Triangle>                 m_triangles;
         Bounds                              m_bounds;
         const Material                      *m_pMaterial;
         bool                                m_bBoundsInit;
         bool                                m_bUseVertexNormals;
-        std::unique_ptr<BvhNode<Triangle>>  m_bvhRoot;
+        DataArray<packet_type>              m_packets;
+        FlatBvh<Triangle>                   m_bvh;
+        BvhStats                            m_bvhStats;
     };
 
 
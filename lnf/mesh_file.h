@@ -0,0 +1,600 @@
+#ifndef LIBS_HEADER_MESH_FILE_H
+#define LIBS_HEADER_MESH_FILE_H
+
+#include "mapped_file.h"
+#include "material.h"
+#include "mesh.h"
+#include "random.h"
+#include "uv.h"
+#include "vec3.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace LNF
+{
+    /* Text parsing over a (mapped) file buffer; parsing stops at the end of the buffer (no terminator needed) */
+    class TextReader
+    {
+     public:
+        TextReader(const char *_pBegin, const char *_pEnd)
+            :m_p(_pBegin),
+             m_pEnd(_pEnd)
+        {}
+
+        bool eof() const {
+            return m_p >= m_pEnd;
+        }
+
+        const char *position() const {
+            return m_p;
+        }
+
+        /* skip to start of next line */
+        void nextLine() {
+            while ( (m_p < m_pEnd) && (*m_p != '\n') ) {
+                m_p++;
+            }
+
+            if (m_p < m_pEnd) {
+                m_p++;
+            }
+        }
+
+        /* next token on current line (empty at the end of the line) */
+        std::string token() {
+            const char *pBegin = nullptr;
+            size_t uLength = token(pBegin);
+            return std::string(pBegin, uLength);
+        }
+
+        /* next token on current line (returns length; 0 at the end of the line) */
+        size_t token(const char *&_pBegin) {
+            while ( (m_p < m_pEnd) && ( (*m_p == ' ') || (*m_p == '\t') || (*m_p == '\r') ) ) {
+                m_p++;
+            }
+
+            _pBegin = m_p;
+            while ( (m_p < m_pEnd) && (*m_p != ' ') && (*m_p != '\t') && (*m_p != '\r') && (*m_p != '\n') ) {
+                m_p++;
+            }
+
+            return (size_t)(m_p - _pBegin);
+        }
+
+        /* parse next token as a number; returns false if there is none */
+        template <typename value_type>
+        bool number(value_type &_value) {
+            const char *pBegin = nullptr;
+            size_t uLength = token(pBegin);
+            return parseNumber(pBegin, uLength, _value);
+        }
+
+        /* parse number from token */
+        template <typename value_type>
+        static bool parseNumber(const char *_pBegin, size_t _uLength, value_type &_value) {
+            char szBuffer[64];
+            if ( (_uLength == 0) || (_uLength >= sizeof(szBuffer)) ) {
+                return false;
+            }
+
+            std::memcpy(szBuffer, _pBegin, _uLength);
+            szBuffer[_uLength] = 0;
+
+            char *pszEnd = nullptr;
+            _value = (value_type)strtod(szBuffer, &pszEnd);
+            return pszEnd != szBuffer;
+        }
+
+     private:
+        const char      *m_p;
+        const char      *m_pEnd;
+    };
+
+
+    /*
+     Loads a Wavefront OBJ file (positions, texture coordinates and normals; polygons are triangulated as fans).
+     Vertices are unique position/uv/normal combinations. _bNormals is set if all vertices have normals.
+     */
+    inline bool loadObj(const std::string &_strPath, std::vector<Mesh::Vertex> &_vertices, std::vector<Mesh::Triangle> &_triangles, bool &_bNormals) {
+        auto pFile = MappedFile::open(_strPath);
+        if (pFile == nullptr) {
+            fprintf(stderr, "ERROR: can not read OBJ file '%s'\n", _strPath.c_str());
+            return false;
+        }
+
+        TextReader reader((const char*)pFile->data(), (const char*)pFile->data() + pFile->size());
+        std::vector<Vec> positions, normals;
+        std::vector<Uv> uvs;
+        // (position, uv, normal) index -> vertex
+        struct VertexKey {
+            bool operator==(const VertexKey &_key) const {
+                return (m_iPosition == _key.m_iPosition) && (m_iUv == _key.m_iUv) && (m_iNormal == _key.m_iNormal);
+            }
+            
+            int64_t     m_iPosition;
+            int64_t     m_iUv;          // -1 if missing
+            int64_t     m_iNormal;      // -1 if missing
+        };
+        
+        struct VertexKeyHash {
+            size_t operator()(const VertexKey &_key) const {
+                return (size_t)hash64(hash64(hash64((uint64_t)_key.m_iPosition) ^ (uint64_t)_key.m_iUv) ^ (uint64_t)_key.m_iNormal);
+            }
+        };
+        
+        std::unordered_map<VertexKey, uint32_t, VertexKeyHash> vertexIndices;
+        std::vector<uint32_t> face;
+        bool bAllNormals = true;
+        int iLine = 1;
+
+        // resolves OBJ index (1-based, negative is relative to the end); returns -1 if missing/invalid
+        auto index = [](const char *_pBegin, size_t _uLength, size_t _uCount) -> int64_t {
+            int64_t i = 0;
+            if (TextReader::parseNumber(_pBegin, _uLength, i) == false) {
+                return -1;
+            }
+
+            i = i < 0 ? (int64_t)_uCount + i : i - 1;
+            return (i >= 0) && (i < (int64_t)_uCount) ? i : -1;
+        };
+
+        for (; reader.eof() == false; reader.nextLine(), iLine++) {
+            const char *pToken = nullptr;
+            size_t uLength = reader.token(pToken);
+            if ( (uLength == 0) || (pToken[0] == '#') ) {
+                continue;
+            }
+
+            if ( (uLength == 1) && (pToken[0] == 'v') ) {
+                float x = 0, y = 0, z = 0;
+                if ( (reader.number(x) && reader.number(y) && reader.number(z)) == false ) {
+                    fprintf(stderr, "ERROR: bad vertex in '%s', line %d\n", _strPath.c_str(), iLine);
+                    return false;
+                }
+
+                positions.emplace_back(x, y, z);
+            }
+            else if ( (uLength == 2) && (pToken[0] == 'v') && (pToken[1] == 't') ) {
+                float u = 0, v = 0;
+                reader.number(u);
+                reader.number(v);
+                uvs.emplace_back(u, v);
+            }
+            else if ( (uLength == 2) && (pToken[0] == 'v') && (pToken[1] == 'n') ) {
+                float x = 0, y = 0, z = 0;
+                reader.number(x);
+                reader.number(y);
+                reader.number(z);
+                normals.emplace_back(Vec(x, y, z).normalized());
+            }
+            else if ( (uLength == 1) && (pToken[0] == 'f') ) {
+                face.clear();
+                const char *pVertex = nullptr;
+                while (size_t uVertexLength = reader.token(pVertex)) {
+                    // v, v/vt, v//vn or v/vt/vn
+                    const char *pEnd = pVertex + uVertexLength;
+                    const char *pSlash1 = std::find(pVertex, pEnd, '/');
+                    const char *pSlash2 = pSlash1 < pEnd ? std::find(pSlash1 + 1, pEnd, '/') : pEnd;
+
+                    int64_t iPosition = index(pVertex, pSlash1 - pVertex, positions.size());
+                    int64_t iUv = pSlash1 < pEnd ? index(pSlash1 + 1, pSlash2 - pSlash1 - 1, uvs.size()) : -1;
+                    int64_t iNormal = pSlash2 < pEnd ? index(pSlash2 + 1, pEnd - pSlash2 - 1, normals.size()) : -1;
+                    if (iPosition < 0) {
+                        fprintf(stderr, "ERROR: bad face index in '%s', line %d\n", _strPath.c_str(), iLine);
+                        return false;
+                    }
+
+                    // unique vertex per position/uv/normal combination
+                    const VertexKey key = {iPosition, iUv, iNormal};
+                    auto it = vertexIndices.find(key);
+                    if (it == vertexIndices.end()) {
+                        Mesh::Vertex vertex;
+                        vertex.m_v = positions[iPosition];
+                        vertex.m_uv = iUv >= 0 ? uvs[iUv] : Uv();
+                        vertex.m_normal = iNormal >= 0 ? normals[iNormal] : Vec();
+                        bAllNormals = bAllNormals && (iNormal >= 0);
+
+                        it = vertexIndices.emplace(key, (uint32_t)_vertices.size()).first;
+                        _vertices.push_back(vertex);
+                    }
+
+                    face.push_back(it->second);
+                }
+
+                for (size_t i = 2; i < face.size(); i++) {
+                    Mesh::Triangle t;
+                    t.m_v[0] = face[0];
+                    t.m_v[1] = face[i - 1];
+                    t.m_v[2] = face[i];
+                    _triangles.push_back(t);
+                }
+            }
+        }
+
+        _bNormals = bAllNormals && (_vertices.empty() == false);
+        return true;
+    }
+
+
+    /*
+     Loads a PLY file (ascii and binary): vertex x/y/z, optional nx/ny/nz and u/v (or s/t), and face vertex index lists
+     (polygons are triangulated as fans). _bNormals is set if the vertices have normals.
+     */
+    inline bool loadPly(const std::string &_strPath, std::vector<Mesh::Vertex> &_vertices, std::vector<Mesh::Triangle> &_triangles, bool &_bNormals) {
+        enum class Format {ASCII, BINARY_LE, BINARY_BE};
+
+        struct Property {
+            std::string     m_strName;
+            int             m_iSize = 0;        // value size in bytes
+            bool            m_bFloat = false;
+            bool            m_bSigned = false;
+            bool            m_bList = false;
+            int             m_iCountSize = 0;   // list count size in bytes
+        };
+
+        struct Element {
+            std::string             m_strName;
+            size_t                  m_uCount = 0;
+            std::vector<Property>   m_properties;
+        };
+
+        // PLY type name -> size, float, signed
+        auto parseType = [](const std::string &_strType, int &_iSize, bool &_bFloat, bool &_bSigned) {
+            static const struct {const char *m_pszName; int m_iSize; bool m_bFloat; bool m_bSigned;} types[] = {
+                {"char", 1, false, true}, {"int8", 1, false, true}, {"uchar", 1, false, false}, {"uint8", 1, false, false},
+                {"short", 2, false, true}, {"int16", 2, false, true}, {"ushort", 2, false, false}, {"uint16", 2, false, false},
+                {"int", 4, false, true}, {"int32", 4, false, true}, {"uint", 4, false, false}, {"uint32", 4, false, false},
+                {"float", 4, true, true}, {"float32", 4, true, true}, {"double", 8, true, true}, {"float64", 8, true, true}
+            };
+
+            for (const auto &type : types) {
+                if (_strType == type.m_pszName) {
+                    _iSize = type.m_iSize;
+                    _bFloat = type.m_bFloat;
+                    _bSigned = type.m_bSigned;
+                    return true;
+                }
+            }
+
+            return false;
+        };
+
+        auto pFile = MappedFile::open(_strPath);
+        if (pFile == nullptr) {
+            fprintf(stderr, "ERROR: can not read PLY file '%s'\n", _strPath.c_str());
+            return false;
+        }
+
+        // header
+        const char *pBegin = (const char*)pFile->data();
+        const char *pEnd = pBegin + pFile->size();
+        TextReader reader(pBegin, pEnd);
+        std::vector<Element> elements;
+        Format format = Format::ASCII;
+
+        if (reader.token() != "ply") {
+            fprintf(stderr, "ERROR: '%s' is not a PLY file\n", _strPath.c_str());
+            return false;
+        }
+
+        for (reader.nextLine(); ; reader.nextLine()) {
+            if (reader.eof() == true) {
+                fprintf(stderr, "ERROR: PLY file '%s' has no end_header\n", _strPath.c_str());
+                return false;
+            }
+
+            const std::string strKeyword = reader.token();
+            if (strKeyword == "format") {
+                const std::string strFormat = reader.token();
+                if (strFormat == "ascii") format = Format::ASCII;
+                else if (strFormat == "binary_little_endian") format = Format::BINARY_LE;
+                else if (strFormat == "binary_big_endian") format = Format::BINARY_BE;
+                else {
+                    fprintf(stderr, "ERROR: unknown PLY format '%s' in '%s'\n", strFormat.c_str(), _strPath.c_str());
+                    return false;
+                }
+            }
+            else if (strKeyword == "element") {
+                Element element;
+                element.m_strName = reader.token();
+                reader.number(element.m_uCount);
+                elements.push_back(element);
+            }
+            else if ( (strKeyword == "property") && (elements.empty() == false) ) {
+                Property property;
+                std::string strType = reader.token();
+                bool bOk = true;
+                if (strType == "list") {
+                    bool bFloat = false;
+                    bool bSigned = false;
+                    property.m_bList = true;
+                    bOk = parseType(reader.token(), property.m_iCountSize, bFloat, bSigned) && (bFloat == false);
+                    strType = reader.token();
+                }
+
+                bOk = bOk && parseType(strType, property.m_iSize, property.m_bFloat, property.m_bSigned);
+                property.m_strName = reader.token();
+                if (bOk == false) {
+                    fprintf(stderr, "ERROR: unsupported PLY property '%s' in '%s'\n", property.m_strName.c_str(), _strPath.c_str());
+                    return false;
+                }
+
+                elements.back().m_properties.push_back(property);
+            }
+            else if (strKeyword == "end_header") {
+                reader.nextLine();
+                break;
+            }
+        }
+
+        // binary value readers
+        const bool bSwap = format == Format::BINARY_BE;
+        const char *p = reader.position();
+        auto readBinary = [&](int _iSize, bool _bFloat, bool _bSigned, double &_fValue) {
+            if (p + _iSize > pEnd) {
+                return false;
+            }
+
+            uint8_t bytes[8];
+            for (int i = 0; i < _iSize; i++) {
+                bytes[i] = (uint8_t)p[bSwap ? _iSize - 1 - i : i];
+            }
+
+            p += _iSize;
+            if (_bFloat == true) {
+                if (_iSize == 4) {float f; std::memcpy(&f, bytes, 4); _fValue = f;}
+                else {double d; std::memcpy(&d, bytes, 8); _fValue = d;}
+            }
+            else {
+                uint32_t u = 0;
+                for (int i = _iSize; i-- > 0; ) {
+                    u = (u << 8) | bytes[i];
+                }
+
+                if ( (_bSigned == true) && (_iSize < 4) && ((u >> (_iSize * 8 - 1)) & 1) ) {
+                    u |= ~0u << (_iSize * 8);      // sign extend
+                }
+
+                _fValue = _bSigned ? (double)(int32_t)u : (double)u;
+            }
+
+            return true;
+        };
+
+        auto readValue = [&](int _iSize, bool _bFloat, bool _bSigned, double &_fValue) {
+            if (format == Format::ASCII) {
+                TextReader ascii(p, pEnd);
+                bool bOk = ascii.number(_fValue);
+                p = ascii.position();
+                return bOk;
+            }
+
+            return readBinary(_iSize, _bFloat, _bSigned, _fValue);
+        };
+
+        // elements
+        bool bNormals = false;
+        std::vector<uint32_t> face;
+        for (const auto &element : elements) {
+            const bool bVertex = element.m_strName == "vertex";
+            const bool bFace = element.m_strName == "face";
+
+            // vertex property slots (x, y, z, nx, ny, nz, u, v)
+            std::vector<int> slots(element.m_properties.size(), -1);
+            if (bVertex == true) {
+                static const char *names[][8] = {{"x", "y", "z", "nx", "ny", "nz", "u", "v"},
+                                                 {"x", "y", "z", "nx", "ny", "nz", "s", "t"},
+                                                 {"x", "y", "z", "nx", "ny", "nz", "texture_u", "texture_v"}};
+                for (size_t i = 0; i < element.m_properties.size(); i++) {
+                    for (const auto &aliases : names) {
+                        for (int j = 0; j < 8; j++) {
+                            if (element.m_properties[i].m_strName == aliases[j]) {
+                                slots[i] = j;
+                            }
+                        }
+                    }
+
+                    bNormals = bNormals || (slots[i] == 3);
+                }
+
+            }
+
+            // every record needs at least its property bytes (count only for lists, two characters per value in ascii files)
+            size_t uRecordSize = 0;
+            for (const auto &property : element.m_properties) {
+                uRecordSize += (format == Format::ASCII) ? 2 : (property.m_bList ? property.m_iCountSize : property.m_iSize);
+            }
+
+            if ( (uRecordSize > 0) && (element.m_uCount > (size_t)(pEnd - p) / uRecordSize) ) {
+                fprintf(stderr, "ERROR: PLY file '%s' is truncated (%zu %s elements do not fit)\n", _strPath.c_str(), element.m_uCount, element.m_strName.c_str());
+                return false;
+            }
+
+            if (bVertex == true) {
+                _vertices.reserve(_vertices.size() + element.m_uCount);
+            }
+
+            for (size_t e = 0; e < element.m_uCount; e++) {
+                float values[8] = {};
+                for (size_t i = 0; i < element.m_properties.size(); i++) {
+                    const auto &property = element.m_properties[i];
+                    double fValue = 0;
+
+                    if (property.m_bList == true) {
+                        double fCount = 0;
+                        if (readValue(property.m_iCountSize, false, false, fCount) == false) {
+                            fprintf(stderr, "ERROR: PLY file '%s' is truncated\n", _strPath.c_str());
+                            return false;
+                        }
+
+                        face.clear();
+                        for (int j = 0; j < (int)fCount; j++) {
+                            if (readValue(property.m_iSize, property.m_bFloat, property.m_bSigned, fValue) == false) {
+                                fprintf(stderr, "ERROR: PLY file '%s' is truncated\n", _strPath.c_str());
+                                return false;
+                            }
+
+                            face.push_back((uint32_t)fValue);
+                        }
+
+                        if ( (bFace == true) && ( (property.m_strName == "vertex_indices") || (property.m_strName == "vertex_index") ) ) {
+                            for (size_t j = 2; j < face.size(); j++) {
+                                Mesh::Triangle t;
+                                t.m_v[0] = face[0];
+                                t.m_v[1] = face[j - 1];
+                                t.m_v[2] = face[j];
+                                _triangles.push_back(t);
+                            }
+                        }
+                    }
+                    else {
+                        if (readValue(property.m_iSize, property.m_bFloat, property.m_bSigned, fValue) == false) {
+                            fprintf(stderr, "ERROR: PLY file '%s' is truncated\n", _strPath.c_str());
+                            return false;
+                        }
+
+                        if (slots[i] >= 0) {
+                            values[slots[i]] = (float)fValue;
+                        }
+                    }
+                }
+
+                if (bVertex == true) {
+                    Mesh::Vertex vertex;
+                    vertex.m_v = Vec(values[0], values[1], values[2]);
+                    vertex.m_normal = bNormals ? Vec(values[3], values[4], values[5]).normalized() : Vec();
+                    vertex.m_uv = Uv(values[6], values[7]);
+                    _vertices.push_back(vertex);
+                }
+
+                if (format == Format::ASCII) {
+                    TextReader ascii(p, pEnd);
+                    ascii.nextLine();
+                    p = ascii.position();
+                }
+            }
+        }
+
+        // drop triangles with bad indices
+        const size_t uVertices = _vertices.size();
+        _triangles.erase(std::remove_if(_triangles.begin(), _triangles.end(), [uVertices](const Mesh::Triangle &_t) {
+                             return (_t.m_v[0] >= uVertices) || (_t.m_v[1] >= uVertices) || (_t.m_v[2] >= uVertices);
+                         }),
+                         _triangles.end());
+
+        _bNormals = bNormals;
+        return true;
+    }
+
+
+    /*
+     Mesh loaded from an OBJ or PLY file.
+     The built mesh (including its BVH) is cached next to the source file ('<file>.lnfcache'); later loads map the
+     cache and use it in place: no parsing, no BVH build and the pages are shared by all meshes/processes using it.
+     Instance the mesh with several PrimitiveInstances (createPrimitive() + createPrimitiveInstance()) to share it within a scene.
+     */
+    class MeshFile    : public Mesh
+    {
+     public:
+        MeshFile(const std::string &_strPath, const Material *_pMaterial, bool _bUseCache = true)
+            :Mesh(_pMaterial),
+             m_bLoaded(false),
+             m_bCached(false)
+        {
+            uint64_t uSourceSize = 0;
+            int64_t iSourceTime = 0;
+            if (fileStamp(_strPath, uSourceSize, iSourceTime) == false) {
+                fprintf(stderr, "ERROR: mesh file '%s' not found\n", _strPath.c_str());
+                return;
+            }
+
+            const std::string strCachePath = _strPath + ".lnfcache";
+            if ( (_bUseCache == true) && (mapCache(MappedFile::open(strCachePath), uSourceSize, iSourceTime) == true) ) {
+                m_bLoaded = true;
+                m_bCached = true;
+                return;
+            }
+
+            std::vector<Mesh::Vertex> vertices;
+            std::vector<Mesh::Triangle> triangles;
+            bool bNormals = false;
+            bool bOk = false;
+
+            if (hasExtension(_strPath, ".obj") == true) {
+                bOk = loadObj(_strPath, vertices, triangles, bNormals);
+            }
+            else if (hasExtension(_strPath, ".ply") == true) {
+                bOk = loadPly(_strPath, vertices, triangles, bNormals);
+            }
+            else {
+                fprintf(stderr, "ERROR: unsupported mesh file '%s' (expected .obj or .ply)\n", _strPath.c_str());
+            }
+
+            if ( (bOk == false) || (triangles.empty() == true) ) {
+                return;
+            }
+
+            setVertices(std::move(vertices));
+            setTriangles(std::move(triangles));
+
+            buildTriangleNormals();
+            if (bNormals == true) {
+                setUseVertexNormals(true);
+            }
+            else {
+                buildVertexNormals();
+            }
+
+            buildBounds();
+            buildBvh();
+            m_bLoaded = true;
+
+            if ( (_bUseCache == true) && (writeCache(strCachePath, uSourceSize, iSourceTime) == false) ) {
+                fprintf(stderr, "WARNING: could not write mesh cache '%s'\n", strCachePath.c_str());
+            }
+        }
+
+        /* returns true if the mesh was loaded (from the source or cache file) */
+        bool loaded() const {
+            return m_bLoaded;
+        }
+
+        /* returns true if the mesh was mapped from its cache file */
+        bool cached() const {
+            return m_bCached;
+        }
+
+     private:
+        static bool hasExtension(const std::string &_strPath, const char *_pszExtension) {
+            const size_t n = strlen(_pszExtension);
+            if (_strPath.size() < n) {
+                return false;
+            }
+
+            for (size_t i = 0; i < n; i++) {
+                if (tolower(_strPath[_strPath.size() - n + i]) != _pszExtension[i]) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+     private:
+        bool        m_bLoaded;
+        bool        m_bCached;
+    };
+
+
+};  // namespace LNF
+
+
+#endif  // #ifndef LIBS_HEADER_MESH_FILE_H
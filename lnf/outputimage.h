@@ -2,10 +2,23 @@
 #define LIBS_HEADER_OUTPUT_IMAGE_H
 
 #include "constants.h"
+#include "color.h"
+
+#include <cstring>
+#include <vector>
 
 
 namespace LNF
 {
+    /* Rectangle of image pixels */
+    struct ImageRect {
+        int         m_iX;
+        int         m_iY;
+        int         m_iWidth;
+        int         m_iHeight;
+    };
+
+
     /* Wrapper class for output image raw buffer (RGB 8:8:8) */
     class OutputImageBuffer
     {
@@ -42,6 +55,15 @@ namespace LNF
         const unsigned char *row(int _iY) const {
             return m_image.data() + BYTES_PER_PIXEL * m_iWidth * _iY;
         }
+        
+        /* copies a rectangle from another image of the same size */
+        void copy(const OutputImageBuffer &_src, const ImageRect &_rect) {
+            for (int j = _rect.m_iY; j < _rect.m_iY + _rect.m_iHeight; j++) {
+                std::memcpy(row(j) + BYTES_PER_PIXEL * _rect.m_iX,
+                            _src.row(j) + BYTES_PER_PIXEL * _rect.m_iX,
+                            BYTES_PER_PIXEL * _rect.m_iWidth);
+            }
+        }
 
      private:
         const int                   m_iWidth;
@@ -49,6 +71,85 @@ namespace LNF
         std::vector<unsigned char>  m_image;
     };
 
+
+    /*
+     Float RGB accumulation buffer (for progressive rendering).
+     Keeps per pixel color sums, luminance sum of squares and sample counts.
+     */
+    class AccumulationBuffer
+    {
+     public:
+        struct Pixel {
+            Pixel()
+                :m_fLuminanceSq(0),
+                 m_uSamples(0)
+            {}
+            
+            void push(const Color &_color) {
+                float fLuminance = luminance(_color);
+                m_sum += _color;
+                m_fLuminanceSq += fLuminance * fLuminance;
+                m_uSamples++;
+            }
+            
+            Color mean() const {
+                return m_uSamples > 0 ? m_sum / (float)m_uSamples : Color();
+            }
+            
+            /* standard error of mean luminance (noise estimate) */
+            float error() const {
+                if (m_uSamples < 2) {
+                    return 1.0f;
+                }
+                
+                float fMean = luminance(m_sum) / m_uSamples;
+                float fVariance = std::max(m_fLuminanceSq / m_uSamples - fMean * fMean, 0.0f);
+                return sqrt(fVariance / (m_uSamples - 1));
+            }
+            
+            /* standard error relative to mean luminance (dark pixels use a minimum reference of 0.01) */
+            float relativeError() const {
+                float fMean = m_uSamples > 0 ? luminance(m_sum) / m_uSamples : 0.0f;
+                return error() / std::max(fMean, 0.01f);
+            }
+            
+            static float luminance(const Color &_color) {
+                return 0.2126f * _color.red() + 0.7152f * _color.green() + 0.0722f * _color.blue();
+            }
+            
+            Color       m_sum;
+            float       m_fLuminanceSq;
+            uint32_t    m_uSamples;
+        };
+        
+     public:
+        AccumulationBuffer(int _iWidth, int _iHeight)
+            :m_iWidth(_iWidth),
+             m_iHeight(_iHeight),
+             m_pixels((size_t)_iWidth * _iHeight)
+        {}
+        
+        int width() const {return m_iWidth;}
+        int height() const {return m_iHeight;}
+        
+        Pixel &pixel(int _iX, int _iY) {
+            return m_pixels[(size_t)_iY * m_iWidth + _iX];
+        }
+        
+        const Pixel &pixel(int _iX, int _iY) const {
+            return m_pixels[(size_t)_iY * m_iWidth + _iX];
+        }
+        
+        void clear() {
+            std::fill(m_pixels.begin(), m_pixels.end(), Pixel());
+        }
+        
+     private:
+        const int                   m_iWidth;
+        const int                   m_iHeight;
+        std::vector<Pixel>          m_pixels;
+    };
+
 };  // namespace LNF
 
 
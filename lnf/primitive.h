@@ -11,12 +11,29 @@
 #include <memory>
 #include <array>
 #include <memory>
-#include <atomic>
-#include <mutex>
 
 
 namespace LNF
 {
+    /* Light sample (point on the surface of an emitting primitive, as seen from the sample origin) */
+    struct LightSample
+    {
+        Vec         m_direction;        // unit direction from origin to sampled point
+        Vec         m_normal;           // surface normal at sampled point (primitive space)
+        Color       m_emitted;          // light emitted towards origin (set by primitive instance)
+        float       m_fDistance;        // distance from origin to sampled point
+        float       m_fPdf;             // solid angle pdf of sampled direction
+    };
+    
+    
+    /* Primitive type tag (scenes run non-virtual fast paths for known types; everything else is CUSTOM) */
+    enum class PrimitiveType
+    {
+        CUSTOM,
+        SPHERE
+    };
+    
+    
     /*
         Scene Primitive
         API could be accessed by multiple worker threads concurrently.
@@ -27,14 +44,42 @@ namespace LNF
         /* Returns the material used for rendering, etc. */
         virtual const Material *material() const = 0;
         
+        /* Returns the material at a hit (primitives with more than one material, e.g. groups, override this) */
+        virtual const Material *material(const Intersect &_hit) const {
+            return material();
+        }
+        
+        /* Returns the type tag (derived classes that change the hit behaviour of a tagged type should return CUSTOM) */
+        virtual PrimitiveType type() const {return PrimitiveType::CUSTOM;}
+        
         /* Quick node hit check (populates at least critical Intersect properties) */
         virtual bool hit(Intersect &_hit) const = 0;
         
+        /*
+         Occlusion check: returns true on any hit closer than _fMaxDist (ray in primitive space).
+         Primitives with cheaper any-hit checks should override this (default uses hit()).
+         */
+        virtual bool occluded(const Ray &_ray, float _fMaxDist) const {
+            Intersect hit(_ray);
+            hit.m_priRay = _ray;
+            hit.m_priRay.m_fMaxDist = _fMaxDist;
+            return this->hit(hit);
+        }
+        
         /* Completes the Intersect properties. */
         virtual Intersect &intersect(Intersect &_hit) const = 0;
         
         /* returns bounds for shape */
         virtual const Bounds &bounds() const = 0;
+        
+        /* Returns true if the primitive supports light sampling (sample() and pdf()) */
+        virtual bool isSampleable() const {return false;}
+        
+        /* Samples a point on the surface, as seen from _origin (primitive space; populates all but m_emitted) */
+        virtual bool sample(LightSample &_sample, const Vec &_origin) const {return false;}
+        
+        /* Returns the solid angle pdf of sample() returning _direction from _origin (primitive space) */
+        virtual float pdf(const Vec &_origin, const Vec &_direction) const {return 0;}
     };
     
 
@@ -46,23 +91,25 @@ namespace LNF
     {
      public:
         PrimitiveInstance()
-            :m_bOwner(false),
-             m_bDirtyBounds(true)
+            :m_pTarget(nullptr),
+             m_bOwner(false)
         {}
         
         PrimitiveInstance(const Primitive *_pTarget, const Axis &_axis)
             :m_pTarget(_pTarget),
              m_axis(_axis),
-             m_bOwner(false),
-             m_bDirtyBounds(true)
-        {}
+             m_bOwner(false)
+        {
+            updateBounds();
+        }
         
         PrimitiveInstance(std::unique_ptr<Primitive> &&_pTarget, const Axis &_axis)
             :m_pTarget(_pTarget.release()),
              m_axis(_axis),
-             m_bOwner(true),
-             m_bDirtyBounds(true)
-        {}
+             m_bOwner(true)
+        {
+            updateBounds();
+        }
         
         virtual ~PrimitiveInstance() {
             if (m_bOwner == true) {
@@ -75,18 +122,35 @@ namespace LNF
             return m_pTarget->material();
         }
         
+        /* Returns the material at a hit (e.g. of the prototype hit inside an instanced group) */
+        const Material *material(const Intersect &_hit) const {
+            return m_pTarget->material(_hit);
+        }
+        
+        /* Returns the instanced primitive */
+        const Primitive *primitive() const {
+            return m_pTarget;
+        }
+        
+        /* Returns the instance transform (primitive to view space) */
+        const Axis &axis() const {
+            return m_axis;
+        }
+        
         /* Quick node hit check (populates at least node and time properties of intercept) */
         virtual bool hit(Intersect &_hit) const {
             // check AA bounding volume first
             if (aaboxIntersectCheck(bounds(), _hit.m_viewRay) == true)
             {
-                // transform ray for primitive hit
+                // transform ray for primitive hit (ray limit scales with instance)
                 _hit.m_priRay = transformRayTo(_hit.m_viewRay, m_axis);
+                _hit.m_priRay.m_fMaxDist = _hit.m_viewRay.m_fMaxDist / m_axis.m_fScale;
                 
                 // check hit
                 bool bHit = m_pTarget->hit(_hit);
                 if (bHit == true) {
                     _hit.m_pPrimitive = this;
+                    _hit.m_fViewPositionOnRay = _hit.m_fPositionOnRay * m_axis.m_fScale;
                     return true;
                 }
             }
@@ -94,19 +158,60 @@ namespace LNF
             return false;
         }
 
+        /* Occlusion check: returns true on any hit closer than _fMaxDist (view space) */
+        virtual bool occluded(const Ray &_ray, float _fMaxDist) const {
+            if (aaboxIntersectCheck(bounds(), _ray) == false) {
+                return false;
+            }
+            
+            // transform ray for primitive check (ray limit scales with instance)
+            return m_pTarget->occluded(transformRayTo(_ray, m_axis), _fMaxDist / m_axis.m_fScale);
+        }
+        
         /* Completes the Intersect properties. */
         virtual Intersect &intersect(Intersect &_hit) const {
             return m_pTarget->intersect(_hit);
         }
         
+        /* Returns true if the instance is a light that can be sampled directly */
+        bool isLight() const {
+            return (m_pTarget->isSampleable() == true) && (material()->isEmissive() == true);
+        }
+        
+        /* Samples a point on the light, as seen from _origin (view space; solid angle pdf) */
+        bool sampleLight(LightSample &_sample, const Vec &_origin) const {
+            auto origin = m_axis.transformTo(_origin);
+            if (m_pTarget->sample(_sample, origin) == false) {
+                return false;
+            }
+            
+            // evaluate emitted light at sampled point
+            Intersect hit;
+            hit.m_priRay = Ray(origin, _sample.m_direction);
+            hit.m_position = hit.m_priRay.position(_sample.m_fDistance);
+            hit.m_normal = _sample.m_normal;
+            _sample.m_emitted = material()->emitted(hit);
+            
+            // back to view space (solid angle is invariant under rotation and uniform scale)
+            _sample.m_direction = m_axis.rotateFrom(_sample.m_direction);
+            _sample.m_fDistance *= m_axis.m_fScale;
+            return true;
+        }
+        
+        /* Returns the solid angle pdf of sampleLight() returning _direction from _origin (view space) */
+        float lightPdf(const Vec &_origin, const Vec &_direction) const {
+            return m_pTarget->pdf(m_axis.transformTo(_origin), m_axis.rotateTo(_direction));
+        }
+        
         /* tranform ray back to view space */
         virtual Ray transformRayFrom(const Ray &_ray) const {
             return LNF::transformRayFrom(_ray, m_axis);
         }
 
-        /* move instance */
+        /* move instance (bounds are updated; the scene BVH has to be refit, see Scene::update()) */
         virtual void move(const Vec &_origin) {
             m_axis.m_origin = _origin;
+            updateBounds();
         }
         
         /*
@@ -116,31 +221,25 @@ namespace LNF
          gamma - angle around X axis
          */
         void rotateEulerZYX(float _fAlpha, float _fBeta, float _fGamma) {
-            m_axis = axisEulerZYX(_fAlpha, _fBeta, _fGamma, m_axis.m_origin);
+            m_axis = axisEulerZYX(_fAlpha, _fBeta, _fGamma, m_axis.m_origin, m_axis.m_fScale);
+            updateBounds();
         }
         
-        /* return axis aligned bounding volume */
+        /* return axis aligned bounding volume (view space; updated when the instance is moved or rotated) */
         const Bounds &bounds() const {
-            if (m_bDirtyBounds == true) {
-                std::lock_guard<std::mutex> lock(m_mutex);
-                
-                if (m_bDirtyBounds == true) {
-                    m_bounds = rotateBounds(m_pTarget->bounds(), m_axis);
-                    m_bDirtyBounds = false;
-                }
-            }
-            
             return m_bounds;
         }
         
+     private:
+        void updateBounds() {
+            m_bounds = rotateBounds(m_pTarget->bounds(), m_axis);
+        }
+        
      private:
         const Primitive             *m_pTarget;
         Axis                        m_axis;
         bool                        m_bOwner;
-        
-        mutable std::mutex          m_mutex;
-        mutable Bounds              m_bounds;
-        mutable std::atomic<bool>   m_bDirtyBounds;
+        Bounds                      m_bounds;
     };
     
 
@@ -0,0 +1,209 @@
+#ifndef LIBS_HEADER_PRIMITIVE_GROUP_H
+#define LIBS_HEADER_PRIMITIVE_GROUP_H
+
+#include "arena.h"
+#include "bvh.h"
+#include "constants.h"
+#include "counters.h"
+#include "intersect.h"
+#include "primitive.h"
+#include "ray.h"
+#include "vec3.h"
+
+#include <cassert>
+#include <vector>
+
+
+namespace LNF
+{
+    /*
+     Primitive group (prototype sub-scene with its own BVH).
+     Group instances are placed in group space; the group itself is instanced like any other primitive, so a
+     scene of many copies stores the prototypes once plus one PrimitiveInstance per copy (two-level instancing).
+     The view ray is transformed once into group space by the outer instance, then once more per prototype
+     instance tested in the group BVH.
+
+     Groups can not be nested (group instances may not reference another group) and have to be built before they
+     are instanced. Emissive prototypes still emit light, but are not sampled directly (not in the scene lights).
+     API could be accessed by multiple worker threads concurrently (after build()).
+     */
+    class PrimitiveGroup    : public Primitive
+    {
+     public:
+        PrimitiveGroup()
+        {}
+
+        /* Groups have no single material (see material(const Intersect &)) */
+        virtual const Material *material() const override {
+            return nullptr;
+        }
+
+        /* Returns the material of the prototype instance that was hit */
+        virtual const Material *material(const Intersect &_hit) const override {
+            return _hit.m_pGroupInstance->material();
+        }
+
+        /*
+         Quick node hit check (ray in group space).
+         Prototype instances are tested with the group space ray as their view ray; on a hit the prototype attributes
+         are kept (for intersect()), with the group space ray and distance restored.
+         */
+        virtual bool hit(Intersect &_hit) const override {
+            ScopedCount tests(Counter::PRIMITIVE_TESTS);
+            const Ray viewRay = _hit.m_viewRay;
+            const Ray groupRay = _hit.m_priRay;
+
+            _hit.m_viewRay = groupRay;
+            HitCandidates candidates(_hit);
+            m_bvh.traverse(groupRay, groupRay.m_fMaxDist,
+                           [&](uint32_t _uOffset, uint32_t _uCount, float &_fMaxDist) {
+                               for (uint32_t i = _uOffset; i < _uOffset + _uCount; i++) {
+                                   tests.add();
+                                   auto &nh = candidates.next(_fMaxDist);
+                                   if ( (m_instances[i]->hit(nh) == true) &&
+                                        (nh.m_fViewPositionOnRay < _fMaxDist) )
+                                   {
+                                       _fMaxDist = nh.m_fViewPositionOnRay;
+                                       candidates.accept();
+                                   }
+                               }
+                           });
+
+            bool bHit = candidates.finish();
+            if (bHit == true) {
+                _hit.m_pGroupInstance = _hit.m_pPrimitive;
+                _hit.m_fPositionOnRay = _hit.m_fViewPositionOnRay;
+            }
+
+            _hit.m_viewRay = viewRay;
+            _hit.m_priRay = groupRay;
+            return bHit;
+        }
+
+        /* Occlusion check (ray in group space; stops at first hit) */
+        virtual bool occluded(const Ray &_ray, float _fMaxDist) const override {
+            ScopedCount tests(Counter::PRIMITIVE_TESTS);
+            return m_bvh.traverseAny(_ray, _fMaxDist,
+                                     [&](uint32_t _uOffset, uint32_t _uCount, float _fDist) {
+                                         for (uint32_t i = _uOffset; i < _uOffset + _uCount; i++) {
+                                             tests.add();
+                                             if (m_instances[i]->occluded(_ray, _fDist) == true) {
+                                                 return true;
+                                             }
+                                         }
+
+                                         return false;
+                                     });
+        }
+
+        /* Completes the Intersect properties (prototype completes the hit in its own space; results are moved to group space). */
+        virtual Intersect &intersect(Intersect &_hit) const override {
+            const auto *pInstance = _hit.m_pGroupInstance;
+            const auto &axis = pInstance->axis();
+            const Ray groupRay = _hit.m_priRay;
+            const float fPositionOnRay = _hit.m_fPositionOnRay;
+
+            // same prototype ray as tested by PrimitiveInstance::hit()
+            _hit.m_priRay = transformRayTo(groupRay, axis);
+            _hit.m_priRay.m_fMaxDist = groupRay.m_fMaxDist / axis.m_fScale;
+            _hit.m_fPositionOnRay = fPositionOnRay / axis.m_fScale;
+            pInstance->primitive()->intersect(_hit);
+
+            // back to group space (normals keep unit length under rotation and uniform scale)
+            _hit.m_position = axis.transformFrom(_hit.m_position);
+            _hit.m_normal = axis.rotateFrom(_hit.m_normal);
+            _hit.m_priRay = groupRay;
+            _hit.m_fPositionOnRay = fPositionOnRay;
+            return _hit;
+        }
+
+        /* returns bounds for shape (group space; valid after build()) */
+        virtual const Bounds &bounds() const override {
+            return m_bounds;
+        }
+
+        /* Add a prototype instance (group space transform; allocated from the scene arena, see createGroupInstance()) */
+        PrimitiveInstance *addPrimitiveInstance(PrimitiveInstance *_pInstance) {
+            assert(dynamic_cast<const PrimitiveGroup*>(_pInstance->primitive()) == nullptr);
+            m_instances.push_back(_pInstance);
+            return _pInstance;
+        }
+
+        /* Returns the number of prototype instances */
+        size_t instanceCount() const {
+            return m_instances.size();
+        }
+
+        /* Returns prototype instance (in BVH order once built) */
+        const PrimitiveInstance *instance(size_t _uIndex) const {
+            return m_instances[_uIndex];
+        }
+
+        /* build group BVH and bounds (has to be called before the group is instanced) */
+        void build(BvhBuildMethod _method = BvhBuildMethod::SAH, BvhWidth _width = BvhWidth::WIDE4) {
+            if (m_instances.empty() == false) {
+                m_bounds = findBounds(m_instances);
+            }
+            
+            Arena buildArena;
+            auto pRoot = buildBvhRoot<2>(buildArena, m_instances, 16, _method);
+            m_bvhStats = LNF::bvhStats(pRoot);
+            m_bvh.build(pRoot, _width);
+
+            // instances in BVH leaf order (leaf ranges then index directly into instance list)
+            m_instances = m_bvh.primitives();
+            m_bvh.releasePrimitives();
+        }
+
+        /* returns BVH tree cost, depth and leaf size stats (from last build) */
+        const BvhStats &bvhStats() const {
+            return m_bvhStats;
+        }
+
+     private:
+        std::vector<const PrimitiveInstance*>   m_instances;    // owned by the scene arena
+        FlatBvh<PrimitiveInstance>              m_bvh;
+        BvhStats                                m_bvhStats;
+        Bounds                                  m_bounds;
+    };
+
+
+    // create primitive group (in the scene arena) and add to scene as a resource
+    template <typename scene_ptr_type>
+    PrimitiveGroup *createPrimitiveGroup(scene_ptr_type &_pScene) {
+        return static_cast<PrimitiveGroup*>(
+            _pScene->addResource(
+                _pScene->arena().template create<PrimitiveGroup>()
+            )
+        );
+    }
+
+
+    // create new prototype instance in a group that only references the provided primitive resource
+    template <typename scene_ptr_type>
+    PrimitiveInstance *createGroupInstance(scene_ptr_type &_pScene, PrimitiveGroup *_pGroup, const Axis &_axis, const Primitive *_pPrimitive) {
+        return _pGroup->addPrimitiveInstance(
+            _pScene->arena().template create<PrimitiveInstance>(
+                _pPrimitive,
+                _axis
+            )
+        );
+    }
+
+
+    // create new prototype instance in a group with its own primitive (primitive is not added as a shared resource)
+    template <typename primitive_type, typename scene_ptr_type, class... T>
+    PrimitiveInstance *createGroupInstance(scene_ptr_type &_pScene, PrimitiveGroup *_pGroup, const Axis &_axis, T ... t) {
+        return _pGroup->addPrimitiveInstance(
+            _pScene->arena().template create<PrimitiveInstance>(
+                _pScene->arena().template create<primitive_type>(t ...),
+                _axis
+            )
+        );
+    }
+
+
+};  // namespace LNF
+
+
+#endif  // #ifndef LIBS_HEADER_PRIMITIVE_GROUP_H
@@ -3,6 +3,7 @@
 #define LIBS_HEADER_PROFILE_H
 
 #include <chrono>
+#include <cstdio>
 
 
 namespace LNF
@@ -5,7 +5,10 @@
 #include "constants.h"
 #include "random.h"
 
+#include <algorithm>
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
 #include <queue>
 
@@ -1,13 +1,62 @@
 #ifndef LIBS_HEADER_RANDOM_H
 #define LIBS_HEADER_RANDOM_H
 
+#include <cstdint>
 #include <random>
 #include <thread>
 
 
 namespace LNF
 {
-    using default_rand_type = std::mt19937;
+    /*
+     PCG32 random number generator (https://www.pcg-random.org, pcg32_random_r).
+     Small state (128bit), fast to seed and step, and seeds with a stream (sequence) selector.
+     */
+    class Pcg32
+    {
+     public:
+        using result_type = uint32_t;
+
+        static constexpr uint64_t DEFAULT_STATE     = 0x853c49e6748fea9bULL;
+        static constexpr uint64_t DEFAULT_STREAM    = 0xda3e39cb94b95bdbULL;
+        static constexpr uint64_t MULTIPLIER        = 6364136223846793005ULL;
+
+     public:
+        Pcg32() noexcept
+            :m_uState(DEFAULT_STATE),
+             m_uIncrement(DEFAULT_STREAM)
+        {}
+
+        explicit Pcg32(uint64_t _uSeed, uint64_t _uStream = DEFAULT_STREAM) noexcept {
+            seed(_uSeed, _uStream);
+        }
+
+        void seed(uint64_t _uSeed, uint64_t _uStream = DEFAULT_STREAM) {
+            m_uState = 0;
+            m_uIncrement = (_uStream << 1) | 1;
+            (*this)();
+            m_uState += _uSeed;
+            (*this)();
+        }
+
+        result_type operator()() {
+            uint64_t uOld = m_uState;
+            m_uState = uOld * MULTIPLIER + m_uIncrement;
+            auto uXorShifted = (uint32_t)(((uOld >> 18) ^ uOld) >> 27);
+            auto uRot = (uint32_t)(uOld >> 59);
+            return (uXorShifted >> uRot) | (uXorShifted << ((-uRot) & 31));
+        }
+
+        static constexpr result_type min() {return 0;}
+        static constexpr result_type max() {return UINT32_MAX;}
+
+     private:
+        uint64_t    m_uState;
+        uint64_t    m_uIncrement;
+    };
+
+
+    using default_rand_type = Pcg32;
 
     // global random number generator
     template <typename generator_type = default_rand_type>
@@ -31,6 +80,42 @@ namespace LNF
         generator<generator_type>().seed(noise());
     }
 
+
+    // returns a random float in [0, 1) (24 bits, without a distribution object)
+    inline float random01() {
+        return (generator()() >> 8) * (1.0f / 16777216.0f);
+    }
+
+
+    // returns a random index in [0, _uCount)
+    inline uint32_t randomIndex(uint32_t _uCount) {
+        return (uint32_t)(((uint64_t)generator()() * _uCount) >> 32);
+    }
+
+
+    // 64bit hash/mixer (splitmix64 finaliser)
+    inline uint64_t hash64(uint64_t _uValue) {
+        _uValue = (_uValue ^ (_uValue >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        _uValue = (_uValue ^ (_uValue >> 27)) * 0x94d049bb133111ebULL;
+        return _uValue ^ (_uValue >> 31);
+    }
+
+
+    // 32bit hash/mixer (lowbias32)
+    inline uint32_t hash32(uint32_t _uValue) {
+        _uValue ^= _uValue >> 16;
+        _uValue *= 0x7feb352dU;
+        _uValue ^= _uValue >> 15;
+        _uValue *= 0x846ca68bU;
+        return _uValue ^ (_uValue >> 16);
+    }
+
+
+    // combine hash with value
+    inline uint32_t hashCombine(uint32_t _uSeed, uint32_t _uValue) {
+        return _uSeed ^ (_uValue + (_uSeed << 6) + (_uSeed >> 2));
+    }
+
 };  // namespace LNF
 
 
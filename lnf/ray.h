@@ -15,6 +15,10 @@
 namespace LNF
 {
     /* ray with origin and direction */
+    /*
+     Ray with precomputed inverse direction and direction sign mask (bit 0/1/2 set for negative x/y/z),
+     so that slab tests can pick the near and far box planes directly.
+     */
     struct Ray
     {
         static constexpr float MIN_DIST = 1e-4f;
@@ -29,9 +33,10 @@ namespace LNF
         Ray(U &&_origin, V &&_direction) noexcept
             :m_origin(std::forward<U>(_origin)),
              m_direction(std::forward<V>(_direction)),
-             m_invDirection(1/_direction),
+             m_invDirection(1/m_direction),
              m_fMinDist(MIN_DIST),
-             m_fMaxDist(MAX_DIST)
+             m_fMaxDist(MAX_DIST),
+             m_uSignMask(signMask(m_direction))
         {}
 
         Ray &operator=(const Ray &) noexcept = default;
@@ -45,11 +50,21 @@ namespace LNF
             return (_ft <= m_fMaxDist) && (_ft >= m_fMinDist);
         }
 
-        Vec     m_origin;
-        Vec     m_direction;
-        Vec     m_invDirection;
-        float   m_fMinDist;
-        float   m_fMaxDist;
+        /* returns true if the direction is negative along axis _iAxis */
+        bool negative(int _iAxis) const {
+            return (m_uSignMask >> _iAxis) & 1;
+        }
+        
+        static uint32_t signMask(const Vec &_direction) {
+            return (_direction.x() < 0 ? 1u : 0u) | (_direction.y() < 0 ? 2u : 0u) | (_direction.z() < 0 ? 4u : 0u);
+        }
+
+        Vec         m_origin;
+        Vec         m_direction;
+        Vec         m_invDirection;
+        float       m_fMinDist;
+        float       m_fMaxDist;
+        uint32_t    m_uSignMask;
     };
 
 
@@ -95,11 +110,10 @@ namespace LNF
         // https://graphics.stanford.edu/courses/cs148-10-summer/docs/2006--degreve--reflection_refraction.pdf
         float cosi = -_vec * _normal;
         float k = sqr(_fEtaiOverEtat) * (1 - sqr(cosi));
-        std::uniform_real_distribution<float> uniform01(0, 1);
         
         // k > 1 ==> total internal reflection
         if ( (k > 1) ||
-             (uniform01(generator()) < schlick(cosi, _fEtaiOverEtat)) )
+             (random01() < schlick(cosi, _fEtaiOverEtat)) )
         {
             // total internal reflection
             return _vec + _normal * 2 * cosi;
@@ -121,15 +135,39 @@ namespace LNF
     }
 
 
-    /* ray-box intersection (_invDir = 1 / ray_direction) */
+    /* ray-box entry/exit distances (near and far planes picked with the ray sign mask, no per axis min/max) */
+    inline void aaboxSlabs(const Bounds &_box, const Ray &_ray, float &_fTMin, float &_fTMax) {
+        const Vec &o = _ray.m_origin;
+        const Vec &inv = _ray.m_invDirection;
+        const uint32_t s = _ray.m_uSignMask;
+        
+        const float txn = (((s & 1) ? _box.m_max.x() : _box.m_min.x()) - o.x()) * inv.x();
+        const float txf = (((s & 1) ? _box.m_min.x() : _box.m_max.x()) - o.x()) * inv.x();
+        const float tyn = (((s & 2) ? _box.m_max.y() : _box.m_min.y()) - o.y()) * inv.y();
+        const float tyf = (((s & 2) ? _box.m_min.y() : _box.m_max.y()) - o.y()) * inv.y();
+        const float tzn = (((s & 4) ? _box.m_max.z() : _box.m_min.z()) - o.z()) * inv.z();
+        const float tzf = (((s & 4) ? _box.m_min.z() : _box.m_max.z()) - o.z()) * inv.z();
+        
+        _fTMin = std::max(std::max(txn, tyn), tzn);
+        _fTMax = std::min(std::min(txf, tyf), tzf);
+    }
+
+
+    /* ray-box intersection */
     inline bool aaboxIntersectCheck(const Bounds &_box, const Ray &_ray) {
-        return aaboxIntersectCheck(_box, _ray.m_origin, _ray.m_invDirection);
+        float tmin, tmax;
+        aaboxSlabs(_box, _ray, tmin, tmax);
+        return tmin < tmax;
     }
 
 
-    /* ray-box intersection (_invDir = 1 / ray_direction) */
+    /* ray-box intersection */
     inline AABoxItersect aaboxIntersect(const Bounds &_box, const Ray &_ray) {
-        return aaboxIntersect(_box, _ray.m_origin, _ray.m_invDirection);
+        AABoxItersect ret;
+        aaboxSlabs(_box, _ray, ret.m_tmin, ret.m_tmax);
+        ret.m_intersect = ret.m_tmin < ret.m_tmax;
+        ret.m_inside = ret.m_intersect && (ret.m_tmin < 0) && (ret.m_tmax > 0);
+        return ret;
     }
 
 
@@ -0,0 +1,147 @@
+#ifndef LIBS_HEADER_SAMPLER_H
+#define LIBS_HEADER_SAMPLER_H
+
+
+#include "random.h"
+#include "uv.h"
+
+#include <cstdint>
+#include <memory>
+
+
+namespace LNF
+{
+    /* Sampler types (sample sequences used for camera rays) */
+    enum class SamplerType
+    {
+        RANDOM,         // independent random samples
+        SOBOL           // Owen scrambled Sobol (0,2) sequence per dimension pair
+    };
+
+
+    /*
+     Pixel sample generator.
+     Samples are indexed by (pixel, sample, dimension), so the result does not depend on which thread traces a
+     sample or in which order. startSample() also seeds the thread's random generator for the rest of the path
+     (scattering, light sampling, etc.), which makes renders reproducible from the seed.
+     API could be accessed by multiple worker threads concurrently.
+     */
+    class Sampler
+    {
+     public:
+        Sampler(uint32_t _uSeed)
+            :m_uSeed(_uSeed)
+        {}
+
+        virtual ~Sampler() = default;
+
+        /* Seeds the thread's random generator for the given pixel sample */
+        void startSample(uint32_t _uPixel, uint32_t _uSample) const {
+            generator().seed(hash64(((uint64_t)_uPixel << 32) | _uSample), m_uSeed);
+        }
+
+        /* Returns a 2D sample point in [0, 1)^2 for the given pixel sample and dimension pair */
+        virtual Uv get2D(uint32_t _uPixel, uint32_t _uSample, uint32_t _uDimension) const = 0;
+
+     protected:
+        /* per pixel and dimension scramble seed */
+        uint32_t scrambleSeed(uint32_t _uPixel, uint32_t _uDimension) const {
+            return hash32(hashCombine(hashCombine(hash32(m_uSeed), _uPixel), _uDimension));
+        }
+
+     private:
+        uint32_t        m_uSeed;
+    };
+
+
+    /* Independent random samples (drawn from the thread's generator, after startSample()) */
+    class RandomSampler : public Sampler
+    {
+     public:
+        RandomSampler(uint32_t _uSeed)
+            :Sampler(_uSeed)
+        {}
+
+        virtual Uv get2D(uint32_t _uPixel, uint32_t _uSample, uint32_t _uDimension) const override {
+            return Uv(random01(), random01());
+        }
+    };
+
+
+    /*
+     Owen scrambled Sobol samples (first two Sobol dimensions, scrambled and shuffled per pixel and dimension pair).
+     Every power of 2 prefix of a pixel's samples is well stratified, which converges faster than random sampling
+     for pixel area and lens sampling.
+     See "Practical Hash-based Owen Scrambling" (Burley 2020).
+     */
+    class SobolSampler : public Sampler
+    {
+     public:
+        SobolSampler(uint32_t _uSeed)
+            :Sampler(_uSeed)
+        {}
+
+        virtual Uv get2D(uint32_t _uPixel, uint32_t _uSample, uint32_t _uDimension) const override {
+            uint32_t uSeed = scrambleSeed(_uPixel, _uDimension);
+            uint32_t uIndex = nestedUniformScramble(_uSample, uSeed);
+
+            uint32_t uX = nestedUniformScramble(reverseBits(uIndex), hashCombine(uSeed, 0));
+            uint32_t uY = nestedUniformScramble(sobol1(uIndex), hashCombine(uSeed, 1));
+
+            return Uv((uX >> 8) * (1.0f / 16777216.0f),
+                      (uY >> 8) * (1.0f / 16777216.0f));
+        }
+
+     private:
+        static uint32_t reverseBits(uint32_t _uValue) {
+            _uValue = ((_uValue >> 1) & 0x55555555U) | ((_uValue & 0x55555555U) << 1);
+            _uValue = ((_uValue >> 2) & 0x33333333U) | ((_uValue & 0x33333333U) << 2);
+            _uValue = ((_uValue >> 4) & 0x0f0f0f0fU) | ((_uValue & 0x0f0f0f0fU) << 4);
+            _uValue = ((_uValue >> 8) & 0x00ff00ffU) | ((_uValue & 0x00ff00ffU) << 8);
+            return (_uValue >> 16) | (_uValue << 16);
+        }
+
+        /* second Sobol dimension (first dimension is the bit reversed index) */
+        static uint32_t sobol1(uint32_t _uIndex) {
+            uint32_t uResult = 0;
+            for (uint32_t v = 1U << 31; _uIndex != 0; _uIndex >>= 1, v ^= v >> 1) {
+                if (_uIndex & 1) {
+                    uResult ^= v;
+                }
+            }
+
+            return uResult;
+        }
+
+        /* Laine-Karras style permutation (scrambles higher bits based on lower bits) */
+        static uint32_t laineKarrasPermutation(uint32_t _uValue, uint32_t _uSeed) {
+            _uValue += _uSeed;
+            _uValue ^= _uValue * 0x6c50b47cU;
+            _uValue ^= _uValue * 0xb82f1e52U;
+            _uValue ^= _uValue * 0xc7afe638U;
+            _uValue ^= _uValue * 0x8d22f6e6U;
+            return _uValue;
+        }
+
+        /* Owen scrambling (every bit flipped based on all higher bits) */
+        static uint32_t nestedUniformScramble(uint32_t _uValue, uint32_t _uSeed) {
+            return reverseBits(laineKarrasPermutation(reverseBits(_uValue), _uSeed));
+        }
+    };
+
+
+    /* create sampler of given type */
+    inline std::unique_ptr<Sampler> createSampler(SamplerType _type, uint32_t _uSeed) {
+        switch (_type) {
+            case SamplerType::RANDOM: return std::make_unique<RandomSampler>(_uSeed);
+            case SamplerType::SOBOL: return std::make_unique<SobolSampler>(_uSeed);
+        }
+
+        return nullptr;
+    }
+
+
+};  // namespace LNF
+
+
+#endif  // #ifndef LIBS_HEADER_SAMPLER_H
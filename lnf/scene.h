@@ -2,6 +2,7 @@
 #ifndef LIBS_HEADER_SCENE_H
 #define LIBS_HEADER_SCENE_H
 
+#include "arena.h"
 #include "constants.h"
 #include "intersect.h"
 #include "ray.h"
@@ -10,24 +11,59 @@
 
 #include <algorithm>
 #include <limits>
+#include <memory>
 #include <random>
+#include <vector>
 
 
 namespace LNF
 {
 
-    /* Scene (collection of primitives, BVH, etc.) */
+    /*
+     Scene (collection of primitives, BVH, etc.).
+     Scene resources are allocated from the scene arena and all released at once when the scene is destroyed.
+     */
     class Scene
     {
      public:
         virtual ~Scene() = default;
 
+        /* Scene lifetime arena (resources, instances) */
+        Arena &arena() {
+            return m_arena;
+        }
+
+        /* Scene memory usage */
+        const ArenaStats &memoryStats() const {
+            return m_arena.stats();
+        }
+
         /*
            Checks for an intersect with a scene object.
            Could be accessed by multiple worker threads concurrently.
          */
         virtual bool hit(Intersect &_hit) const = 0;
         
+        /*
+         Occlusion check: returns true on any hit closer than _fMaxDist.
+         Could be accessed by multiple worker threads concurrently.
+         Scenes should override this with an any-hit query (default uses hit()).
+         */
+        virtual bool occluded(const Ray &_ray, float _fMaxDist) const {
+            Intersect hit(_ray);
+            hit.m_viewRay.m_fMaxDist = _fMaxDist;
+            return this->hit(hit);
+        }
+        
+        /*
+         Returns the lights (emissive instances that can be sampled directly).
+         Could be accessed by multiple worker threads concurrently.
+         */
+        virtual const std::vector<const PrimitiveInstance*> &lights() const {
+            static const std::vector<const PrimitiveInstance*> noLights;
+            return noLights;
+        }
+        
         /*
          Checks for the background color (miss handler).
          Could be accessed by multiple worker threads concurrently.
@@ -35,25 +71,44 @@ namespace LNF
         virtual Color backgroundColor() const = 0;
         
         /*
-         Add a new resource (material, primitive, instance) to the scene.
+         Add a new resource (material, primitive, instance) allocated from the scene arena.
          May not be safe to call while worker threads are calling 'hit'/
          */
-        virtual Resource *addResource(std::unique_ptr<Resource> &&_pResource) = 0;
+        virtual Resource *addResource(Resource *_pResource) = 0;
 
         /*
-         Add a new primitive instance to the scene.
+         Add a new primitive instance allocated from the scene arena.
          May not be safe to call while worker threads are calling 'hit'/
          */
-        virtual PrimitiveInstance *addPrimitiveInstance(std::unique_ptr<PrimitiveInstance> &&_pInstance) = 0;
+        virtual PrimitiveInstance *addPrimitiveInstance(PrimitiveInstance *_pInstance) = 0;
+
+        /* Add a heap allocated resource (ownership moves to the scene arena) */
+        Resource *addResource(std::unique_ptr<Resource> &&_pResource) {
+            return addResource(m_arena.adopt(std::move(_pResource)));
+        }
+
+        /* Add a heap allocated primitive instance (ownership moves to the scene arena) */
+        PrimitiveInstance *addPrimitiveInstance(std::unique_ptr<PrimitiveInstance> &&_pInstance) {
+            return addPrimitiveInstance(m_arena.adopt(std::move(_pInstance)));
+        }
+        
+        /*
+         Updates acceleration structures after instances were moved (animation).
+         Not safe to call while worker threads are calling 'hit'.
+         */
+        virtual void update() {}
+
+     private:
+        Arena       m_arena;
     };
     
     
-    // create primitive and add to scene as a resource
+    // create primitive (in the scene arena) and add to scene as a resource
     template <typename primitive_type, typename scene_ptr_type, class... T>
     Primitive *createPrimitive(scene_ptr_type &_pScene, T ... t) {
         return static_cast<Primitive*>(
             _pScene->addResource(
-                std::make_unique<primitive_type>(t ...)
+                _pScene->arena().template create<primitive_type>(t ...)
             )
         );
     }
@@ -63,7 +118,7 @@ namespace LNF
     template <typename scene_ptr_type>
     PrimitiveInstance *createPrimitiveInstance(scene_ptr_type &_pScene, const Axis &_axis, const Primitive *_pPrimitive) {
         return _pScene->addPrimitiveInstance(
-            std::make_unique<PrimitiveInstance>(
+            _pScene->arena().template create<PrimitiveInstance>(
                 _pPrimitive,
                 _axis
             )
@@ -71,24 +126,24 @@ namespace LNF
     }
 
 
-    // create new primitive instance that owns a primitive (no other instancing possible)
+    // create new primitive instance with its own primitive (primitive is not added as a shared resource)
     template <typename primitive_type, typename scene_ptr_type, class... T>
     PrimitiveInstance *createPrimitiveInstance(scene_ptr_type &_pScene, const Axis &_axis, T ... t) {
         return _pScene->addPrimitiveInstance(
-            std::make_unique<PrimitiveInstance>(
-                std::make_unique<primitive_type>(t ...),
+            _pScene->arena().template create<PrimitiveInstance>(
+                _pScene->arena().template create<primitive_type>(t ...),
                 _axis
             )
         );
     }
 
 
-    // create material and add to scene as a resource
+    // create material (in the scene arena) and add to scene as a resource
     template <typename material_type, typename scene_ptr_type, class... T>
     Material *createMaterial(scene_ptr_type &_pScene, T ... t) {
         return static_cast<Material*>(
             _pScene->addResource(
-                std::make_unique<material_type>(t ...)
+                _pScene->arena().template create<material_type>(t ...)
             )
         );
     }
@@ -0,0 +1,486 @@
+#ifndef LIBS_HEADER_SCENE_FILE_H
+#define LIBS_HEADER_SCENE_FILE_H
+
+#include "animation.h"
+#include "box.h"
+#include "camera.h"
+#include "compact_mesh.h"
+#include "constants.h"
+#include "default_materials.h"
+#include "jobs.h"
+#include "json.h"
+#include "loaders.h"
+#include "mapped_file.h"
+#include "marched_bubbles.h"
+#include "marched_mandle.h"
+#include "marched_materials.h"
+#include "marched_sphere.h"
+#include "mesh.h"
+#include "mesh_file.h"
+#include "plane.h"
+#include "scene.h"
+#include "simple_scene.h"
+#include "smoke_box.h"
+#include "sphere.h"
+#include "texture.h"
+#include "vec3.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace LNF
+{
+    /*
+     Scene description file (JSON), so any scene can be rendered without compiling a Loader:
+
+       {
+         "settings":   {"width": 1024, "height": 768, "spp": 128, "depth": 64, ..},      (render defaults, see settings())
+         "camera":     {"origin": [x, y, z], "up": [0, 1, 0], "lookat": [x, y, z], "fov": 60, "aperture": 0, "focus": 100},
+         "animation":  {"frames": 240, "turntable": 8},                                   (optional camera turntable, seconds per turn)
+         "materials":  {"<name>": {"type": "glass", "color": [r, g, b], "scatter": 0.01, "ior": 1.8}, ..},
+         "primitives": {"<name>": {"type": "sphere", "radius": 10, "material": "<name>"}, ..},
+         "instances":  [{"primitive": "<name>", "position": [x, y, z], "rotation": [z, y, x], "scale": 1},
+                        {"type": "disc", "radius": 500, "material": "<name>", "position": [x, y, z]},
+                        {"primitive": "<name>", "positions": [x, y, z, x, y, z, ..]}, ..]
+       }
+
+     Material and primitive types (and their parameters) match the class names (Material::name(), e.g. "diffuse_checkered");
+     angles are in degrees. Instances either reference a named primitive or define one inline; "positions" places many
+     instances of one primitive with a flat coordinate array.
+     Identical definitions (same type and parameters) are created once and shared: named and inline primitives with the same
+     definition reference the same Primitive resource, materials and textures are shared the same way.
+     The file is parsed once from a memory mapping; instance axes (and definition keys) of large instance lists are converted
+     on all hardware threads before the instances are added to the scene.
+     */
+    class LoaderSceneFile  : public Loader
+    {
+     public:
+        static constexpr size_t PARALLEL_MIN_INSTANCES = 4096;     // convert smaller instance lists on the calling thread (also the chunk size of parallel conversion)
+
+     public:
+        explicit LoaderSceneFile(const std::string &_strPath)
+            :m_strPath(_strPath)
+        {
+            auto pFile = MappedFile::open(_strPath);
+            if (pFile == nullptr) {
+                fprintf(stderr, "ERROR: can't open scene file %s\n", _strPath.c_str());
+                return;
+            }
+
+            std::string strError;
+            m_bLoaded = JsonValue::parse((const char*)pFile->data(), pFile->size(), m_root, &strError);
+            if (m_bLoaded == false) {
+                fprintf(stderr, "ERROR: scene file %s: %s\n", _strPath.c_str(), strError.c_str());
+            }
+            else if (m_root.isObject() == false) {
+                fprintf(stderr, "ERROR: scene file %s: expected an object\n", _strPath.c_str());
+                m_bLoaded = false;
+            }
+        }
+
+        /* returns false if the file could not be read or parsed */
+        bool loaded() const {
+            return m_bLoaded;
+        }
+
+        virtual const char *name() const override {
+            return "scene_file";
+        }
+
+        /* render settings from the file ("width", "height", "spp", "depth", "threads", "seed", "tile", "pass", "wavefront", "output", "quality") */
+        const JsonValue &settings() const {
+            return m_root["settings"];
+        }
+
+        virtual std::unique_ptr<Scene> loadScene() const override {
+            auto pScene = std::make_unique<SimpleSceneBvh>();
+            Definitions definitions;
+
+            for (const auto &member : m_root["materials"].members()) {
+                auto pMaterial = material(pScene.get(), member.second, definitions);
+                if (pMaterial == nullptr) {
+                    fprintf(stderr, "ERROR: scene file %s: bad material '%s'\n", m_strPath.c_str(), member.first.c_str());
+                }
+                else {
+                    definitions.m_namedMaterialKeys[member.first] = definitionKey(member.second, definitions);
+                }
+
+                definitions.m_namedMaterials[member.first] = pMaterial;
+            }
+
+            for (const auto &member : m_root["primitives"].members()) {
+                auto pPrimitive = primitive(pScene.get(), member.second, definitionKey(member.second, definitions), definitions);
+                if (pPrimitive == nullptr) {
+                    fprintf(stderr, "ERROR: scene file %s: bad primitive '%s'\n", m_strPath.c_str(), member.first.c_str());
+                }
+
+                definitions.m_namedPrimitives[member.first] = pPrimitive;
+            }
+
+            const auto &instances = m_root["instances"].items();
+            std::vector<Axis> axes;
+            std::vector<size_t> offsets;
+            std::vector<std::string> keys;
+            convertInstances(instances, definitions, axes, offsets, keys);
+
+            for (size_t i = 0; i < instances.size(); i++) {
+                const auto &instance = instances[i];
+                if (offsets[i] == offsets[i + 1]) {
+                    continue;   // empty "positions"
+                }
+
+                const Primitive *pPrimitive = nullptr;
+                if (instance.has("primitive") == true) {
+                    auto it = definitions.m_namedPrimitives.find(instance["primitive"].string());
+                    pPrimitive = it != definitions.m_namedPrimitives.end() ? it->second : nullptr;
+                }
+                else {
+                    pPrimitive = primitive(pScene.get(), instance, keys[i], definitions);
+                }
+
+                if (pPrimitive == nullptr) {
+                    fprintf(stderr, "ERROR: scene file %s: bad primitive for instance %zu\n", m_strPath.c_str(), i);
+                    continue;
+                }
+
+                for (size_t j = offsets[i]; j < offsets[i + 1]; j++) {
+                    createPrimitiveInstance(pScene, axes[j], pPrimitive);
+                }
+            }
+
+            pScene->build();   // build BVH
+            return pScene;
+        }
+
+        virtual std::unique_ptr<Camera> loadCamera() const override {
+            const auto &camera = m_root["camera"];
+            return std::make_unique<SimpleCamera>(vec(camera["origin"], Vec(0, 0, -100)),
+                                                  vec(camera["up"], Vec(0, 1, 0)),
+                                                  vec(camera["lookat"], Vec(0, 0, 0)),
+                                                  deg2rad((float)camera["fov"].number(60)),
+                                                  (float)camera["aperture"].number(0),
+                                                  (float)camera["focus"].number(100));
+        }
+
+        // camera turntable (if the file has an "animation" with a "turntable" period)
+        virtual std::unique_ptr<Animation> loadAnimation(Scene *_pScene) const override {
+            const auto &animation = m_root["animation"];
+            if (animation.has("turntable") == false) {
+                return nullptr;
+            }
+
+            const auto &camera = m_root["camera"];
+            return std::make_unique<Animation>(turntablePath(vec(camera["origin"], Vec(0, 0, -100)),
+                                                             vec(camera["up"], Vec(0, 1, 0)),
+                                                             vec(camera["lookat"], Vec(0, 0, 0)),
+                                                             deg2rad((float)camera["fov"].number(60)),
+                                                             (float)camera["aperture"].number(0),
+                                                             (float)camera["focus"].number(100),
+                                                             (float)animation["turntable"].number(8)),
+                                               (int)animation["frames"].number(240));
+        }
+
+     private:
+        // resources created while loading a scene (shared by definition key and by name)
+        struct Definitions
+        {
+            std::map<std::string, const Material*>      m_materials;            // by definition key
+            std::map<std::string, const Material*>      m_namedMaterials;
+            std::map<std::string, std::string>          m_namedMaterialKeys;    // name -> definition key (valid materials only)
+            std::map<std::string, const Primitive*>     m_primitives;           // by definition key
+            std::map<std::string, const Primitive*>     m_namedPrimitives;
+            std::map<std::string, const Texture*>       m_textures;             // by path
+        };
+
+        static Vec vec(const JsonValue &_value, const Vec &_default) {
+            if (_value.isNumber() == true) {
+                const float f = (float)_value.number();
+                return Vec(f, f, f);
+            }
+
+            if ( (_value.isArray() == false) || (_value.size() != 3) ) {
+                return _default;
+            }
+
+            return Vec((float)_value[0].number(), (float)_value[1].number(), (float)_value[2].number());
+        }
+
+        static Color color(const JsonValue &_value, const Color &_default) {
+            if ( (_value.isArray() == false) || (_value.size() != 3) ) {
+                return _default;
+            }
+
+            return Color((float)_value[0].number(), (float)_value[1].number(), (float)_value[2].number());
+        }
+
+        static MarchSettings marchSettings(const JsonValue &_value) {
+            MarchSettings settings;
+            settings.m_iMaxSteps = (int)_value["steps"].number(settings.m_iMaxSteps);
+            settings.m_fEpsilon = (float)_value["epsilon"].number(settings.m_fEpsilon);
+            settings.m_fEpsilonGrowth = (float)_value["epsilon_growth"].number(settings.m_fEpsilonGrowth);
+            settings.m_fRelaxation = (float)_value["relaxation"].number(settings.m_fRelaxation);
+            settings.m_fCrossingScale = (float)_value["crossing_scale"].number(settings.m_fCrossingScale);
+            return settings;
+        }
+
+        /*
+         Returns the definition key of a material or primitive (type and parameters, independent of member order).
+         Placement members are skipped and material names are replaced by the definition key of the (shared) material they
+         resolve to, so equal definitions get equal keys. Names that don't resolve to a material are kept as they are.
+         */
+        static std::string definitionKey(const JsonValue &_def, const Definitions &_definitions) {
+            std::vector<std::string> members;
+            for (const auto &member : _def.members()) {
+                const auto &strName = member.first;
+                if ( (strName == "position") || (strName == "positions") || (strName == "rotation") || (strName == "scale") ) {
+                    continue;
+                }
+
+                if (strName == "material") {
+                    auto it = _definitions.m_namedMaterialKeys.find(member.second.string());
+                    if (it != _definitions.m_namedMaterialKeys.end()) {
+                        members.push_back(strName + ":{" + it->second + "}");
+                    }
+                    else {
+                        members.push_back(strName + ":unresolved:" + member.second.dump());
+                    }
+                }
+                else {
+                    members.push_back(strName + ":" + member.second.dump());
+                }
+            }
+
+            std::sort(members.begin(), members.end());
+
+            std::string strKey;
+            for (const auto &strMember : members) {
+                strKey += strMember;
+                strKey += ',';
+            }
+
+            return strKey;
+        }
+
+        /* returns shared material for definition (nullptr for unknown types) */
+        static const Material *material(Scene *_pScene, const JsonValue &_def, Definitions &_definitions) {
+            const std::string strKey = definitionKey(_def, _definitions);
+            auto it = _definitions.m_materials.find(strKey);
+            if (it != _definitions.m_materials.end()) {
+                return it->second;
+            }
+
+            const std::string strType = _def["type"].string("");
+            const Color col = color(_def["color"], Color(0.8f, 0.8f, 0.8f));
+            const Material *pMaterial = nullptr;
+            if (strType == "diffuse") {
+                pMaterial = createMaterial<Diffuse>(_pScene, col);
+            }
+            else if (strType == "diffuse_checkered") {
+                pMaterial = createMaterial<DiffuseCheckered>(_pScene, col, color(_def["color2"], Color(0.2f, 0.2f, 0.2f)), (int)_def["block"].number(2));
+            }
+            else if (strType == "diffuse_mandlebrot") {
+                pMaterial = createMaterial<DiffuseMandlebrot>(_pScene, (int)_def["bake"].number(0));
+            }
+            else if (strType == "diffuse_texture") {
+                const std::string strPath = _def["texture"].string("");
+                auto &pTexture = _definitions.m_textures[strPath];
+                if (pTexture == nullptr) {
+                    pTexture = createTexture(_pScene, strPath);
+                }
+
+                if (pTexture->valid() == true) {
+                    pMaterial = createMaterial<DiffuseTexture>(_pScene, pTexture, (float)_def["lod"].number(0), color(_def["tint"], Color(1, 1, 1)));
+                }
+            }
+            else if (strType == "light") {
+                pMaterial = createMaterial<Light>(_pScene, color(_def["color"], Color(10.0f, 10.0f, 10.0f)));
+            }
+            else if (strType == "metal") {
+                pMaterial = createMaterial<Metal>(_pScene, col, (float)_def["scatter"].number(0));
+            }
+            else if (strType == "glass") {
+                pMaterial = createMaterial<Glass>(_pScene, col, (float)_def["scatter"].number(0), (float)_def["ior"].number(1.5));
+            }
+            else if (strType == "surface_normal") {
+                pMaterial = createMaterial<SurfaceNormal>(_pScene, _def["inside"].boolean(false));
+            }
+            else if (strType == "triangle_rgb") {
+                pMaterial = createMaterial<TriangleRGB>(_pScene);
+            }
+            else if (strType == "fake_ambient_occlusion") {
+                pMaterial = createMaterial<FakeAmbientOcclusion>(_pScene);
+            }
+            else if (strType == "metal_iterations") {
+                pMaterial = createMaterial<MetalIterations>(_pScene);
+            }
+            else if (strType == "glow") {
+                pMaterial = createMaterial<Glow>(_pScene);
+            }
+
+            if (pMaterial != nullptr) {
+                _definitions.m_materials[strKey] = pMaterial;
+            }
+
+            return pMaterial;
+        }
+
+        /* returns shared primitive for definition (nullptr for unknown types, unknown materials or meshes that failed to load) */
+        static const Primitive *primitive(Scene *_pScene, const JsonValue &_def, const std::string &_strKey, Definitions &_definitions) {
+            auto it = _definitions.m_primitives.find(_strKey);
+            if (it != _definitions.m_primitives.end()) {
+                return it->second;
+            }
+
+            auto itMaterial = _definitions.m_namedMaterials.find(_def["material"].string(""));
+            const Material *pMaterial = itMaterial != _definitions.m_namedMaterials.end() ? itMaterial->second : nullptr;
+            const std::string strType = _def["type"].string("");
+            if ( (pMaterial == nullptr) && (strType != "mesh") ) {
+                return nullptr;
+            }
+
+            const float fSize = (float)_def["size"].number(1);
+            const Vec size = vec(_def["size"], Vec(1, 1, 1));
+            const Primitive *pPrimitive = nullptr;
+            if (strType == "sphere") {
+                pPrimitive = createPrimitive<Sphere>(_pScene, (float)_def["radius"].number(1), pMaterial);
+            }
+            else if (strType == "disc") {
+                pPrimitive = createPrimitive<Disc>(_pScene, (float)_def["radius"].number(1), pMaterial, (float)_def["uv_scale"].number(0.02));
+            }
+            else if (strType == "rectangle") {
+                pPrimitive = createPrimitive<Rectangle>(_pScene, (float)_def["width"].number(1), (float)_def["length"].number(1), pMaterial, (float)_def["uv_scale"].number(0.02));
+            }
+            else if (strType == "box") {
+                pPrimitive = createPrimitive<Box>(_pScene, size, pMaterial, (float)_def["uv_scale"].number(0.2));
+            }
+            else if (strType == "smoke_box") {
+                pPrimitive = createPrimitive<SmokeBox>(_pScene, size, pMaterial, (float)_def["visibility"].number(1));
+            }
+            else if (strType == "sphere_mesh") {
+                pPrimitive = createPrimitive<SphereMesh>(_pScene, (int)_def["slices"].number(16), (int)_def["divs"].number(16), (float)_def["radius"].number(1), pMaterial);
+            }
+            else if (strType == "marched_sphere") {
+                pPrimitive = createPrimitive<MarchedSphere>(_pScene, fSize, pMaterial, (float)_def["wave"].number(0), marchSettings(_def["march"]));
+            }
+            else if (strType == "marched_bubbles") {
+                pPrimitive = createPrimitive<MarchedBubbles>(_pScene, fSize, pMaterial, marchSettings(_def["march"]));
+            }
+            else if (strType == "marched_mandle") {
+                pPrimitive = createPrimitive<MarchedMandle>(_pScene, pMaterial, marchSettings(_def["march"]), (int)_def["bake"].number(0));
+            }
+            else if (strType == "mesh") {
+                // mesh is loaded (or mapped from its cache) once; without a material the surface normal is shown
+                if (pMaterial == nullptr) {
+                    pMaterial = createMaterial<SurfaceNormal>(_pScene);
+                }
+
+                const std::string strPath = _def["path"].string("");
+                if (_def["compact"].boolean(false) == true) {
+                    auto pFile = std::make_unique<MeshFile>(strPath, pMaterial);
+                    if (pFile->loaded() == true) {
+                        pPrimitive = static_cast<Primitive*>(_pScene->addResource(_pScene->arena().template create<CompactMesh>(*pFile, pMaterial)));
+                    }
+                }
+                else {
+                    auto pFile = _pScene->arena().template create<MeshFile>(strPath, pMaterial);
+                    _pScene->addResource(pFile);
+                    if (pFile->loaded() == true) {
+                        pPrimitive = pFile;
+                    }
+                }
+            }
+
+            if (pPrimitive != nullptr) {
+                _definitions.m_primitives[_strKey] = pPrimitive;
+            }
+
+            return pPrimitive;
+        }
+
+        /* returns instance axis (rotation in degrees, Euler ZYX) */
+        static Axis instanceAxis(const JsonValue &_instance, const Vec &_position) {
+            const float fScale = (float)_instance["scale"].number(1);
+            if (_instance.has("rotation") == false) {
+                return axisTranslation(_position, fScale);
+            }
+
+            const Vec rotation = vec(_instance["rotation"], Vec(0, 0, 0));
+            return axisEulerZYX(deg2rad(rotation.x()), deg2rad(rotation.y()), deg2rad(rotation.z()), _position, fScale);
+        }
+
+        /*
+         Converts all instance placements to axes (_axes[_offsets[i]] to _axes[_offsets[i + 1]] belong to instance i) and creates the
+         definition keys of inline primitives. Materials have to be created before (keys reference them); the scene is not touched,
+         so large instance lists are converted in chunks on a temporary worker pool.
+         */
+        static void convertInstances(const std::vector<JsonValue> &_instances, const Definitions &_definitions,
+                                     std::vector<Axis> &_axes, std::vector<size_t> &_offsets, std::vector<std::string> &_keys)
+        {
+            _offsets.assign(1, 0);
+            for (const auto &instance : _instances) {
+                const auto &positions = instance["positions"];
+                _offsets.push_back(_offsets.back() + (positions.isArray() == true ? positions.size() / 3 : 1));
+            }
+
+            _axes.resize(_offsets.back());
+            _keys.resize(_instances.size());
+
+            // placements [_uBegin, _uEnd); every instance key is created by the chunk converting its first placement
+            auto convert = [&](size_t _uBegin, size_t _uEnd) {
+                size_t i = std::upper_bound(_offsets.begin(), _offsets.end(), _uBegin) - _offsets.begin() - 1;
+                for (size_t j = _uBegin; j < _uEnd; j++) {
+                    while (j >= _offsets[i + 1]) {
+                        i++;
+                    }
+
+                    const auto &instance = _instances[i];
+                    if (j == _offsets[i]) {
+                        if (instance.has("primitive") == false) {
+                            _keys[i] = definitionKey(instance, _definitions);
+                        }
+                    }
+
+                    const auto &positions = instance["positions"];
+                    if (positions.isArray() == true) {
+                        const size_t k = (j - _offsets[i]) * 3;
+                        _axes[j] = instanceAxis(instance, Vec((float)positions[k].number(), (float)positions[k + 1].number(), (float)positions[k + 2].number()));
+                    }
+                    else {
+                        _axes[j] = instanceAxis(instance, vec(instance["position"], Vec(0, 0, 0)));
+                    }
+                }
+            };
+
+            const size_t uCount = _axes.size();
+            if ( (uCount < PARALLEL_MIN_INSTANCES) || (std::thread::hardware_concurrency() <= 1) ) {
+                convert(0, uCount);
+                return;
+            }
+
+            WorkerPool pool;
+            TaskGroup tasks(pool.jobs());
+            for (size_t uBegin = 0; uBegin < uCount; uBegin += PARALLEL_MIN_INSTANCES) {
+                tasks.run([&, uBegin]{
+                    convert(uBegin, std::min(uBegin + PARALLEL_MIN_INSTANCES, uCount));
+                });
+            }
+
+            tasks.wait();
+        }
+
+     private:
+        std::string     m_strPath;
+        JsonValue       m_root;
+        bool            m_bLoaded = false;
+    };
+
+};  // namespace LNF
+
+
+#endif  // #ifndef LIBS_HEADER_SCENE_FILE_H
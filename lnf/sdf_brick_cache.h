@@ -0,0 +1,270 @@
+#ifndef LIBS_HEADER_SDF_BRICK_CACHE_H
+#define LIBS_HEADER_SDF_BRICK_CACHE_H
+
+#include "constants.h"
+#include "jobs.h"
+#include "vec3.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+
+namespace LNF
+{
+    /*
+     Sparse brick cache for static signed distance fields (baked once, read by many threads).
+     The bounds are split into bricks of BRICK_SIZE^3 voxels. Bricks far from the surface only store a
+     conservative distance bound; bricks near the surface store (BRICK_SIZE + 1)^3 distance samples (and fractal
+     iteration counts) for trilinear lookups.
+     Distance estimates that under-estimate (fractals, etc.) are rescaled per brick by their sampled gradient, so
+     lookups return (approximate) euclidean distances and allow longer steps than the analytic SDF. Far brick bounds
+     are never larger than the unscaled centre distance (centre gradients miss thin features).
+     Lookups are only accurate to about a voxel, so the marcher should switch to the analytic SDF close to the surface.
+     */
+    class SdfBrickCache
+    {
+     public:
+        static const int BRICK_SIZE         = 8;                    // voxels per brick side
+        static const int BRICK_SAMPLES      = BRICK_SIZE + 1;       // samples per brick side (corners shared with neighbours)
+        static constexpr float GRADIENT_SAFETY  = 1.5f;             // sampled gradients are scaled up by this (features between samples)
+        static constexpr float GRADIENT_MIN     = 0.01f;            // lower limit for sampled gradients
+        static const int BAKE_CHUNK_BRICKS  = 16;                   // near bricks sampled per job
+
+     public:
+        SdfBrickCache()
+            :m_iBricks(0),
+             m_fVoxelSize(0)
+        {}
+
+        /* returns true if nothing was baked */
+        bool empty() const {
+            return m_bricks.empty();
+        }
+
+        /*
+         Samples _sdf (float(const Vec &, int &iterations)) into _iBricks^3 bricks inside _bounds (near bricks are sampled on a worker pool).
+         Far bricks are classified from the brick centre distances (and their gradients) only.
+         */
+        template <typename sdf_func>
+        void bake(const Bounds &_bounds, int _iBricks, const sdf_func &_sdf) {
+            m_bounds = _bounds;
+            m_iBricks = std::max(_iBricks, 2);
+            m_brickSize = (_bounds.m_max - _bounds.m_min) / (float)m_iBricks;
+            m_invBrickSize = Vec(1.0f / m_brickSize.x(), 1.0f / m_brickSize.y(), 1.0f / m_brickSize.z());
+            m_fVoxelSize = std::max(std::max(m_brickSize.x(), m_brickSize.y()), m_brickSize.z()) / BRICK_SIZE;
+            m_bricks = std::vector<Brick>((size_t)m_iBricks * m_iBricks * m_iBricks);
+            m_distances.clear();
+            m_iterations.clear();
+
+            // brick centre distances
+            std::vector<float> centres(m_bricks.size());
+            for (int z = 0; z < m_iBricks; z++) {
+                for (int y = 0; y < m_iBricks; y++) {
+                    for (int x = 0; x < m_iBricks; x++) {
+                        int iIterations = 0;
+                        centres[brickIndex(x, y, z)] = _sdf(m_bounds.m_min + perElementScale(Vec(x + 0.5f, y + 0.5f, z + 0.5f), m_brickSize), iIterations);
+                    }
+                }
+            }
+
+            // classify bricks (far bricks keep a distance bound, near bricks are sampled)
+            const float fHalfDiagonal = m_brickSize.size() * 0.5f;
+            const float fBand = fHalfDiagonal + voxelDiagonal() * 2;
+            std::vector<size_t> denseBricks;
+
+            for (int z = 0; z < m_iBricks; z++) {
+                for (int y = 0; y < m_iBricks; y++) {
+                    for (int x = 0; x < m_iBricks; x++) {
+                        auto &brick = m_bricks[brickIndex(x, y, z)];
+                        float d = centres[brickIndex(x, y, z)];
+                        float fGradient = centreGradient(centres, x, y, z);
+                        
+                        const float fDist = std::min(fabs(d) / fGradient, fabs(d));
+                        if (fDist > fBand) {
+                            brick.m_fBound = d > 0 ? fDist - fHalfDiagonal : fHalfDiagonal - fDist;
+                            brick.m_fScale = 1.0f;
+                            brick.m_iDense = -1;
+                        }
+                        else {
+                            brick.m_fBound = 0;
+                            brick.m_fScale = 1.0f;
+                            brick.m_iDense = (int32_t)denseBricks.size();
+                            denseBricks.push_back(brickIndex(x, y, z));
+                        }
+                    }
+                }
+            }
+
+            // sample near bricks
+            const size_t uBrickSamples = BRICK_SAMPLES * BRICK_SAMPLES * BRICK_SAMPLES;
+            m_distances.resize(denseBricks.size() * uBrickSamples);
+            m_iterations.resize(denseBricks.size() * uBrickSamples);
+
+            auto sampleBricks = [&](size_t _uBegin, size_t _uEnd) {
+                for (size_t i = _uBegin; i < _uEnd; i++) {
+                    auto uBrick = denseBricks[i];
+                    auto brickMin = m_bounds.m_min + perElementScale(Vec((float)(uBrick % m_iBricks),
+                                                                         (float)(uBrick / m_iBricks % m_iBricks),
+                                                                         (float)(uBrick / m_iBricks / m_iBricks)),
+                                                                     m_brickSize);
+
+                    size_t uSample = i * uBrickSamples;
+                    for (int z = 0; z < BRICK_SAMPLES; z++) {
+                        for (int y = 0; y < BRICK_SAMPLES; y++) {
+                            for (int x = 0; x < BRICK_SAMPLES; x++, uSample++) {
+                                int iIterations = 0;
+                                m_distances[uSample] = _sdf(brickMin + perElementScale(Vec((float)x, (float)y, (float)z), m_brickSize) / BRICK_SIZE, iIterations);
+                                m_iterations[uSample] = (uint8_t)std::min(iIterations, (int)UINT8_MAX);
+                            }
+                        }
+                    }
+                    
+                    m_bricks[uBrick].m_fScale = 1.0f / sampleGradient(i);
+                }
+            };
+
+            if ( (denseBricks.size() <= BAKE_CHUNK_BRICKS) || (std::thread::hardware_concurrency() <= 1) ) {
+                sampleBricks(0, denseBricks.size());
+                return;
+            }
+
+            WorkerPool pool;
+            TaskGroup tasks(pool.jobs());
+            for (size_t uBegin = 0; uBegin < denseBricks.size(); uBegin += BAKE_CHUNK_BRICKS) {
+                tasks.run([&, uBegin]{
+                    sampleBricks(uBegin, std::min(uBegin + BAKE_CHUNK_BRICKS, denseBricks.size()));
+                });
+            }
+
+            tasks.wait();
+        }
+
+        /* returns the (approximate) euclidean distance at _p (inside bounds) and the iteration count of the nearest sample */
+        float distance(const Vec &_p, int &_iterations) const {
+            auto g = perElementScale(_p, m_bounds.m_min, m_invBrickSize);
+            int bx = std::clamp((int)g.x(), 0, m_iBricks - 1);
+            int by = std::clamp((int)g.y(), 0, m_iBricks - 1);
+            int bz = std::clamp((int)g.z(), 0, m_iBricks - 1);
+
+            const auto &brick = m_bricks[brickIndex(bx, by, bz)];
+            if (brick.m_iDense < 0) {
+                _iterations = 0;
+                return brick.m_fBound;
+            }
+
+            // voxel and trilinear weights inside brick
+            float fx = std::clamp((g.x() - bx) * BRICK_SIZE, 0.0f, (float)BRICK_SIZE);
+            float fy = std::clamp((g.y() - by) * BRICK_SIZE, 0.0f, (float)BRICK_SIZE);
+            float fz = std::clamp((g.z() - bz) * BRICK_SIZE, 0.0f, (float)BRICK_SIZE);
+            int vx = std::min((int)fx, BRICK_SIZE - 1);
+            int vy = std::min((int)fy, BRICK_SIZE - 1);
+            int vz = std::min((int)fz, BRICK_SIZE - 1);
+            fx -= vx;
+            fy -= vy;
+            fz -= vz;
+
+            const size_t uBase = (size_t)brick.m_iDense * BRICK_SAMPLES * BRICK_SAMPLES * BRICK_SAMPLES;
+            const size_t i000 = uBase + ((size_t)vz * BRICK_SAMPLES + vy) * BRICK_SAMPLES + vx;
+            const size_t dy = BRICK_SAMPLES;
+            const size_t dz = BRICK_SAMPLES * BRICK_SAMPLES;
+            const float *pD = m_distances.data();
+
+            float d00 = pD[i000] + (pD[i000 + 1] - pD[i000]) * fx;
+            float d10 = pD[i000 + dy] + (pD[i000 + dy + 1] - pD[i000 + dy]) * fx;
+            float d01 = pD[i000 + dz] + (pD[i000 + dz + 1] - pD[i000 + dz]) * fx;
+            float d11 = pD[i000 + dz + dy] + (pD[i000 + dz + dy + 1] - pD[i000 + dz + dy]) * fx;
+            float d0 = d00 + (d10 - d00) * fy;
+            float d1 = d01 + (d11 - d01) * fy;
+
+            _iterations = m_iterations[i000 + (fz > 0.5f ? dz : 0) + (fy > 0.5f ? dy : 0) + (fx > 0.5f ? 1 : 0)];
+            return (d0 + (d1 - d0) * fz) * brick.m_fScale;
+        }
+
+        /* returns the voxel size (largest side) */
+        float voxelSize() const {
+            return m_fVoxelSize;
+        }
+
+        /* returns the voxel diagonal (worst case error of lookups between samples) */
+        float voxelDiagonal() const {
+            return m_fVoxelSize * 1.7320508f;
+        }
+
+        /* returns the number of densely sampled bricks */
+        size_t denseBricks() const {
+            return m_distances.size() / (BRICK_SAMPLES * BRICK_SAMPLES * BRICK_SAMPLES);
+        }
+
+        /* returns the baked data size in bytes */
+        size_t memorySize() const {
+            return m_bricks.size() * sizeof(Brick) + m_distances.size() * sizeof(float) + m_iterations.size();
+        }
+
+     private:
+        struct Brick
+        {
+            float       m_fBound;       // distance bound (far bricks)
+            float       m_fScale;       // sampled distance to euclidean distance scale (near bricks)
+            int32_t     m_iDense;       // index of sampled brick data (-1 for far bricks)
+        };
+
+        /* gradient estimate at brick centre (from neighbouring brick centres) */
+        float centreGradient(const std::vector<float> &_centres, int _x, int _y, int _z) const {
+            float d = _centres[brickIndex(_x, _y, _z)];
+            float fGradient = 0;
+            auto diff = [&](int _dx, int _dy, int _dz, float _fSize) {
+                int x = _x + _dx, y = _y + _dy, z = _z + _dz;
+                if ( (x >= 0) && (x < m_iBricks) && (y >= 0) && (y < m_iBricks) && (z >= 0) && (z < m_iBricks) ) {
+                    fGradient = std::max(fGradient, std::abs(_centres[brickIndex(x, y, z)] - d) / _fSize);
+                }
+            };
+            
+            diff(-1, 0, 0, m_brickSize.x());
+            diff(1, 0, 0, m_brickSize.x());
+            diff(0, -1, 0, m_brickSize.y());
+            diff(0, 1, 0, m_brickSize.y());
+            diff(0, 0, -1, m_brickSize.z());
+            diff(0, 0, 1, m_brickSize.z());
+            
+            return std::max(fGradient * GRADIENT_SAFETY, GRADIENT_MIN);
+        }
+        
+        /* gradient estimate for sampled brick (largest difference between neighbouring samples) */
+        float sampleGradient(size_t _uDense) const {
+            const float *pD = m_distances.data() + _uDense * BRICK_SAMPLES * BRICK_SAMPLES * BRICK_SAMPLES;
+            float fDiff = 0;
+            for (int z = 0; z < BRICK_SAMPLES; z++) {
+                for (int y = 0; y < BRICK_SAMPLES; y++) {
+                    for (int x = 0; x < BRICK_SAMPLES; x++) {
+                        const float *p = pD + (z * BRICK_SAMPLES + y) * BRICK_SAMPLES + x;
+                        if (x > 0) fDiff = std::max(fDiff, std::abs(p[0] - p[-1]));
+                        if (y > 0) fDiff = std::max(fDiff, std::abs(p[0] - p[-BRICK_SAMPLES]));
+                        if (z > 0) fDiff = std::max(fDiff, std::abs(p[0] - p[-BRICK_SAMPLES * BRICK_SAMPLES]));
+                    }
+                }
+            }
+            
+            return std::max(fDiff / m_fVoxelSize * GRADIENT_SAFETY, GRADIENT_MIN);
+        }
+
+        size_t brickIndex(int _x, int _y, int _z) const {
+            return ((size_t)_z * m_iBricks + _y) * m_iBricks + _x;
+        }
+
+     private:
+        Bounds                  m_bounds;
+        Vec                     m_brickSize;
+        Vec                     m_invBrickSize;
+        int                     m_iBricks;
+        float                   m_fVoxelSize;
+        std::vector<Brick>      m_bricks;
+        std::vector<float>      m_distances;
+        std::vector<uint8_t>    m_iterations;
+    };
+
+};  // namespace LNF
+
+
+#endif  // #ifndef LIBS_HEADER_SDF_BRICK_CACHE_H
@@ -2,6 +2,7 @@
 #define LIBS_HEADER_SDF_H
 
 #include "constants.h"
+#include "simd.h"
 #include "vec3.h"
 
 
@@ -30,41 +31,93 @@ namespace LNF
     }
 
 
+    /*
+     Mandlebulb (power 8) iteration step z -> z^8 in its trigonometry free (polynomial) form, templated on float
+     or SimdFloat lanes. Same result as the polar form (acos, atan2, pow, sin, cos) at a fraction of the cost.
+     See https://iquilezles.org/articles/mandelbulb (with the polar axis mapped from Y to Z).
+     */
+    template <typename float_type>
+    void mandlePower8(float_type &_x, float_type &_y, float_type &_z) {
+        using F = float_type;
+        const F x = _y, y = _z, z = _x;
+        const F x2 = x*x, x4 = x2*x2;
+        const F y2 = y*y, y4 = y2*y2;
+        const F z2 = z*z, z4 = z2*z2;
+        
+        // clamped on the polar axis, where the polar form has a singularity as well
+        const F k3 = simdMax(x2 + z2, F(1e-10f));
+        const F k2 = F(1.0f) / (k3*k3*k3*simdSqrt(k3));
+        const F k1 = x4 + y4 + z4 - F(6.0f)*y2*z2 - F(6.0f)*x2*y2 + F(2.0f)*z2*x2;
+        const F k4 = x2 - y2 + z2;
+        
+        _y = F(64.0f)*x*y*z*(x2 - z2)*k4*(x4 - F(6.0f)*x2*z2 + z4)*k1*k2;
+        _z = F(-16.0f)*y2*k3*k4*k4 + k1*k1;
+        _x = F(-8.0f)*y*k4*(x4*x4 - F(28.0f)*x4*x2*z2 + F(70.0f)*x4*z4 - F(28.0f)*x2*z2*z4 + z4*z4)*k1*k2;
+    }
+
+
     float sdfMandle(const Vec &_p, int &_iterations) {
-        float BAIL_OUT = 2.0f;
-        float POWER = 8.0f;
-        float PHASE = 0.0f;
-        int MAX_ITERATIONS = 100;
+        const float BAIL_OUT = 2.0f;
+        const int MAX_ITERATIONS = 100;
         
-        Vec z = _p;
+        float x = _p.x(), y = _p.y(), z = _p.z();
         float dr = 1.0;
-        float r = 0.0;
+        float r2 = x*x + y*y + z*z;
         int i = 0;
         for (; i < MAX_ITERATIONS; i++) {
-            r = z.size();
-            if (r > BAIL_OUT)
+            if (r2 > BAIL_OUT * BAIL_OUT)
                 break;
             
-            // convert to polar coordinates
-            float theta = acos(z.z()/r);
-            float phi = atan2(z.y(), z.x()) + PHASE;
-            dr =  pow(r, POWER - 1.0f) * POWER * dr + 1.0f;
-            
-            // scale and rotate the point
-            float zr = pow(r, POWER);
-            theta = theta * POWER;
-            phi = phi * POWER;
+            float r = sqrt(r2);
+            dr = r2 * r2 * r2 * r * 8.0f * dr + 1.0f;
             
-            // convert back to cartesian coordinates
-            z = zr * Vec(sin(theta) * cos(phi), sin(phi) * sin(theta), cos(theta));
-            z += _p;
+            mandlePower8(x, y, z);
+            x += _p.x();
+            y += _p.y();
+            z += _p.z();
+            r2 = x*x + y*y + z*z;
         }
         
-        _iterations = i;        
+        _iterations = i;
+        float r = sqrt(r2);
         return 0.1f * log(r) * r/dr;
     }
 
 
+    /* Mandlebulb SDF for N points at once (lanes that bail out early are masked until all lanes are done) */
+    template <int N>
+    SimdFloat<N> sdfMandle(const SimdFloat<N> &_px, const SimdFloat<N> &_py, const SimdFloat<N> &_pz, SimdFloat<N> &_iterations) {
+        using F = SimdFloat<N>;
+        const F BAIL_OUT2(4.0f);
+        const int MAX_ITERATIONS = 100;
+        
+        F x = _px, y = _py, z = _pz;
+        F dr(1.0f);
+        F r2 = x*x + y*y + z*z;
+        _iterations = F(0.0f);
+        for (int i = 0; i < MAX_ITERATIONS; i++) {
+            F active = r2 <= BAIL_OUT2;
+            if (simdMoveMask(active) == 0)
+                break;
+            
+            F r = simdSqrt(r2);
+            dr = simdSelect(active, dr, r2 * r2 * r2 * r * F(8.0f) * dr + F(1.0f));
+            
+            F nx = x, ny = y, nz = z;
+            mandlePower8(nx, ny, nz);
+            x = simdSelect(active, x, nx + _px);
+            y = simdSelect(active, y, ny + _py);
+            z = simdSelect(active, z, nz + _pz);
+            
+            r2 = x*x + y*y + z*z;
+            _iterations = _iterations + (active & F(1.0f));
+        }
+        
+        F r = simdSqrt(r2);
+        return F(0.1f) * simdLog(r) * r/dr;
+    }
+
+
     float sdfBubbles(const Vec &_p, float _fAngleY, float _fHeight) {
         float sdf = 0;
         float k = 4;
@@ -82,6 +135,73 @@ namespace LNF
     }
 
 
+    /*
+     Bubbles SDF with the bubble origins and radii precomputed, evaluating 4 bubbles per SIMD step
+     (same result as sdfBubbles()).
+     */
+    class SdfBubbles
+    {
+     public:
+        static const int BUBBLES = 16;
+        
+     public:
+        SdfBubbles(float _fAngleY, float _fHeight) {
+            for (int i = 0; i < BUBBLES; i++) {
+                float t = (float)i/BUBBLES;
+                m_fX[i] = 0.45f*_fHeight*sin(t * LNF::pi * 4 + _fAngleY);
+                m_fY[i] = (t - 0.5f)*_fHeight;
+                m_fZ[i] = 0.45f*_fHeight*cos(t * LNF::pi * 4 + _fAngleY);
+                m_fRadius[i] = (frac(t/0.3f) + 0.1f)*_fHeight*0.1f;
+            }
+        }
+        
+        float operator()(const Vec &_p) const {
+            const Float4 k(-4.0f);
+            const Float4 px(_p.x()), py(_p.y()), pz(_p.z());
+            Float4 sum(0.0f);
+            for (int i = 0; i < BUBBLES; i += 4) {
+                Float4 dx = px - Float4::load(m_fX + i);
+                Float4 dy = py - Float4::load(m_fY + i);
+                Float4 dz = pz - Float4::load(m_fZ + i);
+                Float4 d = simdSqrt(dx*dx + dy*dy + dz*dz) - Float4::load(m_fRadius + i);
+                sum = sum + simdExp(k * d);
+            }
+            
+            alignas(16) float fSum[4];
+            sum.store(fSum);
+            return -log(fSum[0] + fSum[1] + fSum[2] + fSum[3]) * 0.1f;
+        }
+        
+     private:
+        alignas(16) float   m_fX[BUBBLES];
+        alignas(16) float   m_fY[BUBBLES];
+        alignas(16) float   m_fZ[BUBBLES];
+        alignas(16) float   m_fRadius[BUBBLES];
+    };
+
+
+    /*
+     Surface normal from 4 SDF samples (tetrahedral differences), evaluated as a single SIMD call.
+     _sdf4 takes x, y, z Float4 lanes and returns Float4 distances.
+     */
+    template <typename sdf4_func>
+    Vec surfaceNormal4(const Vec &_p, const sdf4_func &_sdf4, float _fEpsilon = 0.0001f) {
+        alignas(16) static const float kx[4] = {1, -1, -1, 1};
+        alignas(16) static const float ky[4] = {-1, -1, 1, 1};
+        alignas(16) static const float kz[4] = {-1, 1, -1, 1};
+        
+        const Float4 e(_fEpsilon);
+        alignas(16) float d[4];
+        _sdf4(Float4(_p.x()) + Float4::load(kx) * e,
+              Float4(_p.y()) + Float4::load(ky) * e,
+              Float4(_p.z()) + Float4::load(kz) * e).store(d);
+        
+        return Vec(d[0] - d[1] - d[2] + d[3],
+                   -d[0] - d[1] + d[2] + d[3],
+                   -d[0] + d[1] - d[2] + d[3]).normalized();
+    }
+
+
 };  // namespace LNF
 
 
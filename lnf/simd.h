@@ -0,0 +1,635 @@
+#ifndef LIBS_HEADER_SIMD_H
+#define LIBS_HEADER_SIMD_H
+
+#include "constants.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX__)
+    #define LNF_SIMD_AVX
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+    #define LNF_SIMD_SSE
+    #include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    #define LNF_SIMD_NEON
+    #include <arm_neon.h>
+#endif
+
+
+namespace LNF
+{
+    /*
+     Portable SIMD float vectors (SSE/AVX on x86, NEON on ARM64, plain arrays otherwise).
+     Comparisons return lane masks (all bits set for true lanes) of the same type.
+     SimdFloat<8> falls back to two 4-wide halves if AVX is not available.
+     */
+    template <int N> struct SimdFloat;
+
+
+    template <>
+    struct SimdFloat<4>
+    {
+        static const int WIDTH = 4;
+
+#if defined(LNF_SIMD_SSE)
+        using native_type = __m128;
+#elif defined(LNF_SIMD_NEON)
+        using native_type = float32x4_t;
+#else
+        struct native_type {float m_f[4];};
+#endif
+
+        SimdFloat() noexcept = default;
+        SimdFloat(native_type _v) noexcept : m_v(_v) {}
+
+        SimdFloat(float _f) noexcept {
+#if defined(LNF_SIMD_SSE)
+            m_v = _mm_set1_ps(_f);
+#elif defined(LNF_SIMD_NEON)
+            m_v = vdupq_n_f32(_f);
+#else
+            for (auto &f : m_v.m_f) f = _f;
+#endif
+        }
+
+        /* load from 16 byte aligned memory */
+        static SimdFloat load(const float *_pData) {
+#if defined(LNF_SIMD_SSE)
+            return _mm_load_ps(_pData);
+#elif defined(LNF_SIMD_NEON)
+            return vld1q_f32(_pData);
+#else
+            native_type v;
+            for (int i = 0; i < 4; i++) v.m_f[i] = _pData[i];
+            return v;
+#endif
+        }
+
+        /* store to 16 byte aligned memory */
+        void store(float *_pData) const {
+#if defined(LNF_SIMD_SSE)
+            _mm_store_ps(_pData, m_v);
+#elif defined(LNF_SIMD_NEON)
+            vst1q_f32(_pData, m_v);
+#else
+            for (int i = 0; i < 4; i++) _pData[i] = m_v.m_f[i];
+#endif
+        }
+
+        native_type     m_v;
+    };
+
+
+#if defined(LNF_SIMD_SSE)
+    inline SimdFloat<4> operator+(SimdFloat<4> _a, SimdFloat<4> _b) {return _mm_add_ps(_a.m_v, _b.m_v);}
+    inline SimdFloat<4> operator-(SimdFloat<4> _a, SimdFloat<4> _b) {return _mm_sub_ps(_a.m_v, _b.m_v);}
+    inline SimdFloat<4> operator*(SimdFloat<4> _a, SimdFloat<4> _b) {return _mm_mul_ps(_a.m_v, _b.m_v);}
+    inline SimdFloat<4> operator/(SimdFloat<4> _a, SimdFloat<4> _b) {return _mm_div_ps(_a.m_v, _b.m_v);}
+    inline SimdFloat<4> operator<(SimdFloat<4> _a, SimdFloat<4> _b) {return _mm_cmplt_ps(_a.m_v, _b.m_v);}
+    inline SimdFloat<4> operator<=(SimdFloat<4> _a, SimdFloat<4> _b) {return _mm_cmple_ps(_a.m_v, _b.m_v);}
+    inline SimdFloat<4> operator>(SimdFloat<4> _a, SimdFloat<4> _b) {return _mm_cmpgt_ps(_a.m_v, _b.m_v);}
+    inline SimdFloat<4> operator>=(SimdFloat<4> _a, SimdFloat<4> _b) {return _mm_cmpge_ps(_a.m_v, _b.m_v);}
+    inline SimdFloat<4> operator&(SimdFloat<4> _a, SimdFloat<4> _b) {return _mm_and_ps(_a.m_v, _b.m_v);}
+    inline SimdFloat<4> operator|(SimdFloat<4> _a, SimdFloat<4> _b) {return _mm_or_ps(_a.m_v, _b.m_v);}
+    inline SimdFloat<4> simdMin(SimdFloat<4> _a, SimdFloat<4> _b) {return _mm_min_ps(_a.m_v, _b.m_v);}
+    inline SimdFloat<4> simdMax(SimdFloat<4> _a, SimdFloat<4> _b) {return _mm_max_ps(_a.m_v, _b.m_v);}
+    inline SimdFloat<4> simdAbs(SimdFloat<4> _a) {return _mm_andnot_ps(_mm_set1_ps(-0.0f), _a.m_v);}
+    inline SimdFloat<4> simdSqrt(SimdFloat<4> _a) {return _mm_sqrt_ps(_a.m_v);}
+
+    // returns _b where _mask is set and _a otherwise
+    inline SimdFloat<4> simdSelect(SimdFloat<4> _mask, SimdFloat<4> _a, SimdFloat<4> _b) {
+        return _mm_or_ps(_mm_and_ps(_mask.m_v, _b.m_v), _mm_andnot_ps(_mask.m_v, _a.m_v));
+    }
+
+    // returns lane mask bits (bit i is set if lane i is true)
+    inline int simdMoveMask(SimdFloat<4> _mask) {return _mm_movemask_ps(_mask.m_v);}
+
+    // rounds lanes down
+    inline SimdFloat<4> simdFloor(SimdFloat<4> _a) {
+        __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(_a.m_v));
+        return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, _a.m_v), _mm_set1_ps(1.0f)));
+    }
+
+    // returns 2^n for integer valued lanes (n in -126..127)
+    inline SimdFloat<4> simdPow2(SimdFloat<4> _n) {
+        return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(_n.m_v), _mm_set1_epi32(127)), 23));
+    }
+
+    // splits positive (normal) lanes into exponent (returned) and mantissa [1, 2)
+    inline SimdFloat<4> simdFrexp(SimdFloat<4> _a, SimdFloat<4> &_mantissa) {
+        __m128i bits = _mm_castps_si128(_a.m_v);
+        _mantissa = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+        return _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+    }
+
+#elif defined(LNF_SIMD_NEON)
+    inline SimdFloat<4> operator+(SimdFloat<4> _a, SimdFloat<4> _b) {return vaddq_f32(_a.m_v, _b.m_v);}
+    inline SimdFloat<4> operator-(SimdFloat<4> _a, SimdFloat<4> _b) {return vsubq_f32(_a.m_v, _b.m_v);}
+    inline SimdFloat<4> operator*(SimdFloat<4> _a, SimdFloat<4> _b) {return vmulq_f32(_a.m_v, _b.m_v);}
+    inline SimdFloat<4> operator/(SimdFloat<4> _a, SimdFloat<4> _b) {return vdivq_f32(_a.m_v, _b.m_v);}
+    inline SimdFloat<4> operator<(SimdFloat<4> _a, SimdFloat<4> _b) {return vreinterpretq_f32_u32(vcltq_f32(_a.m_v, _b.m_v));}
+    inline SimdFloat<4> operator<=(SimdFloat<4> _a, SimdFloat<4> _b) {return vreinterpretq_f32_u32(vcleq_f32(_a.m_v, _b.m_v));}
+    inline SimdFloat<4> operator>(SimdFloat<4> _a, SimdFloat<4> _b) {return vreinterpretq_f32_u32(vcgtq_f32(_a.m_v, _b.m_v));}
+    inline SimdFloat<4> operator>=(SimdFloat<4> _a, SimdFloat<4> _b) {return vreinterpretq_f32_u32(vcgeq_f32(_a.m_v, _b.m_v));}
+    inline SimdFloat<4> operator&(SimdFloat<4> _a, SimdFloat<4> _b) {
+        return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(_a.m_v), vreinterpretq_u32_f32(_b.m_v)));
+    }
+    inline SimdFloat<4> operator|(SimdFloat<4> _a, SimdFloat<4> _b) {
+        return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(_a.m_v), vreinterpretq_u32_f32(_b.m_v)));
+    }
+    inline SimdFloat<4> simdMin(SimdFloat<4> _a, SimdFloat<4> _b) {return vminq_f32(_a.m_v, _b.m_v);}
+    inline SimdFloat<4> simdMax(SimdFloat<4> _a, SimdFloat<4> _b) {return vmaxq_f32(_a.m_v, _b.m_v);}
+    inline SimdFloat<4> simdAbs(SimdFloat<4> _a) {return vabsq_f32(_a.m_v);}
+    inline SimdFloat<4> simdSqrt(SimdFloat<4> _a) {return vsqrtq_f32(_a.m_v);}
+
+    // returns _b where _mask is set and _a otherwise
+    inline SimdFloat<4> simdSelect(SimdFloat<4> _mask, SimdFloat<4> _a, SimdFloat<4> _b) {
+        return vbslq_f32(vreinterpretq_u32_f32(_mask.m_v), _b.m_v, _a.m_v);
+    }
+
+    // returns lane mask bits (bit i is set if lane i is true)
+    inline int simdMoveMask(SimdFloat<4> _mask) {
+        static const int32_t shifts[4] = {0, 1, 2, 3};
+        uint32x4_t bits = vshrq_n_u32(vreinterpretq_u32_f32(_mask.m_v), 31);
+        return (int)vaddvq_u32(vshlq_u32(bits, vld1q_s32(shifts)));
+    }
+
+    // rounds lanes down
+    inline SimdFloat<4> simdFloor(SimdFloat<4> _a) {return vrndmq_f32(_a.m_v);}
+
+    // returns 2^n for integer valued lanes (n in -126..127)
+    inline SimdFloat<4> simdPow2(SimdFloat<4> _n) {
+        return vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32(vcvtnq_s32_f32(_n.m_v), vdupq_n_s32(127)), 23));
+    }
+
+    // splits positive (normal) lanes into exponent (returned) and mantissa [1, 2)
+    inline SimdFloat<4> simdFrexp(SimdFloat<4> _a, SimdFloat<4> &_mantissa) {
+        uint32x4_t bits = vreinterpretq_u32_f32(_a.m_v);
+        _mantissa = vreinterpretq_f32_u32(vorrq_u32(vandq_u32(bits, vdupq_n_u32(0x007fffff)), vdupq_n_u32(0x3f800000)));
+        return vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), vdupq_n_s32(127)));
+    }
+
+#else
+    namespace detail {
+        template <typename func_type>
+        inline SimdFloat<4> lanes(SimdFloat<4> _a, SimdFloat<4> _b, func_type &&_func) {
+            SimdFloat<4> ret;
+            for (int i = 0; i < 4; i++) ret.m_v.m_f[i] = _func(_a.m_v.m_f[i], _b.m_v.m_f[i]);
+            return ret;
+        }
+
+        inline float maskValue(bool _b) {
+            uint32_t u = _b ? 0xffffffff : 0;
+            float f;
+            memcpy(&f, &u, sizeof(f));
+            return f;
+        }
+
+        inline uint32_t bits(float _f) {
+            uint32_t u;
+            memcpy(&u, &_f, sizeof(u));
+            return u;
+        }
+
+        inline float fromBits(uint32_t _u) {
+            float f;
+            memcpy(&f, &_u, sizeof(f));
+            return f;
+        }
+    };
+
+    inline SimdFloat<4> operator+(SimdFloat<4> _a, SimdFloat<4> _b) {return detail::lanes(_a, _b, [](float a, float b){return a + b;});}
+    inline SimdFloat<4> operator-(SimdFloat<4> _a, SimdFloat<4> _b) {return detail::lanes(_a, _b, [](float a, float b){return a - b;});}
+    inline SimdFloat<4> operator*(SimdFloat<4> _a, SimdFloat<4> _b) {return detail::lanes(_a, _b, [](float a, float b){return a * b;});}
+    inline SimdFloat<4> operator/(SimdFloat<4> _a, SimdFloat<4> _b) {return detail::lanes(_a, _b, [](float a, float b){return a / b;});}
+    inline SimdFloat<4> operator<(SimdFloat<4> _a, SimdFloat<4> _b) {return detail::lanes(_a, _b, [](float a, float b){return detail::maskValue(a < b);});}
+    inline SimdFloat<4> operator<=(SimdFloat<4> _a, SimdFloat<4> _b) {return detail::lanes(_a, _b, [](float a, float b){return detail::maskValue(a <= b);});}
+    inline SimdFloat<4> operator>(SimdFloat<4> _a, SimdFloat<4> _b) {return detail::lanes(_a, _b, [](float a, float b){return detail::maskValue(a > b);});}
+    inline SimdFloat<4> operator>=(SimdFloat<4> _a, SimdFloat<4> _b) {return detail::lanes(_a, _b, [](float a, float b){return detail::maskValue(a >= b);});}
+    inline SimdFloat<4> operator&(SimdFloat<4> _a, SimdFloat<4> _b) {
+        return detail::lanes(_a, _b, [](float a, float b){return detail::fromBits(detail::bits(a) & detail::bits(b));});
+    }
+    inline SimdFloat<4> operator|(SimdFloat<4> _a, SimdFloat<4> _b) {
+        return detail::lanes(_a, _b, [](float a, float b){return detail::fromBits(detail::bits(a) | detail::bits(b));});
+    }
+    inline SimdFloat<4> simdMin(SimdFloat<4> _a, SimdFloat<4> _b) {return detail::lanes(_a, _b, [](float a, float b){return b < a ? b : a;});}
+    inline SimdFloat<4> simdMax(SimdFloat<4> _a, SimdFloat<4> _b) {return detail::lanes(_a, _b, [](float a, float b){return b > a ? b : a;});}
+    inline SimdFloat<4> simdAbs(SimdFloat<4> _a) {return detail::lanes(_a, _a, [](float a, float){return fabs(a);});}
+    inline SimdFloat<4> simdSqrt(SimdFloat<4> _a) {return detail::lanes(_a, _a, [](float a, float){return sqrt(a);});}
+
+    // returns _b where _mask is set and _a otherwise
+    inline SimdFloat<4> simdSelect(SimdFloat<4> _mask, SimdFloat<4> _a, SimdFloat<4> _b) {
+        SimdFloat<4> ret;
+        for (int i = 0; i < 4; i++) ret.m_v.m_f[i] = detail::bits(_mask.m_v.m_f[i]) ? _b.m_v.m_f[i] : _a.m_v.m_f[i];
+        return ret;
+    }
+
+    // returns lane mask bits (bit i is set if lane i is true)
+    inline int simdMoveMask(SimdFloat<4> _mask) {
+        int ret = 0;
+        for (int i = 0; i < 4; i++) ret |= (detail::bits(_mask.m_v.m_f[i]) >> 31) << i;
+        return ret;
+    }
+
+    // rounds lanes down
+    inline SimdFloat<4> simdFloor(SimdFloat<4> _a) {return detail::lanes(_a, _a, [](float a, float){return floorf(a);});}
+
+    // returns 2^n for integer valued lanes (n in -126..127)
+    inline SimdFloat<4> simdPow2(SimdFloat<4> _n) {
+        return detail::lanes(_n, _n, [](float a, float){return detail::fromBits((uint32_t)((int32_t)a + 127) << 23);});
+    }
+
+    // splits positive (normal) lanes into exponent (returned) and mantissa [1, 2)
+    inline SimdFloat<4> simdFrexp(SimdFloat<4> _a, SimdFloat<4> &_mantissa) {
+        _mantissa = detail::lanes(_a, _a, [](float a, float){return detail::fromBits((detail::bits(a) & 0x007fffff) | 0x3f800000);});
+        return detail::lanes(_a, _a, [](float a, float){return (float)((int32_t)(detail::bits(a) >> 23) - 127);});
+    }
+
+#endif
+
+
+#if defined(LNF_SIMD_AVX)
+    template <>
+    struct SimdFloat<8>
+    {
+        static const int WIDTH = 8;
+        using native_type = __m256;
+
+        SimdFloat() noexcept = default;
+        SimdFloat(native_type _v) noexcept : m_v(_v) {}
+        SimdFloat(float _f) noexcept : m_v(_mm256_set1_ps(_f)) {}
+
+        /* load from 32 byte aligned memory */
+        static SimdFloat load(const float *_pData) {return _mm256_load_ps(_pData);}
+
+        /* store to 32 byte aligned memory */
+        void store(float *_pData) const {_mm256_store_ps(_pData, m_v);}
+
+        native_type     m_v;
+    };
+
+    inline SimdFloat<8> operator+(SimdFloat<8> _a, SimdFloat<8> _b) {return _mm256_add_ps(_a.m_v, _b.m_v);}
+    inline SimdFloat<8> operator-(SimdFloat<8> _a, SimdFloat<8> _b) {return _mm256_sub_ps(_a.m_v, _b.m_v);}
+    inline SimdFloat<8> operator*(SimdFloat<8> _a, SimdFloat<8> _b) {return _mm256_mul_ps(_a.m_v, _b.m_v);}
+    inline SimdFloat<8> operator/(SimdFloat<8> _a, SimdFloat<8> _b) {return _mm256_div_ps(_a.m_v, _b.m_v);}
+    inline SimdFloat<8> operator<(SimdFloat<8> _a, SimdFloat<8> _b) {return _mm256_cmp_ps(_a.m_v, _b.m_v, _CMP_LT_OQ);}
+    inline SimdFloat<8> operator<=(SimdFloat<8> _a, SimdFloat<8> _b) {return _mm256_cmp_ps(_a.m_v, _b.m_v, _CMP_LE_OQ);}
+    inline SimdFloat<8> operator>(SimdFloat<8> _a, SimdFloat<8> _b) {return _mm256_cmp_ps(_a.m_v, _b.m_v, _CMP_GT_OQ);}
+    inline SimdFloat<8> operator>=(SimdFloat<8> _a, SimdFloat<8> _b) {return _mm256_cmp_ps(_a.m_v, _b.m_v, _CMP_GE_OQ);}
+    inline SimdFloat<8> operator&(SimdFloat<8> _a, SimdFloat<8> _b) {return _mm256_and_ps(_a.m_v, _b.m_v);}
+    inline SimdFloat<8> operator|(SimdFloat<8> _a, SimdFloat<8> _b) {return _mm256_or_ps(_a.m_v, _b.m_v);}
+    inline SimdFloat<8> simdMin(SimdFloat<8> _a, SimdFloat<8> _b) {return _mm256_min_ps(_a.m_v, _b.m_v);}
+    inline SimdFloat<8> simdMax(SimdFloat<8> _a, SimdFloat<8> _b) {return _mm256_max_ps(_a.m_v, _b.m_v);}
+    inline SimdFloat<8> simdAbs(SimdFloat<8> _a) {return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), _a.m_v);}
+    inline SimdFloat<8> simdSqrt(SimdFloat<8> _a) {return _mm256_sqrt_ps(_a.m_v);}
+
+    // returns _b where _mask is set and _a otherwise
+    inline SimdFloat<8> simdSelect(SimdFloat<8> _mask, SimdFloat<8> _a, SimdFloat<8> _b) {return _mm256_blendv_ps(_a.m_v, _b.m_v, _mask.m_v);}
+
+    // returns lane mask bits (bit i is set if lane i is true)
+    inline int simdMoveMask(SimdFloat<8> _mask) {return _mm256_movemask_ps(_mask.m_v);}
+
+    // rounds lanes down
+    inline SimdFloat<8> simdFloor(SimdFloat<8> _a) {return _mm256_floor_ps(_a.m_v);}
+
+    // returns 2^n for integer valued lanes (n in -126..127; integer ops on 4-wide halves, AVX2 is not required)
+    inline SimdFloat<8> simdPow2(SimdFloat<8> _n) {
+        auto lo = simdPow2(SimdFloat<4>(_mm256_castps256_ps128(_n.m_v)));
+        auto hi = simdPow2(SimdFloat<4>(_mm256_extractf128_ps(_n.m_v, 1)));
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(lo.m_v), hi.m_v, 1);
+    }
+
+    // splits positive (normal) lanes into exponent (returned) and mantissa [1, 2)
+    inline SimdFloat<8> simdFrexp(SimdFloat<8> _a, SimdFloat<8> &_mantissa) {
+        SimdFloat<4> mlo, mhi;
+        auto lo = simdFrexp(SimdFloat<4>(_mm256_castps256_ps128(_a.m_v)), mlo);
+        auto hi = simdFrexp(SimdFloat<4>(_mm256_extractf128_ps(_a.m_v, 1)), mhi);
+        _mantissa = _mm256_insertf128_ps(_mm256_castps128_ps256(mlo.m_v), mhi.m_v, 1);
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(lo.m_v), hi.m_v, 1);
+    }
+
+#else
+    template <>
+    struct SimdFloat<8>
+    {
+        static const int WIDTH = 8;
+
+        SimdFloat() noexcept = default;
+        SimdFloat(SimdFloat<4> _lo, SimdFloat<4> _hi) noexcept : m_lo(_lo), m_hi(_hi) {}
+        SimdFloat(float _f) noexcept : m_lo(_f), m_hi(_f) {}
+
+        /* load from 32 byte aligned memory */
+        static SimdFloat load(const float *_pData) {return SimdFloat(SimdFloat<4>::load(_pData), SimdFloat<4>::load(_pData + 4));}
+
+        /* store to 32 byte aligned memory */
+        void store(float *_pData) const {m_lo.store(_pData); m_hi.store(_pData + 4);}
+
+        SimdFloat<4>    m_lo;
+        SimdFloat<4>    m_hi;
+    };
+
+    inline SimdFloat<8> operator+(SimdFloat<8> _a, SimdFloat<8> _b) {return {_a.m_lo + _b.m_lo, _a.m_hi + _b.m_hi};}
+    inline SimdFloat<8> operator-(SimdFloat<8> _a, SimdFloat<8> _b) {return {_a.m_lo - _b.m_lo, _a.m_hi - _b.m_hi};}
+    inline SimdFloat<8> operator*(SimdFloat<8> _a, SimdFloat<8> _b) {return {_a.m_lo * _b.m_lo, _a.m_hi * _b.m_hi};}
+    inline SimdFloat<8> operator/(SimdFloat<8> _a, SimdFloat<8> _b) {return {_a.m_lo / _b.m_lo, _a.m_hi / _b.m_hi};}
+    inline SimdFloat<8> operator<(SimdFloat<8> _a, SimdFloat<8> _b) {return {_a.m_lo < _b.m_lo, _a.m_hi < _b.m_hi};}
+    inline SimdFloat<8> operator<=(SimdFloat<8> _a, SimdFloat<8> _b) {return {_a.m_lo <= _b.m_lo, _a.m_hi <= _b.m_hi};}
+    inline SimdFloat<8> operator>(SimdFloat<8> _a, SimdFloat<8> _b) {return {_a.m_lo > _b.m_lo, _a.m_hi > _b.m_hi};}
+    inline SimdFloat<8> operator>=(SimdFloat<8> _a, SimdFloat<8> _b) {return {_a.m_lo >= _b.m_lo, _a.m_hi >= _b.m_hi};}
+    inline SimdFloat<8> operator&(SimdFloat<8> _a, SimdFloat<8> _b) {return {_a.m_lo & _b.m_lo, _a.m_hi & _b.m_hi};}
+    inline SimdFloat<8> operator|(SimdFloat<8> _a, SimdFloat<8> _b) {return {_a.m_lo | _b.m_lo, _a.m_hi | _b.m_hi};}
+    inline SimdFloat<8> simdMin(SimdFloat<8> _a, SimdFloat<8> _b) {return {simdMin(_a.m_lo, _b.m_lo), simdMin(_a.m_hi, _b.m_hi)};}
+    inline SimdFloat<8> simdMax(SimdFloat<8> _a, SimdFloat<8> _b) {return {simdMax(_a.m_lo, _b.m_lo), simdMax(_a.m_hi, _b.m_hi)};}
+    inline SimdFloat<8> simdAbs(SimdFloat<8> _a) {return {simdAbs(_a.m_lo), simdAbs(_a.m_hi)};}
+    inline SimdFloat<8> simdSqrt(SimdFloat<8> _a) {return {simdSqrt(_a.m_lo), simdSqrt(_a.m_hi)};}
+
+    // returns _b where _mask is set and _a otherwise
+    inline SimdFloat<8> simdSelect(SimdFloat<8> _mask, SimdFloat<8> _a, SimdFloat<8> _b) {
+        return {simdSelect(_mask.m_lo, _a.m_lo, _b.m_lo), simdSelect(_mask.m_hi, _a.m_hi, _b.m_hi)};
+    }
+
+    // returns lane mask bits (bit i is set if lane i is true)
+    inline int simdMoveMask(SimdFloat<8> _mask) {return simdMoveMask(_mask.m_lo) | (simdMoveMask(_mask.m_hi) << 4);}
+
+    inline SimdFloat<8> simdFloor(SimdFloat<8> _a) {return {simdFloor(_a.m_lo), simdFloor(_a.m_hi)};}
+    inline SimdFloat<8> simdPow2(SimdFloat<8> _n) {return {simdPow2(_n.m_lo), simdPow2(_n.m_hi)};}
+    inline SimdFloat<8> simdFrexp(SimdFloat<8> _a, SimdFloat<8> &_mantissa) {
+        return {simdFrexp(_a.m_lo, _mantissa.m_lo), simdFrexp(_a.m_hi, _mantissa.m_hi)};
+    }
+
+#endif
+
+
+    /*
+     4-wide double vectors (AVX; two 2-wide halves with SSE2/NEON; plain arrays otherwise).
+     Only the basic arithmetic, comparison and mask operations are provided.
+     */
+    template <int N> struct SimdDouble;
+
+
+    template <>
+    struct SimdDouble<4>
+    {
+        static const int WIDTH = 4;
+
+#if defined(LNF_SIMD_AVX)
+        using native_type = __m256d;
+#elif defined(LNF_SIMD_SSE)
+        struct native_type {__m128d m_lo, m_hi;};
+#elif defined(LNF_SIMD_NEON)
+        struct native_type {float64x2_t m_lo, m_hi;};
+#else
+        struct native_type {double m_f[4];};
+#endif
+
+        SimdDouble() noexcept = default;
+        SimdDouble(native_type _v) noexcept : m_v(_v) {}
+
+        SimdDouble(double _f) noexcept {
+#if defined(LNF_SIMD_AVX)
+            m_v = _mm256_set1_pd(_f);
+#elif defined(LNF_SIMD_SSE)
+            m_v.m_lo = m_v.m_hi = _mm_set1_pd(_f);
+#elif defined(LNF_SIMD_NEON)
+            m_v.m_lo = m_v.m_hi = vdupq_n_f64(_f);
+#else
+            for (auto &f : m_v.m_f) f = _f;
+#endif
+        }
+
+        /* load from 32 byte aligned memory */
+        static SimdDouble load(const double *_pData) {
+#if defined(LNF_SIMD_AVX)
+            return _mm256_load_pd(_pData);
+#elif defined(LNF_SIMD_SSE)
+            return native_type{_mm_load_pd(_pData), _mm_load_pd(_pData + 2)};
+#elif defined(LNF_SIMD_NEON)
+            return native_type{vld1q_f64(_pData), vld1q_f64(_pData + 2)};
+#else
+            native_type v;
+            for (int i = 0; i < 4; i++) v.m_f[i] = _pData[i];
+            return v;
+#endif
+        }
+
+        /* store to 32 byte aligned memory */
+        void store(double *_pData) const {
+#if defined(LNF_SIMD_AVX)
+            _mm256_store_pd(_pData, m_v);
+#elif defined(LNF_SIMD_SSE)
+            _mm_store_pd(_pData, m_v.m_lo);
+            _mm_store_pd(_pData + 2, m_v.m_hi);
+#elif defined(LNF_SIMD_NEON)
+            vst1q_f64(_pData, m_v.m_lo);
+            vst1q_f64(_pData + 2, m_v.m_hi);
+#else
+            for (int i = 0; i < 4; i++) _pData[i] = m_v.m_f[i];
+#endif
+        }
+
+        native_type     m_v;
+    };
+
+
+#if defined(LNF_SIMD_AVX)
+    inline SimdDouble<4> operator+(SimdDouble<4> _a, SimdDouble<4> _b) {return _mm256_add_pd(_a.m_v, _b.m_v);}
+    inline SimdDouble<4> operator-(SimdDouble<4> _a, SimdDouble<4> _b) {return _mm256_sub_pd(_a.m_v, _b.m_v);}
+    inline SimdDouble<4> operator*(SimdDouble<4> _a, SimdDouble<4> _b) {return _mm256_mul_pd(_a.m_v, _b.m_v);}
+    inline SimdDouble<4> operator<(SimdDouble<4> _a, SimdDouble<4> _b) {return _mm256_cmp_pd(_a.m_v, _b.m_v, _CMP_LT_OQ);}
+    inline SimdDouble<4> operator>=(SimdDouble<4> _a, SimdDouble<4> _b) {return _mm256_cmp_pd(_a.m_v, _b.m_v, _CMP_GE_OQ);}
+    inline SimdDouble<4> operator&(SimdDouble<4> _a, SimdDouble<4> _b) {return _mm256_and_pd(_a.m_v, _b.m_v);}
+    inline SimdDouble<4> operator|(SimdDouble<4> _a, SimdDouble<4> _b) {return _mm256_or_pd(_a.m_v, _b.m_v);}
+
+    // returns _b where _mask is set and _a otherwise
+    inline SimdDouble<4> simdSelect(SimdDouble<4> _mask, SimdDouble<4> _a, SimdDouble<4> _b) {return _mm256_blendv_pd(_a.m_v, _b.m_v, _mask.m_v);}
+
+    // returns lane mask bits (bit i is set if lane i is true)
+    inline int simdMoveMask(SimdDouble<4> _mask) {return _mm256_movemask_pd(_mask.m_v);}
+
+#elif defined(LNF_SIMD_SSE) || defined(LNF_SIMD_NEON)
+    namespace detail {
+        template <typename func_type>
+        inline SimdDouble<4> halves(SimdDouble<4> _a, SimdDouble<4> _b, func_type &&_func) {
+            return SimdDouble<4>::native_type{_func(_a.m_v.m_lo, _b.m_v.m_lo), _func(_a.m_v.m_hi, _b.m_v.m_hi)};
+        }
+    };
+
+#if defined(LNF_SIMD_SSE)
+    #define LNF_SIMD_DOUBLE_OP(_op, _func) \
+        inline SimdDouble<4> operator _op(SimdDouble<4> _a, SimdDouble<4> _b) {return detail::halves(_a, _b, [](__m128d a, __m128d b){return _func(a, b);});}
+
+    LNF_SIMD_DOUBLE_OP(+, _mm_add_pd)
+    LNF_SIMD_DOUBLE_OP(-, _mm_sub_pd)
+    LNF_SIMD_DOUBLE_OP(*, _mm_mul_pd)
+    LNF_SIMD_DOUBLE_OP(<, _mm_cmplt_pd)
+    LNF_SIMD_DOUBLE_OP(>=, _mm_cmpge_pd)
+    LNF_SIMD_DOUBLE_OP(&, _mm_and_pd)
+    LNF_SIMD_DOUBLE_OP(|, _mm_or_pd)
+
+    // returns _b where _mask is set and _a otherwise
+    inline SimdDouble<4> simdSelect(SimdDouble<4> _mask, SimdDouble<4> _a, SimdDouble<4> _b) {
+        return (_mask & _b) | SimdDouble<4>::native_type{_mm_andnot_pd(_mask.m_v.m_lo, _a.m_v.m_lo), _mm_andnot_pd(_mask.m_v.m_hi, _a.m_v.m_hi)};
+    }
+
+    // returns lane mask bits (bit i is set if lane i is true)
+    inline int simdMoveMask(SimdDouble<4> _mask) {return _mm_movemask_pd(_mask.m_v.m_lo) | (_mm_movemask_pd(_mask.m_v.m_hi) << 2);}
+#else
+    #define LNF_SIMD_DOUBLE_OP(_op, _expr) \
+        inline SimdDouble<4> operator _op(SimdDouble<4> _a, SimdDouble<4> _b) {return detail::halves(_a, _b, [](float64x2_t a, float64x2_t b){return _expr;});}
+
+    LNF_SIMD_DOUBLE_OP(+, vaddq_f64(a, b))
+    LNF_SIMD_DOUBLE_OP(-, vsubq_f64(a, b))
+    LNF_SIMD_DOUBLE_OP(*, vmulq_f64(a, b))
+    LNF_SIMD_DOUBLE_OP(<, vreinterpretq_f64_u64(vcltq_f64(a, b)))
+    LNF_SIMD_DOUBLE_OP(>=, vreinterpretq_f64_u64(vcgeq_f64(a, b)))
+    LNF_SIMD_DOUBLE_OP(&, vreinterpretq_f64_u64(vandq_u64(vreinterpretq_u64_f64(a), vreinterpretq_u64_f64(b))))
+    LNF_SIMD_DOUBLE_OP(|, vreinterpretq_f64_u64(vorrq_u64(vreinterpretq_u64_f64(a), vreinterpretq_u64_f64(b))))
+
+    // returns _b where _mask is set and _a otherwise
+    inline SimdDouble<4> simdSelect(SimdDouble<4> _mask, SimdDouble<4> _a, SimdDouble<4> _b) {
+        return SimdDouble<4>::native_type{vbslq_f64(vreinterpretq_u64_f64(_mask.m_v.m_lo), _b.m_v.m_lo, _a.m_v.m_lo),
+                                          vbslq_f64(vreinterpretq_u64_f64(_mask.m_v.m_hi), _b.m_v.m_hi, _a.m_v.m_hi)};
+    }
+
+    // returns lane mask bits (bit i is set if lane i is true)
+    inline int simdMoveMask(SimdDouble<4> _mask) {
+        uint64x2_t lo = vshrq_n_u64(vreinterpretq_u64_f64(_mask.m_v.m_lo), 63);
+        uint64x2_t hi = vshrq_n_u64(vreinterpretq_u64_f64(_mask.m_v.m_hi), 63);
+        return (int)(vgetq_lane_u64(lo, 0) | (vgetq_lane_u64(lo, 1) << 1) | (vgetq_lane_u64(hi, 0) << 2) | (vgetq_lane_u64(hi, 1) << 3));
+    }
+#endif
+
+    #undef LNF_SIMD_DOUBLE_OP
+
+#else
+    namespace detail {
+        template <typename func_type>
+        inline SimdDouble<4> lanes(SimdDouble<4> _a, SimdDouble<4> _b, func_type &&_func) {
+            SimdDouble<4> ret;
+            for (int i = 0; i < 4; i++) ret.m_v.m_f[i] = _func(_a.m_v.m_f[i], _b.m_v.m_f[i]);
+            return ret;
+        }
+
+        inline double maskValueDouble(bool _b) {
+            const uint64_t u = _b ? ~0ull : 0ull;
+            double f;
+            memcpy(&f, &u, sizeof(f));
+            return f;
+        }
+
+        inline uint64_t bitsDouble(double _f) {
+            uint64_t u;
+            memcpy(&u, &_f, sizeof(u));
+            return u;
+        }
+
+        inline double fromBitsDouble(uint64_t _u) {
+            double f;
+            memcpy(&f, &_u, sizeof(f));
+            return f;
+        }
+    };
+
+    inline SimdDouble<4> operator+(SimdDouble<4> _a, SimdDouble<4> _b) {return detail::lanes(_a, _b, [](double a, double b){return a + b;});}
+    inline SimdDouble<4> operator-(SimdDouble<4> _a, SimdDouble<4> _b) {return detail::lanes(_a, _b, [](double a, double b){return a - b;});}
+    inline SimdDouble<4> operator*(SimdDouble<4> _a, SimdDouble<4> _b) {return detail::lanes(_a, _b, [](double a, double b){return a * b;});}
+    inline SimdDouble<4> operator<(SimdDouble<4> _a, SimdDouble<4> _b) {return detail::lanes(_a, _b, [](double a, double b){return detail::maskValueDouble(a < b);});}
+    inline SimdDouble<4> operator>=(SimdDouble<4> _a, SimdDouble<4> _b) {return detail::lanes(_a, _b, [](double a, double b){return detail::maskValueDouble(a >= b);});}
+    inline SimdDouble<4> operator&(SimdDouble<4> _a, SimdDouble<4> _b) {
+        return detail::lanes(_a, _b, [](double a, double b){return detail::fromBitsDouble(detail::bitsDouble(a) & detail::bitsDouble(b));});
+    }
+    inline SimdDouble<4> operator|(SimdDouble<4> _a, SimdDouble<4> _b) {
+        return detail::lanes(_a, _b, [](double a, double b){return detail::fromBitsDouble(detail::bitsDouble(a) | detail::bitsDouble(b));});
+    }
+
+    // returns _b where _mask is set and _a otherwise
+    inline SimdDouble<4> simdSelect(SimdDouble<4> _mask, SimdDouble<4> _a, SimdDouble<4> _b) {
+        SimdDouble<4> ret;
+        for (int i = 0; i < 4; i++) ret.m_v.m_f[i] = detail::bitsDouble(_mask.m_v.m_f[i]) ? _b.m_v.m_f[i] : _a.m_v.m_f[i];
+        return ret;
+    }
+
+    // returns lane mask bits (bit i is set if lane i is true)
+    inline int simdMoveMask(SimdDouble<4> _mask) {
+        int ret = 0;
+        for (int i = 0; i < 4; i++) ret |= (int)(detail::bitsDouble(_mask.m_v.m_f[i]) >> 63) << i;
+        return ret;
+    }
+
+#endif
+
+
+    using Float4 = SimdFloat<4>;
+    using Float8 = SimdFloat<8>;
+    using Double4 = SimdDouble<4>;
+
+
+    /* scalar versions (for code templated on float or SimdFloat) */
+    inline float simdMin(float _a, float _b) {return _b < _a ? _b : _a;}
+    inline float simdMax(float _a, float _b) {return _b > _a ? _b : _a;}
+    inline float simdAbs(float _a) {return fabs(_a);}
+    inline float simdSqrt(float _a) {return sqrt(_a);}
+
+
+    /* fast exp (Cody-Waite range reduction and polynomial; ~2 ulp, inputs clamped to [-87, 88]) */
+    template <int N>
+    inline SimdFloat<N> simdExp(SimdFloat<N> _x) {
+        using F = SimdFloat<N>;
+        _x = simdMin(simdMax(_x, F(-87.0f)), F(88.0f));
+        
+        // x = n * ln2 + g, |g| <= ln2/2
+        auto n = simdFloor(_x * F(1.44269504f) + F(0.5f));
+        auto g = _x - n * F(0.693145751953125f) - n * F(1.428606765330187e-6f);
+        
+        auto p = F(1.0f / 720.0f);
+        p = p * g + F(1.0f / 120.0f);
+        p = p * g + F(1.0f / 24.0f);
+        p = p * g + F(1.0f / 6.0f);
+        p = p * g + F(0.5f);
+        p = p * g + F(1.0f);
+        p = p * g + F(1.0f);
+        
+        return p * simdPow2(n);
+    }
+
+
+    /* fast natural log (positive, normal inputs only; atanh series on the mantissa, ~2 ulp) */
+    template <int N>
+    inline SimdFloat<N> simdLog(SimdFloat<N> _x) {
+        using F = SimdFloat<N>;
+        F m;
+        auto e = simdFrexp(_x, m);
+        
+        // mantissa in [sqrt(2)/2, sqrt(2)]
+        auto big = m > F(1.41421356f);
+        m = simdSelect(big, m, m * F(0.5f));
+        e = simdSelect(big, e, e + F(1.0f));
+        
+        // log(m) = 2 * atanh((m - 1) / (m + 1))
+        auto t = (m - F(1.0f)) / (m + F(1.0f));
+        auto t2 = t * t;
+        auto p = F(2.0f / 9.0f);
+        p = p * t2 + F(2.0f / 7.0f);
+        p = p * t2 + F(2.0f / 5.0f);
+        p = p * t2 + F(2.0f / 3.0f);
+        p = p * t2 + F(2.0f);
+        
+        return p * t + e * F(0.693147181f);
+    }
+
+
+    /* Widest native SIMD width for this build */
+#if defined(LNF_SIMD_AVX)
+    const int SIMD_WIDTH = 8;
+#else
+    const int SIMD_WIDTH = 4;
+#endif
+
+
+};  // namespace LNF
+
+
+#endif  // #ifndef LIBS_HEADER_SIMD_H
@@ -0,0 +1,327 @@
+#ifndef LIBS_HEADER_SIMPLE_SCENE_H
+#define LIBS_HEADER_SIMPLE_SCENE_H
+
+#include "bvh.h"
+#include "color.h"
+#include "counters.h"
+#include "intersect.h"
+#include "primitive.h"
+#include "ray.h"
+#include "resource.h"
+#include "scene.h"
+#include "sphere.h"
+
+#include <memory>
+#include <vector>
+
+
+namespace LNF
+{
+    // simple scene with a linear search for object hits
+    class SimpleScene   : public Scene
+    {
+     public:
+        SimpleScene()
+        {}
+
+        /*
+           Checks for an intersect with a scene object.
+           Could be accessed by multiple worker threads concurrently.
+         */
+        virtual bool hit(Intersect &_hit) const override {
+            ScopedCount tests(Counter::PRIMITIVE_TESTS);
+            HitCandidates candidates(_hit);
+            float fMaxDist = _hit.m_viewRay.m_fMaxDist;
+            for (const auto &pObj : m_objects) {
+                tests.add();
+                auto &nh = candidates.next(fMaxDist);
+                if ( (pObj->hit(nh) == true) &&
+                     (nh.m_fViewPositionOnRay < fMaxDist) )
+                {
+                    fMaxDist = nh.m_fViewPositionOnRay;
+                    candidates.accept();
+                }
+            }
+
+            return candidates.finish();
+        }
+
+        /*
+         Occlusion check: returns true on any hit closer than _fMaxDist.
+         Could be accessed by multiple worker threads concurrently.
+         */
+        virtual bool occluded(const Ray &_ray, float _fMaxDist) const override {
+            ScopedCount tests(Counter::PRIMITIVE_TESTS);
+            for (const auto &pObj : m_objects) {
+                tests.add();
+                if (pObj->occluded(_ray, _fMaxDist) == true) {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        /*
+         Checks for the background color (miss handler).
+         Could be accessed by multiple worker threads concurrently.
+         */
+        virtual Color backgroundColor() const override {
+            return Color(0.2f, 0.2f, 0.2f);
+        }
+
+        /*
+         Returns the lights (emissive instances that can be sampled directly).
+         Could be accessed by multiple worker threads concurrently.
+         */
+        virtual const std::vector<const PrimitiveInstance*> &lights() const override {
+            return m_lights;
+        }
+
+        using Scene::addResource;
+        using Scene::addPrimitiveInstance;
+
+        /*
+         Add a new resource (material, primitive, instance) allocated from the scene arena.
+         May not be safe to call while worker threads are calling 'hit'/
+        */
+        virtual Resource *addResource(Resource *_pResource) override {
+            m_resources.push_back(_pResource);
+            return _pResource;
+        }
+
+        /*
+         Add a new primitive instance allocated from the scene arena.
+         May not be safe to call while worker threads are calling 'hit'/
+         */
+        virtual PrimitiveInstance *addPrimitiveInstance(PrimitiveInstance *_pInstance) override {
+            m_objects.push_back(_pInstance);
+            if (_pInstance->isLight() == true) {
+                m_lights.push_back(_pInstance);
+            }
+
+            return _pInstance;
+        }
+
+        /* Returns the number of primitive instances */
+        size_t instanceCount() const {
+            return m_objects.size();
+        }
+
+        /* Returns primitive instance (in the order added; e.g. to animate) */
+        PrimitiveInstance *instance(size_t _uIndex) const {
+            return m_objects[_uIndex];
+        }
+
+     protected:
+        std::vector<Resource*>                           m_resources;        // owned by the scene arena
+        std::vector<PrimitiveInstance*>                  m_objects;          // owned by the scene arena
+        std::vector<const PrimitiveInstance*>            m_lights;
+    };
+
+
+    /*
+     Simple scene using a BVH for optimising hits.
+     BVH primitives are tagged by type and table index: instanced spheres are stored (only spheres) in a view space
+     SoA table and tested in a non-virtual leaf loop (no instance ray transform). This is a sphere-only fast path;
+     all other primitives (boxes, planes, meshes, groups, marched and custom shapes) use the virtual
+     PrimitiveInstance/Primitive API.
+     */
+    class SimpleSceneBvh   : public SimpleScene
+    {
+     public:
+        static constexpr double REFIT_MAX_COST_RATIO = 1.5;     // rebuild instead of refit once SAH cost grows by this ratio
+
+     public:
+        SimpleSceneBvh()
+            :m_fBuildSahCost(0),
+             m_uRebuildCount(0)
+        {}
+
+        // Checks for an intersect with a scene object (could be accessed by multiple worker threads concurrently).
+        virtual bool hit(Intersect &_hit) const override {
+            ScopedCount tests(Counter::PRIMITIVE_TESTS);
+            HitCandidates candidates(_hit);
+            const Ray viewRay = _hit.m_viewRay;
+            m_bvh.traverse(viewRay, viewRay.m_fMaxDist,
+                           [&](uint32_t _uOffset, uint32_t _uCount, float &_fMaxDist) {
+                               const auto &primitives = m_bvh.primitives();
+                               for (uint32_t i = _uOffset; i < _uOffset + _uCount; i++) {
+                                   tests.add();
+                                   const auto &tag = m_tags[i];
+                                   if (tag.m_type == PrimitiveType::SPHERE) {
+                                       const float fScale = m_spheres.m_scale[tag.m_uTable];
+                                       float fT = 0.0f;
+                                       bool bInside = false;
+                                       if ( (hitSphere(tag.m_uTable, viewRay, _fMaxDist, fT, bInside) == true) &&
+                                            (fT * fScale < _fMaxDist) )
+                                       {
+                                           // complete hit as PrimitiveInstance::hit() would
+                                           auto &nh = candidates.next(_fMaxDist);
+                                           nh.m_priRay = transformRayTo(viewRay, primitives[i]->axis());
+                                           nh.m_priRay.m_fMaxDist = _fMaxDist / fScale;
+                                           nh.m_fPositionOnRay = fT;
+                                           nh.m_bInside = bInside;
+                                           nh.m_pPrimitive = primitives[i];
+                                           nh.m_fViewPositionOnRay = fT * fScale;
+                                           
+                                           _fMaxDist = nh.m_fViewPositionOnRay;
+                                           candidates.accept();
+                                       }
+                                       
+                                       continue;
+                                   }
+                                   
+                                   auto &nh = candidates.next(_fMaxDist);
+                                   if ( (primitives[i]->hit(nh) == true) &&
+                                        (nh.m_fViewPositionOnRay < _fMaxDist) )
+                                   {
+                                       _fMaxDist = nh.m_fViewPositionOnRay;
+                                       candidates.accept();
+                                   }
+                               }
+                           });
+
+            return candidates.finish();
+        }
+
+        // Occlusion check, stops at first hit (could be accessed by multiple worker threads concurrently).
+        virtual bool occluded(const Ray &_ray, float _fMaxDist) const override {
+            ScopedCount tests(Counter::PRIMITIVE_TESTS);
+            return m_bvh.traverseAny(_ray, _fMaxDist,
+                                     [&](uint32_t _uOffset, uint32_t _uCount, float _fDist) {
+                                         const auto &primitives = m_bvh.primitives();
+                                         for (uint32_t i = _uOffset; i < _uOffset + _uCount; i++) {
+                                             tests.add();
+                                             float fT = 0.0f;
+                                             bool bInside = false;
+                                             if ( (m_tags[i].m_type == PrimitiveType::SPHERE) ?
+                                                  hitSphere(m_tags[i].m_uTable, _ray, _fDist, fT, bInside) :
+                                                  primitives[i]->occluded(_ray, _fDist) )
+                                             {
+                                                 return true;
+                                             }
+                                         }
+
+                                         return false;
+                                     });
+        }
+
+        // Build acceleration structures
+        void build(BvhBuildMethod _method = BvhBuildMethod::SAH, BvhWidth _width = BvhWidth::WIDE4) {
+            m_buildMethod = _method;
+            m_buildWidth = _width;
+            buildBvh();
+        }
+
+        /*
+         Refit acceleration structures after instances were moved.
+         The BVH is rebuilt (same settings as last build) once the refit tree's SAH cost degraded too much.
+         */
+        virtual void update() override {
+            m_bvh.refit();
+            if (m_bvh.sahCost() > m_fBuildSahCost * REFIT_MAX_COST_RATIO) {
+                buildBvh();
+                m_uRebuildCount++;
+            }
+            else {
+                buildPrimitiveTables();
+            }
+        }
+
+        // number of rebuilds by update() (refit quality too low)
+        size_t rebuildCount() const {
+            return m_uRebuildCount;
+        }
+
+        // BVH tree cost, depth and leaf size stats (from last build)
+        const BvhStats &bvhStats() const {
+            return m_bvhStats;
+        }
+
+     private:
+        void buildBvh() {
+            std::vector<const PrimitiveInstance*> rawObjects(m_objects.begin(), m_objects.end());
+            Arena buildArena;
+            auto pRoot = buildBvhRoot<2>(buildArena, rawObjects, 16, m_buildMethod);
+            m_bvhStats = LNF::bvhStats(pRoot);
+            m_bvh.build(pRoot, m_buildWidth);
+            m_fBuildSahCost = m_bvh.sahCost();
+            buildPrimitiveTables();
+        }
+
+        // type tags (in BVH primitive order) and the view space sphere table (spheres only, in BVH primitive order)
+        void buildPrimitiveTables() {
+            const auto &primitives = m_bvh.primitives();
+            m_tags.assign(primitives.size(), PrimitiveTag());
+            m_spheres = SphereTable();
+
+            for (size_t i = 0; i < primitives.size(); i++) {
+                const auto *pPrimitive = primitives[i]->primitive();
+                if (pPrimitive->type() == PrimitiveType::SPHERE) {
+                    const auto &axis = primitives[i]->axis();
+                    const float fRadius = static_cast<const Sphere*>(pPrimitive)->radius() * axis.m_fScale;
+                    m_tags[i] = {PrimitiveType::SPHERE, (uint32_t)m_spheres.m_scale.size()};
+                    m_spheres.m_centerX.push_back(axis.m_origin.x());
+                    m_spheres.m_centerY.push_back(axis.m_origin.y());
+                    m_spheres.m_centerZ.push_back(axis.m_origin.z());
+                    m_spheres.m_radiusSqr.push_back(fRadius * fRadius);
+                    m_spheres.m_scale.push_back(axis.m_fScale);
+                }
+            }
+        }
+
+        /*
+         View space version of Sphere::hit() for sphere table entry _uIndex.
+         Returns the distance on the primitive space ray in _fT (ray limits are checked in primitive space as well).
+         */
+        bool hitSphere(uint32_t _uIndex, const Ray &_ray, float _fMaxDist, float &_fT, bool &_bInside) const {
+            const float ocx = _ray.m_origin.x() - m_spheres.m_centerX[_uIndex];
+            const float ocy = _ray.m_origin.y() - m_spheres.m_centerY[_uIndex];
+            const float ocz = _ray.m_origin.z() - m_spheres.m_centerZ[_uIndex];
+            const float fRayLength = -(ocx * _ray.m_direction.x() + ocy * _ray.m_direction.y() + ocz * _ray.m_direction.z());
+            const float fIntersectRadiusSqr = ocx * ocx + ocy * ocy + ocz * ocz - fRayLength * fRayLength;
+            const float fRadiusSqr = m_spheres.m_radiusSqr[_uIndex];
+            if (fIntersectRadiusSqr > fRadiusSqr) {
+                return false;
+            }
+
+            const float dt = sqrt(fRadiusSqr - fIntersectRadiusSqr);
+            const float fScale = m_spheres.m_scale[_uIndex];
+            _bInside = dt > fRayLength;
+            _fT = (_bInside ? fRayLength + dt : fRayLength - dt) / fScale;
+            return (_fT >= Ray::MIN_DIST) && (_fT <= _fMaxDist / fScale);
+        }
+
+     private:
+        // BVH primitive type and index into the table for that type (CUSTOM primitives have no table)
+        struct PrimitiveTag {
+            PrimitiveType           m_type = PrimitiveType::CUSTOM;
+            uint32_t                m_uTable = 0;
+        };
+        
+        // instanced spheres in view space (SoA; indexed by PrimitiveTag::m_uTable)
+        struct SphereTable {
+            std::vector<float>      m_centerX;
+            std::vector<float>      m_centerY;
+            std::vector<float>      m_centerZ;
+            std::vector<float>      m_radiusSqr;
+            std::vector<float>      m_scale;
+        };
+
+     private:
+        FlatBvh<PrimitiveInstance>                       m_bvh;
+        std::vector<PrimitiveTag>                        m_tags;
+        SphereTable                                      m_spheres;
+        BvhStats                                         m_bvhStats;
+        BvhBuildMethod                                   m_buildMethod = BvhBuildMethod::SAH;
+        BvhWidth                                         m_buildWidth = BvhWidth::WIDE4;
+        double                                           m_fBuildSahCost;
+        size_t                                           m_uRebuildCount;
+    };
+
+
+};  // namespace LNF
+
+
+#endif  // #ifndef LIBS_HEADER_SIMPLE_SCENE_H
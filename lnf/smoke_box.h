@@ -37,11 +37,9 @@ namespace LNF
                 if ( (bi.m_inside == true) ||                    
                      (_hit.m_priRay.inside(bi.m_tmin) == true) )
                 {
-                    std::uniform_real_distribution<float> dist(0, m_fVisibility);
-
                     // calculate random hit point on ray inside volume
                     auto tdist = bi.m_inside ? bi.m_tmax : (bi.m_tmax - bi.m_tmin);
-                    auto rdist = dist(generator());
+                    auto rdist = random01() * m_fVisibility;
 
                     if (rdist < tdist) {
                         _hit.m_bInside = bi.m_inside;
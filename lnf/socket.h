@@ -0,0 +1,236 @@
+#ifndef LIBS_HEADER_SOCKET_H
+#define LIBS_HEADER_SOCKET_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+namespace LNF
+{
+    /*
+     Blocking TCP socket (POSIX). Send/receive transfer the full buffer or fail; shutdown() unblocks a receive on
+     another thread. Keep-alive is enabled so that connections to dead hosts fail eventually.
+     */
+    class TcpSocket
+    {
+     public:
+        TcpSocket()
+            :m_iSocket(-1)
+        {}
+
+        explicit TcpSocket(int _iSocket)
+            :m_iSocket(_iSocket)
+        {
+            configure();
+        }
+
+        ~TcpSocket() {
+            close();
+        }
+
+        TcpSocket(TcpSocket &&_other) noexcept
+            :m_iSocket(_other.m_iSocket)
+        {
+            _other.m_iSocket = -1;
+        }
+
+        TcpSocket &operator=(TcpSocket &&_other) noexcept {
+            if (this != &_other) {
+                close();
+                m_iSocket = _other.m_iSocket;
+                _other.m_iSocket = -1;
+            }
+
+            return *this;
+        }
+
+        TcpSocket(const TcpSocket &) = delete;
+        TcpSocket &operator=(const TcpSocket &) = delete;
+
+        bool valid() const {
+            return m_iSocket >= 0;
+        }
+
+        /* connects to host ('name' or 'address'); returns 0 on success */
+        int connect(const std::string &_strHost, uint16_t _uPort) {
+            close();
+
+            addrinfo hints = {};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+
+            addrinfo *pAddresses = nullptr;
+            if (getaddrinfo(_strHost.c_str(), std::to_string(_uPort).c_str(), &hints, &pAddresses) != 0) {
+                fprintf(stderr, "ERROR: can't resolve %s\n", _strHost.c_str());
+                return -1;
+            }
+
+            for (auto pAddress = pAddresses; pAddress != nullptr; pAddress = pAddress->ai_next) {
+                int iSocket = ::socket(pAddress->ai_family, pAddress->ai_socktype, pAddress->ai_protocol);
+                if (iSocket < 0) {
+                    continue;
+                }
+
+                if (::connect(iSocket, pAddress->ai_addr, pAddress->ai_addrlen) == 0) {
+                    m_iSocket = iSocket;
+                    break;
+                }
+
+                ::close(iSocket);
+            }
+
+            freeaddrinfo(pAddresses);
+            if (m_iSocket < 0) {
+                fprintf(stderr, "ERROR: can't connect to %s:%d\n", _strHost.c_str(), (int)_uPort);
+                return -1;
+            }
+
+            configure();
+            return 0;
+        }
+
+        /* listens on all interfaces; returns 0 on success */
+        int listen(uint16_t _uPort) {
+            close();
+
+            m_iSocket = ::socket(AF_INET, SOCK_STREAM, 0);
+            if (m_iSocket < 0) {
+                fprintf(stderr, "ERROR: can't create socket\n");
+                return -1;
+            }
+
+            int iReuse = 1;
+            setsockopt(m_iSocket, SOL_SOCKET, SO_REUSEADDR, &iReuse, sizeof(iReuse));
+
+            sockaddr_in address = {};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_ANY);
+            address.sin_port = htons(_uPort);
+
+            if ( (::bind(m_iSocket, (const sockaddr*)&address, sizeof(address)) != 0) ||
+                 (::listen(m_iSocket, 8) != 0) )
+            {
+                fprintf(stderr, "ERROR: can't listen on port %d\n", (int)_uPort);
+                close();
+                return -1;
+            }
+
+            return 0;
+        }
+
+        /* waits for the next connection (returns an invalid socket on error) */
+        TcpSocket accept() {
+            return TcpSocket(::accept(m_iSocket, nullptr, nullptr));
+        }
+
+        /* sends the whole buffer; returns 0 on success */
+        int send(const void *_pData, size_t _uSize) {
+            auto pData = (const char*)_pData;
+            while (_uSize > 0) {
+                auto iSent = ::send(m_iSocket, pData, _uSize, SEND_FLAGS);
+                if (iSent <= 0) {
+                    return -1;
+                }
+
+                pData += iSent;
+                _uSize -= (size_t)iSent;
+            }
+
+            return 0;
+        }
+
+        /* receives exactly _uSize bytes; returns 0 on success (-1 on error or if the connection was closed) */
+        int receive(void *_pData, size_t _uSize) {
+            auto pData = (char*)_pData;
+            while (_uSize > 0) {
+                auto iReceived = ::recv(m_iSocket, pData, _uSize, 0);
+                if (iReceived <= 0) {
+                    return -1;
+                }
+
+                pData += iReceived;
+                _uSize -= (size_t)iReceived;
+            }
+
+            return 0;
+        }
+
+        /* stops sending and receiving (blocked calls on other threads return with an error) */
+        void shutdown() {
+            if (m_iSocket >= 0) {
+                ::shutdown(m_iSocket, SHUT_RDWR);
+            }
+        }
+
+        void close() {
+            if (m_iSocket >= 0) {
+                ::close(m_iSocket);
+                m_iSocket = -1;
+            }
+        }
+
+     private:
+#ifdef MSG_NOSIGNAL
+        static constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+        static constexpr int SEND_FLAGS = 0;
+#endif
+
+        void configure() {
+            if (m_iSocket >= 0) {
+                int iOn = 1;
+                setsockopt(m_iSocket, IPPROTO_TCP, TCP_NODELAY, &iOn, sizeof(iOn));
+                setsockopt(m_iSocket, SOL_SOCKET, SO_KEEPALIVE, &iOn, sizeof(iOn));
+#ifdef SO_NOSIGPIPE
+                setsockopt(m_iSocket, SOL_SOCKET, SO_NOSIGPIPE, &iOn, sizeof(iOn));
+#endif
+            }
+        }
+
+     private:
+        int         m_iSocket;
+    };
+
+
+    /*
+     Message framing: 32 bit type and payload size (host byte order, all nodes are expected to share endianness)
+     followed by the payload.
+     */
+    inline int sendMessage(TcpSocket &_socket, uint32_t _uType, const void *_pData, size_t _uSize) {
+        const uint32_t header[2] = {_uType, (uint32_t)_uSize};
+        if ( (_socket.send(header, sizeof(header)) != 0) ||
+             (_socket.send(_pData, _uSize) != 0) )
+        {
+            return -1;
+        }
+
+        return 0;
+    }
+
+
+    /* receives the next message; returns 0 on success (payloads larger than _uMaxSize fail) */
+    inline int receiveMessage(TcpSocket &_socket, uint32_t &_uType, std::vector<unsigned char> &_data, size_t _uMaxSize = (size_t)1 << 30) {
+        uint32_t header[2] = {};
+        if ( (_socket.receive(header, sizeof(header)) != 0) || (header[1] > _uMaxSize) ) {
+            return -1;
+        }
+
+        _uType = header[0];
+        _data.resize(header[1]);
+        return _socket.receive(_data.data(), _data.size());
+    }
+
+
+};  // namespace LNF
+
+
+#endif  // #ifndef LIBS_HEADER_SOCKET_H
@@ -30,6 +30,12 @@ namespace LNF
             return m_pMaterial;
         }
         
+        virtual PrimitiveType type() const override {return PrimitiveType::SPHERE;}
+        
+        float radius() const {
+            return m_fRadius;
+        }
+        
         /* Quick node hit check (populates at least node and time properties of intercept) */
         virtual bool hit(Intersect &_hit) const override {
             float dRayLength = -_hit.m_priRay.m_origin * _hit.m_priRay.m_direction;
@@ -70,6 +76,61 @@ namespace LNF
         virtual const Bounds &bounds() const override {
             return  m_bounds;
         }
+        
+        /* Returns true if the primitive supports light sampling (sample() and pdf()) */
+        virtual bool isSampleable() const override {return true;}
+        
+        /* Samples the cone of directions subtended by the sphere (uniform over solid angle) */
+        virtual bool sample(LightSample &_sample, const Vec &_origin) const override {
+            float fDistSqr = _origin.sizeSqr();
+            if (fDistSqr <= m_fRadiusSqr) {
+                return false;   // inside sphere
+            }
+            
+            float fDist = sqrt(fDistSqr);
+            float fCosMax = coneCosMax(fDistSqr);
+            float fOneMinusCosMax = m_fRadiusSqr / fDistSqr / (1.0f + fCosMax);
+            
+            float fCos = 1.0f - random01() * fOneMinusCosMax;
+            float fSin = sqrt(std::max(0.0f, 1.0f - fCos * fCos));
+            float fPhi = 2.0f * pi * random01();
+            
+            auto axis = axisPlane(-_origin / fDist, Vec());
+            _sample.m_direction = (axis.m_x * (fSin * cos(fPhi)) + axis.m_y * fCos + axis.m_z * (fSin * sin(fPhi))).normalized();
+            
+            // distance to near side of sphere along sampled direction
+            float b = _origin * _sample.m_direction;
+            float d = std::max(0.0f, b * b - (fDistSqr - m_fRadiusSqr));
+            _sample.m_fDistance = -b - sqrt(d);
+            _sample.m_normal = (_origin + _sample.m_direction * _sample.m_fDistance) / m_fRadius;
+            _sample.m_fPdf = 1.0f / (2.0f * pi * fOneMinusCosMax);
+            
+            return true;
+        }
+        
+        /* Returns the solid angle pdf of sample() returning _direction from _origin */
+        virtual float pdf(const Vec &_origin, const Vec &_direction) const override {
+            float fDistSqr = _origin.sizeSqr();
+            if (fDistSqr <= m_fRadiusSqr) {
+                return 0;
+            }
+            
+            float fCosMax = coneCosMax(fDistSqr);
+            if (-(_origin * _direction) < fCosMax * sqrt(fDistSqr)) {
+                return 0;   // direction outside of cone
+            }
+            
+            return (1.0f + fCosMax) / (2.0f * pi * m_fRadiusSqr / fDistSqr);
+        }
+        
+     private:
+        /*
+         Cosine of cone half-angle as seen from distance.
+         NOTE: 1 - cos is calculated as sin^2 / (1 + cos) when required (accurate for small, distant lights).
+         */
+        float coneCosMax(float _fDistSqr) const {
+            return sqrt(std::max(0.0f, 1.0f - m_fRadiusSqr / _fDistSqr));
+        }
 
      private:
         const Material     *m_pMaterial;
@@ -3,6 +3,8 @@
 
 #include "constants.h"
 
+#include <cstdint>
+
 
 namespace LNF
 {
@@ -17,7 +19,7 @@ namespace LNF
         {}
     
         void push(double _x) {
-            if (isnan(_x) == false) {
+            if (std::isnan(_x) == false) {
                 m_uCount++;
                 auto delta = _x - m_dMean;
                 m_dMean += delta / m_uCount;
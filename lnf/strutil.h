@@ -2,6 +2,9 @@
 #ifndef LIBS_HEADER_STRUTIL_H
 #define LIBS_HEADER_STRUTIL_H
 
+#include <string>
+#include <vector>
+
 namespace LNF
 {
     namespace detail {
@@ -0,0 +1,510 @@
+#ifndef LIBS_HEADER_TEXTURE_H
+#define LIBS_HEADER_TEXTURE_H
+
+#include "color.h"
+#include "jpeg.h"
+#include "mapped_file.h"
+#include "resource.h"
+#include "uv.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace LNF
+{
+    /* Square tile of RGBA (8:8:8:8) texels */
+    struct TextureTile
+    {
+        static constexpr int SIZE = 32;
+        static constexpr size_t BYTES = SIZE * SIZE * 4;
+
+        uint8_t     m_texels[BYTES];
+    };
+
+
+    /* Texture cache statistics */
+    struct TextureCacheStats
+    {
+        void print(const char *_pszName) const {
+            printf("%s texture cache: resident=%.2fMB, budget=%.2fMB, hits=%d, misses=%d, evictions=%d\n",
+                   _pszName, m_uResidentBytes / (1024.0 * 1024.0), m_uBudgetBytes / (1024.0 * 1024.0),
+                   (int)m_uHits, (int)m_uMisses, (int)m_uEvictions);
+        }
+
+        size_t      m_uResidentBytes = 0;
+        size_t      m_uBudgetBytes = 0;
+        size_t      m_uHits = 0;
+        size_t      m_uMisses = 0;
+        size_t      m_uEvictions = 0;
+    };
+
+
+    /*
+     Bounded LRU cache of texture tiles (shared by all streamed textures).
+     Tiles are loaded on a miss and the least recently used tiles are dropped once the budget is exceeded.
+     Tiles in use stay valid after eviction (shared ownership), so the budget can be exceeded by the tiles threads are sampling.
+     Thread safe.
+     */
+    class TextureCache
+    {
+     public:
+        static constexpr size_t DEFAULT_BUDGET = 256 * 1024 * 1024;
+
+        using tile_ptr = std::shared_ptr<const TextureTile>;
+        using load_func = std::function<bool(TextureTile &)>;
+
+     public:
+        explicit TextureCache(size_t _uBudgetBytes = DEFAULT_BUDGET)
+            :m_uBudgetBytes(_uBudgetBytes)
+        {}
+
+        /* shared cache used by textures by default */
+        static TextureCache &global() {
+            static TextureCache cache;
+            return cache;
+        }
+
+        void setBudget(size_t _uBudgetBytes) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_uBudgetBytes = _uBudgetBytes;
+            evict();
+        }
+
+        /* returns tile for key, using _load to fill it on a miss (nullptr if loading failed) */
+        tile_ptr tile(uint64_t _uKey, const load_func &_load) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                auto it = m_entries.find(_uKey);
+                if (it != m_entries.end()) {
+                    m_lru.splice(m_lru.begin(), m_lru, it->second);
+                    m_stats.m_uHits++;
+                    return it->second->second;
+                }
+
+                m_stats.m_uMisses++;
+            }
+
+            // load outside of the lock (another thread may load the same tile; the first one is kept)
+            auto pTile = std::make_shared<TextureTile>();
+            if (_load(*pTile) == false) {
+                return nullptr;
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_entries.find(_uKey);
+            if (it != m_entries.end()) {
+                return it->second->second;
+            }
+
+            m_lru.emplace_front(_uKey, pTile);
+            m_entries[_uKey] = m_lru.begin();
+            m_stats.m_uResidentBytes += sizeof(TextureTile);
+            evict();
+            return pTile;
+        }
+
+        /* drop all tiles of a texture (key prefix) */
+        void remove(uint32_t _uTextureId) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto it = m_lru.begin(); it != m_lru.end(); ) {
+                if ((uint32_t)(it->first >> 40) == _uTextureId) {
+                    m_entries.erase(it->first);
+                    it = m_lru.erase(it);
+                    m_stats.m_uResidentBytes -= sizeof(TextureTile);
+                }
+                else {
+                    ++it;
+                }
+            }
+        }
+
+        TextureCacheStats stats() const {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            TextureCacheStats stats = m_stats;
+            stats.m_uBudgetBytes = m_uBudgetBytes;
+            return stats;
+        }
+
+     private:
+        using entry_list = std::list<std::pair<uint64_t, tile_ptr>>;
+
+        // drop least recently used tiles until within budget (keeps at least one tile)
+        void evict() {
+            while ( (m_stats.m_uResidentBytes > m_uBudgetBytes) && (m_lru.size() > 1) ) {
+                m_entries.erase(m_lru.back().first);
+                m_lru.pop_back();
+                m_stats.m_uResidentBytes -= sizeof(TextureTile);
+                m_stats.m_uEvictions++;
+            }
+        }
+
+     private:
+        mutable std::mutex                                      m_mutex;
+        size_t                                                  m_uBudgetBytes;
+        entry_list                                              m_lru;          // most recently used first
+        std::unordered_map<uint64_t, entry_list::iterator>      m_entries;
+        TextureCacheStats                                       m_stats;
+    };
+
+
+    /*
+     Mip-mapped RGB texture stored as tiles (repeat addressing, bilinear/trilinear filtering; v = 0 is the bottom row).
+     Image textures are converted to a tiled mip pyramid file next to the image ('<file>.lnftex'; rebuilt when the
+     image changes) and their tiles are streamed through a TextureCache, so only recently used tiles stay resident.
+     If the tile file can not be written, or for generated textures, all tiles are kept in memory.
+     */
+    class Texture   : public Resource
+    {
+     public:
+        static constexpr int TILE_SIZE = TextureTile::SIZE;
+
+     public:
+        /* load JPEG image (check valid()) */
+        Texture(const std::string &_strPath, TextureCache *_pCache = &TextureCache::global())
+            :m_uId(nextId()),
+             m_pCache(_pCache),
+             m_fScale(1.0f / 255)
+        {
+            uint64_t uSourceSize = 0;
+            int64_t iSourceTime = 0;
+            if (fileStamp(_strPath, uSourceSize, iSourceTime) == false) {
+                fprintf(stderr, "ERROR: texture '%s' not found\n", _strPath.c_str());
+                return;
+            }
+
+            const std::string strTilePath = _strPath + ".lnftex";
+            if (openTileFile(strTilePath, uSourceSize, iSourceTime) == true) {
+                return;
+            }
+
+            int iWidth = 0, iHeight = 0;
+            std::vector<unsigned char> image;
+            if (readJpegFile(_strPath.c_str(), iWidth, iHeight, image) != 0) {
+                return;
+            }
+
+            buildPyramid(iWidth, iHeight, [&](int _iX, int _iY, uint8_t *_pTexel) {
+                const unsigned char *pPixel = &image[((size_t)_iY * iWidth + _iX) * 3];
+                _pTexel[0] = pPixel[0];
+                _pTexel[1] = pPixel[1];
+                _pTexel[2] = pPixel[2];
+                _pTexel[3] = 255;
+            });
+
+            // stream from the tile file if it can be written (keep tiles in memory otherwise)
+            if ( (writeTileFile(strTilePath, uSourceSize, iSourceTime) == true) && (openTileFile(strTilePath, uSourceSize, iSourceTime) == true) ) {
+                m_tiles = std::vector<TextureTile>();
+            }
+        }
+
+        /*
+         Generated texture (e.g. a baked procedural material), kept in memory.
+         _texelFunc(const Uv &) returns the color at the texel center; colors are stored relative to _fRange (8 bits per channel).
+         */
+        Texture(int _iWidth, int _iHeight, const std::function<Color(const Uv &)> &_texelFunc, float _fRange = 1.0f)
+            :m_uId(nextId()),
+             m_pCache(nullptr),
+             m_fScale(_fRange / 255)
+        {
+            buildPyramid(_iWidth, _iHeight, [&](int _iX, int _iY, uint8_t *_pTexel) {
+                const Color color = _texelFunc(Uv((_iX + 0.5f) / _iWidth, 1.0f - (_iY + 0.5f) / _iHeight)) * (255.0f / _fRange);
+                _pTexel[0] = (uint8_t)std::clamp(std::lround(color.red()), 0l, 255l);
+                _pTexel[1] = (uint8_t)std::clamp(std::lround(color.green()), 0l, 255l);
+                _pTexel[2] = (uint8_t)std::clamp(std::lround(color.blue()), 0l, 255l);
+                _pTexel[3] = 255;
+            });
+        }
+
+        virtual ~Texture() {
+            if (m_pFile != nullptr) {
+                fclose(m_pFile);
+                if (m_pCache != nullptr) {
+                    m_pCache->remove(m_uId);
+                }
+            }
+        }
+
+        Texture(const Texture &) = delete;
+        Texture &operator=(const Texture &) = delete;
+
+        bool valid() const {
+            return m_levels.empty() == false;
+        }
+
+        int width() const {return valid() ? m_levels[0].m_iWidth : 0;}
+        int height() const {return valid() ? m_levels[0].m_iHeight : 0;}
+        int levels() const {return (int)m_levels.size();}
+
+        /* true if tiles are streamed through the texture cache */
+        bool streamed() const {
+            return m_pFile != nullptr;
+        }
+
+        /* returns filtered color (_fLod: mip level, fractions blend between levels) */
+        Color sample(const Uv &_uv, float _fLod = 0.0f) const {
+            if (valid() == false) {
+                return Color();
+            }
+
+            const float fLod = std::clamp(_fLod, 0.0f, (float)(m_levels.size() - 1));
+            const int iLevel = (int)fLod;
+            const float f = fLod - iLevel;
+
+            Color color = bilinear(iLevel, _uv);
+            if ( (f > 0.0f) && (iLevel + 1 < (int)m_levels.size()) ) {
+                color = color * (1 - f) + bilinear(iLevel + 1, _uv) * f;
+            }
+
+            return color;
+        }
+
+        /* returns unfiltered texel color */
+        Color texel(int _iLevel, int _iX, int _iY) const {
+            const uint8_t *pTexel = texelData(_iLevel, _iX, _iY);
+            return pTexel != nullptr ? Color(pTexel[0] * m_fScale, pTexel[1] * m_fScale, pTexel[2] * m_fScale) : Color();
+        }
+
+     private:
+        struct Level {
+            int         m_iWidth;
+            int         m_iHeight;
+            int         m_iTilesX;
+            int         m_iTilesY;
+            size_t      m_uFirstTile;       // index of first tile (all levels' tiles are stored in one list)
+        };
+
+        static constexpr uint32_t   FILE_VERSION = 1;
+
+        // tile file header (followed by all tiles, level by level, row by row)
+        struct FileHeader {
+            char        m_szMagic[8];
+            uint32_t    m_uVersion;
+            uint32_t    m_uTileSize;
+            uint64_t    m_uSourceSize;
+            int64_t     m_iSourceTime;
+            uint32_t    m_uWidth;
+            uint32_t    m_uHeight;
+        };
+
+        // ids key the cache tiles (24 bits id, 40 bits tile)
+        static uint32_t nextId() {
+            static std::atomic<uint32_t> uNextId(1);
+            return uNextId++ & 0xffffff;
+        }
+
+        static FileHeader fileHeader(uint64_t _uSourceSize, int64_t _iSourceTime, int _iWidth, int _iHeight) {
+            FileHeader header = {};
+            std::memcpy(header.m_szMagic, "LNFTEX", 7);
+            header.m_uVersion = FILE_VERSION;
+            header.m_uTileSize = TILE_SIZE;
+            header.m_uSourceSize = _uSourceSize;
+            header.m_iSourceTime = _iSourceTime;
+            header.m_uWidth = (uint32_t)_iWidth;
+            header.m_uHeight = (uint32_t)_iHeight;
+            return header;
+        }
+
+        // mip level layout (halved until 1x1)
+        void initLevels(int _iWidth, int _iHeight) {
+            m_levels.clear();
+            size_t uTiles = 0;
+            for (int w = _iWidth, h = _iHeight; ; w = std::max(w / 2, 1), h = std::max(h / 2, 1)) {
+                Level level = {w, h, (w + TILE_SIZE - 1) / TILE_SIZE, (h + TILE_SIZE - 1) / TILE_SIZE, uTiles};
+                uTiles += (size_t)level.m_iTilesX * level.m_iTilesY;
+                m_levels.push_back(level);
+
+                if ( (w == 1) && (h == 1) ) {
+                    break;
+                }
+            }
+
+            m_uTileCount = uTiles;
+        }
+
+        // fill level 0 with _texelFunc(x, y, texel) and box filter the smaller levels (tiles are kept in memory)
+        template <typename texel_func>
+        void buildPyramid(int _iWidth, int _iHeight, texel_func &&_texelFunc) {
+            if ( (_iWidth <= 0) || (_iHeight <= 0) ) {
+                return;
+            }
+
+            initLevels(_iWidth, _iHeight);
+            m_tiles.resize(m_uTileCount);
+
+            for (int y = 0; y < _iHeight; y++) {
+                for (int x = 0; x < _iWidth; x++) {
+                    _texelFunc(x, y, mutableTexel(0, x, y));
+                }
+            }
+
+            for (size_t l = 1; l < m_levels.size(); l++) {
+                const Level &src = m_levels[l - 1];
+                for (int y = 0; y < m_levels[l].m_iHeight; y++) {
+                    for (int x = 0; x < m_levels[l].m_iWidth; x++) {
+                        const int x0 = std::min(2 * x, src.m_iWidth - 1), x1 = std::min(2 * x + 1, src.m_iWidth - 1);
+                        const int y0 = std::min(2 * y, src.m_iHeight - 1), y1 = std::min(2 * y + 1, src.m_iHeight - 1);
+                        const uint8_t *p00 = mutableTexel(l - 1, x0, y0), *p10 = mutableTexel(l - 1, x1, y0);
+                        const uint8_t *p01 = mutableTexel(l - 1, x0, y1), *p11 = mutableTexel(l - 1, x1, y1);
+
+                        uint8_t *pTexel = mutableTexel(l, x, y);
+                        for (int c = 0; c < 4; c++) {
+                            pTexel[c] = (uint8_t)((p00[c] + p10[c] + p01[c] + p11[c] + 2) / 4);
+                        }
+                    }
+                }
+            }
+        }
+
+        uint8_t *mutableTexel(size_t _uLevel, int _iX, int _iY) {
+            const Level &level = m_levels[_uLevel];
+            auto &tile = m_tiles[level.m_uFirstTile + (size_t)(_iY / TILE_SIZE) * level.m_iTilesX + _iX / TILE_SIZE];
+            return &tile.m_texels[((_iY % TILE_SIZE) * TILE_SIZE + _iX % TILE_SIZE) * 4];
+        }
+
+        // writes memory tiles to a tile file (via a temporary file)
+        bool writeTileFile(const std::string &_strPath, uint64_t _uSourceSize, int64_t _iSourceTime) const {
+            const std::string strTempPath = _strPath + ".tmp";
+            FILE *pFile = fopen(strTempPath.c_str(), "wb");
+            if (pFile == nullptr) {
+                return false;
+            }
+
+            const FileHeader header = fileHeader(_uSourceSize, _iSourceTime, m_levels[0].m_iWidth, m_levels[0].m_iHeight);
+            bool bOk = (fwrite(&header, sizeof(header), 1, pFile) == 1) &&
+                       (fwrite(m_tiles.data(), sizeof(TextureTile), m_tiles.size(), pFile) == m_tiles.size());
+
+            bOk = (fclose(pFile) == 0) && bOk;
+            if ( (bOk == false) || (std::rename(strTempPath.c_str(), _strPath.c_str()) != 0) ) {
+                std::remove(strTempPath.c_str());
+                return false;
+            }
+
+            return true;
+        }
+
+        // opens tile file for streaming (false if missing, for another source file or truncated)
+        bool openTileFile(const std::string &_strPath, uint64_t _uSourceSize, int64_t _iSourceTime) {
+            FILE *pFile = fopen(_strPath.c_str(), "rb");
+            if (pFile == nullptr) {
+                return false;
+            }
+
+            FileHeader header = {};
+            if (fread(&header, sizeof(header), 1, pFile) == 1) {
+                const FileHeader expected = fileHeader(_uSourceSize, _iSourceTime, (int)header.m_uWidth, (int)header.m_uHeight);
+                uint64_t uFileSize = 0;
+                int64_t iFileTime = 0;
+                if ( (std::memcmp(&header, &expected, sizeof(header)) == 0) && (header.m_uWidth > 0) && (header.m_uHeight > 0) &&
+                     (fileStamp(_strPath, uFileSize, iFileTime) == true) )
+                {
+                    initLevels((int)header.m_uWidth, (int)header.m_uHeight);
+                    if (uFileSize == sizeof(header) + m_uTileCount * sizeof(TextureTile)) {
+                        m_pFile = pFile;
+                        return true;
+                    }
+
+                    m_levels.clear();
+                }
+            }
+
+            fclose(pFile);
+            return false;
+        }
+
+        // returns texel (coordinates wrap around); streamed tiles go through the cache
+        const uint8_t *texelData(int _iLevel, int _iX, int _iY) const {
+            const Level &level = m_levels[_iLevel];
+            const int x = ((_iX % level.m_iWidth) + level.m_iWidth) % level.m_iWidth;
+            const int y = ((_iY % level.m_iHeight) + level.m_iHeight) % level.m_iHeight;
+            const size_t uTile = level.m_uFirstTile + (size_t)(y / TILE_SIZE) * level.m_iTilesX + x / TILE_SIZE;
+            const size_t uTexel = ((y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE) * 4;
+
+            if (m_pFile == nullptr) {
+                return &m_tiles[uTile].m_texels[uTexel];
+            }
+
+            const TextureTile *pTile = streamedTile(uTile);
+            return pTile != nullptr ? &pTile->m_texels[uTexel] : nullptr;
+        }
+
+        // streamed tile lookup (the last tiles used by a thread are remembered, which also keeps them alive)
+        const TextureTile *streamedTile(size_t _uTile) const {
+            struct RecentTile {
+                uint64_t                    m_uKey = 0;
+                TextureCache::tile_ptr      m_pTile;
+            };
+
+            static constexpr int RECENT_TILES = 8;
+            thread_local RecentTile recent[RECENT_TILES];
+
+            const uint64_t uKey = ((uint64_t)m_uId << 40) | (uint64_t)_uTile;
+            auto &slot = recent[_uTile % RECENT_TILES];
+            if ( (slot.m_uKey == uKey) && (slot.m_pTile != nullptr) ) {
+                return slot.m_pTile.get();
+            }
+
+            auto pTile = m_pCache->tile(uKey, [this, _uTile](TextureTile &_tile) {
+                std::lock_guard<std::mutex> lock(m_fileMutex);
+                return (fseek(m_pFile, (long)(sizeof(FileHeader) + _uTile * sizeof(TextureTile)), SEEK_SET) == 0) &&
+                       (fread(&_tile, sizeof(TextureTile), 1, m_pFile) == 1);
+            });
+
+            slot.m_uKey = uKey;
+            slot.m_pTile = pTile;
+            return pTile.get();
+        }
+
+        // bilinear filtered color on mip level (texel centers at half texel offsets)
+        Color bilinear(int _iLevel, const Uv &_uv) const {
+            const Level &level = m_levels[_iLevel];
+            const float fX = _uv.u() * level.m_iWidth - 0.5f;
+            const float fY = (1.0f - _uv.v()) * level.m_iHeight - 0.5f;
+            const float fX0 = std::floor(fX), fY0 = std::floor(fY);
+            const float fx = fX - fX0, fy = fY - fY0;
+            const int x = (int)fX0, y = (int)fY0;
+
+            return texel(_iLevel, x, y) * ((1 - fx) * (1 - fy)) +
+                   texel(_iLevel, x + 1, y) * (fx * (1 - fy)) +
+                   texel(_iLevel, x, y + 1) * ((1 - fx) * fy) +
+                   texel(_iLevel, x + 1, y + 1) * (fx * fy);
+        }
+
+     private:
+        uint32_t                    m_uId;
+        TextureCache                *m_pCache;
+        float                       m_fScale;           // texel value to color
+        std::vector<Level>          m_levels;
+        size_t                      m_uTileCount = 0;
+        std::vector<TextureTile>    m_tiles;            // in memory tiles (not streamed)
+        FILE                        *m_pFile = nullptr; // tile file (streamed)
+        mutable std::mutex          m_fileMutex;
+    };
+
+
+    // create texture (in the scene arena) and add to scene as a resource
+    template <typename scene_ptr_type, class... T>
+    const Texture *createTexture(scene_ptr_type &_pScene, T ... t) {
+        return static_cast<const Texture*>(
+            _pScene->addResource(
+                _pScene->arena().template create<Texture>(t ...)
+            )
+        );
+    }
+
+
+};  // namespace LNF
+
+
+#endif  // #ifndef LIBS_HEADER_TEXTURE_H
@@ -4,8 +4,10 @@
 
 #include "color.h"
 #include "constants.h"
+#include "counters.h"
 #include "intersect.h"
 #include "material.h"
+#include "random.h"
 #include "outputimage.h"
 #include "ray.h"
 #include "scene.h"
@@ -16,6 +18,8 @@
 #include <vector>
 #include <random>
 #include <atomic>
+#include <cstdint>
+#include <cstdio>
 #include <functional>
 
 
@@ -23,132 +27,308 @@ namespace LNF
 {
     // constants
     const float T_MIN = 1e-4f;
+    const float SHADOW_EPSILON = 1e-3f;     // relative distance shadow rays stop short of sampled light points
+
+
+    /* power heuristic for multiple importance sampling (weight of strategy with _fPdfA) */
+    inline float powerHeuristic(float _fPdfA, float _fPdfB) {
+        float a = _fPdfA * _fPdfA;
+        float b = _fPdfB * _fPdfB;
+        return (a + b) > 0 ? a / (a + b) : 0.0f;
+    }
+
+
+    /*
+     Direct light sampling (next event estimation) on a lambertian surface (position and normal in view space).
+     Picks one scene light uniformly, casts a shadow ray towards a point on it and returns the reflected light
+     (still to be scaled by path throughput), MIS weighted against cosine weighted BSDF sampling.
+     */
+    inline Color sampleLights(const Scene *_pScene, const Vec &_position, const Vec &_normal, const Color &_albedo) {
+        const auto &lights = _pScene->lights();
+        if (lights.empty() == true) {
+            return Color();
+        }
+        
+        const auto *pLight = lights[randomIndex((uint32_t)lights.size())];
+        
+        LightSample sample;
+        if (pLight->sampleLight(sample, _position) == false) {
+            return Color();
+        }
+        
+        float fCos = _normal * sample.m_direction;
+        if ( (fCos <= 0) || (sample.m_fPdf <= 0) || (sample.m_emitted.isBlack() == true) ) {
+            return Color();
+        }
+        
+        // shadow ray (stops just short of the light surface)
+        auto shadowRay = Ray(_position + sample.m_direction * T_MIN, sample.m_direction);
+        countEvent(Counter::SHADOW_RAYS);
+        if (_pScene->occluded(shadowRay, sample.m_fDistance * (1.0f - SHADOW_EPSILON) - T_MIN) == true) {
+            return Color();
+        }
+        
+        float fLightPdf = sample.m_fPdf / lights.size();
+        float fBsdfPdf = fCos / pi;
+        return _albedo * sample.m_emitted * (fBsdfPdf / fLightPdf * powerHeuristic(fLightPdf, fBsdfPdf));
+    }
+
+
+    /*
+     MIS weight for light hit by BSDF sampling from a lambertian surface at _origin (view space; _fBsdfPdf is the
+     solid angle pdf of the scattered direction). Complements the weight applied in sampleLights().
+     */
+    inline float lightHitWeight(const Scene *_pScene, const PrimitiveInstance *_pLight, const Vec &_origin, const Vec &_direction, float _fBsdfPdf) {
+        float fLightPdf = _pLight->lightPdf(_origin, _direction) / _pScene->lights().size();
+        return powerHeuristic(_fBsdfPdf, fLightPdf);
+    }
 
 
     /*
         Ray tracing functions and stats.
         Works on a pre-constructed scene.
+        Paths are traced iteratively, carrying the path throughput. After _uRouletteDepth bounces paths are
+        terminated randomly (Russian roulette, with survival probability based on throughput), which keeps
+        the result unbiased while bounding time spent on long, dim paths. A roulette depth of 0 disables it.
+        Lambertian surfaces also sample the scene lights directly (next event estimation, MIS weighted).
     */
     class RayTracer
     {
      public:
-        RayTracer(const Scene *_pScene, uint16_t _uMaxTraceDepth)
+        const static uint16_t   DEFAULT_ROULETTE_DEPTH  = 5;
+        
+     public:
+        RayTracer(const Scene *_pScene, uint16_t _uMaxTraceDepth, uint16_t _uRouletteDepth = DEFAULT_ROULETTE_DEPTH)
             :m_pScene(_pScene),
              m_uTraceLimit(_uMaxTraceDepth),
+             m_uRouletteDepth(_uRouletteDepth),
              m_uTraceDepthMax(0),
              m_uRayCount(0)
         {}
         
         Color trace(const Ray &_ray) {
-            return traceRay(_ray, 0);
+            return traceRay(_ray);
         }
         
         uint16_t traceDepthMax() const {return m_uTraceDepthMax;}
         uint64_t rayCount() const {return m_uRayCount;}
 
      protected:
-        /* Trace ray (recursively) through scene */
-        Color traceRay(const Ray &_ray, int _iDepth) {
-            m_uRayCount++;
+        /* Trace ray (iteratively) through scene */
+        Color traceRay(const Ray &_ray) {
+            Color radiance;
+            Color throughput(1.0f, 1.0f, 1.0f);
+            Ray ray(_ray);
+            Vec lastPosition;               // last lambertian surface point (view space)
+            float fBsdfPdf = 0.0f;          // pdf of last scattered direction (0 if lights were not sampled)
             
-            // check for hits on scene
-            Intersect hit(_ray);
-            if (m_pScene->hit(hit) == true) {
+            for (uint16_t uDepth = 1; ; uDepth++) {
+                m_uRayCount++;
+                countRay(uDepth);
+                
+                // check for hits on scene
+                Intersect hit(ray);
+                if (m_pScene->hit(hit) == false) {
+                    radiance += throughput * m_pScene->backgroundColor();
+                    break;
+                }
+                
                 // update stats
-                hit.m_uTraceDepth = _iDepth+1;
+                hit.m_uTraceDepth = uDepth;
                 m_uTraceDepthMax = std::max(hit.m_uTraceDepth, m_uTraceDepthMax);
                 
                 // normal hit -- complete hit
                 hit.m_pPrimitive->intersect(hit);
                 
                 // create scattered, reflected, refracted, etc. ray and color
-                auto scatteredRay = hit.m_pPrimitive->material()->scatter(hit);
-                auto tracedColor = scatteredRay.m_emitted;
-
-                // trace recursively and blend colors
-                if ( (hit.m_uTraceDepth < m_uTraceLimit) && (scatteredRay.m_color.isBlack() == false) ) {
-                    // move slightly to avoid self intersection
-                    scatteredRay.m_ray.m_origin = scatteredRay.m_ray.position(T_MIN);
+                const auto *pMaterial = hit.m_pPrimitive->material(hit);
+                countScatter(pMaterial->name());
+                auto scatteredRay = pMaterial->scatter(hit);
+                
+                if ( (fBsdfPdf > 0) && (hit.m_pPrimitive->isLight() == true) ) {
+                    radiance += throughput * scatteredRay.m_emitted * lightHitWeight(m_pScene, hit.m_pPrimitive, lastPosition, ray.m_direction, fBsdfPdf);
+                }
+                else {
+                    radiance += throughput * scatteredRay.m_emitted;
+                }
+                
+                if ( (uDepth >= m_uTraceLimit) || (scatteredRay.m_color.isBlack() == true) ) {
+                    break;
+                }
+                
+                // direct light sampling
+                fBsdfPdf = 0.0f;
+                if ( (pMaterial->isLambertian() == true) && (m_pScene->lights().empty() == false) ) {
+                    auto surface = hit.m_pPrimitive->transformRayFrom(Ray(hit.m_position, hit.m_normal));
+                    radiance += throughput * sampleLights(m_pScene, surface.m_origin, surface.m_direction, pMaterial->albedo(hit));
+                    lastPosition = surface.m_origin;
+                    fBsdfPdf = std::max(hit.m_normal * scatteredRay.m_ray.m_direction, 0.0f) / pi;
+                }
+                
+                throughput *= scatteredRay.m_color;
+                
+                // russian roulette
+                if ( (m_uRouletteDepth > 0) && (uDepth >= m_uRouletteDepth) ) {
+                    float fSurvive = std::min(std::max(std::max(throughput.red(), throughput.green()), throughput.blue()), 1.0f);
+                    if (random01() >= fSurvive) {
+                        break;
+                    }
                     
-                    // transform ray back to world space
-                    scatteredRay.m_ray = hit.m_pPrimitive->transformRayFrom(scatteredRay.m_ray);
-
-                    // recursively trace again
-                    tracedColor += scatteredRay.m_color * traceRay(scatteredRay.m_ray, _iDepth + 1);
+                    throughput /= fSurvive;
                 }
-
-                return tracedColor;
+                
+                // move slightly to avoid self intersection
+                scatteredRay.m_ray.m_origin = scatteredRay.m_ray.position(T_MIN);
+                
+                // transform ray back to world space
+                ray = hit.m_pPrimitive->transformRayFrom(scatteredRay.m_ray);
             }
 
-            return m_pScene->backgroundColor();
+            return radiance;
         }
         
      private:
         const Scene     *m_pScene;
         uint16_t        m_uTraceLimit;
+        uint16_t        m_uRouletteDepth;
         uint16_t        m_uTraceDepthMax;
         uint64_t        m_uRayCount;
     };
 
 
     /*
-     Ray marching on provided signed distance function.
+     Ray marching settings (per marched primitive).
+     Epsilon (hit distance) may grow with distance along the ray, so far away surfaces need fewer steps. Steps may be
+     over-relaxed (m_fRelaxation times the distance bound), falling back to plain sphere tracing after an overshoot.
+     Defaults are plain sphere tracing, since materials like Glow/FakeAmbientOcclusion are coloured by step count.
+     */
+    struct MarchSettings
+    {
+        int         m_iMaxSteps = 1000;             // march budget (steps per hit check; exhausted budget is a miss)
+        float       m_fEpsilon = 1e-5f;             // hit distance at ray origin
+        float       m_fEpsilonGrowth = 0.0f;        // hit distance growth per unit distance on ray
+        float       m_fRelaxation = 1.0f;           // over-relaxation step scale (1 for plain sphere tracing)
+        float       m_fCrossingScale = 0.8f;        // step scale reduction after crossing the surface (inexact distance bounds)
+    };
+
+
+    /* Ray marching stats (march steps per hit check; updated by all worker threads) */
+    class MarchStats
+    {
+     public:
+        MarchStats()
+            :m_uHits(0),
+             m_uMisses(0),
+             m_uBudgetMisses(0),
+             m_uSteps(0)
+        {}
+        
+        void push(bool _bHit, bool _bBudget, int _iSteps) {
+            (_bHit ? m_uHits : m_uMisses).fetch_add(1, std::memory_order_relaxed);
+            m_uSteps.fetch_add((uint64_t)_iSteps, std::memory_order_relaxed);
+            if (_bBudget == true) {
+                m_uBudgetMisses.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        
+        uint64_t hits() const {return m_uHits;}
+        uint64_t misses() const {return m_uMisses;}
+        uint64_t budgetMisses() const {return m_uBudgetMisses;}
+        uint64_t steps() const {return m_uSteps;}
+        
+        /* mean number of steps per hit check */
+        double stepsPerCheck() const {
+            auto uChecks = m_uHits + m_uMisses;
+            return uChecks > 0 ? (double)m_uSteps / uChecks : 0.0;
+        }
+        
+        void print(const char *_pszName) const {
+            printf("%s march: hits=%llu, misses=%llu, budget_misses=%llu, steps_per_check=%.1f\n",
+                   _pszName, (unsigned long long)hits(), (unsigned long long)misses(), (unsigned long long)budgetMisses(), stepsPerCheck());
+        }
+        
+     private:
+        std::atomic<uint64_t>       m_uHits;
+        std::atomic<uint64_t>       m_uMisses;
+        std::atomic<uint64_t>       m_uBudgetMisses;
+        std::atomic<uint64_t>       m_uSteps;
+    };
+
+
+    /*
+     Ray marching on provided signed distance function (starts at _fStartPos and misses beyond _fMaxDist on ray).
      Attributes populated in _hit:
         - m_position
         - m_bInside
-        - m_uHitIterationCount
+        - m_uMarchDepth
         - m_fPositionOnRay
      */
     template <typename sdf_func>
-    bool check_marched_hit(Intersect &_hit, float _fMaxDist, const sdf_func &_sdf)
+    bool check_marched_hit(Intersect &_hit, float _fMaxDist, const sdf_func &_sdf,
+                           const MarchSettings &_settings = MarchSettings(), MarchStats *_pStats = nullptr,
+                           float _fStartPos = 0.0f)
     {
-        // TODO: play with these values and maybe adjust dynamically for best performance
-        // TODO: exit criteria could include min stepScale
-        const int maxSamples = 100000;
-        const float e = 0.00001f;
-        float stepScale = 1.0f;
-        float distance = 0.0f;
-        
         // first step (check inside/outside)
-        _hit.m_position = _hit.m_priRay.position(0);
-        float dT = _sdf(_hit.m_position);
+        _hit.m_position = _hit.m_priRay.position(_fStartPos);
+        float fDist = _sdf(_hit.m_position);
+        _hit.m_bInside = fDist < 0;
         
-        if (dT < 0) {
-            _hit.m_bInside = true;
-            stepScale *= -1;
-        }
-        else {
-            _hit.m_bInside = false;
-        }
+        const float fSign = _hit.m_bInside ? -1.0f : 1.0f;
+        float fRelaxation = _settings.m_fRelaxation;
+        float fStepScale = 1.0f;
+        float fPos = _fStartPos;
+        float fLastPos = _fStartPos;    // last position stepped from
+        float fLastDist = 0.0f;         // distance bound at last position
+        bool bHit = false;
+        int i = 0;
         
-        // iterate until we hit or miss
-        for (int i = 0; i < maxSamples; i++) {
+        // iterate until we hit or miss (distances are positive on the starting side of the surface)
+        for (; i < _settings.m_iMaxSteps; i++) {
+            float d = fDist * fSign;
+            
             // check hit or miss
-            float absd = fabs(dT);
-            if (absd > _fMaxDist) {
-                _hit.m_uMarchDepth = (uint16_t)i;
-                return false;  // missed
-            }
-            else if (absd <= e) {
-                _hit.m_fPositionOnRay = distance + dT * stepScale;
-                _hit.m_uMarchDepth = (uint16_t)i;
-                return true;    // hit
+            if (fabs(d) <= _settings.m_fEpsilon + _settings.m_fEpsilonGrowth * fPos) {
+                bHit = true;
+                break;
             }
             
-            // move forward
-            distance += dT * stepScale;
+            if (fPos > _fMaxDist) {
+                break;
+            }
             
-            // check for surface crossing
-            _hit.m_position = _hit.m_priRay.position(distance);
-            auto dM = _sdf(_hit.m_position);
-            if (dT * dM < -e) {
-                stepScale *= 0.8;
+            if ( (fRelaxation > 1.0f) && (fPos > fLastPos) &&
+                 ( (d < 0) || (fLastDist + d < fPos - fLastPos) ) )
+            {
+                // over-relaxed step overshot (surface crossed or distance spheres don't overlap): plain step from last position
+                fRelaxation = 1.0f;
+                fPos = fLastPos + fLastDist;
+            }
+            else if (d < 0) {
+                // crossed surface: step back with smaller steps
+                fStepScale *= _settings.m_fCrossingScale;
+                fPos += d * fStepScale;
+            }
+            else {
+                fLastPos = fPos;
+                fLastDist = d;
+                fPos += d * fRelaxation * fStepScale;
             }
             
-            dT = dM;
+            _hit.m_position = _hit.m_priRay.position(fPos);
+            fDist = _sdf(_hit.m_position);
+        }
+        
+        _hit.m_uMarchDepth = (uint16_t)std::min(i, (int)UINT16_MAX);
+        countEvent(Counter::MARCH_STEPS, (uint64_t)i);
+        if (bHit == true) {
+            _hit.m_fPositionOnRay = fPos;
+        }
+        
+        if (_pStats != nullptr) {
+            _pStats->push(bHit, (bHit == false) && (i >= _settings.m_iMaxSteps), i);
         }
         
-        return false;       // missed
+        return bHit;
     }
     
 
@@ -279,10 +279,10 @@ namespace LNF
         Bounds &operator=(Bounds &&) noexcept = default;
         
         double area() const {
-            Vec dist = m_max - m_min;            
-            return 2 * dist.x() * dist.x() +
-                   2 * dist.y() * dist.y() +
-                   2 * dist.z() * dist.z();
+            Vec dist = m_max - m_min;
+            return 2 * dist.x() * dist.y() +
+                   2 * dist.y() * dist.z() +
+                   2 * dist.z() * dist.x();
         }
         
         double volume() const {
@@ -294,6 +294,10 @@ namespace LNF
             return m_max - m_min;
         }
         
+        Vec center() const {
+            return (m_min + m_max) * 0.5f;
+        }
+        
         Vec     m_min;
         Vec     m_max;
     };
@@ -319,7 +323,7 @@ namespace LNF
 
     
     // combine bounds into one
-    Bounds combineBoxes(const Bounds &_left, Bounds &_right) {
+    Bounds combineBoxes(const Bounds &_left, const Bounds &_right) {
         return Bounds(perElementMin(_left.m_min, _right.m_min),
                       perElementMax(_left.m_max, _right.m_max));
     }
@@ -445,21 +449,31 @@ namespace LNF
 
     // returns a vector within the unit cube (-1..1, -1..1, -1..1)
     inline Vec randomUnitCube() {
-        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
-        auto &rgen = generator();
-        return Vec(dist(rgen), dist(rgen), dist(rgen));
+        float x = random01() * 2 - 1;
+        float y = random01() * 2 - 1;
+        float z = random01() * 2 - 1;
+        return Vec(x, y, z);
     }
 
     
     // returns a vector within the unit disc (-1..1, -1..1, 0)
     inline Vec randomUnitSquare() {
-        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
-        auto &rgen = generator();
-        return Vec(dist(rgen), dist(rgen), 0);
+        float x = random01() * 2 - 1;
+        float y = random01() * 2 - 1;
+        return Vec(x, y, 0);
     }
 
     
-    // returns a vector within the unit sphere (radius of 1)
+    // returns a vector on the surface of the unit sphere (radius of 1)
+    inline Vec randomUnitSphereSurface() {
+        float z = 1 - 2 * random01();
+        float phi = 2 * pi * random01();
+        float r = sqrt(std::max(0.0f, 1 - z * z));
+        return Vec(r * cos(phi), r * sin(phi), z);
+    }
+
+
+    // returns a vector within the unit sphere (radius of 1; rejection sampling is faster than the closed form with cbrt/sin/cos)
     inline Vec randomUnitSphere() {
         Vec ret = randomUnitCube();
         while (ret.sizeSqr() > 1) {
@@ -470,14 +484,33 @@ namespace LNF
     }
 
 
-    // returns a vector within the unit disc (y/x plane, radius of 1)
-    inline Vec randomUnitDisc() {
-        Vec ret = randomUnitSquare();        
-        while (ret.sizeSqr() > 1) {
-            ret = randomUnitSquare();
+    // maps [0..1, 0..1] to the unit disc (y/x plane, radius of 1; concentric mapping keeps strata intact)
+    inline Vec mapUnitDisc(float _fU, float _fV) {
+        float a = 2 * _fU - 1;
+        float b = 2 * _fV - 1;
+        if ( (a == 0) && (b == 0) ) {
+            return Vec();
         }
         
-        return ret;
+        float r, phi;
+        if (fabs(a) > fabs(b)) {
+            r = a;
+            phi = (pi / 4) * (b / a);
+        }
+        else {
+            r = b;
+            phi = (pi / 2) - (pi / 4) * (a / b);
+        }
+        
+        return Vec(r * cos(phi), r * sin(phi), 0);
+    }
+
+
+    // returns a vector within the unit disc (y/x plane, radius of 1)
+    inline Vec randomUnitDisc() {
+        float u = random01();
+        float v = random01();
+        return mapUnitDisc(u, v);
     }
 
 
@@ -591,7 +624,8 @@ namespace LNF
             e1,
             _normal,
             e2,
-            _origin
+            _origin,
+            1.0f
         };
     }
     
@@ -0,0 +1,179 @@
+#ifndef LIBS_HEADER_WAVEFRONT_H
+#define LIBS_HEADER_WAVEFRONT_H
+
+
+#include "color.h"
+#include "constants.h"
+#include "counters.h"
+#include "intersect.h"
+#include "material.h"
+#include "primitive.h"
+#include "random.h"
+#include "ray.h"
+#include "scene.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+
+namespace LNF
+{
+    /*
+        Wavefront (stream) path tracer.
+        Traces a batch of rays one bounce at a time: all active paths are intersected with the scene first, then
+        the hits are sorted by material and primitive and completed/scattered group by group before the next bounce.
+        Uses the same Scene/Primitive/Material interfaces (and path throughput/roulette/light sampling logic) as RayTracer.
+    */
+    class WavefrontTracer
+    {
+     public:
+        WavefrontTracer(const Scene *_pScene, uint16_t _uMaxTraceDepth, uint16_t _uRouletteDepth = RayTracer::DEFAULT_ROULETTE_DEPTH)
+            :m_pScene(_pScene),
+             m_uTraceLimit(_uMaxTraceDepth),
+             m_uRouletteDepth(_uRouletteDepth),
+             m_uTraceDepthMax(0),
+             m_uRayCount(0)
+        {}
+        
+        /*
+         Trace all rays; _colors receives one color per ray.
+         Every path draws from its own random generator (_pRandom gives the initial generator state per ray,
+         otherwise paths are seeded from the thread's generator), so results do not depend on the processing order.
+         */
+        void trace(const std::vector<Ray> &_rays, std::vector<Color> &_colors, const std::vector<default_rand_type> *_pRandom = nullptr) {
+            _colors.assign(_rays.size(), Color());
+            
+            m_paths.clear();
+            m_paths.reserve(_rays.size());
+            for (size_t i = 0; i < _rays.size(); i++) {
+                auto random = _pRandom != nullptr ? (*_pRandom)[i] : default_rand_type(generator()(), i);
+                m_paths.push_back({_rays[i], Color(1.0f, 1.0f, 1.0f), Vec(), random, 0.0f, (uint32_t)i});
+            }
+            
+            for (uint16_t uDepth = 1; m_paths.empty() == false; uDepth++) {
+                m_uRayCount += m_paths.size();
+                countRay(uDepth, m_paths.size());
+                m_uTraceDepthMax = std::max(uDepth, m_uTraceDepthMax);
+                
+                // intersect stage
+                m_hits.clear();
+                for (uint32_t i = 0; i < (uint32_t)m_paths.size(); i++) {
+                    auto &path = m_paths[i];
+                    Intersect hit(path.m_ray);
+                    
+                    generator() = path.m_random;
+                    bool bHit = m_pScene->hit(hit);
+                    path.m_random = generator();
+                    
+                    if (bHit == true) {
+                        hit.m_uTraceDepth = uDepth;
+                        m_hits.push_back({hit, hit.m_pPrimitive->material(hit), hit.m_pPrimitive->primitive(), i});
+                    }
+                    else {
+                        _colors[path.m_uIndex] += path.m_throughput * m_pScene->backgroundColor();
+                    }
+                }
+                
+                // sort hits by material and primitive
+                m_order.resize(m_hits.size());
+                std::iota(m_order.begin(), m_order.end(), 0);
+                std::sort(m_order.begin(), m_order.end(), [this](uint32_t _a, uint32_t _b) {
+                    const auto &a = m_hits[_a];
+                    const auto &b = m_hits[_b];
+                    return (a.m_pMaterial < b.m_pMaterial) ||
+                           ( (a.m_pMaterial == b.m_pMaterial) && (a.m_pPrimitive < b.m_pPrimitive) );
+                });
+                
+                // complete intersects and scatter (group by group)
+                m_nextPaths.clear();
+                for (auto uHit : m_order) {
+                    auto &record = m_hits[uHit];
+                    auto &hit = record.m_hit;
+                    const auto &path = m_paths[record.m_uPath];
+                    generator() = path.m_random;
+                    
+                    hit.m_pPrimitive->intersect(hit);
+                    countScatter(record.m_pMaterial->name());
+                    auto scatteredRay = record.m_pMaterial->scatter(hit);
+                    
+                    if ( (path.m_fBsdfPdf > 0) && (hit.m_pPrimitive->isLight() == true) ) {
+                        _colors[path.m_uIndex] += path.m_throughput * scatteredRay.m_emitted *
+                                                  lightHitWeight(m_pScene, hit.m_pPrimitive, path.m_lastPosition, path.m_ray.m_direction, path.m_fBsdfPdf);
+                    }
+                    else {
+                        _colors[path.m_uIndex] += path.m_throughput * scatteredRay.m_emitted;
+                    }
+                    
+                    if ( (uDepth >= m_uTraceLimit) || (scatteredRay.m_color.isBlack() == true) ) {
+                        continue;
+                    }
+                    
+                    // direct light sampling
+                    Vec lastPosition;
+                    float fBsdfPdf = 0.0f;
+                    if ( (record.m_pMaterial->isLambertian() == true) && (m_pScene->lights().empty() == false) ) {
+                        auto surface = hit.m_pPrimitive->transformRayFrom(Ray(hit.m_position, hit.m_normal));
+                        _colors[path.m_uIndex] += path.m_throughput * sampleLights(m_pScene, surface.m_origin, surface.m_direction, record.m_pMaterial->albedo(hit));
+                        lastPosition = surface.m_origin;
+                        fBsdfPdf = std::max(hit.m_normal * scatteredRay.m_ray.m_direction, 0.0f) / pi;
+                    }
+                    
+                    Color throughput = path.m_throughput * scatteredRay.m_color;
+                    
+                    // russian roulette
+                    if ( (m_uRouletteDepth > 0) && (uDepth >= m_uRouletteDepth) ) {
+                        float fSurvive = std::min(std::max(std::max(throughput.red(), throughput.green()), throughput.blue()), 1.0f);
+                        if (random01() >= fSurvive) {
+                            continue;
+                        }
+                        
+                        throughput /= fSurvive;
+                    }
+                    
+                    // move slightly to avoid self intersection and transform ray back to world space
+                    scatteredRay.m_ray.m_origin = scatteredRay.m_ray.position(T_MIN);
+                    m_nextPaths.push_back({hit.m_pPrimitive->transformRayFrom(scatteredRay.m_ray), throughput, lastPosition, generator(), fBsdfPdf, path.m_uIndex});
+                }
+                
+                std::swap(m_paths, m_nextPaths);
+            }
+        }
+        
+        uint16_t traceDepthMax() const {return m_uTraceDepthMax;}
+        uint64_t rayCount() const {return m_uRayCount;}
+        
+     private:
+        struct Path {
+            Ray                 m_ray;
+            Color               m_throughput;
+            Vec                 m_lastPosition; // last lambertian surface point (view space)
+            default_rand_type   m_random;       // path random generator state
+            float               m_fBsdfPdf;     // pdf of scattered direction (0 if lights were not sampled)
+            uint32_t            m_uIndex;       // index of camera ray
+        };
+        
+        struct HitRecord {
+            Intersect           m_hit;
+            const Material      *m_pMaterial;
+            const Primitive     *m_pPrimitive;
+            uint32_t            m_uPath;
+        };
+        
+     private:
+        const Scene                 *m_pScene;
+        uint16_t                    m_uTraceLimit;
+        uint16_t                    m_uRouletteDepth;
+        uint16_t                    m_uTraceDepthMax;
+        uint64_t                    m_uRayCount;
+        std::vector<Path>           m_paths;
+        std::vector<Path>           m_nextPaths;
+        std::vector<HitRecord>      m_hits;
+        std::vector<uint32_t>       m_order;
+    };
+    
+
+};  // namespace LNF
+
+#endif  // #ifndef LIBS_HEADER_WAVEFRONT_H
@@ -0,0 +1,286 @@
+#ifndef RAYTRACER_BENCH_KERNELS_H
+#define RAYTRACER_BENCH_KERNELS_H
+
+#include "lnf/color.h"
+#include "lnf/intersect.h"
+#include "lnf/json.h"
+#include "lnf/loaders.h"
+#include "lnf/mesh.h"
+#include "lnf/random.h"
+#include "lnf/ray.h"
+#include "lnf/signed_distance_functions.h"
+#include "lnf/simd.h"
+#include "lnf/sphere.h"
+#include "lnf/vec3.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+
+namespace LNF
+{
+    /*
+     Fixed kernel inputs, generated from a single PCG32 stream, so every run (and every build)
+     times the same rays, boxes, triangles, points and colors.
+     */
+    struct KernelData
+    {
+        static constexpr int COUNT = 4096;          // inputs per kernel batch
+        static constexpr int BVH_WIDTH = 128;       // camera rays per BVH batch (width x height)
+        static constexpr int BVH_HEIGHT = 96;
+
+        explicit KernelData(uint32_t _uSeed)
+            :m_uSeed(_uSeed)
+        {
+            Pcg32 rng(_uSeed);
+            auto rand01 = [&]() {return (rng() >> 8) * (1.0f / 16777216.0f);};
+            auto randomCube = [&](float _fSize) {return Vec(rand01() * 2 - 1, rand01() * 2 - 1, rand01() * 2 - 1) * _fSize;};
+
+            for (int i = 0; i < COUNT; i++) {
+                // rays start around the unit cube and point towards it (a mix of hits and misses)
+                auto origin = randomCube(4.0f);
+                auto target = randomCube(1.0f);
+                m_rays.emplace_back(origin, (target - origin).normalized());
+
+                auto boxMin = randomCube(1.0f) * 0.75f;
+                m_boxes.emplace_back(boxMin, boxMin + Vec(rand01(), rand01(), rand01()) + Vec(0.1f, 0.1f, 0.1f));
+
+                m_vertices.push_back(randomCube(1.0f));
+                m_vertices.push_back(randomCube(1.0f));
+                m_vertices.push_back(randomCube(1.0f));
+
+                m_points.push_back(randomCube(1.2f));
+                m_colors.emplace_back(rand01(), rand01(), rand01());
+            }
+
+            for (int i = 0; i < BVH_WIDTH * BVH_HEIGHT; i++) {
+                m_jitter.emplace_back(rand01(), rand01());
+            }
+        }
+
+        /* pinhole camera rays through a jittered pixel grid (same mapping as Frame, without depth of field) */
+        std::vector<Ray> cameraRays(const Camera &_camera, float _fViewAspect) const {
+            std::vector<Ray> rays;
+            const float fFovScale = tan(_camera.fov() * 0.5f);
+            const Axis &axis = _camera.axis();
+            const Vec origin = axis.transformFrom(Vec(0, 0, 0));
+            for (int j = 0; j < BVH_HEIGHT; j++) {
+                for (int i = 0; i < BVH_WIDTH; i++) {
+                    const auto &jitter = m_jitter[j * BVH_WIDTH + i];
+                    const float y = (1 - 2 * (j + jitter.v()) / BVH_HEIGHT) * fFovScale;
+                    const float x = (2 * (i + jitter.u()) / BVH_WIDTH - 1) * _fViewAspect * fFovScale;
+                    auto focus = axis.transformFrom(Vec(-x, y, 1).normalized());
+                    rays.emplace_back(origin, (focus - origin).normalized());
+                }
+            }
+
+            return rays;
+        }
+
+        uint32_t                m_uSeed;
+        std::vector<Ray>        m_rays;
+        std::vector<Bounds>     m_boxes;
+        std::vector<Vec>        m_vertices;     // 3 per triangle
+        std::vector<Vec>        m_points;
+        std::vector<Color>      m_colors;
+        std::vector<Uv>         m_jitter;       // sub-pixel offsets for BVH camera rays
+    };
+
+
+    /*
+     Times one kernel: _kernel processes all _uOps inputs and returns a checksum of its results
+     (keeps the work from being optimised away and shows that two runs did the same work).
+     Batches repeat until at least _fMinTimeS has passed (and at least 3 batches); the fastest batch is kept.
+     */
+    template <typename kernel_func>
+    JsonValue timeKernel(const char *_pszName, size_t _uOps, double _fMinTimeS, const kernel_func &_kernel) {
+        double fBestS = 0;
+        double fTotalS = 0;
+        double fChecksum = 0;
+        int iBatches = 0;
+        while ( (iBatches < 3) || (fTotalS < _fMinTimeS) ) {
+            auto tpStart = std::chrono::steady_clock::now();
+            fChecksum = _kernel();
+            auto fTimeS = std::chrono::duration<double>(std::chrono::steady_clock::now() - tpStart).count();
+
+            fBestS = (iBatches == 0) ? fTimeS : std::min(fBestS, fTimeS);
+            fTotalS += fTimeS;
+            iBatches++;
+        }
+
+        const double fNsPerOp = fBestS * 1e9 / _uOps;
+        printf("  %-28s %10.2f ns/op  (%d x %zu ops, checksum %.6g)\n", _pszName, fNsPerOp, iBatches, _uOps, fChecksum);
+
+        auto result = JsonValue::object();
+        result.set("name", _pszName);
+        result.set("ops", (double)_uOps);
+        result.set("batches", iBatches);
+        result.set("ns_per_op", fNsPerOp);
+        result.set("checksum", fChecksum);
+        return result;
+    }
+
+
+    /* runs all kernel microbenchmarks (BVH traversal for each of _bvhScenes); returns the results as a JSON array */
+    inline JsonValue runKernels(uint32_t _uSeed, double _fMinTimeS, const std::vector<int> &_bvhScenes, float _fViewAspect) {
+        const KernelData data(_uSeed);
+        const size_t uCount = KernelData::COUNT;
+        auto kernels = JsonValue::array();
+        printf("kernels (seed %u):\n", _uSeed);
+
+        kernels.push(timeKernel("aabox_intersect_check", uCount, _fMinTimeS, [&]() {
+            double fHits = 0;
+            for (size_t i = 0; i < uCount; i++) {
+                fHits += aaboxIntersectCheck(data.m_boxes[i], data.m_rays[i]) ? 1 : 0;
+            }
+
+            return fHits;
+        }));
+
+        kernels.push(timeKernel("aabox_intersect_check_inv", uCount, _fMinTimeS, [&]() {
+            double fHits = 0;
+            for (size_t i = 0; i < uCount; i++) {
+                const auto &ray = data.m_rays[i];
+                fHits += aaboxIntersectCheck(data.m_boxes[i], ray.m_origin, ray.m_invDirection) ? 1 : 0;
+            }
+
+            return fHits;
+        }));
+
+        kernels.push(timeKernel("aabox_intersect", uCount, _fMinTimeS, [&]() {
+            double fSum = 0;
+            for (size_t i = 0; i < uCount; i++) {
+                auto hit = aaboxIntersect(data.m_boxes[i], data.m_rays[i]);
+                fSum += hit.m_intersect ? hit.m_tmin : 0;
+            }
+
+            return fSum;
+        }));
+
+        kernels.push(timeKernel("triangle_intersect", uCount, _fMinTimeS, [&]() {
+            double fSum = 0;
+            for (size_t i = 0; i < uCount; i++) {
+                float fT = 0;
+                Uv uv;
+                if (triangleIntersect(fT, uv, data.m_rays[i], data.m_vertices[i*3], data.m_vertices[i*3 + 1], data.m_vertices[i*3 + 2]) == true) {
+                    fSum += fT;
+                }
+            }
+
+            return fSum;
+        }));
+
+        kernels.push(timeKernel("sphere_hit", uCount, _fMinTimeS, [&]() {
+            const Sphere sphere(1.0f, nullptr);
+            double fSum = 0;
+            for (size_t i = 0; i < uCount; i++) {
+                Intersect hit;
+                hit.m_priRay = data.m_rays[i];
+                if (sphere.hit(hit) == true) {
+                    fSum += hit.m_fPositionOnRay;
+                }
+            }
+
+            return fSum;
+        }));
+
+        kernels.push(timeKernel("sdf_mandle", uCount, _fMinTimeS, [&]() {
+            double fSum = 0;
+            for (size_t i = 0; i < uCount; i++) {
+                int iIterations = 0;
+                fSum += sdfMandle(data.m_points[i], iIterations);
+            }
+
+            return fSum;
+        }));
+
+        kernels.push(timeKernel("sdf_mandle_x4", uCount, _fMinTimeS, [&]() {
+            double fSum = 0;
+            for (size_t i = 0; i + 4 <= uCount; i += 4) {
+                alignas(16) float fX[4], fY[4], fZ[4], fSdf[4];
+                for (int k = 0; k < 4; k++) {
+                    fX[k] = data.m_points[i + k].x();
+                    fY[k] = data.m_points[i + k].y();
+                    fZ[k] = data.m_points[i + k].z();
+                }
+
+                Float4 iterations;
+                sdfMandle(Float4::load(fX), Float4::load(fY), Float4::load(fZ), iterations).store(fSdf);
+                fSum += fSdf[0] + fSdf[1] + fSdf[2] + fSdf[3];
+            }
+
+            return fSum;
+        }));
+
+        kernels.push(timeKernel("sdf_bubbles", uCount, _fMinTimeS, [&]() {
+            double fSum = 0;
+            for (size_t i = 0; i < uCount; i++) {
+                fSum += sdfBubbles(data.m_points[i], 0.0f, 2.0f);
+            }
+
+            return fSum;
+        }));
+
+        kernels.push(timeKernel("sdf_bubbles_x4", uCount, _fMinTimeS, [&]() {
+            const SdfBubbles sdf(0.0f, 2.0f);
+            double fSum = 0;
+            for (size_t i = 0; i < uCount; i++) {
+                fSum += sdf(data.m_points[i]);
+            }
+
+            return fSum;
+        }));
+
+        kernels.push(timeKernel("random_unit_sphere", uCount, _fMinTimeS, [&]() {
+            seed(_uSeed);
+            double fSum = 0;
+            for (size_t i = 0; i < uCount; i++) {
+                fSum += randomUnitSphere().x();
+            }
+
+            return fSum;
+        }));
+
+        kernels.push(timeKernel("color_stat_push", uCount, _fMinTimeS, [&]() {
+            ColorStat stat;
+            for (size_t i = 0; i < uCount; i++) {
+                stat.push(data.m_colors[i]);
+            }
+
+            auto mean = stat.mean();
+            return (double)mean.red() + mean.green() + mean.blue() + stat.variance();
+        }));
+
+        for (auto iScene : _bvhScenes) {
+            auto pLoader = createSceneLoader(iScene);
+            auto pScene = pLoader->loadScene();
+            auto pCamera = pLoader->loadCamera();
+            const auto rays = data.cameraRays(*pCamera, _fViewAspect);
+            const std::string strName = std::string("bvh_traverse_") + pLoader->name();
+
+            auto result = timeKernel(strName.c_str(), rays.size(), _fMinTimeS, [&]() {
+                double fSum = 0;
+                for (const auto &ray : rays) {
+                    Intersect hit(ray);
+                    if (pScene->hit(hit) == true) {
+                        fSum += hit.m_fViewPositionOnRay;
+                    }
+                }
+
+                return fSum;
+            });
+
+            result.set("scene", iScene);
+            kernels.push(std::move(result));
+        }
+
+        return kernels;
+    }
+
+};  // namespace LNF
+
+#endif  // #ifndef RAYTRACER_BENCH_KERNELS_H
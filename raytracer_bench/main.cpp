@@ -0,0 +1,471 @@
+#include "lnf/constants.h"
+#include "lnf/frame.h"
+#include "lnf/json.h"
+#include "lnf/loaders.h"
+#include "lnf/viewport.h"
+#include "kernels.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+
+
+using namespace LNF;
+
+
+/* Benchmark settings (fixed resolution, samples and seed, so runs are comparable) */
+struct Settings
+{
+    int                 m_iWidth = 320;
+    int                 m_iHeight = 240;
+    int                 m_iSamplesPerPixel = 16;
+    int                 m_iMaxTraceDepth = 64;
+    uint32_t            m_uRandSeed = 1;
+    int                 m_iTileSize = 32;
+    int                 m_iRepeat = 1;
+    std::vector<int>    m_scenes;               // example scenes (default all)
+    std::vector<int>    m_threads;              // thread counts (default 1, 2, 4, ... hardware threads)
+    std::string         m_strOutput = "bench.json";
+    std::string         m_strBaseline;          // earlier report to compare against
+    std::string         m_strLabel;             // e.g. version or commit
+    float               m_fTolerance = 0.05f;   // allowed Mrays/s drop (or ns/op rise) before a run counts as a regression
+    bool                m_bKernels = false;     // time kernel microbenchmarks instead of whole frames
+    int                 m_iKernelTimeMs = 200;  // minimum time per kernel
+    bool                m_bHelp = false;        // print usage and exit
+};
+
+
+void printUsage(const char *_pszApp) {
+    printf("usage: %s [options]\n", _pszApp);
+    printf("  --width <pixels>       image width (default 320)\n");
+    printf("  --height <pixels>      image height (default 240)\n");
+    printf("  --spp <samples>        samples per pixel (default 16)\n");
+    printf("  --depth <bounces>      max trace depth (default 64)\n");
+    printf("  --seed <seed>          random seed (default 1)\n");
+    printf("  --tile <pixels>        tile size, 0 renders lines (default 32)\n");
+    printf("  --scenes <i,j,..>      example scenes to run (default 0-%d)\n", EXAMPLE_SCENE_COUNT - 1);
+    printf("  --threads <n,m,..>     thread counts per scene (default 1, 2, 4, .. hardware threads)\n");
+    printf("  --repeat <count>       renders per run, the fastest is kept (default 1)\n");
+    printf("  --output <path>        JSON report (default bench.json)\n");
+    printf("  --baseline <path>      compare against an earlier JSON report (exit code 2 on regressions)\n");
+    printf("  --tolerance <percent>  allowed Mrays/s drop against the baseline (default 5)\n");
+    printf("  --label <text>         label stored in the report (e.g. version)\n");
+    printf("  --kernels              time kernel microbenchmarks (ns/op) instead of whole frames;\n");
+    printf("                         --scenes selects the BVH traversal scenes (default meshes and instances)\n");
+    printf("  --kernel-time <ms>     minimum time per kernel (default 200)\n");
+    printf("  --help                 show this message\n");
+}
+
+
+/* parses comma separated integers; returns false on bad values */
+bool parseList(const char *_pszList, std::vector<int> &_values) {
+    _values.clear();
+    const char *p = _pszList;
+    while (*p != 0) {
+        char *pszEnd = nullptr;
+        _values.push_back((int)strtol(p, &pszEnd, 10));
+        if ( (pszEnd == p) || ( (*pszEnd != ',') && (*pszEnd != 0) ) ) {
+            return false;
+        }
+
+        p = *pszEnd == ',' ? pszEnd + 1 : pszEnd;
+    }
+
+    return _values.empty() == false;
+}
+
+
+/* parses command line into _settings; returns false on bad arguments */
+bool parseArgs(int _argc, char *_argv[], Settings &_settings) {
+    for (int i = 1; i < _argc; i++) {
+        const char *pszArg = _argv[i];
+        auto value = [&](int &_iValue) {
+            if (i + 1 >= _argc) {
+                return false;
+            }
+
+            char *pszEnd = nullptr;
+            _iValue = (int)strtol(_argv[++i], &pszEnd, 10);
+            return *pszEnd == 0;
+        };
+
+        int iValue = 0;
+        bool bOk = true;
+        if (strcmp(pszArg, "--width") == 0) {
+            bOk = value(_settings.m_iWidth) && (_settings.m_iWidth > 0);
+        }
+        else if (strcmp(pszArg, "--height") == 0) {
+            bOk = value(_settings.m_iHeight) && (_settings.m_iHeight > 0);
+        }
+        else if (strcmp(pszArg, "--spp") == 0) {
+            bOk = value(_settings.m_iSamplesPerPixel) && (_settings.m_iSamplesPerPixel > 0);
+        }
+        else if (strcmp(pszArg, "--depth") == 0) {
+            bOk = value(_settings.m_iMaxTraceDepth) && (_settings.m_iMaxTraceDepth > 0);
+        }
+        else if (strcmp(pszArg, "--seed") == 0) {
+            bOk = value(iValue);
+            _settings.m_uRandSeed = (uint32_t)iValue;
+        }
+        else if (strcmp(pszArg, "--tile") == 0) {
+            bOk = value(_settings.m_iTileSize) && (_settings.m_iTileSize >= 0);
+        }
+        else if (strcmp(pszArg, "--repeat") == 0) {
+            bOk = value(_settings.m_iRepeat) && (_settings.m_iRepeat > 0);
+        }
+        else if ( (strcmp(pszArg, "--scenes") == 0) && (i + 1 < _argc) ) {
+            bOk = parseList(_argv[++i], _settings.m_scenes);
+            for (auto iScene : _settings.m_scenes) {
+                bOk &= (iScene >= 0) && (iScene < EXAMPLE_SCENE_COUNT);
+            }
+        }
+        else if ( (strcmp(pszArg, "--threads") == 0) && (i + 1 < _argc) ) {
+            bOk = parseList(_argv[++i], _settings.m_threads);
+            for (auto iThreads : _settings.m_threads) {
+                bOk &= iThreads > 0;
+            }
+        }
+        else if ( (strcmp(pszArg, "--output") == 0) && (i + 1 < _argc) ) {
+            _settings.m_strOutput = _argv[++i];
+        }
+        else if ( (strcmp(pszArg, "--baseline") == 0) && (i + 1 < _argc) ) {
+            _settings.m_strBaseline = _argv[++i];
+        }
+        else if (strcmp(pszArg, "--tolerance") == 0) {
+            bOk = value(iValue) && (iValue >= 0);
+            _settings.m_fTolerance = iValue * 0.01f;
+        }
+        else if ( (strcmp(pszArg, "--label") == 0) && (i + 1 < _argc) ) {
+            _settings.m_strLabel = _argv[++i];
+        }
+        else if (strcmp(pszArg, "--kernels") == 0) {
+            _settings.m_bKernels = true;
+        }
+        else if (strcmp(pszArg, "--kernel-time") == 0) {
+            bOk = value(_settings.m_iKernelTimeMs) && (_settings.m_iKernelTimeMs >= 0);
+        }
+        else if (strcmp(pszArg, "--help") == 0) {
+            _settings.m_bHelp = true;
+        }
+        else {
+            bOk = false;
+        }
+
+        if (bOk == false) {
+            fprintf(stderr, "ERROR: bad argument '%s'\n", pszArg);
+            return false;
+        }
+    }
+
+    if ( (_settings.m_scenes.empty() == true) && (_settings.m_bKernels == true) ) {
+        _settings.m_scenes = {4, 6};
+    }
+    else if (_settings.m_scenes.empty() == true) {
+        for (int i = 0; i < EXAMPLE_SCENE_COUNT; i++) {
+            _settings.m_scenes.push_back(i);
+        }
+    }
+
+    if (_settings.m_threads.empty() == true) {
+        const int iHardwareThreads = (int)std::max(std::thread::hardware_concurrency(), 1u);
+        for (int n = 1; n < iHardwareThreads; n *= 2) {
+            _settings.m_threads.push_back(n);
+        }
+
+        _settings.m_threads.push_back(iHardwareThreads);
+    }
+
+    return true;
+}
+
+
+/* restarts peak resident memory tracking (Linux only, elsewhere the peak is for the whole process) */
+void resetPeakMemory() {
+    FILE *pFile = fopen("/proc/self/clear_refs", "w");
+    if (pFile != nullptr) {
+        fputs("5", pFile);
+        fclose(pFile);
+    }
+}
+
+
+/* returns peak resident memory (MB) since the last reset */
+double peakMemoryMb() {
+    FILE *pFile = fopen("/proc/self/status", "r");
+    if (pFile != nullptr) {
+        char szLine[256];
+        long lPeakKb = -1;
+        while (fgets(szLine, sizeof(szLine), pFile) != nullptr) {
+            if (strncmp(szLine, "VmHWM:", 6) == 0) {
+                lPeakKb = strtol(szLine + 6, nullptr, 10);
+                break;
+            }
+        }
+
+        fclose(pFile);
+        if (lPeakKb >= 0) {
+            return lPeakKb / 1024.0;
+        }
+    }
+
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0);     // bytes
+#else
+    return usage.ru_maxrss / 1024.0;                // KB
+#endif
+}
+
+
+/* returns render counters as JSON (hot path events, scatter calls per material type, rays per depth) */
+JsonValue countersJson(const RenderCounters &_counters) {
+    auto result = JsonValue::object();
+    for (int i = 0; i < (int)Counter::COUNT; i++) {
+        result.set(counterName((Counter)i), (double)_counters.m_uCounts[i]);
+    }
+
+    auto &scatters = result.set("scatter_calls", JsonValue::object());
+    for (int i = 0; i < _counters.m_iMaterials; i++) {
+        scatters.set(_counters.m_pszMaterials[i], (double)_counters.m_uScatters[i]);
+    }
+
+    if (_counters.m_uScatters[RenderCounters::MAX_MATERIALS] > 0) {
+        scatters.set("other", (double)_counters.m_uScatters[RenderCounters::MAX_MATERIALS]);
+    }
+
+    auto &depths = result.set("rays_per_depth", JsonValue::array());
+    int iMaxDepth = RenderCounters::MAX_DEPTH - 1;
+    while ( (iMaxDepth > 1) && (_counters.m_uDepthRays[iMaxDepth] == 0) ) {
+        iMaxDepth--;
+    }
+
+    for (int i = 1; i <= iMaxDepth; i++) {
+        depths.push((double)_counters.m_uDepthRays[i]);
+    }
+
+    return result;
+}
+
+
+/* renders scene once per thread count (counters are from the first render) */
+JsonValue runScene(const Settings &_settings, int _iScene) {
+    auto pLoader = createSceneLoader(_iScene);
+    const Viewport viewport(_settings.m_iWidth, _settings.m_iHeight);
+    resetPeakMemory();
+
+    auto tpStart = std::chrono::steady_clock::now();
+    auto pScene = pLoader->loadScene();
+    auto fBuildTimeS = std::chrono::duration<double>(std::chrono::steady_clock::now() - tpStart).count();
+    auto pCamera = pLoader->loadCamera();
+
+    auto result = JsonValue::object();
+    result.set("index", _iScene);
+    result.set("name", pLoader->name());
+    result.set("build_time_s", fBuildTimeS);
+    printf("scene %d (%s): build %.3fs\n", _iScene, pLoader->name(), fBuildTimeS);
+
+    auto runs = JsonValue::array();
+    double fSingleThreadMrays = 0;
+    for (auto iThreads : _settings.m_threads) {
+        double fFrameTimeS = 0;
+        double fMraysPerS = 0;
+        for (int i = 0; i < _settings.m_iRepeat; i++) {
+            auto tpFrame = std::chrono::steady_clock::now();
+            Frame frame(&viewport,
+                        pCamera.get(),
+                        pScene.get(),
+                        iThreads,
+                        _settings.m_iSamplesPerPixel,
+                        _settings.m_iMaxTraceDepth,
+                        0.0f,
+                        _settings.m_uRandSeed,
+                        _settings.m_iTileSize,
+                        TileOrder::SPIRAL);
+
+            frame.waitFinished();
+            auto fTimeS = std::chrono::duration<double>(std::chrono::steady_clock::now() - tpFrame).count();
+            if (result.has("counters") == false) {
+                result.set("counters", countersJson(frame.counters()));
+            }
+
+            if ( (i == 0) || (fTimeS < fFrameTimeS) ) {
+                fFrameTimeS = fTimeS;
+                fMraysPerS = frame.raysPerSecond() * 1e-6;
+            }
+        }
+
+        if (iThreads == 1) {
+            fSingleThreadMrays = fMraysPerS;
+        }
+
+        auto &run = runs.push(JsonValue::object());
+        run.set("threads", iThreads);
+        run.set("frame_time_s", fFrameTimeS);
+        run.set("mrays_per_s", fMraysPerS);
+        if (fSingleThreadMrays > 0) {
+            run.set("speedup", fMraysPerS / fSingleThreadMrays);
+        }
+
+        printf("  threads=%d, frame=%.3fs, mrays_ps=%.3f\n", iThreads, fFrameTimeS, fMraysPerS);
+    }
+
+    // set after the loop ("counters" is added to result inside the loop, moving its members)
+    result.set("runs", std::move(runs));
+    result.set("peak_rss_mb", peakMemoryMb());
+    return result;
+}
+
+
+/* prints Mrays/s changes against a baseline report; returns the number of regressions */
+int compareReports(const JsonValue &_report, const JsonValue &_baseline, float _fTolerance) {
+    int iRegressions = 0;
+    printf("%-14s %8s %12s %12s %8s\n", "scene", "threads", "base_mrays", "mrays", "change");
+    for (const auto &scene : _report["scenes"].items()) {
+        const JsonValue *pBaseScene = nullptr;
+        for (const auto &baseScene : _baseline["scenes"].items()) {
+            if (baseScene["name"].string() == scene["name"].string()) {
+                pBaseScene = &baseScene;
+            }
+        }
+
+        if (pBaseScene == nullptr) {
+            continue;
+        }
+
+        for (const auto &run : scene["runs"].items()) {
+            for (const auto &baseRun : (*pBaseScene)["runs"].items()) {
+                const double fBase = baseRun["mrays_per_s"].number();
+                if ( (baseRun["threads"].number() != run["threads"].number()) || (fBase <= 0) ) {
+                    continue;
+                }
+
+                const double fChange = run["mrays_per_s"].number() / fBase - 1;
+                const bool bRegression = fChange < -_fTolerance;
+                iRegressions += bRegression ? 1 : 0;
+                printf("%-14s %8d %12.3f %12.3f %+7.1f%%%s\n", scene["name"].string().c_str(), (int)run["threads"].number(),
+                       fBase, run["mrays_per_s"].number(), fChange * 100, bRegression ? "  REGRESSION" : "");
+            }
+        }
+    }
+
+    return iRegressions;
+}
+
+
+/* prints ns/op changes against a baseline report; returns the number of regressions */
+int compareKernels(const JsonValue &_report, const JsonValue &_baseline, float _fTolerance) {
+    int iRegressions = 0;
+    printf("%-28s %12s %12s %8s\n", "kernel", "base_ns", "ns", "change");
+    for (const auto &kernel : _report["kernels"].items()) {
+        for (const auto &baseKernel : _baseline["kernels"].items()) {
+            const double fBase = baseKernel["ns_per_op"].number();
+            if ( (baseKernel["name"].string() != kernel["name"].string()) || (fBase <= 0) ) {
+                continue;
+            }
+
+            // a different checksum means different inputs or results (e.g. another seed), so times may not compare
+            const double fChange = kernel["ns_per_op"].number() / fBase - 1;
+            const bool bRegression = fChange > _fTolerance;
+            const double fChecksum = kernel["checksum"].number();
+            const double fBaseChecksum = baseKernel["checksum"].number();
+            const bool bSameWork = fabs(fChecksum - fBaseChecksum) <= 1e-6 * std::max(fabs(fBaseChecksum), 1.0);   // reports store 9 digits
+            iRegressions += bRegression ? 1 : 0;
+            printf("%-28s %12.2f %12.2f %+7.1f%%%s%s\n", kernel["name"].string().c_str(), fBase, kernel["ns_per_op"].number(),
+                   fChange * 100, bRegression ? "  REGRESSION" : "", bSameWork ? "" : "  (checksum differs)");
+        }
+    }
+
+    return iRegressions;
+}
+
+
+int main(int argc, char *argv[])
+{
+    Settings settings;
+    if (parseArgs(argc, argv, settings) == false) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (settings.m_bHelp == true) {
+        printUsage(argv[0]);
+        return 0;
+    }
+
+    auto report = JsonValue::object();
+    report.set("label", settings.m_strLabel);
+
+    auto &build = report.set("build", JsonValue::object());
+#ifdef __VERSION__
+    build.set("compiler", __VERSION__);
+#endif
+#ifdef NDEBUG
+    build.set("optimized", true);
+#else
+    build.set("optimized", false);
+#endif
+    build.set("date", __DATE__);
+
+    report.set("hardware_threads", (int)std::thread::hardware_concurrency());
+
+    auto &config = report.set("settings", JsonValue::object());
+    config.set("width", settings.m_iWidth);
+    config.set("height", settings.m_iHeight);
+    config.set("spp", settings.m_iSamplesPerPixel);
+    config.set("depth", settings.m_iMaxTraceDepth);
+    config.set("seed", (double)settings.m_uRandSeed);
+    config.set("tile", settings.m_iTileSize);
+    config.set("repeat", settings.m_iRepeat);
+
+    if (settings.m_bKernels == true) {
+        const Viewport viewport(settings.m_iWidth, settings.m_iHeight);
+        config.set("kernel_time_ms", settings.m_iKernelTimeMs);
+        report.set("kernels", runKernels(settings.m_uRandSeed, settings.m_iKernelTimeMs * 1e-3, settings.m_scenes, viewport.viewAspect()));
+    }
+    else {
+        auto &scenes = report.set("scenes", JsonValue::array());
+        for (auto iScene : settings.m_scenes) {
+            scenes.push(runScene(settings, iScene));
+        }
+    }
+
+    FILE *pFile = fopen(settings.m_strOutput.c_str(), "w");
+    if (pFile == nullptr) {
+        fprintf(stderr, "ERROR: can't open %s\n", settings.m_strOutput.c_str());
+        return 1;
+    }
+
+    const std::string strReport = report.dump(2);
+    fprintf(pFile, "%s\n", strReport.c_str());
+    fclose(pFile);
+    printf("report written to %s\n", settings.m_strOutput.c_str());
+
+    if (settings.m_strBaseline.empty() == false) {
+        JsonValue baseline;
+        std::string strError;
+        if (JsonValue::parseFile(settings.m_strBaseline, baseline, &strError) == false) {
+            fprintf(stderr, "ERROR: can't read baseline: %s\n", strError.c_str());
+            return 1;
+        }
+
+        int iRegressions = settings.m_bKernels ? compareKernels(report, baseline, settings.m_fTolerance) :
+                                                 compareReports(report, baseline, settings.m_fTolerance);
+        if (iRegressions > 0) {
+            printf("%d regressions (more than %.0f%% slower)\n", iRegressions, settings.m_fTolerance * 100);
+            return 2;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,436 @@
+#include "lnf/animation.h"
+#include "lnf/constants.h"
+#include "lnf/distributed.h"
+#include "lnf/frame.h"
+#include "lnf/image_output.h"
+#include "lnf/loaders.h"
+#include "lnf/sampler.h"
+#include "lnf/scene_file.h"
+#include "lnf/viewport.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+
+using namespace LNF;
+
+
+/* Render settings (defaults match the Qt raytracer) */
+struct Settings
+{
+    int             m_iWidth = 1024;
+    int             m_iHeight = 768;
+    int             m_iSamplesPerPixel = 128;
+    int             m_iMaxTraceDepth = 64;
+    int             m_iNumWorkers = (int)std::max(std::thread::hardware_concurrency(), 1u);
+    uint32_t        m_uRandSeed = 1;
+    int             m_iScene = 0;
+    int             m_iTileSize = 32;
+    int             m_iSamplesPerPass = 0;
+    TracerType      m_tracerType = TracerType::DEPTH_FIRST;
+    std::string     m_strOutput;
+    std::string     m_strMesh;                  // OBJ/PLY mesh file (replaces the example scene)
+    bool            m_bCompactMesh = false;
+    std::string     m_strSceneFile;             // JSON scene description (replaces the example scene)
+    std::string     m_strTexture;               // JPEG texture for the mesh
+    int             m_iFirstFrame = -1;         // animation frame range (-1 renders a still)
+    int             m_iLastFrame = -1;
+    int             m_iQuality = 100;
+    bool            m_bProgress = true;
+    int             m_iServePort = 0;           // run as render node on this port
+    std::vector<std::string> m_nodes;           // render nodes (host:port) for a distributed frame
+    bool            m_bCounters = false;        // print render counters when done
+    std::string     m_strTrace;                 // Chrome trace of job timing
+    std::string     m_strCostHeatmap;           // render time per pixel heatmap
+    bool            m_bHelp = false;            // print usage and exit
+};
+
+
+void printUsage(const char *_pszApp) {
+    printf("usage: %s [options]\n", _pszApp);
+    printf("  --width <pixels>       image width (default 1024)\n");
+    printf("  --height <pixels>      image height (default 768)\n");
+    printf("  --spp <samples>        max samples per pixel (default 128)\n");
+    printf("  --depth <bounces>      max trace depth (default 64)\n");
+    printf("  --threads <count>      worker threads (default: hardware threads)\n");
+    printf("  --seed <seed>          random seed (default 1)\n");
+    printf("  --scene <index>        example scene 0-7 (default 0)\n");
+    printf("  --mesh <path>          render an OBJ/PLY mesh file (cached as <path>.lnfcache)\n");
+    printf("  --scene-file <path>    render a JSON scene description (its settings are defaults for these options)\n");
+    printf("  --compact              compact mesh storage (quantized; less memory, slower)\n");
+    printf("  --texture <path>       JPEG texture for the mesh (tiles cached as <path>.lnftex)\n");
+    printf("  --tile <pixels>        tile size, 0 renders lines (default 32)\n");
+    printf("  --pass <samples>       progressive samples per pass, 0 is a single pass (default 0)\n");
+    printf("  --wavefront            use the wavefront tracer\n");
+    printf("  --frames <first>-<last> render animation frames (numbered image sequence)\n");
+    printf("  --output <path>        output image file, .jpeg, .png or .exr (default raytraced.jpeg; animation: printf pattern, default raytraced_%%04d.jpeg)\n");
+    printf("  --quality <1-100>      JPEG quality (default 100)\n");
+    printf("  --serve <port>         run as render node (renders tiles for --nodes coordinators)\n");
+    printf("  --nodes <host:port,..> render the frame on render nodes (example scenes, single pass)\n");
+    printf("  --counters             print render counters (BVH nodes, primitive/triangle tests, march steps, ..)\n");
+    printf("  --trace <path>         write job timing as a Chrome trace (chrome://tracing, ui.perfetto.dev)\n");
+    printf("  --cost-heatmap <path>  write render time per pixel as a heatmap image\n");
+    printf("  --quiet                no progress output (waits for the frame without polling)\n");
+    printf("  --help                 show this message\n");
+}
+
+
+/* parses command line into _settings; returns false on bad arguments */
+bool parseArgs(int _argc, char *_argv[], Settings &_settings) {
+    for (int i = 1; i < _argc; i++) {
+        const char *pszArg = _argv[i];
+        auto value = [&](int &_iValue) {
+            if (i + 1 >= _argc) {
+                return false;
+            }
+
+            char *pszEnd = nullptr;
+            _iValue = (int)strtol(_argv[++i], &pszEnd, 10);
+            return *pszEnd == 0;
+        };
+
+        int iValue = 0;
+        bool bOk = true;
+        if (strcmp(pszArg, "--width") == 0) {
+            bOk = value(_settings.m_iWidth) && (_settings.m_iWidth > 0);
+        }
+        else if (strcmp(pszArg, "--height") == 0) {
+            bOk = value(_settings.m_iHeight) && (_settings.m_iHeight > 0);
+        }
+        else if (strcmp(pszArg, "--spp") == 0) {
+            bOk = value(_settings.m_iSamplesPerPixel) && (_settings.m_iSamplesPerPixel > 0);
+        }
+        else if (strcmp(pszArg, "--depth") == 0) {
+            bOk = value(_settings.m_iMaxTraceDepth) && (_settings.m_iMaxTraceDepth > 0);
+        }
+        else if (strcmp(pszArg, "--threads") == 0) {
+            bOk = value(_settings.m_iNumWorkers) && (_settings.m_iNumWorkers > 0);
+        }
+        else if (strcmp(pszArg, "--seed") == 0) {
+            bOk = value(iValue);
+            _settings.m_uRandSeed = (uint32_t)iValue;
+        }
+        else if (strcmp(pszArg, "--scene") == 0) {
+            bOk = value(_settings.m_iScene);
+        }
+        else if ( (strcmp(pszArg, "--mesh") == 0) && (i + 1 < _argc) ) {
+            _settings.m_strMesh = _argv[++i];
+        }
+        else if ( (strcmp(pszArg, "--scene-file") == 0) && (i + 1 < _argc) ) {
+            _settings.m_strSceneFile = _argv[++i];
+        }
+        else if (strcmp(pszArg, "--compact") == 0) {
+            _settings.m_bCompactMesh = true;
+        }
+        else if ( (strcmp(pszArg, "--texture") == 0) && (i + 1 < _argc) ) {
+            _settings.m_strTexture = _argv[++i];
+        }
+        else if (strcmp(pszArg, "--tile") == 0) {
+            bOk = value(_settings.m_iTileSize) && (_settings.m_iTileSize >= 0);
+        }
+        else if (strcmp(pszArg, "--pass") == 0) {
+            bOk = value(_settings.m_iSamplesPerPass) && (_settings.m_iSamplesPerPass >= 0);
+        }
+        else if (strcmp(pszArg, "--wavefront") == 0) {
+            _settings.m_tracerType = TracerType::WAVEFRONT;
+        }
+        else if ( (strcmp(pszArg, "--frames") == 0) && (i + 1 < _argc) ) {
+            char *pszEnd = nullptr;
+            const char *pszRange = _argv[++i];
+            _settings.m_iFirstFrame = (int)strtol(pszRange, &pszEnd, 10);
+            bOk = (*pszEnd == '-') && (_settings.m_iFirstFrame >= 0);
+            if (bOk == true) {
+                _settings.m_iLastFrame = (int)strtol(pszEnd + 1, &pszEnd, 10);
+                bOk = (*pszEnd == 0) && (_settings.m_iLastFrame >= _settings.m_iFirstFrame);
+            }
+        }
+        else if ( (strcmp(pszArg, "--output") == 0) && (i + 1 < _argc) ) {
+            _settings.m_strOutput = _argv[++i];
+        }
+        else if (strcmp(pszArg, "--quality") == 0) {
+            bOk = value(_settings.m_iQuality) && (_settings.m_iQuality >= 1) && (_settings.m_iQuality <= 100);
+        }
+        else if (strcmp(pszArg, "--serve") == 0) {
+            bOk = value(_settings.m_iServePort) && (_settings.m_iServePort > 0) && (_settings.m_iServePort < 65536);
+        }
+        else if ( (strcmp(pszArg, "--nodes") == 0) && (i + 1 < _argc) ) {
+            std::string strNodes = _argv[++i];
+            for (size_t uStart = 0; uStart <= strNodes.size(); ) {
+                size_t uEnd = std::min(strNodes.find(',', uStart), strNodes.size());
+                if (uEnd > uStart) {
+                    _settings.m_nodes.push_back(strNodes.substr(uStart, uEnd - uStart));
+                }
+
+                uStart = uEnd + 1;
+            }
+
+            bOk = _settings.m_nodes.empty() == false;
+        }
+        else if (strcmp(pszArg, "--counters") == 0) {
+            _settings.m_bCounters = true;
+        }
+        else if ( (strcmp(pszArg, "--trace") == 0) && (i + 1 < _argc) ) {
+            _settings.m_strTrace = _argv[++i];
+        }
+        else if ( (strcmp(pszArg, "--cost-heatmap") == 0) && (i + 1 < _argc) ) {
+            _settings.m_strCostHeatmap = _argv[++i];
+        }
+        else if (strcmp(pszArg, "--quiet") == 0) {
+            _settings.m_bProgress = false;
+        }
+        else if (strcmp(pszArg, "--help") == 0) {
+            _settings.m_bHelp = true;
+        }
+        else {
+            bOk = false;
+        }
+
+        if (bOk == false) {
+            fprintf(stderr, "ERROR: bad argument '%s'\n", pszArg);
+            return false;
+        }
+    }
+
+    if (_settings.m_strOutput.empty() == true) {
+        _settings.m_strOutput = _settings.m_iFirstFrame >= 0 ? "raytraced_%04d.jpeg" : "raytraced.jpeg";
+    }
+
+    return true;
+}
+
+
+/* applies render settings from a scene file (command line options are parsed again afterwards and take precedence) */
+void applySceneSettings(const JsonValue &_json, Settings &_settings) {
+    _settings.m_iWidth = std::max((int)_json["width"].number(_settings.m_iWidth), 1);
+    _settings.m_iHeight = std::max((int)_json["height"].number(_settings.m_iHeight), 1);
+    _settings.m_iSamplesPerPixel = std::max((int)_json["spp"].number(_settings.m_iSamplesPerPixel), 1);
+    _settings.m_iMaxTraceDepth = std::max((int)_json["depth"].number(_settings.m_iMaxTraceDepth), 1);
+    _settings.m_iNumWorkers = std::max((int)_json["threads"].number(_settings.m_iNumWorkers), 1);
+    _settings.m_uRandSeed = (uint32_t)_json["seed"].number(_settings.m_uRandSeed);
+    _settings.m_iTileSize = std::max((int)_json["tile"].number(_settings.m_iTileSize), 0);
+    _settings.m_iSamplesPerPass = std::max((int)_json["pass"].number(_settings.m_iSamplesPerPass), 0);
+    _settings.m_iQuality = std::clamp((int)_json["quality"].number(_settings.m_iQuality), 1, 100);
+    _settings.m_strOutput = _json["output"].string(_settings.m_strOutput);
+    if (_json["wavefront"].boolean(false) == true) {
+        _settings.m_tracerType = TracerType::WAVEFRONT;
+    }
+}
+
+
+/* renders animation frame range to an image sequence */
+int renderAnimation(const Settings &_settings, const Loader &_loader, const Viewport *_pViewport, Scene *_pScene) {
+    auto pAnimation = _loader.loadAnimation(_pScene);
+    if (pAnimation == nullptr) {
+        fprintf(stderr, "ERROR: scene %s is not animated\n", _loader.name());
+        return 1;
+    }
+
+    if (isFramePathPattern(_settings.m_strOutput) == false) {
+        fprintf(stderr, "ERROR: output pattern '%s' needs exactly one integer conversion (e.g. frame_%%04d.jpeg)\n", _settings.m_strOutput.c_str());
+        return 1;
+    }
+
+    auto createFrame = [&](const Camera *_pCamera, const std::shared_ptr<PixelWorkerPool> &_pWorkers) {
+        return std::make_unique<Frame>(_pViewport,
+                                       _pCamera,
+                                       _pScene,
+                                       _settings.m_iNumWorkers,
+                                       _settings.m_iSamplesPerPixel,
+                                       _settings.m_iMaxTraceDepth,
+                                       0.0f,
+                                       _settings.m_uRandSeed,
+                                       _settings.m_iTileSize,
+                                       TileOrder::SPIRAL,
+                                       ProgressiveSettings{_settings.m_iSamplesPerPass, 0.0f, 0.0f, 0.0f},
+                                       _settings.m_tracerType,
+                                       SamplerType::SOBOL,
+                                       _pWorkers);
+    };
+
+    auto tpStart = std::chrono::steady_clock::now();
+    AnimationRenderer renderer(pAnimation.get(), _pScene, createFrame);
+    int iResult = renderer.render(_settings.m_iFirstFrame, std::min(_settings.m_iLastFrame, pAnimation->frameCount() - 1),
+                                  _settings.m_strOutput, _settings.m_iQuality,
+                                  [&](int _iFrame, Frame &_frame, const std::string &_strPath) {
+                                      if (_settings.m_bProgress == true) {
+                                          printf("frame %d done %.2fs, rays_ps=%.2f, output=%s\n", _iFrame, _frame.timeTotal(), _frame.raysPerSecond(), _strPath.c_str());
+                                      }
+                                  });
+
+    auto fTimeS = std::chrono::duration<float>(std::chrono::steady_clock::now() - tpStart).count();
+    printf("done %.2fs, frames=%d-%d\n", fTimeS, _settings.m_iFirstFrame, std::min(_settings.m_iLastFrame, pAnimation->frameCount() - 1));
+    return iResult == 0 ? 0 : 1;
+}
+
+
+/* renders a still on render nodes */
+int renderDistributed(const Settings &_settings, const Viewport *_pViewport, const Camera *_pCamera) {
+    DistributedFrame frame(_settings.m_nodes,
+                           _settings.m_iScene,
+                           _pViewport,
+                           _pCamera,
+                           _settings.m_iSamplesPerPixel,
+                           _settings.m_iMaxTraceDepth,
+                           _settings.m_uRandSeed,
+                           _settings.m_iTileSize,
+                           TileOrder::SPIRAL,
+                           _settings.m_tracerType);
+
+    if (_settings.m_bProgress == true) {
+        while (frame.isFinished() == false) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            printf("progress=%.2f, total_time=%.2fs, rays_ps=%.2f, failed_nodes=%d\n",
+                   frame.progress(), frame.timeTotal(), frame.raysPerSecond(), frame.failedNodes());
+        }
+    }
+    else {
+        frame.waitFinished();
+    }
+
+    if (frame.incompleteTiles() > 0) {
+        fprintf(stderr, "ERROR: all render nodes failed, %d tiles not rendered\n", frame.incompleteTiles());
+        return 1;
+    }
+
+    const int iResult = frame.writeImageFile(_settings.m_strOutput, _settings.m_iQuality);
+    printf("done %.2fs, rays_ps=%.2f, nodes=%d, failed_nodes=%d, output=%s\n", frame.timeTotal(), frame.raysPerSecond(),
+           (int)_settings.m_nodes.size(), frame.failedNodes(), _settings.m_strOutput.c_str());
+    return iResult == 0 ? 0 : 1;
+}
+
+
+int main(int argc, char *argv[])
+{
+    Settings settings;
+    if (parseArgs(argc, argv, settings) == false) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (settings.m_bHelp == true) {
+        printUsage(argv[0]);
+        return 0;
+    }
+
+    // scene file settings are defaults for the command line options
+    std::unique_ptr<LoaderSceneFile> pSceneFile;
+    if (settings.m_strSceneFile.empty() == false) {
+        pSceneFile = std::make_unique<LoaderSceneFile>(settings.m_strSceneFile);
+        if (pSceneFile->loaded() == false) {
+            return 1;
+        }
+
+        settings = Settings();
+        applySceneSettings(pSceneFile->settings(), settings);
+        parseArgs(argc, argv, settings);
+    }
+
+    if (settings.m_iServePort > 0) {
+        RenderServer server(settings.m_iNumWorkers);
+        return server.serve((uint16_t)settings.m_iServePort) == 0 ? 0 : 1;
+    }
+
+    if ( (settings.m_nodes.empty() == false) &&
+         ( (settings.m_strMesh.empty() == false) || (pSceneFile != nullptr) || (settings.m_iFirstFrame >= 0) || (settings.m_iSamplesPerPass > 0) ) )
+    {
+        fprintf(stderr, "ERROR: render nodes only render example scene stills (no --mesh, --scene-file, --frames or --pass)\n");
+        return 1;
+    }
+
+    std::unique_ptr<Loader> pLoader;
+    if (pSceneFile != nullptr) {
+        pLoader = std::move(pSceneFile);
+    }
+    else if (settings.m_strMesh.empty() == false) {
+        pLoader = std::make_unique<LoaderMeshFile>(settings.m_strMesh, settings.m_bCompactMesh, settings.m_strTexture);
+    }
+    else {
+        pLoader = createSceneLoader(settings.m_iScene);
+    }
+
+    if (pLoader == nullptr) {
+        fprintf(stderr, "ERROR: unknown scene %d\n", settings.m_iScene);
+        return 1;
+    }
+
+    auto pViewport = std::make_unique<Viewport>(settings.m_iWidth, settings.m_iHeight);
+    auto pCamera = pLoader->loadCamera();
+    if (settings.m_nodes.empty() == false) {
+        return renderDistributed(settings, pViewport.get(), pCamera.get());
+    }
+
+    auto pScene = pLoader->loadScene();
+    if (settings.m_bProgress == true) {
+        if (const auto *pBvhScene = dynamic_cast<const SimpleSceneBvh*>(pScene.get())) {
+            pBvhScene->bvhStats().print("scene");
+        }
+        
+        pScene->memoryStats().print("scene");
+    }
+
+    if (settings.m_iFirstFrame >= 0) {
+        return renderAnimation(settings, *pLoader, pViewport.get(), pScene.get());
+    }
+
+    auto pFrame = std::make_unique<Frame>(pViewport.get(),
+                                          pCamera.get(),
+                                          pScene.get(),
+                                          settings.m_iNumWorkers,
+                                          settings.m_iSamplesPerPixel,
+                                          settings.m_iMaxTraceDepth,
+                                          0.0f,
+                                          settings.m_uRandSeed,
+                                          settings.m_iTileSize,
+                                          TileOrder::SPIRAL,
+                                          ProgressiveSettings{settings.m_iSamplesPerPass, 0.0f, 0.0f, 0.0f},
+                                          settings.m_tracerType);
+
+    // rows are written out while the frame renders
+    ImageOutput output;
+    auto result = output.write(pFrame.get(), settings.m_strOutput, settings.m_iQuality);
+
+    if (settings.m_bProgress == true) {
+        // poll progress (same output as the Qt raytracer)
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            pFrame->updateFrameProgress();
+            printf("active jobs=%d, progress=%.2f, time_to_finish=%.2fs, total_time=%.2fs, rays_ps=%.2f, passes=%d, noise=%.4f\n",
+                    (int)pFrame->activeJobs(), pFrame->progress(), pFrame->timeToFinish(), pFrame->timeTotal(), pFrame->raysPerSecond(),
+                    pFrame->passes(), pFrame->noise());
+
+            if (pFrame->isFinished() == true) {
+                break;
+            }
+        }
+    }
+    else {
+        pFrame->waitFinished();
+    }
+
+    int iResult = result.get();
+    printf("done %.2fs, rays_ps=%.2f, output=%s\n", pFrame->timeTotal(), pFrame->raysPerSecond(), settings.m_strOutput.c_str());
+
+    if (settings.m_bCounters == true) {
+        pFrame->counters().print("frame");
+    }
+
+    if ( (settings.m_strTrace.empty() == false) && (pFrame->writeTrace(settings.m_strTrace) != 0) ) {
+        fprintf(stderr, "ERROR: can't write trace %s\n", settings.m_strTrace.c_str());
+        iResult = -1;
+    }
+
+    if ( (settings.m_strCostHeatmap.empty() == false) && (pFrame->writeCostHeatmap(settings.m_strCostHeatmap, settings.m_iQuality) != 0) ) {
+        fprintf(stderr, "ERROR: can't write cost heatmap %s\n", settings.m_strCostHeatmap.c_str());
+        iResult = -1;
+    }
+
+    return iResult == 0 ? 0 : 1;
+}